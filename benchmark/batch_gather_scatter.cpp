@@ -0,0 +1,116 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <heyoka/batch_utils.hpp>
+
+using namespace heyoka;
+
+template <typename F>
+double time_it(const F &f)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    f();
+
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start)
+            .count());
+}
+
+// Benchmark the transposition of n_samples records
+// of n_vars values each from AoS into the batch layout
+// and back, in chunks of batch_size samples.
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+
+    std::uint32_t n_vars, batch_size, n_samples;
+
+    po::options_description desc("Options");
+
+    desc.add_options()("help", "produce help message")(
+        "n_vars", po::value<std::uint32_t>(&n_vars)->default_value(6u), "number of variables per sample")(
+        "batch_size", po::value<std::uint32_t>(&batch_size)->default_value(4u), "batch size")(
+        "n_samples", po::value<std::uint32_t>(&n_samples)->default_value(10000000u), "total number of samples");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 0;
+    }
+
+    if (batch_size == 0u) {
+        throw std::invalid_argument("The batch size cannot be zero");
+    }
+
+    std::vector<double> aos(static_cast<std::vector<double>::size_type>(n_samples) * n_vars), aos_out(aos.size(), 0.);
+    for (decltype(aos.size()) i = 0; i < aos.size(); ++i) {
+        aos[i] = static_cast<double>(i);
+    }
+
+    std::vector<double> batch(static_cast<std::vector<double>::size_type>(n_vars) * batch_size);
+
+    // NOTE: the last chunk may be a partial batch.
+    const auto n_chunks = n_samples / batch_size + static_cast<std::uint32_t>(n_samples % batch_size != 0u);
+
+    // Naive loops, as typically written by hand.
+    const auto naive = time_it([&]() {
+        for (std::uint32_t c = 0; c < n_chunks; ++c) {
+            const auto cur_n = std::min(batch_size, n_samples - c * batch_size);
+            const auto src = aos.data() + static_cast<std::size_t>(c) * batch_size * n_vars;
+            const auto dest = aos_out.data() + static_cast<std::size_t>(c) * batch_size * n_vars;
+
+            for (std::uint32_t i = 0; i < cur_n; ++i) {
+                for (std::uint32_t j = 0; j < n_vars; ++j) {
+                    batch[j * batch_size + i] = src[i * n_vars + j];
+                }
+            }
+            for (std::uint32_t i = 0; i < cur_n; ++i) {
+                for (std::uint32_t j = 0; j < n_vars; ++j) {
+                    dest[i * n_vars + j] = batch[j * batch_size + i];
+                }
+            }
+        }
+    });
+
+    if (aos_out != aos) {
+        throw std::runtime_error("Inconsistent results detected in the naive transposition");
+    }
+
+    std::fill(aos_out.begin(), aos_out.end(), 0.);
+
+    const auto tiled = time_it([&]() {
+        for (std::uint32_t c = 0; c < n_chunks; ++c) {
+            const auto cur_n = std::min(batch_size, n_samples - c * batch_size);
+            const auto offset = static_cast<std::size_t>(c) * batch_size * n_vars;
+
+            batch_gather(batch.data(), aos.data() + offset, n_vars, batch_size, cur_n);
+            batch_scatter(aos_out.data() + offset, batch.data(), n_vars, batch_size, cur_n);
+        }
+    });
+
+    if (aos_out != aos) {
+        throw std::runtime_error("Inconsistent results detected in batch_gather()/batch_scatter()");
+    }
+
+    std::cout << "Naive gather/scatter time: " << naive << "μs\n";
+    std::cout << "batch_gather()/batch_scatter() time: " << tiled << "μs\n";
+}
@@ -0,0 +1,85 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <heyoka/llvm_state.hpp>
+#include <heyoka/nbody.hpp>
+#include <heyoka/taylor.hpp>
+
+using namespace heyoka;
+
+// Benchmark the computation of the jet of derivatives of an N-body
+// system in scalar compact mode, with and without the vectorisation
+// of the derivative calls (see kw::compact_mode_simd).
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+
+    std::uint32_t order, n_bodies, n_evals;
+
+    po::options_description desc("Options");
+
+    desc.add_options()("help", "produce help message")("order", po::value<std::uint32_t>(&order)->default_value(20u),
+                                                       "Taylor order")(
+        "n_bodies", po::value<std::uint32_t>(&n_bodies)->default_value(16u), "number of bodies")(
+        "n_evals", po::value<std::uint32_t>(&n_evals)->default_value(1000u), "number of jet evaluations");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 0;
+    }
+
+    // Bodies on circular orbits around a central mass.
+    std::vector<double> init_state(n_bodies * 6u);
+    for (std::uint32_t i = 1; i < n_bodies; ++i) {
+        const auto r = static_cast<double>(i);
+
+        init_state[i * 6u] = r;
+        init_state[i * 6u + 1u] = 0.1 * r;
+        init_state[i * 6u + 4u] = 1. / std::sqrt(r);
+    }
+
+    for (auto c_simd : {false, true}) {
+        llvm_state s{kw::compact_mode_simd = c_simd};
+
+        taylor_add_jet<double>(s, "jet", make_nbody_sys(n_bodies), order, 1, false, true);
+
+        s.compile();
+
+        auto jptr = reinterpret_cast<void (*)(double *, const double *, const double *)>(s.jit_lookup("jet"));
+
+        std::vector<double> jet(n_bodies * 6u * (order + 1u));
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (std::uint32_t i = 0; i < n_evals; ++i) {
+            std::copy(init_state.begin(), init_state.end(), jet.begin());
+            jptr(jet.data(), nullptr, nullptr);
+        }
+
+        const auto elapsed = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start)
+                .count());
+
+        std::cout << "Compact mode SIMD " << (c_simd ? "on" : "off") << ", order " << order << ", " << n_bodies
+                  << " bodies: " << elapsed / n_evals << "ns\n";
+    }
+}
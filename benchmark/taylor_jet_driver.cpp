@@ -0,0 +1,115 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <heyoka/expression.hpp>
+#include <heyoka/llvm_state.hpp>
+#include <heyoka/math.hpp>
+#include <heyoka/taylor.hpp>
+
+using namespace heyoka;
+
+template <typename F>
+double time_it(const F &f)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    f();
+
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start)
+            .count());
+}
+
+// Benchmark the computation of the jets of derivatives of
+// the two-body problem for n_samples initial conditions,
+// comparing a scalar loop over the jet function with
+// the batched and multithreaded taylor_jet_driver.
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+
+    std::uint32_t order, batch_size;
+    std::size_t n_samples;
+
+    po::options_description desc("Options");
+
+    desc.add_options()("help", "produce help message")("order", po::value<std::uint32_t>(&order)->default_value(20u),
+                                                       "Taylor order")(
+        "batch_size", po::value<std::uint32_t>(&batch_size)->default_value(0u),
+        "batch size (0 to deduce it from the host machine)")(
+        "n_samples", po::value<std::size_t>(&n_samples)->default_value(1000000u), "number of initial conditions");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 0;
+    }
+
+    auto [vx0, vx1, vy0, vy1, vz0, vz1, x0, x1, y0, y1, z0, z1]
+        = make_vars("vx0", "vx1", "vy0", "vy1", "vz0", "vz1", "x0", "x1", "y0", "y1", "z0", "z1");
+
+    auto x01 = x1 - x0;
+    auto y01 = y1 - y0;
+    auto z01 = z1 - z0;
+    auto r01_m3 = pow(x01 * x01 + y01 * y01 + z01 * z01, -3_dbl / 2_dbl);
+
+    const auto sys = std::vector{x01 * r01_m3, -x01 * r01_m3, y01 * r01_m3, -y01 * r01_m3, z01 * r01_m3, -z01 * r01_m3,
+                                 vx0,          vx1,           vy0,          vy1,           vz0,          vz1};
+
+    // Random initial conditions, in SoA layout.
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> dist(-1., 1.);
+    std::vector<double> in(12u * n_samples);
+    for (auto &x : in) {
+        x = dist(rng);
+    }
+
+    std::vector<double> out(12u * (order + 1u) * n_samples);
+
+    // Scalar loop.
+    llvm_state s;
+    taylor_add_jet<double>(s, "jet", sys, order, 1, false, false);
+    s.compile();
+    auto jptr = reinterpret_cast<void (*)(double *, const double *, const double *)>(s.jit_lookup("jet"));
+
+    const auto scalar = time_it([&]() {
+        std::vector<double> jet(12u * (order + 1u));
+
+        for (std::size_t i = 0; i < n_samples; ++i) {
+            for (std::size_t j = 0; j < 12u; ++j) {
+                jet[j] = in[j * n_samples + i];
+            }
+
+            jptr(jet.data(), nullptr, nullptr);
+
+            for (std::size_t j = 0; j < jet.size(); ++j) {
+                out[j * n_samples + i] = jet[j];
+            }
+        }
+    });
+
+    // Jet driver.
+    taylor_jet_driver<double> jd{sys, order, kw::batch_size = batch_size};
+
+    const auto driver = time_it([&]() { jd(out.data(), in.data(), n_samples); });
+
+    std::cout << "Scalar loop time: " << scalar << "μs\n";
+    std::cout << "taylor_jet_driver time (batch size " << jd.get_batch_size() << "): " << driver << "μs\n";
+}
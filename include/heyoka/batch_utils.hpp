@@ -0,0 +1,319 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_BATCH_UTILS_HPP
+#define HEYOKA_BATCH_UTILS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+#include <heyoka/taylor.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+// Size of the square tiles used in the transpositions.
+// NOTE: the full tiles are transposed via loops
+// with fixed trip counts through a local buffer, which
+// allows the compiler to unroll them and to turn
+// the strided accesses into vector shuffles.
+inline constexpr std::uint32_t batch_transpose_tile = 8;
+
+inline void batch_check_args(const void *p1, const void *p2, std::uint32_t batch_size, std::uint32_t n_samples,
+                             const char *fname)
+{
+    if (p1 == nullptr || p2 == nullptr) {
+        throw std::invalid_argument(std::string("Null pointers cannot be passed to ") + fname + "()");
+    }
+
+    if (batch_size == 0u) {
+        throw std::invalid_argument(std::string("The batch size passed to ") + fname + "() cannot be zero");
+    }
+
+    if (n_samples == 0u || n_samples > batch_size) {
+        throw std::invalid_argument(std::string("The number of samples passed to ") + fname
+                                    + "() must be in the [1, batch size] range, but it is "
+                                    + std::to_string(n_samples) + " instead (the batch size is "
+                                    + std::to_string(batch_size) + ")");
+    }
+}
+
+// Copy a tile from the src buffer into the dest buffer, transposing it.
+// src_stride and dest_stride are the row strides of the two buffers.
+template <typename T>
+inline void batch_transpose_tile_impl(T *dest, std::size_t dest_stride, const T *src, std::size_t src_stride,
+                                      std::uint32_t n_rows, std::uint32_t n_cols)
+{
+    constexpr auto ts = batch_transpose_tile;
+
+    if (n_rows == ts && n_cols == ts) {
+        T buf[ts][ts];
+
+        for (std::uint32_t i = 0; i < ts; ++i) {
+            for (std::uint32_t j = 0; j < ts; ++j) {
+                buf[j][i] = src[i * src_stride + j];
+            }
+        }
+
+        for (std::uint32_t j = 0; j < ts; ++j) {
+            for (std::uint32_t i = 0; i < ts; ++i) {
+                dest[j * dest_stride + i] = buf[j][i];
+            }
+        }
+    } else {
+        for (std::uint32_t i = 0; i < n_rows; ++i) {
+            for (std::uint32_t j = 0; j < n_cols; ++j) {
+                dest[j * dest_stride + i] = src[i * src_stride + j];
+            }
+        }
+    }
+}
+
+// Transpose the n_rows x n_cols matrix src (row-major, with row stride src_stride)
+// into dest (row-major, with row stride dest_stride), tile by tile.
+template <typename T>
+inline void batch_transpose(T *dest, std::size_t dest_stride, const T *src, std::size_t src_stride,
+                            std::uint32_t n_rows, std::uint32_t n_cols)
+{
+    constexpr auto ts = batch_transpose_tile;
+
+    for (std::uint32_t i = 0; i < n_rows; i += ts) {
+        const auto nr = std::min(ts, n_rows - i);
+
+        for (std::uint32_t j = 0; j < n_cols; j += ts) {
+            const auto nc = std::min(ts, n_cols - j);
+
+            batch_transpose_tile_impl(dest + static_cast<std::size_t>(j) * dest_stride + i, dest_stride,
+                                      src + static_cast<std::size_t>(i) * src_stride + j, src_stride, nr, nc);
+        }
+    }
+}
+
+} // namespace detail
+
+// Copy n_samples records of n_vars values each from the buffer aos
+// (with layout [sample][var]) into the buffer batch (with layout
+// [var][lane], as used by the batch integrator). If n_samples is less
+// than batch_size, the remaining lanes are filled with copies of
+// the last sample, so that all the lanes of the batch
+// contain valid data.
+template <typename T>
+inline void batch_gather(T *batch, const T *aos, std::uint32_t n_vars, std::uint32_t batch_size,
+                         std::uint32_t n_samples)
+{
+    detail::batch_check_args(batch, aos, batch_size, n_samples, "batch_gather");
+
+    detail::batch_transpose(batch, batch_size, aos, n_vars, n_samples, n_vars);
+
+    // Padding of a partial batch.
+    for (std::uint32_t i = 0; i < n_vars; ++i) {
+        const auto row = batch + static_cast<std::size_t>(i) * batch_size;
+
+        std::fill(row + n_samples, row + batch_size, row[n_samples - 1u]);
+    }
+}
+
+// Copy the first n_samples lanes from the buffer batch (with layout
+// [var][lane]) into the buffer aos (with layout [sample][var]).
+template <typename T>
+inline void batch_scatter(T *aos, const T *batch, std::uint32_t n_vars, std::uint32_t batch_size,
+                          std::uint32_t n_samples)
+{
+    detail::batch_check_args(aos, batch, batch_size, n_samples, "batch_scatter");
+
+    detail::batch_transpose(aos, n_vars, batch, batch_size, n_vars, n_samples);
+}
+
+// Helpers to move the state vectors, the runtime
+// parameters and the times of n_samples records
+// between AoS buffers and a batch integrator.
+template <typename T>
+inline void gather_state(detail::taylor_adaptive_batch_impl<T> &ta, const T *aos, std::uint32_t n_samples)
+{
+    batch_gather(ta.get_state_data(), aos, ta.get_dim(), ta.get_batch_size(), n_samples);
+}
+
+template <typename T>
+inline void scatter_state(T *aos, const detail::taylor_adaptive_batch_impl<T> &ta, std::uint32_t n_samples)
+{
+    batch_scatter(aos, ta.get_state_data(), ta.get_dim(), ta.get_batch_size(), n_samples);
+}
+
+template <typename T>
+inline void gather_pars(detail::taylor_adaptive_batch_impl<T> &ta, const T *aos, std::uint32_t n_samples)
+{
+    const auto n_pars = static_cast<std::uint32_t>(ta.get_pars().size() / ta.get_batch_size());
+
+    if (n_pars > 0u) {
+        batch_gather(ta.get_pars_data(), aos, n_pars, ta.get_batch_size(), n_samples);
+    }
+}
+
+template <typename T>
+inline void scatter_pars(T *aos, const detail::taylor_adaptive_batch_impl<T> &ta, std::uint32_t n_samples)
+{
+    const auto n_pars = static_cast<std::uint32_t>(ta.get_pars().size() / ta.get_batch_size());
+
+    if (n_pars > 0u) {
+        batch_scatter(aos, ta.get_pars_data(), n_pars, ta.get_batch_size(), n_samples);
+    }
+}
+
+template <typename T>
+inline void gather_time(detail::taylor_adaptive_batch_impl<T> &ta, const T *aos, std::uint32_t n_samples)
+{
+    batch_gather(ta.get_time_data(), aos, 1, ta.get_batch_size(), n_samples);
+}
+
+template <typename T>
+inline void scatter_time(T *aos, const detail::taylor_adaptive_batch_impl<T> &ta, std::uint32_t n_samples)
+{
+    batch_scatter(aos, ta.get_time_data(), 1, ta.get_batch_size(), n_samples);
+}
+
+// Random-access iterator over the values of
+// a single lane in a [var][lane] buffer.
+template <typename T>
+class batch_lane_iterator
+    : public boost::iterator_facade<batch_lane_iterator<T>, T, boost::random_access_traversal_tag>
+{
+    friend class boost::iterator_core_access;
+
+    T *m_ptr = nullptr;
+    std::ptrdiff_t m_stride = 0;
+
+public:
+    batch_lane_iterator() = default;
+    explicit batch_lane_iterator(T *ptr, std::ptrdiff_t stride) : m_ptr(ptr), m_stride(stride) {}
+
+    // Conversion from mutable to const iterator.
+    template <typename U, std::enable_if_t<std::is_convertible_v<U *, T *>, int> = 0>
+    batch_lane_iterator(const batch_lane_iterator<U> &other) : m_ptr(other.base()), m_stride(other.stride())
+    {
+    }
+
+    T *base() const
+    {
+        return m_ptr;
+    }
+    std::ptrdiff_t stride() const
+    {
+        return m_stride;
+    }
+
+private:
+    T &dereference() const
+    {
+        return *m_ptr;
+    }
+    bool equal(const batch_lane_iterator &other) const
+    {
+        return m_ptr == other.m_ptr;
+    }
+    void increment()
+    {
+        m_ptr += m_stride;
+    }
+    void decrement()
+    {
+        m_ptr -= m_stride;
+    }
+    void advance(std::ptrdiff_t n)
+    {
+        m_ptr += n * m_stride;
+    }
+    std::ptrdiff_t distance_to(const batch_lane_iterator &other) const
+    {
+        return (other.m_ptr - m_ptr) / m_stride;
+    }
+};
+
+// View over the values of a single lane in a [var][lane]
+// buffer, i.e., over the record of a single sample
+// within a batch.
+template <typename T>
+class batch_lane_view
+{
+    T *m_ptr;
+    std::uint32_t m_n_vars, m_batch_size;
+
+public:
+    using iterator = batch_lane_iterator<T>;
+
+    explicit batch_lane_view(T *batch, std::uint32_t n_vars, std::uint32_t batch_size, std::uint32_t lane)
+        : m_ptr(batch + lane), m_n_vars(n_vars), m_batch_size(batch_size)
+    {
+        if (lane >= batch_size) {
+            throw std::invalid_argument("Cannot create a view of the lane " + std::to_string(lane)
+                                        + " in a batch of size " + std::to_string(batch_size));
+        }
+    }
+
+    std::uint32_t size() const
+    {
+        return m_n_vars;
+    }
+
+    T &operator[](std::uint32_t i) const
+    {
+        return m_ptr[static_cast<std::size_t>(i) * m_batch_size];
+    }
+
+    iterator begin() const
+    {
+        return iterator(m_ptr, static_cast<std::ptrdiff_t>(m_batch_size));
+    }
+    iterator end() const
+    {
+        return iterator(m_ptr + static_cast<std::size_t>(m_n_vars) * m_batch_size,
+                        static_cast<std::ptrdiff_t>(m_batch_size));
+    }
+};
+
+// Views over the state vector and the runtime
+// parameters of a lane of a batch integrator.
+template <typename T>
+inline batch_lane_view<T> state_lane(detail::taylor_adaptive_batch_impl<T> &ta, std::uint32_t lane)
+{
+    return batch_lane_view<T>(ta.get_state_data(), ta.get_dim(), ta.get_batch_size(), lane);
+}
+
+template <typename T>
+inline batch_lane_view<const T> state_lane(const detail::taylor_adaptive_batch_impl<T> &ta, std::uint32_t lane)
+{
+    return batch_lane_view<const T>(ta.get_state_data(), ta.get_dim(), ta.get_batch_size(), lane);
+}
+
+template <typename T>
+inline batch_lane_view<T> pars_lane(detail::taylor_adaptive_batch_impl<T> &ta, std::uint32_t lane)
+{
+    return batch_lane_view<T>(ta.get_pars_data(),
+                              static_cast<std::uint32_t>(ta.get_pars().size() / ta.get_batch_size()),
+                              ta.get_batch_size(), lane);
+}
+
+template <typename T>
+inline batch_lane_view<const T> pars_lane(const detail::taylor_adaptive_batch_impl<T> &ta, std::uint32_t lane)
+{
+    return batch_lane_view<const T>(ta.get_pars_data(),
+                                    static_cast<std::uint32_t>(ta.get_pars().size() / ta.get_batch_size()),
+                                    ta.get_batch_size(), lane);
+}
+
+} // namespace heyoka
+
+#endif
@@ -0,0 +1,53 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_CHAOS_HPP
+#define HEYOKA_CHAOS_HPP
+
+#include <utility>
+#include <vector>
+
+#include <heyoka/detail/fwd_decl.hpp>
+#include <heyoka/detail/visibility.hpp>
+
+namespace heyoka
+{
+
+enum class chaos_indicator { megno, fli };
+
+// Augment the system of ODEs sys with the variational equations
+// and with the differential equation of the accumulator of the chaos
+// indicator ind, so that the indicator is computed by the Taylor
+// integrator alongside the original dynamics (including in batch mode
+// and in ensemble propagations).
+//
+// The returned system consists of:
+// - the original n equations (in the same order),
+// - the n variational equations d_x' = J(x, t) d_x, where d_x is the
+//   tangent vector associated to the state variable x (the
+//   variable representing it is called "d_" followed by the name of x),
+// - the equation for the accumulator, whose variable is called
+//   "megno" or "fli".
+//
+// Denoting by lambda = (d_x . d_x') / (d_x . d_x) the instantaneous
+// stretching rate of the tangent vector, the accumulator obeys:
+// - megno' = lambda * t, so that the MEGNO at time t is 2 * megno(t) / t,
+// - fli' = lambda, so that the FLI at time t is log(|d_x(0)|) + fli(t).
+//
+// The accumulator must be initialised to zero, the tangent vector
+// to a nonzero value and, for the MEGNO, the integration must start from t = 0.
+// NOTE: the tangent vector is not renormalised. Since lambda is invariant
+// under a rescaling of the tangent vector, the tangent vector can be rescaled
+// (e.g., in a step callback) in order to avoid overflow in long integrations
+// of chaotic orbits, without affecting the accumulator.
+HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, expression>>
+make_chaos_sys(std::vector<std::pair<expression, expression>>, chaos_indicator);
+
+} // namespace heyoka
+
+#endif
@@ -0,0 +1,115 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_CLOSE_APPROACH_HPP
+#define HEYOKA_CLOSE_APPROACH_HPP
+
+#include <heyoka/config.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/detail/type_traits.hpp>
+#include <heyoka/detail/visibility.hpp>
+#include <heyoka/taylor.hpp>
+
+namespace heyoka
+{
+
+// A close approach between the bodies i and j (i < j)
+// of an N-body system: t is the time of the minimum
+// distance, dist the minimum distance.
+template <typename T>
+struct close_approach {
+    std::uint32_t i, j;
+    T t, dist;
+};
+
+namespace detail
+{
+
+HEYOKA_DLL_PUBLIC std::vector<close_approach<double>> nbody_close_approaches_dbl(const double *, std::uint32_t,
+                                                                                 std::uint32_t, double, double, double);
+HEYOKA_DLL_PUBLIC std::vector<close_approach<long double>>
+nbody_close_approaches_ldbl(const long double *, std::uint32_t, std::uint32_t, long double, long double, long double);
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+HEYOKA_DLL_PUBLIC std::vector<close_approach<mppp::real128>>
+nbody_close_approaches_f128(const mppp::real128 *, std::uint32_t, std::uint32_t, mppp::real128, mppp::real128,
+                            mppp::real128);
+
+#endif
+
+} // namespace detail
+
+// Detect the close approaches between the bodies of an N-body system
+// during a timestep, from the Taylor coefficients of the timestep.
+// tc points to the Taylor coefficients up to the given order, laid out
+// as in taylor_adaptive::get_tc() (i.e., the coefficients of each state
+// variable are contiguous). The state variables must be laid out
+// as in make_nbody_sys(), with the Cartesian position of the i-th body
+// in the state variables 6 * i, 6 * i + 1 and 6 * i + 2.
+// t0 is the time at the beginning of the timestep, h the (possibly
+// negative) timestep size. A close approach is reported for each pair
+// of bodies whose minimum distance within the timestep is less
+// than threshold.
+//
+// The trajectory of each body over the timestep is first enclosed in an
+// axis-aligned bounding box computed from its Taylor polynomials. The boxes
+// are then swept and pruned along the x axis, and the minimum distance is
+// computed only for the pairs whose boxes overlap, by isolating the real roots of
+// the derivative of the squared distance polynomial (via Descartes' rule of signs).
+// NOTE: the distances are computed from the Taylor polynomials, and thus
+// they are accurate within the integration tolerance only if the timestep
+// size h does not exceed the size of the timestep taken by the integrator.
+template <typename T>
+inline std::vector<close_approach<T>> nbody_close_approaches(const T *tc, std::uint32_t order, std::uint32_t n_bodies,
+                                                             T t0, T h, T threshold)
+{
+    if constexpr (std::is_same_v<T, double>) {
+        return detail::nbody_close_approaches_dbl(tc, order, n_bodies, t0, h, threshold);
+    } else if constexpr (std::is_same_v<T, long double>) {
+        return detail::nbody_close_approaches_ldbl(tc, order, n_bodies, t0, h, threshold);
+#if defined(HEYOKA_HAVE_REAL128)
+    } else if constexpr (std::is_same_v<T, mppp::real128>) {
+        return detail::nbody_close_approaches_f128(tc, order, n_bodies, t0, h, threshold);
+#endif
+    } else {
+        static_assert(detail::always_false_v<T>, "Unhandled type.");
+    }
+}
+
+// Detect the close approaches during the last timestep of the integrator ta,
+// which must have been taken with the writing of the Taylor coefficients
+// enabled. h is the size of the last timestep, as returned by step().
+template <typename T>
+inline std::vector<close_approach<T>> nbody_close_approaches(const detail::taylor_adaptive_impl<T> &ta,
+                                                             std::uint32_t n_bodies, T h, T threshold)
+{
+    if (n_bodies > ta.get_dim() / 6u) {
+        throw std::invalid_argument("Cannot detect the close approaches of " + std::to_string(n_bodies)
+                                    + " bodies in an integrator with " + std::to_string(ta.get_dim())
+                                    + " state variables");
+    }
+
+    return nbody_close_approaches(ta.get_tc_data(), ta.get_order(), n_bodies, ta.get_time() - h, h, threshold);
+}
+
+} // namespace heyoka
+
+#endif
@@ -0,0 +1,129 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_COLUMNAR_HPP
+#define HEYOKA_COLUMNAR_HPP
+
+#include <heyoka/config.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/detail/type_traits.hpp>
+#include <heyoka/detail/visibility.hpp>
+
+namespace heyoka
+{
+
+// Columnar binary format. A columnar file stores a table
+// of n_rows x n_cols values of the same type, column by column,
+// in the native byte order of the host machine:
+//
+// - bytes [0, 8): the magic string "heyokacl",
+// - bytes [8, 12): the format version (uint32),
+// - bytes [12, 16): the endianness marker 0x01020304 (uint32),
+// - bytes [16, 20): the type of the values (uint32, see columnar_type),
+// - bytes [20, 24): reserved (zero),
+// - bytes [24, 32): the size in bytes of a value (uint64),
+// - bytes [32, 40): the number of rows (uint64),
+// - bytes [40, 48): the number of columns (uint64),
+// - bytes [48, 64): reserved (zero),
+// - bytes [64, ...): the values, with the column j starting
+//   at byte 64 + j * n_rows * (size of a value).
+//
+// Each column thus has the layout [row], and the whole data section has
+// the layout [column][row]. If the columns represent the variables and
+// the rows the samples, this is the layout used by the batched
+// jet driver, so that mapped columns can be passed directly
+// to (and filled directly by) the jet driver.
+enum class columnar_type : std::uint32_t { dbl = 0, ldbl = 1, f128 = 2, i64 = 3, u64 = 4 };
+
+namespace detail
+{
+
+template <typename T>
+constexpr columnar_type columnar_type_of()
+{
+    if constexpr (std::is_same_v<T, double>) {
+        return columnar_type::dbl;
+    } else if constexpr (std::is_same_v<T, long double>) {
+        return columnar_type::ldbl;
+#if defined(HEYOKA_HAVE_REAL128)
+    } else if constexpr (std::is_same_v<T, mppp::real128>) {
+        return columnar_type::f128;
+#endif
+    } else if constexpr (std::is_same_v<T, std::int64_t>) {
+        return columnar_type::i64;
+    } else if constexpr (std::is_same_v<T, std::uint64_t>) {
+        return columnar_type::u64;
+    } else {
+        static_assert(always_false_v<T>, "Unhandled type.");
+    }
+}
+
+} // namespace detail
+
+// Memory-mapped columnar file. The columns are accessed
+// directly in the mapped pages, without intermediate copies.
+class HEYOKA_DLL_PUBLIC columnar_file
+{
+    struct impl;
+    std::unique_ptr<impl> m_impl;
+
+    void *column_ptr(columnar_type, std::uint64_t, bool) const;
+
+public:
+    // Map an existing file, either read-only
+    // or in read-write mode.
+    explicit columnar_file(const std::string &, bool = true);
+    // Create a new file (overwriting an existing file with the
+    // same name) with the given type, number of rows and number
+    // of columns, and map it in read-write mode. The values
+    // are initialised to zero.
+    explicit columnar_file(const std::string &, columnar_type, std::uint64_t, std::uint64_t);
+    columnar_file(const columnar_file &) = delete;
+    columnar_file(columnar_file &&) noexcept;
+    columnar_file &operator=(const columnar_file &) = delete;
+    columnar_file &operator=(columnar_file &&) noexcept;
+    ~columnar_file();
+
+    columnar_type get_type() const;
+    std::uint64_t get_n_rows() const;
+    std::uint64_t get_n_cols() const;
+    bool is_read_only() const;
+
+    // Pointers to the values of the j-th column. T
+    // must match the type of the values in the file.
+    // NOTE: mutable_column() requires the file to be
+    // mapped in read-write mode.
+    template <typename T>
+    const T *column(std::uint64_t j) const
+    {
+        return static_cast<const T *>(column_ptr(detail::columnar_type_of<T>(), j, false));
+    }
+    template <typename T>
+    T *mutable_column(std::uint64_t j)
+    {
+        return static_cast<T *>(column_ptr(detail::columnar_type_of<T>(), j, true));
+    }
+
+    // Write the modified pages back to the file.
+    void flush();
+};
+
+} // namespace heyoka
+
+#endif
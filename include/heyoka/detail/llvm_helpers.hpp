@@ -9,6 +9,7 @@
 #ifndef HEYOKA_DETAIL_LLVM_HELPERS_HPP
 #define HEYOKA_DETAIL_LLVM_HELPERS_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <initializer_list>
@@ -43,6 +44,11 @@ inline llvm::Type *to_llvm_vector_type(llvm::LLVMContext &c, std::uint32_t batch
     return make_vector_type(to_llvm_type<T>(c), batch_size);
 }
 
+// Alignment (in bytes) of the compact mode global arrays and of the
+// scratch buffers of the jet driver. This is the size of a cache line
+// on most architectures.
+inline constexpr std::size_t llvm_simd_alignment = 64;
+
 HEYOKA_DLL_PUBLIC llvm::Value *load_vector_from_memory(ir_builder &, llvm::Value *, std::uint32_t);
 HEYOKA_DLL_PUBLIC void store_vector_to_memory(ir_builder &, llvm::Value *, llvm::Value *);
 
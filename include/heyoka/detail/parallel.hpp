@@ -0,0 +1,127 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_DETAIL_PARALLEL_HPP
+#define HEYOKA_DETAIL_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <heyoka/detail/visibility.hpp>
+
+namespace heyoka::detail
+{
+
+// Override the number of threads used for parallel work,
+// regardless of the hardware (a value of zero removes the override).
+// This is used in the test suite in order to exercise
+// both the serial and the parallel code paths.
+HEYOKA_DLL_PUBLIC void parallel_set_n_threads(std::size_t);
+HEYOKA_DLL_PUBLIC std::size_t parallel_get_n_threads_override();
+
+// Number of threads available for parallel work.
+inline std::size_t parallel_n_threads()
+{
+    if (const auto ov = parallel_get_n_threads_override(); ov != 0u) {
+        return ov;
+    }
+
+    const auto n = std::thread::hardware_concurrency();
+
+    return n == 0u ? 1u : static_cast<std::size_t>(n);
+}
+
+// Split the range [0, n) into at most parallel_n_threads()
+// contiguous blocks, each containing at least grain elements
+// (unless n < grain, in which case a single block is returned).
+// The return value contains the boundaries of the blocks.
+inline std::vector<std::size_t> parallel_split(std::size_t n, std::size_t grain)
+{
+    const auto n_blocks = std::max(std::min(parallel_n_threads(), n / std::max(grain, std::size_t(1))), std::size_t(1));
+
+    const auto bsize = n / n_blocks, rem = n % n_blocks;
+
+    std::vector<std::size_t> retval;
+    for (std::size_t i = 0; i <= n_blocks; ++i) {
+        retval.push_back(i * bsize + std::min(i, rem));
+    }
+
+    return retval;
+}
+
+// Invoke f(begin, end) on each block of the range [0, n), as
+// determined by parallel_split(). The blocks are processed in
+// parallel, with the first block processed in the calling thread.
+// The first exception thrown by f (in block order) is re-thrown
+// after all blocks have been processed.
+// NOTE: the block decomposition depends on the number of threads,
+// thus f must produce results which do not depend on how
+// the range is split in order to ensure determinism.
+template <typename F>
+inline void parallel_for_blocks(std::size_t n, std::size_t grain, const F &f)
+{
+    const auto blocks = parallel_split(n, grain);
+    const auto n_blocks = blocks.size() - 1u;
+
+    if (n_blocks == 1u) {
+        if (n > 0u) {
+            f(std::size_t(0), n);
+        }
+
+        return;
+    }
+
+    // Launch the blocks after the first one asynchronously.
+    std::vector<std::future<void>> futs;
+    futs.reserve(n_blocks - 1u);
+    for (std::size_t i = 1; i < n_blocks; ++i) {
+        futs.push_back(std::async(std::launch::async, [&f, b = blocks[i], e = blocks[i + 1u]]() { f(b, e); }));
+    }
+
+    // Process the first block in the current thread.
+    std::exception_ptr eptr;
+    try {
+        f(blocks[0], blocks[1]);
+    } catch (...) {
+        eptr = std::current_exception();
+    }
+
+    // Wait for the other blocks.
+    for (auto &fut : futs) {
+        try {
+            fut.get();
+        } catch (...) {
+            if (!eptr) {
+                eptr = std::current_exception();
+            }
+        }
+    }
+
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+}
+
+// Invoke f(i) for each i in [0, n), in parallel.
+template <typename F>
+inline void parallel_for(std::size_t n, std::size_t grain, const F &f)
+{
+    parallel_for_blocks(n, grain, [&f](std::size_t b, std::size_t e) {
+        for (auto i = b; i < e; ++i) {
+            f(i);
+        }
+    });
+}
+
+} // namespace heyoka::detail
+
+#endif
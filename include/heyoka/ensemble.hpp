@@ -0,0 +1,232 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_ENSEMBLE_HPP
+#define HEYOKA_ENSEMBLE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/numeric/conversion/cast.hpp>
+
+#include <heyoka/columnar.hpp>
+#include <heyoka/detail/parallel.hpp>
+#include <heyoka/detail/type_traits.hpp>
+#include <heyoka/taylor.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+template <typename TA>
+using ensemble_reset_vo_order_t = decltype(std::declval<TA &>().reset_vo_order());
+
+// Number of chunks of iterations per worker in ensemble_for_each().
+inline constexpr std::size_t ensemble_chunks_per_worker = 8;
+
+} // namespace detail
+
+// Invoke f(ta_w, i) for each i in [0, n_iter), in parallel.
+// Each worker thread operates on its own copy ta_w of the integrator ta
+// (which can be either a scalar or a batch integrator). The copy is created
+// by the worker itself, and it is then reused for all the iterations
+// processed by the worker, so that the integrator is copied (and its code
+// compiled) only once per worker. The iterations are scheduled dynamically:
+// the workers repeatedly claim the next chunk of contiguous iterations from a
+// shared atomic counter, so that iterations with heterogeneous costs
+// do not leave workers idle.
+// NOTE: the workers are not pinned to specific cores, and no attempt
+// is made to place the memory of the copies (or of the data
+// accessed by f) on specific NUMA nodes.
+// NOTE: f must set up the integrator for the i-th iteration
+// (e.g., time, state and parameters), since the state left by
+// the previous iteration processed by the same worker is not reset.
+// The only exception is the order in variable-order mode, which is
+// reset before each iteration via reset_vo_order().
+// NOTE: the results must not depend on how the iterations are
+// distributed among the workers in order to ensure determinism.
+template <typename TA, typename F>
+inline void ensemble_for_each(const TA &ta, std::size_t n_iter, const F &f)
+{
+    if (n_iter == 0u) {
+        return;
+    }
+
+    const auto n_workers = std::min(detail::parallel_n_threads(), n_iter);
+
+    // NOTE: aim for several chunks per worker, in order to balance the load.
+    const auto chunk_size = std::max(n_iter / (n_workers * detail::ensemble_chunks_per_worker), std::size_t(1));
+
+    // The index of the first iteration of the next chunk.
+    std::atomic<std::size_t> next(0);
+
+    detail::parallel_for_blocks(n_workers, 1, [&](std::size_t begin, std::size_t end) {
+        // NOTE: the copy is made in the worker thread.
+        auto ta_w = ta;
+
+        // NOTE: each block usually contains a single worker, but
+        // a block will run the workers serially if parallel_for_blocks()
+        // splits the range in fewer blocks.
+        for (auto w = begin; w < end; ++w) {
+            try {
+                for (auto b = next.fetch_add(chunk_size); b < n_iter; b = next.fetch_add(chunk_size)) {
+                    const auto e = b + std::min(chunk_size, n_iter - b);
+
+                    for (auto i = b; i < e; ++i) {
+                        if constexpr (detail::is_detected_v<detail::ensemble_reset_vo_order_t, TA>) {
+                            ta_w.reset_vo_order();
+                        }
+
+                        f(ta_w, i);
+                    }
+                }
+            } catch (...) {
+                // NOTE: stop the other workers.
+                next.store(n_iter);
+
+                throw;
+            }
+        }
+    });
+}
+
+// Ensemble propagation: for each i in [0, n_iter), gen(ta_w, i) sets up
+// the integrator ta_w for the i-th iteration (e.g., by altering the initial
+// conditions and the parameters), then ta_w is propagated up to the time t.
+// The return value contains, for each iteration, the result of propagate_until()
+// and the final state vector. The final state vectors are allocated
+// by the workers.
+template <typename T, typename G>
+inline std::vector<std::pair<std::tuple<taylor_outcome, T, T, std::size_t>, std::vector<T>>>
+ensemble_propagate_until(const detail::taylor_adaptive_impl<T> &ta, T t, std::size_t n_iter, const G &gen,
+                         std::size_t max_steps = 0)
+{
+    std::vector<std::pair<std::tuple<taylor_outcome, T, T, std::size_t>, std::vector<T>>> retval(n_iter);
+
+    ensemble_for_each(ta, n_iter, [t, max_steps, &gen, &retval](detail::taylor_adaptive_impl<T> &ta_w, std::size_t i) {
+        gen(ta_w, i);
+
+        retval[i].first = ta_w.propagate_until(t, max_steps);
+        retval[i].second = ta_w.get_state();
+    });
+
+    return retval;
+}
+
+// Batch version of the ensemble propagation: for each i in [0, n_iter),
+// gen(ta_w, i) sets up the batch integrator ta_w for the i-th iteration,
+// then ta_w is propagated up to the times ts (one per batch element).
+// The return value contains, for each iteration, the results of
+// propagate_until() for each batch element and the final state vector.
+template <typename T, typename G>
+inline std::vector<std::pair<std::vector<std::tuple<taylor_outcome, T, T, std::size_t>>, std::vector<T>>>
+ensemble_propagate_until(const detail::taylor_adaptive_batch_impl<T> &ta, const std::vector<T> &ts,
+                         std::size_t n_iter, const G &gen, std::size_t max_steps = 0)
+{
+    if (ts.size() != ta.get_batch_size()) {
+        throw std::invalid_argument("The number of final times passed to a batch ensemble propagation ("
+                                    + std::to_string(ts.size()) + ") differs from the batch size ("
+                                    + std::to_string(ta.get_batch_size()) + ")");
+    }
+
+    std::vector<std::pair<std::vector<std::tuple<taylor_outcome, T, T, std::size_t>>, std::vector<T>>> retval(n_iter);
+
+    ensemble_for_each(ta, n_iter,
+                      [&ts, max_steps, &gen, &retval](detail::taylor_adaptive_batch_impl<T> &ta_w, std::size_t i) {
+                          gen(ta_w, i);
+
+                          retval[i].first = ta_w.propagate_until(ts, max_steps);
+                          retval[i].second = ta_w.get_state();
+                      });
+
+    return retval;
+}
+
+// Ensemble propagation with memory-mapped columnar inputs and outputs.
+// Row i of the file in contains the initial state (in the first n_dim columns)
+// and the values of the parameters (in the remaining columns) for the i-th
+// iteration, in which ta_w is propagated from the initial time of ta up to t.
+// The final state is written to row i of the file out (with n_dim columns),
+// and the outcome and the number of steps are written to row i of the file
+// stats (with 2 columns of type std::int64_t). The workers read the inputs
+// from and write the outputs to the mapped pages directly.
+template <typename T>
+inline void ensemble_propagate_until(const detail::taylor_adaptive_impl<T> &ta, T t, const columnar_file &in,
+                                     columnar_file &out, columnar_file &stats, std::size_t max_steps = 0)
+{
+    const auto n_dim = ta.get_dim();
+    const auto n_pars = ta.get_pars().size();
+
+    if (in.get_n_cols() != n_dim + n_pars) {
+        throw std::invalid_argument("The number of columns in the input file of an ensemble propagation ("
+                                    + std::to_string(in.get_n_cols())
+                                    + ") differs from the number of state variables plus the number of parameters ("
+                                    + std::to_string(n_dim + n_pars) + ")");
+    }
+
+    if (out.get_n_cols() != n_dim || stats.get_n_cols() != 2u) {
+        throw std::invalid_argument(
+            "Invalid number of columns detected in the output files of an ensemble propagation");
+    }
+
+    if (out.get_n_rows() != in.get_n_rows() || stats.get_n_rows() != in.get_n_rows()) {
+        throw std::invalid_argument("The number of rows in the output files of an ensemble propagation differs from "
+                                    "the number of rows in the input file");
+    }
+
+    const auto n_iter = boost::numeric_cast<std::size_t>(in.get_n_rows());
+
+    // Fetch the pointers to the columns.
+    std::vector<const T *> in_cols;
+    for (decltype(in.get_n_cols()) j = 0; j < in.get_n_cols(); ++j) {
+        in_cols.push_back(in.column<T>(j));
+    }
+
+    std::vector<T *> out_cols;
+    for (std::uint32_t j = 0; j < n_dim; ++j) {
+        out_cols.push_back(out.mutable_column<T>(j));
+    }
+
+    auto *oc_col = stats.mutable_column<std::int64_t>(0);
+    auto *ns_col = stats.mutable_column<std::int64_t>(1);
+
+    const auto t0 = ta.get_time();
+
+    ensemble_for_each(ta, n_iter, [&](detail::taylor_adaptive_impl<T> &ta_w, std::size_t i) {
+        ta_w.set_time(t0);
+        for (std::uint32_t j = 0; j < n_dim; ++j) {
+            ta_w.get_state_data()[j] = in_cols[j][i];
+        }
+        for (decltype(ta_w.get_pars().size()) j = 0; j < n_pars; ++j) {
+            ta_w.get_pars_data()[j] = in_cols[n_dim + j][i];
+        }
+        ta_w.reset_inv_drift();
+
+        const auto pres = ta_w.propagate_until(t, max_steps);
+
+        for (std::uint32_t j = 0; j < n_dim; ++j) {
+            out_cols[j][i] = ta_w.get_state()[j];
+        }
+        oc_col[i] = static_cast<std::int64_t>(std::get<0>(pres));
+        ns_col[i] = boost::numeric_cast<std::int64_t>(std::get<3>(pres));
+    });
+}
+
+} // namespace heyoka
+
+#endif
@@ -9,7 +9,12 @@
 #ifndef HEYOKA_HEYOKA_HPP
 #define HEYOKA_HEYOKA_HPP
 
+#include <heyoka/batch_utils.hpp>
 #include <heyoka/binary_operator.hpp>
+#include <heyoka/chaos.hpp>
+#include <heyoka/close_approach.hpp>
+#include <heyoka/columnar.hpp>
+#include <heyoka/ensemble.hpp>
 #include <heyoka/exceptions.hpp>
 #include <heyoka/expression.hpp>
 #include <heyoka/func.hpp>
@@ -21,7 +26,10 @@
 #include <heyoka/nbody.hpp>
 #include <heyoka/number.hpp>
 #include <heyoka/param.hpp>
+#include <heyoka/parser.hpp>
+#include <heyoka/serialization.hpp>
 #include <heyoka/splitmix64.hpp>
+#include <heyoka/sph_harm.hpp>
 #include <heyoka/taylor.hpp>
 #include <heyoka/variable.hpp>
 
@@ -54,6 +54,8 @@ IGOR_MAKE_NAMED_ARGUMENT(opt_level);
 IGOR_MAKE_NAMED_ARGUMENT(fast_math);
 IGOR_MAKE_NAMED_ARGUMENT(save_object_code);
 IGOR_MAKE_NAMED_ARGUMENT(inline_functions);
+IGOR_MAKE_NAMED_ARGUMENT(huge_pages);
+IGOR_MAKE_NAMED_ARGUMENT(compact_mode_simd);
 
 } // namespace kw
 
@@ -75,6 +77,8 @@ class HEYOKA_DLL_PUBLIC llvm_state
     bool m_save_object_code;
     std::string m_object_code;
     bool m_inline_functions;
+    bool m_huge_pages;
+    bool m_compact_mode_simd;
 
     // Check functions.
     HEYOKA_DLL_LOCAL void check_uncompiled(const char *) const;
@@ -136,10 +140,28 @@ class HEYOKA_DLL_PUBLIC llvm_state
                 }
             }();
 
-            return std::tuple{std::move(mod_name), opt_level, fmath, socode, i_func};
+            // Place the JIT-compiled code in huge pages (defaults to false).
+            auto h_pages = [&p]() -> bool {
+                if constexpr (p.has(kw::huge_pages)) {
+                    return std::forward<decltype(p(kw::huge_pages))>(p(kw::huge_pages));
+                } else {
+                    return false;
+                }
+            }();
+
+            // Vectorise the Taylor derivatives in scalar compact mode (defaults to true).
+            auto c_simd = [&p]() -> bool {
+                if constexpr (p.has(kw::compact_mode_simd)) {
+                    return std::forward<decltype(p(kw::compact_mode_simd))>(p(kw::compact_mode_simd));
+                } else {
+                    return true;
+                }
+            }();
+
+            return std::tuple{std::move(mod_name), opt_level, fmath, socode, i_func, h_pages, c_simd};
         }
     }
-    explicit llvm_state(std::tuple<std::string, unsigned, bool, bool, bool> &&);
+    explicit llvm_state(std::tuple<std::string, unsigned, bool, bool, bool, bool, bool> &&);
 
 public:
     llvm_state();
@@ -168,6 +190,7 @@ public:
     unsigned &opt_level();
     bool &fast_math();
     bool &inline_functions();
+    bool &compact_mode_simd();
 
     const llvm::Module &module() const;
     const ir_builder &builder() const;
@@ -175,6 +198,8 @@ public:
     const unsigned &opt_level() const;
     const bool &fast_math() const;
     const bool &inline_functions() const;
+    bool huge_pages() const;
+    const bool &compact_mode_simd() const;
 
     std::string get_ir() const;
     void dump_object_code(const std::string &) const;
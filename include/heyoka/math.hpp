@@ -19,6 +19,7 @@
 #include <heyoka/math/cosh.hpp>
 #include <heyoka/math/erf.hpp>
 #include <heyoka/math/exp.hpp>
+#include <heyoka/math/lin_comb.hpp>
 #include <heyoka/math/log.hpp>
 #include <heyoka/math/pow.hpp>
 #include <heyoka/math/sigmoid.hpp>
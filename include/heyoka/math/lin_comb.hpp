@@ -0,0 +1,75 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_MATH_LIN_COMB_HPP
+#define HEYOKA_MATH_LIN_COMB_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <heyoka/config.hpp>
+#include <heyoka/detail/fwd_decl.hpp>
+#include <heyoka/detail/llvm_fwd.hpp>
+#include <heyoka/detail/visibility.hpp>
+#include <heyoka/func.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+// Linear combination c_0 * x_0 + c_1 * x_1 + ... with constant
+// coefficients. The arguments are stored as the sequence
+// c_0, x_0, c_1, x_1, ..., where the coefficients c_i must be
+// numbers or params.
+class HEYOKA_DLL_PUBLIC lin_comb_impl : public func_base
+{
+public:
+    lin_comb_impl();
+    explicit lin_comb_impl(std::vector<std::pair<expression, expression>>);
+
+    llvm::Value *codegen_dbl(llvm_state &, const std::vector<llvm::Value *> &) const;
+    llvm::Value *codegen_ldbl(llvm_state &, const std::vector<llvm::Value *> &) const;
+#if defined(HEYOKA_HAVE_REAL128)
+    llvm::Value *codegen_f128(llvm_state &, const std::vector<llvm::Value *> &) const;
+#endif
+
+    expression diff(const std::string &) const;
+
+    llvm::Value *taylor_diff_dbl(llvm_state &, const std::vector<std::uint32_t> &, const std::vector<llvm::Value *> &,
+                                 llvm::Value *, llvm::Value *, std::uint32_t, std::uint32_t, std::uint32_t,
+                                 std::uint32_t) const;
+    llvm::Value *taylor_diff_ldbl(llvm_state &, const std::vector<std::uint32_t> &, const std::vector<llvm::Value *> &,
+                                  llvm::Value *, llvm::Value *, std::uint32_t, std::uint32_t, std::uint32_t,
+                                  std::uint32_t) const;
+#if defined(HEYOKA_HAVE_REAL128)
+    llvm::Value *taylor_diff_f128(llvm_state &, const std::vector<std::uint32_t> &, const std::vector<llvm::Value *> &,
+                                  llvm::Value *, llvm::Value *, std::uint32_t, std::uint32_t, std::uint32_t,
+                                  std::uint32_t) const;
+#endif
+    llvm::Function *taylor_c_diff_func_dbl(llvm_state &, std::uint32_t, std::uint32_t) const;
+    llvm::Function *taylor_c_diff_func_ldbl(llvm_state &, std::uint32_t, std::uint32_t) const;
+#if defined(HEYOKA_HAVE_REAL128)
+    llvm::Function *taylor_c_diff_func_f128(llvm_state &, std::uint32_t, std::uint32_t) const;
+#endif
+};
+
+} // namespace detail
+
+// Create the linear combination of the second members of the input
+// pairs with coefficients given by the first members, which must be
+// numbers or params. In a Taylor decomposition, a linear combination
+// is represented by a single u variable regardless of the number of terms.
+HEYOKA_DLL_PUBLIC expression lin_comb(std::vector<std::pair<expression, expression>>);
+
+} // namespace heyoka
+
+#endif
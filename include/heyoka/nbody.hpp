@@ -10,6 +10,7 @@
 #define HEYOKA_NBODY_HPP
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <random>
 #include <stdexcept>
@@ -148,6 +149,26 @@ HEYOKA_DLL_PUBLIC std::array<double, 6> random_elliptic_state(double, const std:
                                                               unsigned = std::random_device{}());
 
 HEYOKA_DLL_PUBLIC std::array<double, 6> cartesian_to_oe(double, const std::array<double, 6> &);
+HEYOKA_DLL_PUBLIC std::array<double, 6> oe_to_cartesian(double, const std::array<double, 6> &);
+
+HEYOKA_DLL_PUBLIC double kepE(double, double);
+
+// Batch versions of the functions above. The states and the
+// orbital elements are passed as structure-of-arrays,
+// that is, as 6 pointers to arrays of size n.
+// NOTE: the batch versions evaluate the scalar kernels in a loop
+// (calling the scalar libm functions), and they split large batches
+// across multiple threads. They are not explicitly vectorised.
+HEYOKA_DLL_PUBLIC void random_elliptic_state_batch(double, const std::array<std::pair<double, double>, 6> &,
+                                                   std::size_t, const std::array<double *, 6> &,
+                                                   unsigned = std::random_device{}());
+
+HEYOKA_DLL_PUBLIC void cartesian_to_oe_batch(double, std::size_t, const std::array<const double *, 6> &,
+                                             const std::array<double *, 6> &);
+HEYOKA_DLL_PUBLIC void oe_to_cartesian_batch(double, std::size_t, const std::array<const double *, 6> &,
+                                             const std::array<double *, 6> &);
+
+HEYOKA_DLL_PUBLIC void kepE_batch(std::size_t, const double *, const double *, double *);
 
 } // namespace heyoka
 
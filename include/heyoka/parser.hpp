@@ -0,0 +1,49 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_PARSER_HPP
+#define HEYOKA_PARSER_HPP
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <heyoka/detail/fwd_decl.hpp>
+#include <heyoka/detail/visibility.hpp>
+
+namespace heyoka
+{
+
+// Parse an expression/a system of ODEs from text.
+//
+// The accepted syntax is the one produced by the stream operator
+// of expression, extended with the usual infix precedence rules
+// (so that redundant parentheses can be omitted). Systems of ODEs
+// are written as sequences of statements of the form
+//
+// prime(x) = <expression>
+//
+// optionally separated by semicolons. Everything following a '#'
+// up to the end of the line is ignored. The identifier 't' denotes
+// the time, 'par[n]' denotes a runtime parameter, and function calls
+// are resolved by name via the function registry (see serialization.hpp).
+// Numerical constants are parsed in double precision.
+// NOTE: since expression is a value type, every occurrence of
+// a subexpression in the input is parsed into an independent copy,
+// that is, no sharing of subexpressions is performed while parsing.
+// Common subexpressions are eliminated later, when the system
+// is decomposed for the Taylor integrator.
+HEYOKA_DLL_PUBLIC expression parse_expression(const std::string &);
+
+HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, expression>> parse_sys(std::istream &);
+HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, expression>> parse_sys(const std::string &);
+
+} // namespace heyoka
+
+#endif
@@ -0,0 +1,94 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_SERIALIZATION_HPP
+#define HEYOKA_SERIALIZATION_HPP
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <heyoka/detail/fwd_decl.hpp>
+#include <heyoka/detail/visibility.hpp>
+
+namespace heyoka
+{
+
+// Registry of the function types which can be
+// reconstructed when reading a binary stream. A function
+// is identified in the binary format by its name, and it
+// is rebuilt from its arguments via the registered factory.
+// All the functions shipped with heyoka are pre-registered.
+using func_factory_t = std::function<func(std::vector<expression>)>;
+
+HEYOKA_DLL_PUBLIC void register_func_type(const std::string &, func_factory_t);
+HEYOKA_DLL_PUBLIC bool is_registered_func_type(const std::string &);
+HEYOKA_DLL_PUBLIC func func_from_registry(const std::string &, std::vector<expression>);
+
+// Binary writer. The header is written on construction,
+// after which expressions and decomposition entries
+// can be streamed out one at a time.
+class HEYOKA_DLL_PUBLIC binary_writer
+{
+    std::ostream &m_os;
+
+public:
+    explicit binary_writer(std::ostream &);
+    binary_writer(const binary_writer &) = delete;
+    binary_writer(binary_writer &&) = delete;
+    binary_writer &operator=(const binary_writer &) = delete;
+    binary_writer &operator=(binary_writer &&) = delete;
+    ~binary_writer();
+
+    void write(const expression &);
+    void write(const std::pair<expression, std::vector<std::uint32_t>> &);
+    void write(const std::pair<expression, expression> &);
+
+    void write_size(std::uint64_t);
+};
+
+// Binary reader. The header is read and validated
+// on construction.
+class HEYOKA_DLL_PUBLIC binary_reader
+{
+    std::istream &m_is;
+
+public:
+    explicit binary_reader(std::istream &);
+    binary_reader(const binary_reader &) = delete;
+    binary_reader(binary_reader &&) = delete;
+    binary_reader &operator=(const binary_reader &) = delete;
+    binary_reader &operator=(binary_reader &&) = delete;
+    ~binary_reader();
+
+    expression read_expression();
+    std::pair<expression, std::vector<std::uint32_t>> read_dc_entry();
+    std::pair<expression, expression> read_eq();
+
+    std::uint64_t read_size();
+};
+
+// Convenience functions to save/load whole
+// vectors of expressions, systems of equations
+// and Taylor decompositions.
+HEYOKA_DLL_PUBLIC void save_binary(std::ostream &, const std::vector<expression> &);
+HEYOKA_DLL_PUBLIC void save_binary(std::ostream &, const std::vector<std::pair<expression, expression>> &);
+HEYOKA_DLL_PUBLIC void save_binary(std::ostream &,
+                                   const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &);
+
+HEYOKA_DLL_PUBLIC std::vector<expression> load_binary_expressions(std::istream &);
+HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, expression>> load_binary_sys(std::istream &);
+HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>> load_binary_dc(std::istream &);
+
+} // namespace heyoka
+
+#endif
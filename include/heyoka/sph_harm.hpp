@@ -0,0 +1,216 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef HEYOKA_SPH_HARM_HPP
+#define HEYOKA_SPH_HARM_HPP
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/numeric/conversion/cast.hpp>
+
+#include <heyoka/detail/igor.hpp>
+#include <heyoka/detail/type_traits.hpp>
+#include <heyoka/detail/visibility.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/kw.hpp>
+#include <heyoka/number.hpp>
+
+namespace heyoka
+{
+
+namespace kw
+{
+
+IGOR_MAKE_NAMED_ARGUMENT(mu);
+IGOR_MAKE_NAMED_ARGUMENT(radius);
+IGOR_MAKE_NAMED_ARGUMENT(cnm);
+IGOR_MAKE_NAMED_ARGUMENT(snm);
+IGOR_MAKE_NAMED_ARGUMENT(normalised);
+IGOR_MAKE_NAMED_ARGUMENT(par_offset);
+
+} // namespace kw
+
+namespace detail
+{
+
+// Component (0 for x, 1 for y, 2 for z) of the acceleration due to a
+// spherical harmonics gravity field. This function can only be used in Taylor
+// integrators: its Taylor decomposition consists of the definitions of the
+// u variables implementing the recursions for the solid spherical harmonics.
+// The component is encoded in the name of the function, and all the other
+// properties of the field are stored in the arguments, so that fields
+// with different coefficients compare (and hash) differently. The arguments are:
+//
+// - the position x, y, z,
+// - the gravitational parameter and the reference radius (as numbers),
+// - the degree and the order (as integral numbers),
+// - the normalisation flag (as a number, 0 for unnormalised coefficients),
+// - the coefficients C_nm and S_nm (as numbers or params), interleaved,
+//   for n = 0, 1, ..., degree and m = 0, 1, ..., min(n, order).
+class HEYOKA_DLL_PUBLIC sph_harm_impl : public func_base
+{
+public:
+    sph_harm_impl();
+    explicit sph_harm_impl(std::uint32_t, std::vector<expression>);
+
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type
+    taylor_decompose(std::vector<std::pair<expression, std::vector<std::uint32_t>>> &) &&;
+};
+
+HEYOKA_DLL_PUBLIC std::vector<expression> sph_harm_gravity_impl(expression, expression, expression, std::uint32_t,
+                                                                std::uint32_t, number, number,
+                                                                std::vector<std::vector<number>>,
+                                                                std::vector<std::vector<number>>, bool, std::uint32_t);
+
+template <typename T>
+inline std::vector<std::vector<number>> sph_harm_table(const T &tab)
+{
+    std::vector<std::vector<number>> retval;
+
+    for (const auto &row : tab) {
+        retval.emplace_back();
+        for (const auto &c : row) {
+            retval.back().emplace_back(c);
+        }
+    }
+
+    return retval;
+}
+
+} // namespace detail
+
+// Create the acceleration due to a gravity field expanded in spherical harmonics
+// up to the given degree and order (order <= degree), at the position (x, y, z)
+// in the body-fixed frame of the harmonic coefficients. The following optional
+// kwargs can be passed:
+//
+// - 'mu', which contains the numerical value of the gravitational parameter,
+// - 'radius', which contains the numerical value of the reference radius,
+// - 'cnm' and 'snm', which contain the tables of the harmonic coefficients
+//   (row n contains the coefficients of degree n and order m = 0, 1, ..., n),
+// - 'normalised', which signals whether the coefficients
+//   are fully normalised (as in most published gravity models),
+// - 'par_offset', see below.
+//
+// 'mu' and 'radius' default to 1, and 'normalised' defaults to true.
+// If 'cnm' and 'snm' are not specified, the coefficients are runtime parameters:
+// the coefficients C_nm and S_nm are the parameters at the indices
+// par_offset + 2 * k and par_offset + 2 * k + 1 respectively, where k is the
+// position of (n, m) in the sequence (0, 0), (1, 0), (1, 1), (2, 0), ...,
+// limited to m <= order ('par_offset' defaults to 0). The parameters
+// corresponding to S_n0 are not used.
+//
+// The acceleration is computed via Cunningham's recursions for the solid
+// spherical harmonics (see Montenbruck & Gill, Satellite Orbits, section 3.2),
+// which are emitted directly in the Taylor decomposition. The terms of the
+// recursions are shared among the three components, so that the number of
+// u variables grows quadratically with the degree, while the kinds of
+// u variables (and thus the size of the code in compact mode) do not
+// depend on the degree. The returned expressions can be used
+// only in the definition of the dynamics of Taylor integrators.
+// NOTE: the recursions are implemented in terms of the unnormalised harmonics,
+// which overflow in double precision for very high degrees. The degree is thus
+// limited to 120.
+template <typename... KwArgs>
+inline std::vector<expression> sph_harm_gravity(expression x, expression y, expression z, std::uint32_t degree,
+                                                std::uint32_t order, KwArgs &&...kw_args)
+{
+    igor::parser p{kw_args...};
+
+    if constexpr (p.has_unnamed_arguments()) {
+        static_assert(detail::always_false_v<KwArgs...>,
+                      "The variadic arguments in the construction of a spherical harmonics gravity field contain "
+                      "unnamed arguments.");
+    } else {
+        // Gravitational parameter (defaults to 1).
+        auto mu = [&p]() {
+            if constexpr (p.has(kw::mu)) {
+                return number{std::forward<decltype(p(kw::mu))>(p(kw::mu))};
+            } else {
+                return number{1.};
+            }
+        }();
+
+        // Reference radius (defaults to 1).
+        auto radius = [&p]() {
+            if constexpr (p.has(kw::radius)) {
+                return number{std::forward<decltype(p(kw::radius))>(p(kw::radius))};
+            } else {
+                return number{1.};
+            }
+        }();
+
+        // Coefficient tables (default to runtime parameters).
+        std::vector<std::vector<number>> cnm, snm;
+        if constexpr (p.has(kw::cnm) && p.has(kw::snm)) {
+            cnm = detail::sph_harm_table(p(kw::cnm));
+            snm = detail::sph_harm_table(p(kw::snm));
+        } else if constexpr (p.has(kw::cnm) || p.has(kw::snm)) {
+            static_assert(detail::always_false_v<KwArgs...>,
+                          "The cnm and snm keyword arguments must be either both present or both absent.");
+        }
+
+        // Normalisation (defaults to true).
+        auto normalised = [&p]() -> bool {
+            if constexpr (p.has(kw::normalised)) {
+                return std::forward<decltype(p(kw::normalised))>(p(kw::normalised));
+            } else {
+                return true;
+            }
+        }();
+
+        // Offset of the coefficients in the array
+        // of parameters (defaults to 0).
+        auto par_offset = [&p]() -> std::uint32_t {
+            if constexpr (p.has(kw::par_offset)) {
+                if constexpr (std::is_integral_v<detail::uncvref_t<decltype(p(kw::par_offset))>>) {
+                    return boost::numeric_cast<std::uint32_t>(p(kw::par_offset));
+                } else {
+                    static_assert(detail::always_false_v<KwArgs...>,
+                                  "The par_offset keyword argument must be of integral type.");
+                }
+            } else {
+                return 0;
+            }
+        }();
+
+        return detail::sph_harm_gravity_impl(std::move(x), std::move(y), std::move(z), degree, order, std::move(mu),
+                                             std::move(radius), std::move(cnm), std::move(snm), normalised,
+                                             par_offset);
+    }
+}
+
+// Create an ODE system representing the motion of a particle in
+// the gravity field of a non-rotating body expanded in spherical harmonics up to
+// the given degree and order. The optional kwargs are the same as in sph_harm_gravity().
+//
+// The returned system consists of the differential equations for
+// x, y, z, vx, vy and vz (in this order).
+template <typename... KwArgs>
+inline std::vector<std::pair<expression, expression>> make_sph_harm_sys(std::uint32_t degree, std::uint32_t order,
+                                                                        KwArgs &&...kw_args)
+{
+    auto [x, y, z, vx, vy, vz] = make_vars("x", "y", "z", "vx", "vy", "vz");
+
+    auto acc = sph_harm_gravity(x, y, z, degree, order, std::forward<KwArgs>(kw_args)...);
+
+    return {prime(x) = vx,
+            prime(y) = vy,
+            prime(z) = vz,
+            prime(vx) = std::move(acc[0]),
+            prime(vy) = std::move(acc[1]),
+            prime(vz) = std::move(acc[2])};
+}
+
+} // namespace heyoka
+
+#endif
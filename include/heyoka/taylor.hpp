@@ -11,10 +11,12 @@
 
 #include <heyoka/config.hpp>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <ostream>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -122,34 +124,129 @@ HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
     taylor_decompose(std::vector<expression>);
 HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
     taylor_decompose(std::vector<std::pair<expression, expression>>);
+HEYOKA_DLL_PUBLIC
+std::pair<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>>
+    taylor_decompose(std::vector<expression>, std::vector<expression>);
+HEYOKA_DLL_PUBLIC
+std::pair<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>>
+    taylor_decompose(std::vector<std::pair<expression, expression>>, std::vector<expression>);
+
+// Create a first-order system from a system of second-order ODEs x_i'' = f_i(x, x', t).
+// Each element of the input vector is a tuple (x_i, v_i, f_i), where x_i and v_i are
+// the variables representing the coordinate and its first-order derivative.
+// The returned system consists of the equations x_i' = v_i (in the order of the input),
+// followed by the equations v_i' = f_i.
+// NOTE: the equations x_i' = v_i do not introduce any u variable in the Taylor decomposition,
+// and the normalised derivatives of order k of x_i are computed directly from the
+// normalised derivatives of order k - 1 of v_i.
+HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, expression>>
+    make_second_order_sys(std::vector<std::tuple<expression, expression, expression>>);
+
+// Static estimate of the cost of a timestep of a Taylor integrator, computed
+// from the Taylor decomposition of the system before any code is compiled.
+// The floating-point operations and the calls to transcendental functions
+// are counted for all the elements of a batch (that is, they are proportional
+// to the batch size, regardless of the vectorisation of the batch).
+// The code sizes are measured in (approximate) numbers of LLVM instructions.
+// NOTE: these are heuristic estimates meant for capacity planning and
+// for the selection of the compilation mode. They do not account for
+// the high accuracy mode, the events and the optimisations
+// performed by LLVM.
+struct HEYOKA_DLL_PUBLIC taylor_cost_estimate {
+    // Number of floating-point operations for the computation of the
+    // Taylor derivatives of order 0, 1, ..., order of all the u variables.
+    std::vector<std::uint64_t> order_flops;
+    // Total number of floating-point operations in a timestep,
+    // including the determination of the timestep size and the
+    // update of the state via the evaluation of the Taylor polynomials.
+    std::uint64_t step_flops = 0;
+    // Number of calls to transcendental functions in a timestep.
+    std::uint64_t step_transcendentals = 0;
+    // Size in bytes of the jet of all the u variables.
+    std::uint64_t jet_bytes = 0;
+    // Estimated code sizes in compact and unrolled modes.
+    std::uint64_t compact_code_size = 0;
+    std::uint64_t unrolled_code_size = 0;
+
+    // Whether or not compact mode is recommended, based on the
+    // estimated code size in unrolled mode.
+    bool compact_mode_recommended() const;
+};
+
+namespace detail
+{
+
+HEYOKA_DLL_PUBLIC taylor_cost_estimate
+taylor_estimate_cost_impl(const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &, std::uint32_t,
+                          std::uint32_t, std::uint32_t, std::size_t);
+HEYOKA_DLL_PUBLIC taylor_cost_estimate taylor_estimate_cost_impl(std::vector<expression>, std::uint32_t,
+                                                                 std::uint32_t, std::size_t);
+HEYOKA_DLL_PUBLIC taylor_cost_estimate taylor_estimate_cost_impl(std::vector<std::pair<expression, expression>>,
+                                                                 std::uint32_t, std::uint32_t, std::size_t);
+
+} // namespace detail
+
+// Estimate the cost of a timestep at the given order and batch size
+// for the Taylor decomposition dc of a system with n_eq equations, such as
+// the one returned by taylor_decompose() or get_decomposition().
+template <typename T>
+inline taylor_cost_estimate
+taylor_estimate_cost(const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc, std::uint32_t n_eq,
+                     std::uint32_t order, std::uint32_t batch_size = 1)
+{
+    return detail::taylor_estimate_cost_impl(dc, n_eq, order, batch_size, sizeof(T));
+}
+
+template <typename T>
+inline taylor_cost_estimate taylor_estimate_cost(std::vector<expression> sys, std::uint32_t order,
+                                                 std::uint32_t batch_size = 1)
+{
+    return detail::taylor_estimate_cost_impl(std::move(sys), order, batch_size, sizeof(T));
+}
+
+template <typename T>
+inline taylor_cost_estimate taylor_estimate_cost(std::vector<std::pair<expression, expression>> sys,
+                                                 std::uint32_t order, std::uint32_t batch_size = 1)
+{
+    return detail::taylor_estimate_cost_impl(std::move(sys), order, batch_size, sizeof(T));
+}
 
 HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_dbl(llvm_state &, const std::string &, std::vector<expression>, std::uint32_t, std::uint32_t, bool,
-                   bool);
+                   bool, std::vector<expression> = {});
 HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_ldbl(llvm_state &, const std::string &, std::vector<expression>, std::uint32_t, std::uint32_t, bool,
-                    bool);
+                    bool, std::vector<expression> = {});
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_f128(llvm_state &, const std::string &, std::vector<expression>, std::uint32_t, std::uint32_t, bool,
-                    bool);
+                    bool, std::vector<expression> = {});
 
 #endif
 
+// NOTE: sv_funcs is a list of functions of the state variables (and
+// of the time and of the parameters) whose jets will be computed
+// alongside the jet of the state variables. The jet is laid out order
+// by order, and, within each order, the functions of the state variables
+// follow the state variables. The order-0 values of the functions
+// of the state variables are also written to the jet array.
 template <typename T>
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet(llvm_state &s, const std::string &name, std::vector<expression> sys, std::uint32_t order,
-               std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+               std::uint32_t batch_size, bool high_accuracy, bool compact_mode, std::vector<expression> sv_funcs = {})
 {
     if constexpr (std::is_same_v<T, double>) {
-        return taylor_add_jet_dbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+        return taylor_add_jet_dbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                  std::move(sv_funcs));
     } else if constexpr (std::is_same_v<T, long double>) {
-        return taylor_add_jet_ldbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+        return taylor_add_jet_ldbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                   std::move(sv_funcs));
 #if defined(HEYOKA_HAVE_REAL128)
     } else if constexpr (std::is_same_v<T, mppp::real128>) {
-        return taylor_add_jet_f128(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+        return taylor_add_jet_f128(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                   std::move(sv_funcs));
 #endif
     } else {
         static_assert(detail::always_false_v<T>, "Unhandled type.");
@@ -158,64 +255,77 @@ taylor_add_jet(llvm_state &s, const std::string &name, std::vector<expression> s
 
 HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_dbl(llvm_state &, const std::string &, std::vector<std::pair<expression, expression>>, std::uint32_t,
-                   std::uint32_t, bool, bool);
+                   std::uint32_t, bool, bool, std::vector<expression> = {});
 HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_ldbl(llvm_state &, const std::string &, std::vector<std::pair<expression, expression>>, std::uint32_t,
-                    std::uint32_t, bool, bool);
+                    std::uint32_t, bool, bool, std::vector<expression> = {});
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 HEYOKA_DLL_PUBLIC std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_f128(llvm_state &, const std::string &, std::vector<std::pair<expression, expression>>, std::uint32_t,
-                    std::uint32_t, bool, bool);
+                    std::uint32_t, bool, bool, std::vector<expression> = {});
 
 #endif
 
 template <typename T>
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet(llvm_state &s, const std::string &name, std::vector<std::pair<expression, expression>> sys,
-               std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+               std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+               std::vector<expression> sv_funcs = {})
 {
     if constexpr (std::is_same_v<T, double>) {
-        return taylor_add_jet_dbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+        return taylor_add_jet_dbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                  std::move(sv_funcs));
     } else if constexpr (std::is_same_v<T, long double>) {
-        return taylor_add_jet_ldbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+        return taylor_add_jet_ldbl(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                   std::move(sv_funcs));
 #if defined(HEYOKA_HAVE_REAL128)
     } else if constexpr (std::is_same_v<T, mppp::real128>) {
-        return taylor_add_jet_f128(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+        return taylor_add_jet_f128(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                   std::move(sv_funcs));
 #endif
     } else {
         static_assert(detail::always_false_v<T>, "Unhandled type.");
     }
 }
 
+// NOTE: if sv_funcs is not empty, the Taylor coefficients of the functions
+// of the state variables are written to the Taylor coefficients output
+// after those of the state variables. If weights is not empty, it must contain
+// one positive weight per state variable: the step-size control is then
+// performed on the state vector scaled component-wise by the weights.
 HEYOKA_DLL_PUBLIC std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_dbl(llvm_state &, const std::string &, std::vector<expression>, double, std::uint32_t, bool,
-                             bool);
+                             bool, std::vector<expression> = {}, std::vector<double> = {});
 HEYOKA_DLL_PUBLIC std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_ldbl(llvm_state &, const std::string &, std::vector<expression>, long double, std::uint32_t,
-                              bool, bool);
+                              bool, bool, std::vector<expression> = {}, std::vector<long double> = {});
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 HEYOKA_DLL_PUBLIC std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_f128(llvm_state &, const std::string &, std::vector<expression>, mppp::real128, std::uint32_t,
-                              bool, bool);
+                              bool, bool, std::vector<expression> = {}, std::vector<mppp::real128> = {});
 
 #endif
 
 template <typename T>
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step(llvm_state &s, const std::string &name, std::vector<expression> sys, T tol,
-                         std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                         std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                         std::vector<expression> sv_funcs = {}, std::vector<T> weights = {})
 {
     if constexpr (std::is_same_v<T, double>) {
-        return taylor_add_adaptive_step_dbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode);
+        return taylor_add_adaptive_step_dbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode,
+                                            std::move(sv_funcs), std::move(weights));
     } else if constexpr (std::is_same_v<T, long double>) {
-        return taylor_add_adaptive_step_ldbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode);
+        return taylor_add_adaptive_step_ldbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode,
+                                             std::move(sv_funcs), std::move(weights));
 #if defined(HEYOKA_HAVE_REAL128)
     } else if constexpr (std::is_same_v<T, mppp::real128>) {
-        return taylor_add_adaptive_step_f128(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode);
+        return taylor_add_adaptive_step_f128(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode,
+                                             std::move(sv_funcs), std::move(weights));
 #endif
     } else {
         static_assert(detail::always_false_v<T>, "Unhandled type.");
@@ -224,31 +334,37 @@ taylor_add_adaptive_step(llvm_state &s, const std::string &name, std::vector<exp
 
 HEYOKA_DLL_PUBLIC std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_dbl(llvm_state &, const std::string &, std::vector<std::pair<expression, expression>>, double,
-                             std::uint32_t, bool, bool);
+                             std::uint32_t, bool, bool, std::vector<expression> = {}, std::vector<double> = {});
 HEYOKA_DLL_PUBLIC std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_ldbl(llvm_state &, const std::string &, std::vector<std::pair<expression, expression>>,
-                              long double, std::uint32_t, bool, bool);
+                              long double, std::uint32_t, bool, bool, std::vector<expression> = {},
+                              std::vector<long double> = {});
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 HEYOKA_DLL_PUBLIC std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_f128(llvm_state &, const std::string &, std::vector<std::pair<expression, expression>>,
-                              mppp::real128, std::uint32_t, bool, bool);
+                              mppp::real128, std::uint32_t, bool, bool, std::vector<expression> = {},
+                              std::vector<mppp::real128> = {});
 
 #endif
 
 template <typename T>
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step(llvm_state &s, const std::string &name, std::vector<std::pair<expression, expression>> sys,
-                         T tol, std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                         T tol, std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                         std::vector<expression> sv_funcs = {}, std::vector<T> weights = {})
 {
     if constexpr (std::is_same_v<T, double>) {
-        return taylor_add_adaptive_step_dbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode);
+        return taylor_add_adaptive_step_dbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode,
+                                            std::move(sv_funcs), std::move(weights));
     } else if constexpr (std::is_same_v<T, long double>) {
-        return taylor_add_adaptive_step_ldbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode);
+        return taylor_add_adaptive_step_ldbl(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode,
+                                             std::move(sv_funcs), std::move(weights));
 #if defined(HEYOKA_HAVE_REAL128)
     } else if constexpr (std::is_same_v<T, mppp::real128>) {
-        return taylor_add_adaptive_step_f128(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode);
+        return taylor_add_adaptive_step_f128(s, name, std::move(sys), tol, batch_size, high_accuracy, compact_mode,
+                                             std::move(sv_funcs), std::move(weights));
 #endif
     } else {
         static_assert(detail::always_false_v<T>, "Unhandled type.");
@@ -326,10 +442,12 @@ taylor_add_custom_step(llvm_state &s, const std::string &name, std::vector<std::
 // Enum to represent the outcome of a Taylor integration
 // stepping function.
 enum class taylor_outcome {
-    success,     // Integration step was successful, no time/step limits were reached.
-    step_limit,  // Maximum number of steps reached.
-    time_limit,  // Time limit reached.
-    err_nf_state // Non-finite state detected at the end of the timestep.
+    success,      // Integration step was successful, no time/step limits were reached.
+    step_limit,   // Maximum number of steps reached.
+    time_limit,   // Time limit reached.
+    err_nf_state, // Non-finite state detected at the end of the timestep.
+    cb_stop,      // Propagation stopped by a step callback.
+    err_inv_drift // The drift of an invariant exceeded the tolerance at the end of the timestep.
 };
 
 HEYOKA_DLL_PUBLIC std::ostream &operator<<(std::ostream &, taylor_outcome);
@@ -342,6 +460,12 @@ IGOR_MAKE_NAMED_ARGUMENT(tol);
 IGOR_MAKE_NAMED_ARGUMENT(high_accuracy);
 IGOR_MAKE_NAMED_ARGUMENT(compact_mode);
 IGOR_MAKE_NAMED_ARGUMENT(pars);
+IGOR_MAKE_NAMED_ARGUMENT(observables);
+IGOR_MAKE_NAMED_ARGUMENT(invariants);
+IGOR_MAKE_NAMED_ARGUMENT(inv_tol);
+IGOR_MAKE_NAMED_ARGUMENT(weights);
+IGOR_MAKE_NAMED_ARGUMENT(variable_order);
+IGOR_MAKE_NAMED_ARGUMENT(extra_tols);
 
 } // namespace kw
 
@@ -397,7 +521,31 @@ inline auto taylor_adaptive_common_ops(KwArgs &&...kw_args)
         }
     }();
 
-    return std::tuple{high_accuracy, tol, compact_mode, std::move(pars)};
+    // Observables (defaults to empty vector).
+    auto obs = [&p]() -> std::vector<expression> {
+        if constexpr (p.has(kw::observables)) {
+            return std::forward<decltype(p(kw::observables))>(p(kw::observables));
+        } else {
+            return {};
+        }
+    }();
+
+    return std::tuple{high_accuracy, tol, compact_mode, std::move(pars), std::move(obs)};
+}
+
+// Helper for parsing the weights of the state variables
+// in the step-size control of the adaptive integrators.
+template <typename T, typename... KwArgs>
+inline std::vector<T> taylor_adaptive_weights(KwArgs &&...kw_args)
+{
+    igor::parser p{kw_args...};
+
+    // Weights (defaults to empty vector, i.e., unit weights).
+    if constexpr (p.has(kw::weights)) {
+        return std::forward<decltype(p(kw::weights))>(p(kw::weights));
+    } else {
+        return {};
+    }
 }
 
 template <typename T>
@@ -422,14 +570,57 @@ class HEYOKA_DLL_PUBLIC taylor_adaptive_impl
     std::vector<T> m_pars;
     // The vector for the Taylor coefficients.
     std::vector<T> m_tc;
-
-    HEYOKA_DLL_LOCAL std::tuple<taylor_outcome, T> step_impl(T, bool);
+    // The observables.
+    std::vector<expression> m_obs;
+    // The invariants.
+    std::vector<expression> m_inv;
+    // The function for the evaluation of the invariants.
+    using inv_f_t = void (*)(T *, const T *, const T *, const T *);
+    inv_f_t m_inv_f = nullptr;
+    // The reference values of the invariants,
+    // their current values and their max relative drifts.
+    std::vector<T> m_inv_ref, m_inv_values, m_inv_drift;
+    // The tolerance on the drift of the invariants.
+    T m_inv_tol;
+    // The weights of the state variables
+    // in the step-size control.
+    std::vector<T> m_weights;
+    // Variable-order mode: the candidate orders,
+    // the corresponding steppers, their estimated costs,
+    // the index of the order to be used in the next
+    // timestep and the index of the order deduced
+    // from the tolerance.
+    std::vector<std::uint32_t> m_vo_orders;
+    std::vector<step_f_t> m_vo_step_f;
+    std::vector<T> m_vo_costs;
+    std::size_t m_vo_idx = 0;
+    std::size_t m_vo_nom_idx = 0;
+    // The tolerances (the first one is the tolerance
+    // passed via kw::tol). If there are multiple tolerances,
+    // the orders and the steppers for each tolerance and
+    // the index of the active tolerance are stored as well.
+    std::vector<T> m_tols;
+    std::vector<std::uint32_t> m_mt_orders;
+    std::vector<step_f_t> m_mt_step_f;
+    std::size_t m_mt_idx = 0;
+
+    bool update_inv();
+    void vo_select_order(bool);
+    void tc_relayout(std::uint32_t);
+
+    // NOTE: these are not DLL-local because they are
+    // invoked from the inline implementation of
+    // propagate_until() with a step callback.
+    std::tuple<taylor_outcome, T> step_impl(T, bool);
+    void propagate_check(T) const;
 
     // Private implementation-detail constructor machinery.
     // NOTE: apparently on Windows we need to re-iterate
     // here that this is going to be dll-exported.
     template <typename U>
-    HEYOKA_DLL_PUBLIC void finalise_ctor_impl(U, std::vector<T>, T, T, bool, bool, std::vector<T>);
+    HEYOKA_DLL_PUBLIC void finalise_ctor_impl(U, std::vector<T>, T, T, bool, bool, std::vector<T>,
+                                              std::vector<expression>, std::vector<expression>, T, std::vector<T>,
+                                              bool, std::vector<T>);
     template <typename U, typename... KwArgs>
     void finalise_ctor(U sys, std::vector<T> state, KwArgs &&...kw_args)
     {
@@ -449,11 +640,50 @@ class HEYOKA_DLL_PUBLIC taylor_adaptive_impl
                 }
             }();
 
-            auto [high_accuracy, tol, compact_mode, pars]
+            auto [high_accuracy, tol, compact_mode, pars, obs]
                 = taylor_adaptive_common_ops<T>(std::forward<KwArgs>(kw_args)...);
 
+            // Invariants (defaults to empty vector).
+            auto invariants = [&p]() -> std::vector<expression> {
+                if constexpr (p.has(kw::invariants)) {
+                    return std::forward<decltype(p(kw::invariants))>(p(kw::invariants));
+                } else {
+                    return {};
+                }
+            }();
+
+            // Tolerance on the drift of the invariants
+            // (defaults to infinity, i.e., no limit).
+            const auto inv_tol = [&p]() -> T {
+                if constexpr (p.has(kw::inv_tol)) {
+                    return std::forward<decltype(p(kw::inv_tol))>(p(kw::inv_tol));
+                } else {
+                    return std::numeric_limits<T>::infinity();
+                }
+            }();
+
+            // Variable-order mode (defaults to false).
+            const auto variable_order = [&p]() -> bool {
+                if constexpr (p.has(kw::variable_order)) {
+                    return std::forward<decltype(p(kw::variable_order))>(p(kw::variable_order));
+                } else {
+                    return false;
+                }
+            }();
+
+            // Additional tolerances (defaults to empty vector).
+            auto extra_tols = [&p]() -> std::vector<T> {
+                if constexpr (p.has(kw::extra_tols)) {
+                    return std::forward<decltype(p(kw::extra_tols))>(p(kw::extra_tols));
+                } else {
+                    return {};
+                }
+            }();
+
             finalise_ctor_impl(std::move(sys), std::move(state), time, tol, high_accuracy, compact_mode,
-                               std::move(pars));
+                               std::move(pars), std::move(obs), std::move(invariants), inv_tol,
+                               taylor_adaptive_weights<T>(std::forward<KwArgs>(kw_args)...), variable_order,
+                               std::move(extra_tols));
         }
     }
 
@@ -535,6 +765,101 @@ public:
         return m_tc.data();
     }
 
+    // Observables. Their Taylor coefficients are stored
+    // in the vector of Taylor coefficients, after those
+    // of the state variables.
+    const std::vector<expression> &get_observables() const
+    {
+        return m_obs;
+    }
+    const T *get_obs_tc_data() const
+    {
+        return m_tc.data() + static_cast<typename std::vector<T>::size_type>(m_dim) * (m_order + 1u);
+    }
+
+    // The weights of the state variables in the step-size
+    // control (empty if all the weights are 1).
+    const std::vector<T> &get_weights() const
+    {
+        return m_weights;
+    }
+
+    // Variable-order mode. The integrator compiles steppers
+    // for a set of candidate orders around the order deduced from
+    // the tolerance, and after each timestep it selects the order
+    // for the next timestep by minimising the estimated computational
+    // cost per unit of time. In this mode get_order() returns
+    // the largest candidate order, which determines the layout
+    // of the Taylor coefficients (the coefficients above the order
+    // actually used in the last timestep are set to zero).
+    // The candidate orders are empty if the variable-order
+    // mode is not active.
+    const std::vector<std::uint32_t> &get_vo_orders() const
+    {
+        return m_vo_orders;
+    }
+    std::uint32_t get_cur_order() const
+    {
+        if (!m_vo_orders.empty()) {
+            return m_vo_orders[m_vo_idx];
+        }
+
+        return m_mt_orders.empty() ? m_order : m_mt_orders[m_mt_idx];
+    }
+    // Reset the order of the next timestep to the order
+    // deduced from the tolerance, as in a newly-constructed
+    // integrator. This is a no-op if the variable-order
+    // mode is not active.
+    void reset_vo_order()
+    {
+        if (!m_vo_orders.empty()) {
+            m_vo_idx = m_vo_nom_idx;
+            m_step_f = m_vo_step_f[m_vo_idx];
+        }
+    }
+
+    // Multiple tolerances. The integrator compiles a stepper
+    // for the tolerance passed via kw::tol and for each tolerance
+    // passed via kw::extra_tols. The steppers are stored in the
+    // same LLVM module and they share the Taylor decomposition
+    // (and, in compact mode, the AD functions). The active tolerance
+    // can be switched at any time via select_tol() (initially, it is
+    // the tolerance passed via kw::tol). As in the variable-order
+    // mode, get_order() returns the largest order, which determines
+    // the layout of the Taylor coefficients.
+    const std::vector<T> &get_tols() const
+    {
+        return m_tols;
+    }
+    std::size_t get_tol_idx() const
+    {
+        return m_mt_idx;
+    }
+    void select_tol(std::size_t);
+
+    // Invariants. The values of the invariants are computed
+    // at the end of each timestep, and their drifts are measured
+    // with respect to the values at the beginning of the integration
+    // (or at the last invocation of reset_inv_drift()). The drift
+    // is relative, unless the reference value is zero.
+    const std::vector<expression> &get_invariants() const
+    {
+        return m_inv;
+    }
+    const std::vector<T> &get_inv_values() const
+    {
+        return m_inv_values;
+    }
+    const std::vector<T> &get_inv_drift() const
+    {
+        return m_inv_drift;
+    }
+    T get_inv_tol() const
+    {
+        return m_inv_tol;
+    }
+    void reset_inv_drift();
+
     std::tuple<taylor_outcome, T> step(bool = false);
     std::tuple<taylor_outcome, T> step_backward(bool = false);
     std::tuple<taylor_outcome, T> step(T, bool = false);
@@ -549,6 +874,80 @@ public:
     // only if at least 1-2 steps were taken successfully.
     std::tuple<taylor_outcome, T, T, std::size_t> propagate_for(T, std::size_t = 0);
     std::tuple<taylor_outcome, T, T, std::size_t> propagate_until(T, std::size_t = 0);
+
+    // Overloads accepting a callback which is invoked (with the integrator
+    // as only argument) after each successful step. If the callback returns false,
+    // the propagation is stopped and taylor_outcome::cb_stop is returned.
+    // NOTE: the callback is invoked also after the final step, in which
+    // case its return value is ignored (i.e., reaching the time limit
+    // has precedence over a stop request).
+    template <typename F>
+    std::tuple<taylor_outcome, T, T, std::size_t> propagate_for(T delta_t, std::size_t max_steps, F &&cb)
+    {
+        return propagate_until(m_time + delta_t, max_steps, std::forward<F>(cb));
+    }
+    template <typename F>
+    std::tuple<taylor_outcome, T, T, std::size_t> propagate_until(T t, std::size_t max_steps, F &&cb)
+    {
+        static_assert(std::is_invocable_r_v<bool, F &, taylor_adaptive_impl &>,
+                      "The step callback must be invocable with a reference to the integrator as argument, and it "
+                      "must return a value convertible to bool.");
+
+        propagate_check(t);
+
+        // Initial values for the counters,
+        // the min/max abs of the integration
+        // timesteps, and min/max Taylor orders.
+        // NOTE: iter_counter is for keeping track of the max_steps
+        // limits, step_counter counts the number of timesteps performed
+        // with a non-zero h. Most of the time these two quantities
+        // will be identical, apart from corner cases.
+        std::size_t iter_counter = 0, step_counter = 0;
+        T min_h = std::numeric_limits<T>::infinity(), max_h(0);
+
+        while (true) {
+            // NOTE: t - m_time is guaranteed not to be nan: t is never non-finite,
+            // and at the first iteration we have checked above the value of m_time.
+            // At successive iterations, we know that m_time must be finite because
+            // otherwise we would have exited the loop when checking res.
+            const auto [res, h] = step_impl(t - m_time, false);
+
+            if (res != taylor_outcome::success && res != taylor_outcome::time_limit) {
+                // Something went wrong in the propagation of the timestep, exit.
+                return std::tuple{res, min_h, max_h, step_counter};
+            }
+
+            // Update the number of iterations.
+            ++iter_counter;
+
+            // Update the number of steps.
+            step_counter += static_cast<std::size_t>(h != 0);
+
+            // Break out if the time limit is reached,
+            // *before* updating the min_h/max_h values.
+            if (res == taylor_outcome::time_limit) {
+                cb(*this);
+
+                return std::tuple{taylor_outcome::time_limit, min_h, max_h, step_counter};
+            }
+
+            // Update min_h/max_h.
+            using std::abs;
+            const auto abs_h = abs(h);
+            min_h = std::min(min_h, abs_h);
+            max_h = std::max(max_h, abs_h);
+
+            // Invoke the callback.
+            if (!cb(*this)) {
+                return std::tuple{taylor_outcome::cb_stop, min_h, max_h, step_counter};
+            }
+
+            // Check the iteration limit.
+            if (max_steps != 0u && iter_counter == max_steps) {
+                return std::tuple{taylor_outcome::step_limit, min_h, max_h, step_counter};
+            }
+        }
+    }
 };
 
 } // namespace detail
@@ -637,6 +1036,11 @@ class HEYOKA_DLL_PUBLIC taylor_adaptive_batch_impl
     std::vector<T> m_pars;
     // The vector for the Taylor coefficients.
     std::vector<T> m_tc;
+    // The observables.
+    std::vector<expression> m_obs;
+    // The weights of the state variables
+    // in the step-size control.
+    std::vector<T> m_weights;
     // Temporary vectors for use
     // in the timestepping functions.
     // These two are used as default values,
@@ -654,12 +1058,17 @@ class HEYOKA_DLL_PUBLIC taylor_adaptive_batch_impl
     std::vector<T> m_cur_max_delta_ts;
     std::vector<T> m_pfor_ts;
 
-    HEYOKA_DLL_LOCAL const std::vector<std::tuple<taylor_outcome, T>> &step_impl(const std::vector<T> &, bool);
+    // NOTE: these are not DLL-local because they are
+    // invoked from the inline implementation of
+    // propagate_until() with a step callback.
+    const std::vector<std::tuple<taylor_outcome, T>> &step_impl(const std::vector<T> &, bool);
+    void propagate_check(const std::vector<T> &) const;
+    const std::vector<T> &propagate_for_ts(const std::vector<T> &);
 
     // Private implementation-detail constructor machinery.
     template <typename U>
     HEYOKA_DLL_PUBLIC void finalise_ctor_impl(U, std::vector<T>, std::uint32_t, std::vector<T>, T, bool, bool,
-                                              std::vector<T>);
+                                              std::vector<T>, std::vector<expression>, std::vector<T>);
     template <typename U, typename... KwArgs>
     void finalise_ctor(U sys, std::vector<T> state, std::uint32_t batch_size, KwArgs &&...kw_args)
     {
@@ -679,11 +1088,12 @@ class HEYOKA_DLL_PUBLIC taylor_adaptive_batch_impl
                 }
             }();
 
-            auto [high_accuracy, tol, compact_mode, pars]
+            auto [high_accuracy, tol, compact_mode, pars, obs]
                 = taylor_adaptive_common_ops<T>(std::forward<KwArgs>(kw_args)...);
 
             finalise_ctor_impl(std::move(sys), std::move(state), batch_size, std::move(time), tol, high_accuracy,
-                               compact_mode, std::move(pars));
+                               compact_mode, std::move(pars), std::move(obs),
+                               taylor_adaptive_weights<T>(std::forward<KwArgs>(kw_args)...));
         }
     }
 
@@ -771,6 +1181,25 @@ public:
         return m_tc.data();
     }
 
+    // Observables. Their Taylor coefficients are stored
+    // in the vector of Taylor coefficients, after those
+    // of the state variables.
+    const std::vector<expression> &get_observables() const
+    {
+        return m_obs;
+    }
+    const T *get_obs_tc_data() const
+    {
+        return m_tc.data() + static_cast<typename std::vector<T>::size_type>(m_dim) * (m_order + 1u) * m_batch_size;
+    }
+
+    // The weights of the state variables in the step-size
+    // control (empty if all the weights are 1).
+    const std::vector<T> &get_weights() const
+    {
+        return m_weights;
+    }
+
     const std::vector<std::tuple<taylor_outcome, T>> &step(bool = false);
     const std::vector<std::tuple<taylor_outcome, T>> &step_backward(bool = false);
     const std::vector<std::tuple<taylor_outcome, T>> &step(const std::vector<T> &, bool = false);
@@ -779,6 +1208,129 @@ public:
                                                                                     std::size_t = 0);
     const std::vector<std::tuple<taylor_outcome, T, T, std::size_t>> &propagate_until(const std::vector<T> &,
                                                                                       std::size_t = 0);
+
+    // Overloads accepting a callback which is invoked (with the integrator
+    // as only argument) after each successful step of the batch. If the callback
+    // returns false, the propagation is stopped and taylor_outcome::cb_stop is
+    // returned for the batch elements which have not reached the time limit yet.
+    template <typename F>
+    const std::vector<std::tuple<taylor_outcome, T, T, std::size_t>> &
+    propagate_for(const std::vector<T> &delta_ts, std::size_t max_steps, F &&cb)
+    {
+        return propagate_until(propagate_for_ts(delta_ts), max_steps, std::forward<F>(cb));
+    }
+    template <typename F>
+    const std::vector<std::tuple<taylor_outcome, T, T, std::size_t>> &
+    propagate_until(const std::vector<T> &ts, std::size_t max_steps, F &&cb)
+    {
+        static_assert(std::is_invocable_r_v<bool, F &, taylor_adaptive_batch_impl &>,
+                      "The step callback must be invocable with a reference to the integrator as argument, and it "
+                      "must return a value convertible to bool.");
+
+        propagate_check(ts);
+
+        // Reset the counters and the min/max abs(h) vectors.
+        std::size_t iter_counter = 0;
+        for (std::uint32_t i = 0; i < m_batch_size; ++i) {
+            m_ts_count[i] = 0;
+            m_min_abs_h[i] = std::numeric_limits<T>::infinity();
+            m_max_abs_h[i] = 0;
+        }
+
+        // Flag to signal that the callback requested a stop.
+        bool cb_stop = false;
+
+        while (true) {
+            // Compute the max integration times for this timestep.
+            // NOTE: ts[i] - m_time[i] is guaranteed not to be nan: ts[i] is never non-finite,
+            // and at the first iteration we have checked above the value of m_time.
+            // At successive iterations, we know that m_time[i] must be finite because
+            // otherwise we would have exited the loop when checking m_step_res.
+            for (std::uint32_t i = 0; i < m_batch_size; ++i) {
+                m_cur_max_delta_ts[i] = ts[i] - m_time[i];
+            }
+
+            // Run the integration timestep.
+            step_impl(m_cur_max_delta_ts, false);
+
+            // Check if the integration timestep produced an error condition.
+            if (std::any_of(m_step_res.begin(), m_step_res.end(), [](const auto &tup) {
+                    return std::get<0>(tup) != taylor_outcome::success
+                           && std::get<0>(tup) != taylor_outcome::time_limit;
+                })) {
+                break;
+            }
+
+            // Update the iteration counter.
+            ++iter_counter;
+
+            // Update the local step counters.
+            for (std::uint32_t i = 0; i < m_batch_size; ++i) {
+                // NOTE: the local step counters increase only if we integrated
+                // for a non-zero time.
+                m_ts_count[i] += static_cast<std::size_t>(std::get<1>(m_step_res[i]) != 0);
+            }
+
+            // Break out if we have reached the time limit for all
+            // batch elements.
+            if (std::all_of(m_step_res.begin(), m_step_res.end(),
+                            [](const auto &tup) { return std::get<0>(tup) == taylor_outcome::time_limit; })) {
+                cb(*this);
+
+                break;
+            }
+
+            // Update min_h/max_h.
+            for (std::uint32_t i = 0; i < m_batch_size; ++i) {
+                // Don't update if we reached the time limit.
+                if (std::get<0>(m_step_res[i]) == taylor_outcome::time_limit) {
+                    continue;
+                }
+
+                using std::abs;
+                const auto abs_h = abs(std::get<1>(m_step_res[i]));
+                m_min_abs_h[i] = std::min(m_min_abs_h[i], abs_h);
+                m_max_abs_h[i] = std::max(m_max_abs_h[i], abs_h);
+            }
+
+            // Invoke the callback.
+            if (!cb(*this)) {
+                cb_stop = true;
+
+                break;
+            }
+
+            // Check the iteration limit.
+            if (max_steps != 0u && iter_counter == max_steps) {
+                break;
+            }
+        }
+
+        // Assemble the return value.
+        if (cb_stop || (max_steps != 0u && iter_counter == max_steps)) {
+            // We exited because the callback requested a stop or because we reached
+            // the max_steps limit: if the last integration step was successful
+            // return cb_stop/step_limit, otherwise time_limit.
+            const auto stop_oc = cb_stop ? taylor_outcome::cb_stop : taylor_outcome::step_limit;
+
+            for (std::uint32_t i = 0; i < m_batch_size; ++i) {
+                m_prop_res[i] = std::tuple{std::get<0>(m_step_res[i]) == taylor_outcome::success
+                                               ? stop_oc
+                                               : taylor_outcome::time_limit,
+                                           m_min_abs_h[i], m_max_abs_h[i], m_ts_count[i]};
+            }
+        } else {
+            // We exited either because of an error, or because all the batch
+            // elements reached the time limits. In this case, we just use the
+            // outcome of the last timestep.
+            for (std::uint32_t i = 0; i < m_batch_size; ++i) {
+                m_prop_res[i]
+                    = std::tuple{std::get<0>(m_step_res[i]), m_min_abs_h[i], m_max_abs_h[i], m_ts_count[i]};
+            }
+        }
+
+        return m_prop_res;
+    }
 };
 
 } // namespace detail
@@ -840,6 +1392,646 @@ struct taylor_adaptive_batch_t_impl<mppp::real128> {
 template <typename T>
 using taylor_adaptive_batch = typename detail::taylor_adaptive_batch_t_impl<T>::type;
 
+namespace kw
+{
+
+IGOR_MAKE_NAMED_ARGUMENT(order);
+
+} // namespace kw
+
+namespace detail
+{
+
+// Helper for parsing the options for the fixed-step Taylor integrators.
+template <typename T, typename... KwArgs>
+inline auto taylor_fixed_common_ops(KwArgs &&...kw_args)
+{
+    igor::parser p{kw_args...};
+
+    auto [high_accuracy, tol, compact_mode, pars, obs]
+        = taylor_adaptive_common_ops<T>(std::forward<KwArgs>(kw_args)...);
+
+    if (!obs.empty()) {
+        throw std::invalid_argument("Observables are not supported by the fixed-step Taylor integrators");
+    }
+
+    // Taylor order (defaults to zero, which means
+    // that the order is deduced from the tolerance).
+    auto order = [&p]() -> std::uint32_t {
+        if constexpr (p.has(kw::order)) {
+            return std::forward<decltype(p(kw::order))>(p(kw::order));
+        } else {
+            return 0;
+        }
+    }();
+
+    return std::tuple{high_accuracy, tol, compact_mode, std::move(pars), order};
+}
+
+// Fixed-order, fixed-step Taylor integrator. The integration
+// is performed by a compiled function which advances the
+// state by an arbitrary number of steps of size h, without
+// any step-size control. This results in a cost per step which
+// depends only on the ODE system and on the order.
+template <typename T>
+class HEYOKA_DLL_PUBLIC taylor_fixed_impl
+{
+    // State vector.
+    std::vector<T> m_state;
+    // Time.
+    T m_time;
+    // Timestep.
+    T m_h;
+    // The LLVM machinery.
+    llvm_state m_llvm;
+    // Dimension of the system.
+    std::uint32_t m_dim;
+    // Taylor decomposition.
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> m_dc;
+    // Taylor order.
+    std::uint32_t m_order;
+    // The multi-step function.
+    using step_f_t = void (*)(T *, const T *, T *, const T *, std::uint32_t);
+    step_f_t m_step_f;
+    // The vector of parameters.
+    std::vector<T> m_pars;
+
+    // Private implementation-detail constructor machinery.
+    template <typename U>
+    HEYOKA_DLL_PUBLIC void finalise_ctor_impl(U, std::vector<T>, T, T, std::uint32_t, T, bool, bool, std::vector<T>);
+    template <typename U, typename... KwArgs>
+    void finalise_ctor(U sys, std::vector<T> state, T h, KwArgs &&...kw_args)
+    {
+        igor::parser p{kw_args...};
+
+        if constexpr (p.has_unnamed_arguments()) {
+            static_assert(detail::always_false_v<KwArgs...>,
+                          "The variadic arguments in the construction of a fixed-step Taylor integrator contain "
+                          "unnamed arguments.");
+        } else {
+            // Initial time (defaults to zero).
+            const auto time = [&p]() -> T {
+                if constexpr (p.has(kw::time)) {
+                    return std::forward<decltype(p(kw::time))>(p(kw::time));
+                } else {
+                    return T(0);
+                }
+            }();
+
+            auto [high_accuracy, tol, compact_mode, pars, order]
+                = taylor_fixed_common_ops<T>(std::forward<KwArgs>(kw_args)...);
+
+            finalise_ctor_impl(std::move(sys), std::move(state), time, h, order, tol, high_accuracy, compact_mode,
+                               std::move(pars));
+        }
+    }
+
+public:
+    template <typename... KwArgs>
+    explicit taylor_fixed_impl(std::vector<expression> sys, std::vector<T> state, T h, KwArgs &&...kw_args)
+        : m_llvm{std::forward<KwArgs>(kw_args)...}
+    {
+        finalise_ctor(std::move(sys), std::move(state), h, std::forward<KwArgs>(kw_args)...);
+    }
+    template <typename... KwArgs>
+    explicit taylor_fixed_impl(std::vector<std::pair<expression, expression>> sys, std::vector<T> state, T h,
+                               KwArgs &&...kw_args)
+        : m_llvm{std::forward<KwArgs>(kw_args)...}
+    {
+        finalise_ctor(std::move(sys), std::move(state), h, std::forward<KwArgs>(kw_args)...);
+    }
+
+    taylor_fixed_impl(const taylor_fixed_impl &);
+    taylor_fixed_impl(taylor_fixed_impl &&) noexcept;
+
+    taylor_fixed_impl &operator=(const taylor_fixed_impl &);
+    taylor_fixed_impl &operator=(taylor_fixed_impl &&) noexcept;
+
+    ~taylor_fixed_impl();
+
+    const llvm_state &get_llvm_state() const;
+
+    const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &get_decomposition() const;
+
+    std::uint32_t get_order() const;
+    std::uint32_t get_dim() const;
+
+    T get_time() const
+    {
+        return m_time;
+    }
+    void set_time(T t)
+    {
+        m_time = t;
+    }
+
+    T get_h() const
+    {
+        return m_h;
+    }
+    void set_h(T);
+
+    const std::vector<T> &get_state() const
+    {
+        return m_state;
+    }
+    const T *get_state_data() const
+    {
+        return m_state.data();
+    }
+    T *get_state_data()
+    {
+        return m_state.data();
+    }
+
+    const std::vector<T> &get_pars() const
+    {
+        return m_pars;
+    }
+    const T *get_pars_data() const
+    {
+        return m_pars.data();
+    }
+    T *get_pars_data()
+    {
+        return m_pars.data();
+    }
+
+    // Perform n steps (1 by default). The return value
+    // is taylor_outcome::err_nf_state if the time or the state vector
+    // are non-finite at the end of the last step, taylor_outcome::success
+    // otherwise.
+    taylor_outcome step(std::uint32_t = 1);
+};
+
+} // namespace detail
+
+class HEYOKA_DLL_PUBLIC taylor_fixed_dbl : public detail::taylor_fixed_impl<double>
+{
+public:
+    using base = detail::taylor_fixed_impl<double>;
+    using base::base;
+};
+
+class HEYOKA_DLL_PUBLIC taylor_fixed_ldbl : public detail::taylor_fixed_impl<long double>
+{
+public:
+    using base = detail::taylor_fixed_impl<long double>;
+    using base::base;
+};
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+class HEYOKA_DLL_PUBLIC taylor_fixed_f128 : public detail::taylor_fixed_impl<mppp::real128>
+{
+public:
+    using base = detail::taylor_fixed_impl<mppp::real128>;
+    using base::base;
+};
+
+#endif
+
+namespace detail
+{
+
+template <typename T>
+struct taylor_fixed_t_impl {
+    static_assert(always_false_v<T>, "Unhandled type.");
+};
+
+template <>
+struct taylor_fixed_t_impl<double> {
+    using type = taylor_fixed_dbl;
+};
+
+template <>
+struct taylor_fixed_t_impl<long double> {
+    using type = taylor_fixed_ldbl;
+};
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template <>
+struct taylor_fixed_t_impl<mppp::real128> {
+    using type = taylor_fixed_f128;
+};
+
+#endif
+
+} // namespace detail
+
+template <typename T>
+using taylor_fixed = typename detail::taylor_fixed_t_impl<T>::type;
+
+namespace detail
+{
+
+// Batch version of the fixed-step Taylor integrator.
+// Each element of the batch has its own timestep.
+template <typename T>
+class HEYOKA_DLL_PUBLIC taylor_fixed_batch_impl
+{
+    // The batch size.
+    std::uint32_t m_batch_size;
+    // State vectors.
+    std::vector<T> m_state;
+    // Times.
+    std::vector<T> m_time;
+    // Timesteps.
+    std::vector<T> m_h;
+    // The LLVM machinery.
+    llvm_state m_llvm;
+    // Dimension of the system.
+    std::uint32_t m_dim;
+    // Taylor decomposition.
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> m_dc;
+    // Taylor order.
+    std::uint32_t m_order;
+    // The multi-step function.
+    using step_f_t = void (*)(T *, const T *, T *, const T *, std::uint32_t);
+    step_f_t m_step_f;
+    // The vector of parameters.
+    std::vector<T> m_pars;
+    // The vector used to store the results of step().
+    std::vector<taylor_outcome> m_step_res;
+    // Temporary vector used in step().
+    std::vector<T> m_time_copy;
+
+    // Private implementation-detail constructor machinery.
+    template <typename U>
+    HEYOKA_DLL_PUBLIC void finalise_ctor_impl(U, std::vector<T>, std::uint32_t, std::vector<T>, std::vector<T>,
+                                              std::uint32_t, T, bool, bool, std::vector<T>);
+    template <typename U, typename... KwArgs>
+    void finalise_ctor(U sys, std::vector<T> state, std::uint32_t batch_size, std::vector<T> h, KwArgs &&...kw_args)
+    {
+        igor::parser p{kw_args...};
+
+        if constexpr (p.has_unnamed_arguments()) {
+            static_assert(detail::always_false_v<KwArgs...>,
+                          "The variadic arguments in the construction of a fixed-step batch Taylor integrator contain "
+                          "unnamed arguments.");
+        } else {
+            // Initial times (defaults to a vector of zeroes).
+            auto time = [&p, batch_size]() -> std::vector<T> {
+                if constexpr (p.has(kw::time)) {
+                    return std::forward<decltype(p(kw::time))>(p(kw::time));
+                } else {
+                    return std::vector<T>(static_cast<typename std::vector<T>::size_type>(batch_size), T(0));
+                }
+            }();
+
+            auto [high_accuracy, tol, compact_mode, pars, order]
+                = taylor_fixed_common_ops<T>(std::forward<KwArgs>(kw_args)...);
+
+            finalise_ctor_impl(std::move(sys), std::move(state), batch_size, std::move(time), std::move(h), order, tol,
+                               high_accuracy, compact_mode, std::move(pars));
+        }
+    }
+
+public:
+    template <typename... KwArgs>
+    explicit taylor_fixed_batch_impl(std::vector<expression> sys, std::vector<T> state, std::uint32_t batch_size,
+                                     std::vector<T> h, KwArgs &&...kw_args)
+        : m_llvm{std::forward<KwArgs>(kw_args)...}
+    {
+        finalise_ctor(std::move(sys), std::move(state), batch_size, std::move(h), std::forward<KwArgs>(kw_args)...);
+    }
+    template <typename... KwArgs>
+    explicit taylor_fixed_batch_impl(std::vector<std::pair<expression, expression>> sys, std::vector<T> state,
+                                     std::uint32_t batch_size, std::vector<T> h, KwArgs &&...kw_args)
+        : m_llvm{std::forward<KwArgs>(kw_args)...}
+    {
+        finalise_ctor(std::move(sys), std::move(state), batch_size, std::move(h), std::forward<KwArgs>(kw_args)...);
+    }
+
+    taylor_fixed_batch_impl(const taylor_fixed_batch_impl &);
+    taylor_fixed_batch_impl(taylor_fixed_batch_impl &&) noexcept;
+
+    taylor_fixed_batch_impl &operator=(const taylor_fixed_batch_impl &);
+    taylor_fixed_batch_impl &operator=(taylor_fixed_batch_impl &&) noexcept;
+
+    ~taylor_fixed_batch_impl();
+
+    const llvm_state &get_llvm_state() const;
+
+    const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &get_decomposition() const;
+
+    std::uint32_t get_batch_size() const;
+    std::uint32_t get_order() const;
+    std::uint32_t get_dim() const;
+
+    const std::vector<T> &get_time() const
+    {
+        return m_time;
+    }
+    const T *get_time_data() const
+    {
+        return m_time.data();
+    }
+    T *get_time_data()
+    {
+        return m_time.data();
+    }
+
+    const std::vector<T> &get_h() const
+    {
+        return m_h;
+    }
+    void set_h(std::vector<T>);
+
+    const std::vector<T> &get_state() const
+    {
+        return m_state;
+    }
+    const T *get_state_data() const
+    {
+        return m_state.data();
+    }
+    T *get_state_data()
+    {
+        return m_state.data();
+    }
+
+    const std::vector<T> &get_pars() const
+    {
+        return m_pars;
+    }
+    const T *get_pars_data() const
+    {
+        return m_pars.data();
+    }
+    T *get_pars_data()
+    {
+        return m_pars.data();
+    }
+
+    // Perform n steps (1 by default). The return value
+    // contains the outcome for each element of the batch,
+    // as in the scalar integrator.
+    const std::vector<taylor_outcome> &step(std::uint32_t = 1);
+};
+
+} // namespace detail
+
+class HEYOKA_DLL_PUBLIC taylor_fixed_batch_dbl : public detail::taylor_fixed_batch_impl<double>
+{
+public:
+    using base = detail::taylor_fixed_batch_impl<double>;
+    using base::base;
+};
+
+class HEYOKA_DLL_PUBLIC taylor_fixed_batch_ldbl : public detail::taylor_fixed_batch_impl<long double>
+{
+public:
+    using base = detail::taylor_fixed_batch_impl<long double>;
+    using base::base;
+};
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+class HEYOKA_DLL_PUBLIC taylor_fixed_batch_f128 : public detail::taylor_fixed_batch_impl<mppp::real128>
+{
+public:
+    using base = detail::taylor_fixed_batch_impl<mppp::real128>;
+    using base::base;
+};
+
+#endif
+
+namespace detail
+{
+
+template <typename T>
+struct taylor_fixed_batch_t_impl {
+    static_assert(always_false_v<T>, "Unhandled type.");
+};
+
+template <>
+struct taylor_fixed_batch_t_impl<double> {
+    using type = taylor_fixed_batch_dbl;
+};
+
+template <>
+struct taylor_fixed_batch_t_impl<long double> {
+    using type = taylor_fixed_batch_ldbl;
+};
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template <>
+struct taylor_fixed_batch_t_impl<mppp::real128> {
+    using type = taylor_fixed_batch_f128;
+};
+
+#endif
+
+} // namespace detail
+
+template <typename T>
+using taylor_fixed_batch = typename detail::taylor_fixed_batch_t_impl<T>::type;
+
+namespace kw
+{
+
+IGOR_MAKE_NAMED_ARGUMENT(batch_size);
+
+} // namespace kw
+
+namespace detail
+{
+
+// Driver for the evaluation of the jet of derivatives of an ODE system
+// over a large number of initial conditions. The jet function is compiled
+// once (with a batch size which, by default, matches the SIMD width of
+// the host machine) and then it is invoked in parallel over chunks
+// of the input array.
+// NOTE: in compact mode, the jet function stores the derivatives in
+// global arrays, and thus it cannot be invoked concurrently. In such case,
+// the chunks are processed serially (and the call operator must not be
+// invoked concurrently on the same driver).
+template <typename T>
+class HEYOKA_DLL_PUBLIC taylor_jet_driver_impl
+{
+    // The LLVM machinery.
+    llvm_state m_llvm;
+    // Dimension of the system.
+    std::uint32_t m_dim;
+    // Taylor order.
+    std::uint32_t m_order;
+    // Batch size of the jet function.
+    std::uint32_t m_batch_size;
+    // Number of parameters in the system.
+    std::uint32_t m_n_pars;
+    // Compact mode.
+    bool m_compact_mode;
+    // Taylor decomposition.
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> m_dc;
+    // Functions of the state variables whose
+    // jets are computed alongside the state jet.
+    std::vector<expression> m_obs;
+    // The jet function.
+    using jet_f_t = void (*)(T *, const T *, const T *);
+    jet_f_t m_jet_f;
+
+    // Private implementation-detail constructor machinery.
+    template <typename U>
+    HEYOKA_DLL_PUBLIC void finalise_ctor_impl(U, std::uint32_t, std::uint32_t, bool, bool, std::vector<expression>);
+    template <typename U, typename... KwArgs>
+    void finalise_ctor(U sys, std::uint32_t order, KwArgs &&...kw_args)
+    {
+        igor::parser p{kw_args...};
+
+        if constexpr (p.has_unnamed_arguments()) {
+            static_assert(detail::always_false_v<KwArgs...>,
+                          "The variadic arguments in the construction of a Taylor jet driver contain "
+                          "unnamed arguments.");
+        } else {
+            // Batch size (defaults to zero, which means
+            // that it is deduced from the host machine).
+            auto batch_size = [&p]() -> std::uint32_t {
+                if constexpr (p.has(kw::batch_size)) {
+                    return std::forward<decltype(p(kw::batch_size))>(p(kw::batch_size));
+                } else {
+                    return 0;
+                }
+            }();
+
+            // High accuracy mode (defaults to false).
+            auto high_accuracy = [&p]() -> bool {
+                if constexpr (p.has(kw::high_accuracy)) {
+                    return std::forward<decltype(p(kw::high_accuracy))>(p(kw::high_accuracy));
+                } else {
+                    return false;
+                }
+            }();
+
+            // Compact mode (defaults to false).
+            auto compact_mode = [&p]() -> bool {
+                if constexpr (p.has(kw::compact_mode)) {
+                    return std::forward<decltype(p(kw::compact_mode))>(p(kw::compact_mode));
+                } else {
+                    return false;
+                }
+            }();
+
+            // Observables (defaults to empty vector).
+            auto obs = [&p]() -> std::vector<expression> {
+                if constexpr (p.has(kw::observables)) {
+                    return std::forward<decltype(p(kw::observables))>(p(kw::observables));
+                } else {
+                    return {};
+                }
+            }();
+
+            finalise_ctor_impl(std::move(sys), order, batch_size, high_accuracy, compact_mode, std::move(obs));
+        }
+    }
+
+public:
+    template <typename... KwArgs>
+    explicit taylor_jet_driver_impl(std::vector<expression> sys, std::uint32_t order, KwArgs &&...kw_args)
+        : m_llvm{std::forward<KwArgs>(kw_args)...}
+    {
+        finalise_ctor(std::move(sys), order, std::forward<KwArgs>(kw_args)...);
+    }
+    template <typename... KwArgs>
+    explicit taylor_jet_driver_impl(std::vector<std::pair<expression, expression>> sys, std::uint32_t order,
+                                    KwArgs &&...kw_args)
+        : m_llvm{std::forward<KwArgs>(kw_args)...}
+    {
+        finalise_ctor(std::move(sys), order, std::forward<KwArgs>(kw_args)...);
+    }
+
+    taylor_jet_driver_impl(const taylor_jet_driver_impl &);
+    taylor_jet_driver_impl(taylor_jet_driver_impl &&) noexcept;
+
+    taylor_jet_driver_impl &operator=(const taylor_jet_driver_impl &);
+    taylor_jet_driver_impl &operator=(taylor_jet_driver_impl &&) noexcept;
+
+    ~taylor_jet_driver_impl();
+
+    const llvm_state &get_llvm_state() const;
+
+    const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &get_decomposition() const;
+
+    std::uint32_t get_order() const;
+    std::uint32_t get_dim() const;
+    std::uint32_t get_batch_size() const;
+    std::uint32_t get_n_pars() const;
+    const std::vector<expression> &get_observables() const;
+
+    // Compute the jets for n initial conditions. All the arrays
+    // are in SoA layout, with n as the innermost dimension:
+    // - in (read only) contains the initial conditions, with layout [var][n],
+    // - pars (read only) contains the values of the parameters, with
+    //   layout [par][n]; it can be null if the system has no parameters,
+    // - time (read only) contains the initial times, with layout [n]; if
+    //   null, the initial times are all zero,
+    // - out (write only) receives the jets, with layout [order][var][n], where
+    //   var runs over the state variables followed by the observables.
+    // The arrays cannot overlap.
+    void operator()(T *, const T *, std::size_t, const T * = nullptr, const T * = nullptr) const;
+};
+
+} // namespace detail
+
+class HEYOKA_DLL_PUBLIC taylor_jet_driver_dbl : public detail::taylor_jet_driver_impl<double>
+{
+public:
+    using base = detail::taylor_jet_driver_impl<double>;
+    using base::base;
+};
+
+class HEYOKA_DLL_PUBLIC taylor_jet_driver_ldbl : public detail::taylor_jet_driver_impl<long double>
+{
+public:
+    using base = detail::taylor_jet_driver_impl<long double>;
+    using base::base;
+};
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+class HEYOKA_DLL_PUBLIC taylor_jet_driver_f128 : public detail::taylor_jet_driver_impl<mppp::real128>
+{
+public:
+    using base = detail::taylor_jet_driver_impl<mppp::real128>;
+    using base::base;
+};
+
+#endif
+
+namespace detail
+{
+
+template <typename T>
+struct taylor_jet_driver_t_impl {
+    static_assert(always_false_v<T>, "Unhandled type.");
+};
+
+template <>
+struct taylor_jet_driver_t_impl<double> {
+    using type = taylor_jet_driver_dbl;
+};
+
+template <>
+struct taylor_jet_driver_t_impl<long double> {
+    using type = taylor_jet_driver_ldbl;
+};
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template <>
+struct taylor_jet_driver_t_impl<mppp::real128> {
+    using type = taylor_jet_driver_f128;
+};
+
+#endif
+
+} // namespace detail
+
+template <typename T>
+using taylor_jet_driver = typename detail::taylor_jet_driver_t_impl<T>::type;
+
 namespace detail
 {
 
@@ -0,0 +1,124 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <heyoka/chaos.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/math/square.hpp>
+#include <heyoka/math/time.hpp>
+#include <heyoka/number.hpp>
+#include <heyoka/variable.hpp>
+
+namespace heyoka
+{
+
+std::vector<std::pair<expression, expression>> make_chaos_sys(std::vector<std::pair<expression, expression>> sys,
+                                                              chaos_indicator ind)
+{
+    if (sys.empty()) {
+        throw std::invalid_argument("Cannot augment a system of zero equations with a chaos indicator");
+    }
+
+    std::string acc_name;
+    switch (ind) {
+        case chaos_indicator::megno:
+            acc_name = "megno";
+            break;
+        case chaos_indicator::fli:
+            acc_name = "fli";
+            break;
+        default:
+            throw std::invalid_argument("Invalid chaos indicator " + std::to_string(static_cast<int>(ind))
+                                        + " specified in the augmentation of a system of ODEs");
+    }
+
+    // Fetch the state variables, checking that they
+    // are all distinct.
+    std::vector<std::string> vars;
+    std::unordered_set<std::string> vars_set;
+    for (const auto &[lhs, _] : sys) {
+        if (auto p_var = std::get_if<variable>(&lhs.value())) {
+            if (!vars_set.insert(p_var->name()).second) {
+                throw std::invalid_argument("Error in the augmentation of a system of ODEs with a chaos indicator: "
+                                            "the variable '"
+                                            + p_var->name() + "' appears in the left-hand side twice");
+            }
+            vars.push_back(p_var->name());
+        } else {
+            throw std::invalid_argument("Error in the augmentation of a system of ODEs with a chaos indicator: "
+                                        "the left-hand side contains an expression which is not a variable");
+        }
+    }
+
+    // Create the variables for the tangent vector
+    // and for the accumulator.
+    auto check_name = [&vars_set](const std::string &name) {
+        if (vars_set.find(name) != vars_set.end()) {
+            throw std::invalid_argument("Error in the augmentation of a system of ODEs with a chaos indicator: "
+                                        "the name of the auxiliary variable '"
+                                        + name + "' clashes with a state variable");
+        }
+    };
+
+    std::vector<expression> d_vars;
+    for (const auto &name : vars) {
+        check_name("d_" + name);
+        d_vars.emplace_back(variable{"d_" + name});
+    }
+    check_name(acc_name);
+
+    // Build the variational equations.
+    std::vector<expression> d_rhs;
+    for (const auto &[_, rhs] : sys) {
+        std::vector<expression> terms;
+
+        for (decltype(vars.size()) j = 0; j < vars.size(); ++j) {
+            auto der = diff(rhs, vars[j]);
+
+            // NOTE: skip the entries of the Jacobian which are zero,
+            // as it is often the case in mechanical systems.
+            if (auto p_num = std::get_if<number>(&der.value()); p_num != nullptr && is_zero(*p_num)) {
+                continue;
+            }
+
+            terms.push_back(std::move(der) * d_vars[j]);
+        }
+
+        d_rhs.push_back(terms.empty() ? 0_dbl : pairwise_sum(std::move(terms)));
+    }
+
+    // The instantaneous stretching rate of the tangent vector.
+    std::vector<expression> num_terms, den_terms;
+    for (decltype(d_vars.size()) i = 0; i < d_vars.size(); ++i) {
+        num_terms.push_back(d_vars[i] * d_rhs[i]);
+        den_terms.push_back(square(d_vars[i]));
+    }
+    auto lambda = pairwise_sum(std::move(num_terms)) / pairwise_sum(std::move(den_terms));
+
+    // Assemble the augmented system.
+    auto retval = std::move(sys);
+    for (decltype(d_vars.size()) i = 0; i < d_vars.size(); ++i) {
+        retval.push_back(prime(d_vars[i]) = std::move(d_rhs[i]));
+    }
+
+    if (ind == chaos_indicator::megno) {
+        retval.push_back(prime(expression{variable{acc_name}}) = std::move(lambda) * heyoka::time);
+    } else {
+        retval.push_back(prime(expression{variable{acc_name}}) = std::move(lambda));
+    }
+
+    return retval;
+}
+
+} // namespace heyoka
@@ -0,0 +1,414 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// NOTE: the root isolation algorithm is based on Descartes' rule of signs.
+// References:
+// https://en.wikipedia.org/wiki/Real-root_isolation
+// https://en.wikipedia.org/wiki/Descartes%27_rule_of_signs
+
+#include <heyoka/config.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/close_approach.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// Maximum number of bisections in the root isolation
+// of a polynomial. This caps the work when the polynomial
+// has multiple (or numerically clustered) roots.
+constexpr unsigned ca_max_isol_depth = 64;
+
+// Maximum number of bisections in the refinement of an isolated root.
+constexpr unsigned ca_max_refine_iter = 256;
+
+// Evaluate the polynomial with coefficients p at x.
+template <typename T>
+T ca_horner_eval(const std::vector<T> &p, const T &x)
+{
+    assert(!p.empty());
+
+    auto retval = p.back();
+    for (auto i = p.size() - 1u; i > 0u; --i) {
+        retval = p[i - 1u] + retval * x;
+    }
+
+    return retval;
+}
+
+// Count the sign changes in the coefficients of the
+// polynomial p, ignoring zero coefficients.
+template <typename T>
+std::uint32_t ca_count_sign_changes(const std::vector<T> &p)
+{
+    std::uint32_t retval = 0;
+    int last_sign = 0;
+
+    for (const auto &c : p) {
+        const auto cur_sign = (c > 0) - (c < 0);
+
+        if (cur_sign != 0) {
+            retval += static_cast<std::uint32_t>(last_sign != 0 && cur_sign != last_sign);
+            last_sign = cur_sign;
+        }
+    }
+
+    return retval;
+}
+
+// Replace p(x) with p(x + 1) (Taylor shift by 1).
+template <typename T>
+void ca_poly_translate_1(std::vector<T> &p)
+{
+    const auto n = p.size();
+
+    for (decltype(p.size()) i = 0; i + 1u < n; ++i) {
+        for (auto j = n - 1u; j > i; --j) {
+            p[j - 1u] += p[j];
+        }
+    }
+}
+
+// Rescale p by its coefficient of largest magnitude. This does not
+// alter the roots of p, and it prevents the coefficients from
+// overflowing/underflowing during repeated bisections.
+template <typename T>
+void ca_poly_normalise(std::vector<T> &p)
+{
+    using std::abs;
+
+    T max_abs(0);
+    for (const auto &c : p) {
+        max_abs = std::max(max_abs, abs(c));
+    }
+
+    if (max_abs > 0) {
+        for (auto &c : p) {
+            c /= max_abs;
+        }
+    }
+}
+
+// Upper bound for the number of roots of p in (0, 1), via Descartes'
+// rule of signs applied to (x + 1)**n * p(1 / (x + 1)).
+template <typename T>
+std::uint32_t ca_descartes_bound(const std::vector<T> &p)
+{
+    auto tmp(p);
+    std::reverse(tmp.begin(), tmp.end());
+    ca_poly_translate_1(tmp);
+
+    return ca_count_sign_changes(tmp);
+}
+
+// Locate the critical points of the polynomial with derivative dp in the
+// interval (0, 1), appending them to out. The roots of dp are first isolated
+// by recursive bisection, and then refined by bisection.
+template <typename T>
+void ca_find_critical_points(const std::vector<T> &dp, std::vector<T> &out)
+{
+    // The work list of subintervals [lb, ub], each represented by
+    // the polynomial q(x) = dp(lb + x * (ub - lb)) (up to a
+    // positive factor) and by the bisection depth.
+    std::vector<std::tuple<std::vector<T>, T, T, unsigned>> wlist, new_wlist;
+    wlist.emplace_back(dp, T(0), T(1), 0u);
+
+    // Refine the isolated root of dp in [lb, ub].
+    auto refine = [&dp, &out](T lb, T ub) {
+        auto f_lb = ca_horner_eval(dp, lb);
+        const auto f_ub = ca_horner_eval(dp, ub);
+
+        if ((f_lb > 0) == (f_ub > 0) || f_lb == 0 || f_ub == 0) {
+            // NOTE: this can happen only if the root lies on the boundary
+            // of the interval (or because of roundoff errors). The boundaries
+            // are added as candidates.
+            out.push_back(lb);
+            out.push_back(ub);
+            return;
+        }
+
+        for (unsigned i = 0; i < ca_max_refine_iter; ++i) {
+            const auto mid = (lb + ub) / 2;
+            if (!(mid > lb && mid < ub)) {
+                break;
+            }
+
+            const auto f_mid = ca_horner_eval(dp, mid);
+            if (f_mid == 0) {
+                lb = ub = mid;
+                break;
+            }
+
+            if ((f_mid > 0) == (f_lb > 0)) {
+                lb = mid;
+                f_lb = f_mid;
+            } else {
+                ub = mid;
+            }
+        }
+
+        out.push_back((lb + ub) / 2);
+    };
+
+    while (!wlist.empty()) {
+        new_wlist.clear();
+
+        for (auto &[q, lb, ub, k] : wlist) {
+            const auto nroots = ca_descartes_bound(q);
+
+            if (nroots == 0u) {
+                continue;
+            }
+
+            if (nroots == 1u) {
+                refine(lb, ub);
+                continue;
+            }
+
+            // Add the midpoint of the interval as a candidate: it may
+            // be a root of dp, which would not be detected by the
+            // isolation of the two halves.
+            const auto mid = (lb + ub) / 2;
+            out.push_back(mid);
+
+            if (k == ca_max_isol_depth) {
+                // NOTE: the isolation did not converge, use
+                // the midpoint as an approximation.
+                continue;
+            }
+
+            // Left half: q(x / 2).
+            auto q_l(std::move(q));
+            T fac(1);
+            for (auto &coeff : q_l) {
+                coeff *= fac;
+                fac /= 2;
+            }
+            ca_poly_normalise(q_l);
+
+            // Right half: q((x + 1) / 2).
+            auto q_r(q_l);
+            ca_poly_translate_1(q_r);
+
+            new_wlist.emplace_back(std::move(q_l), lb, mid, k + 1u);
+            new_wlist.emplace_back(std::move(q_r), mid, ub, k + 1u);
+        }
+
+        std::swap(wlist, new_wlist);
+    }
+}
+
+template <typename T>
+std::vector<close_approach<T>> nbody_close_approaches_impl(const T *tc, std::uint32_t order, std::uint32_t n_bodies,
+                                                           T t0, T h, T threshold)
+{
+    using std::abs;
+    using std::isfinite;
+    using std::sqrt;
+
+    if (order == 0u) {
+        throw std::invalid_argument("The Taylor order must be at least 1 in the detection of close approaches");
+    }
+    if (!isfinite(t0) || !isfinite(h)) {
+        throw std::invalid_argument("The initial time and the timestep size must be finite in the detection of "
+                                    "close approaches");
+    }
+    if (!isfinite(threshold) || threshold <= 0) {
+        throw std::invalid_argument("The distance threshold must be finite and positive in the detection of "
+                                    "close approaches");
+    }
+
+    std::vector<close_approach<T>> retval;
+
+    if (n_bodies < 2u) {
+        return retval;
+    }
+
+    // NOTE: the Taylor coefficients of the state variables
+    // of the N-body system span 6 * n_bodies * (order + 1) values.
+    if (n_bodies > std::numeric_limits<std::uint32_t>::max() / 6u
+        || order == std::numeric_limits<std::uint32_t>::max()
+        || 6u * n_bodies > std::numeric_limits<std::size_t>::max() / (order + 1u)) {
+        throw std::overflow_error("Overflow detected in the detection of close approaches");
+    }
+
+    assert(tc != nullptr);
+
+    const auto n_coeffs = static_cast<std::size_t>(order) + 1u;
+
+    // Fetch the Taylor coefficients of the positions,
+    // rescaled so that the polynomials are defined
+    // in the normalised time interval [0, 1].
+    std::vector<T> pos_coeffs(static_cast<std::size_t>(n_bodies) * 3u * n_coeffs);
+    for (std::uint32_t i = 0; i < n_bodies; ++i) {
+        for (std::uint32_t c = 0; c < 3u; ++c) {
+            const auto src = tc + (static_cast<std::size_t>(i) * 6u + c) * n_coeffs;
+            const auto dst = pos_coeffs.data() + (static_cast<std::size_t>(i) * 3u + c) * n_coeffs;
+
+            T fac(1);
+            for (std::size_t k = 0; k < n_coeffs; ++k) {
+                dst[k] = src[k] * fac;
+                fac *= h;
+            }
+        }
+    }
+
+    // Compute the bounding box of each body
+    // over the timestep, inflated by half the threshold.
+    std::vector<T> lbs(static_cast<std::size_t>(n_bodies) * 3u), ubs(lbs.size());
+    for (std::size_t i = 0; i < lbs.size(); ++i) {
+        const auto p = pos_coeffs.data() + i * n_coeffs;
+
+        T rad(0);
+        for (std::size_t k = 1; k < n_coeffs; ++k) {
+            rad += abs(p[k]);
+        }
+        rad += threshold / 2;
+
+        lbs[i] = p[0] - rad;
+        ubs[i] = p[0] + rad;
+    }
+
+    // Broad phase: sweep and prune along the x axis.
+    std::vector<std::uint32_t> sorted_bodies(n_bodies);
+    for (std::uint32_t i = 0; i < n_bodies; ++i) {
+        sorted_bodies[i] = i;
+    }
+    std::sort(sorted_bodies.begin(), sorted_bodies.end(),
+              [&lbs](std::uint32_t a, std::uint32_t b) { return lbs[a * 3u] < lbs[b * 3u]; });
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> cands;
+    std::vector<std::uint32_t> active;
+    for (const auto i : sorted_bodies) {
+        // Remove from the active list the bodies whose
+        // boxes end before the beginning of the box of i.
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](std::uint32_t j) { return ubs[j * 3u] < lbs[i * 3u]; }),
+                     active.end());
+
+        for (const auto j : active) {
+            if (lbs[i * 3u + 1u] <= ubs[j * 3u + 1u] && lbs[j * 3u + 1u] <= ubs[i * 3u + 1u]
+                && lbs[i * 3u + 2u] <= ubs[j * 3u + 2u] && lbs[j * 3u + 2u] <= ubs[i * 3u + 2u]) {
+                cands.emplace_back(std::min(i, j), std::max(i, j));
+            }
+        }
+
+        active.push_back(i);
+    }
+
+    // Narrow phase: compute the minimum distance of the candidate pairs.
+    std::vector<T> diff(n_coeffs), r2(2u * n_coeffs - 1u), dr2(2u * n_coeffs - 2u), crit_pts;
+    for (const auto &[i, j] : cands) {
+        // The squared distance polynomial.
+        // NOTE: the square is not truncated to the Taylor order, so that
+        // the minimum distance is exact for the polynomial trajectories.
+        std::fill(r2.begin(), r2.end(), T(0));
+        for (std::uint32_t c = 0; c < 3u; ++c) {
+            const auto pi = pos_coeffs.data() + (static_cast<std::size_t>(i) * 3u + c) * n_coeffs;
+            const auto pj = pos_coeffs.data() + (static_cast<std::size_t>(j) * 3u + c) * n_coeffs;
+
+            for (std::size_t k = 0; k < n_coeffs; ++k) {
+                diff[k] = pj[k] - pi[k];
+            }
+
+            for (std::size_t k = 0; k < n_coeffs; ++k) {
+                for (std::size_t l = 0; l < n_coeffs; ++l) {
+                    r2[k + l] += diff[k] * diff[l];
+                }
+            }
+        }
+
+        // Its derivative.
+        for (std::size_t k = 0; k < dr2.size(); ++k) {
+            dr2[k] = static_cast<T>(k + 1u) * r2[k + 1u];
+        }
+
+        // The minimum of the squared distance is attained either at the
+        // boundaries of the timestep or at a critical point.
+        crit_pts.clear();
+        crit_pts.push_back(T(0));
+        crit_pts.push_back(T(1));
+        ca_find_critical_points(dr2, crit_pts);
+
+        auto min_s = T(0);
+        auto min_r2 = ca_horner_eval(r2, min_s);
+        for (const auto &s : crit_pts) {
+            const auto cur_r2 = ca_horner_eval(r2, s);
+            if (cur_r2 < min_r2) {
+                min_s = s;
+                min_r2 = cur_r2;
+            }
+        }
+
+        // NOTE: the squared distance may be slightly negative
+        // due to roundoff errors or to the truncation.
+        min_r2 = std::max(min_r2, T(0));
+
+        if (min_r2 < threshold * threshold) {
+            retval.push_back(close_approach<T>{i, j, t0 + min_s * h, sqrt(min_r2)});
+        }
+    }
+
+    std::sort(retval.begin(), retval.end(),
+              [](const auto &a, const auto &b) { return std::tie(a.i, a.j) < std::tie(b.i, b.j); });
+
+    return retval;
+}
+
+} // namespace
+
+std::vector<close_approach<double>> nbody_close_approaches_dbl(const double *tc, std::uint32_t order,
+                                                               std::uint32_t n_bodies, double t0, double h,
+                                                               double threshold)
+{
+    return nbody_close_approaches_impl(tc, order, n_bodies, t0, h, threshold);
+}
+
+std::vector<close_approach<long double>> nbody_close_approaches_ldbl(const long double *tc, std::uint32_t order,
+                                                                     std::uint32_t n_bodies, long double t0,
+                                                                     long double h, long double threshold)
+{
+    return nbody_close_approaches_impl(tc, order, n_bodies, t0, h, threshold);
+}
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+std::vector<close_approach<mppp::real128>> nbody_close_approaches_f128(const mppp::real128 *tc, std::uint32_t order,
+                                                                       std::uint32_t n_bodies, mppp::real128 t0,
+                                                                       mppp::real128 h, mppp::real128 threshold)
+{
+    return nbody_close_approaches_impl(tc, order, n_bodies, t0, h, threshold);
+}
+
+#endif
+
+} // namespace detail
+
+} // namespace heyoka
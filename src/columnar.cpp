@@ -0,0 +1,273 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <heyoka/config.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <fmt/format.h>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/columnar.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> columnar_magic = {'h', 'e', 'y', 'o', 'k', 'a', 'c', 'l'};
+constexpr std::uint32_t columnar_version = 1;
+constexpr std::uint32_t columnar_endian_marker = 0x01020304ul;
+
+// Size of the header. This is also the offset
+// of the data section.
+constexpr std::size_t columnar_header_size = 64;
+
+// Offsets of the fields in the header.
+constexpr std::size_t columnar_version_offset = 8;
+constexpr std::size_t columnar_endian_offset = 12;
+constexpr std::size_t columnar_type_offset = 16;
+constexpr std::size_t columnar_vsize_offset = 24;
+constexpr std::size_t columnar_n_rows_offset = 32;
+constexpr std::size_t columnar_n_cols_offset = 40;
+
+// Size of a value of the given type.
+std::uint64_t columnar_value_size(columnar_type t)
+{
+    switch (t) {
+        case columnar_type::dbl:
+            return sizeof(double);
+        case columnar_type::ldbl:
+            return sizeof(long double);
+        case columnar_type::f128:
+#if defined(HEYOKA_HAVE_REAL128)
+            return sizeof(mppp::real128);
+#else
+            throw std::invalid_argument("Cannot use a columnar file containing quadruple-precision values: heyoka "
+                                        "was built without support for quadruple-precision computations");
+#endif
+        case columnar_type::i64:
+            return sizeof(std::int64_t);
+        case columnar_type::u64:
+            return sizeof(std::uint64_t);
+        default:
+            using namespace fmt::literals;
+
+            throw std::invalid_argument("Invalid value type {} detected in a columnar file"_format(
+                static_cast<std::uint32_t>(t)));
+    }
+}
+
+// Total size in bytes of a columnar file.
+std::uint64_t columnar_file_size(std::uint64_t vsize, std::uint64_t n_rows, std::uint64_t n_cols)
+{
+    constexpr auto max = std::numeric_limits<std::uint64_t>::max();
+
+    if ((n_cols != 0u && n_rows > max / n_cols) || (n_rows * n_cols != 0u && vsize > max / (n_rows * n_cols))
+        || n_rows * n_cols * vsize > max - columnar_header_size
+        || n_rows * n_cols * vsize + columnar_header_size > std::numeric_limits<std::size_t>::max()) {
+        throw std::overflow_error("Overflow detected in the computation of the size of a columnar file");
+    }
+
+    return n_rows * n_cols * vsize + columnar_header_size;
+}
+
+template <typename T>
+void columnar_write_field(char *header, std::size_t offset, const T &x)
+{
+    std::memcpy(header + offset, &x, sizeof(T));
+}
+
+template <typename T>
+T columnar_read_field(const char *header, std::size_t offset)
+{
+    T retval;
+    std::memcpy(&retval, header + offset, sizeof(T));
+    return retval;
+}
+
+} // namespace
+
+} // namespace detail
+
+struct columnar_file::impl {
+    boost::interprocess::file_mapping m_fm;
+    boost::interprocess::mapped_region m_reg;
+    columnar_type m_type;
+    std::uint64_t m_vsize, m_n_rows, m_n_cols;
+    bool m_read_only;
+
+    explicit impl(const std::string &path, bool read_only)
+        : m_fm(path.c_str(), read_only ? boost::interprocess::read_only : boost::interprocess::read_write),
+          m_reg(m_fm, read_only ? boost::interprocess::read_only : boost::interprocess::read_write),
+          m_read_only(read_only)
+    {
+        using namespace fmt::literals;
+
+        if (m_reg.get_size() < detail::columnar_header_size) {
+            throw std::invalid_argument("The file '{}' is too small to be a columnar file"_format(path));
+        }
+
+        const auto *header = static_cast<const char *>(m_reg.get_address());
+
+        if (std::memcmp(header, detail::columnar_magic.data(), detail::columnar_magic.size()) != 0) {
+            throw std::invalid_argument("Invalid header detected in the columnar file '{}'"_format(path));
+        }
+
+        // NOTE: the endianness marker must be validated before
+        // reading any other multi-byte field, otherwise a file produced
+        // on a platform with a different endianness would be reported
+        // as having an unsupported version.
+        if (detail::columnar_read_field<std::uint32_t>(header, detail::columnar_endian_offset)
+            != detail::columnar_endian_marker) {
+            throw std::invalid_argument(
+                "The columnar file '{}' was produced on a platform with a different endianness"_format(path));
+        }
+
+        if (const auto ver = detail::columnar_read_field<std::uint32_t>(header, detail::columnar_version_offset);
+            ver != detail::columnar_version) {
+            throw std::invalid_argument("Unsupported format version detected in the columnar file '{}': {} was "
+                                        "expected, but {} was read instead"_format(path, detail::columnar_version,
+                                                                                   ver));
+        }
+
+        m_type = static_cast<columnar_type>(
+            detail::columnar_read_field<std::uint32_t>(header, detail::columnar_type_offset));
+        m_vsize = detail::columnar_read_field<std::uint64_t>(header, detail::columnar_vsize_offset);
+        m_n_rows = detail::columnar_read_field<std::uint64_t>(header, detail::columnar_n_rows_offset);
+        m_n_cols = detail::columnar_read_field<std::uint64_t>(header, detail::columnar_n_cols_offset);
+
+        if (m_vsize != detail::columnar_value_size(m_type)) {
+            throw std::invalid_argument(
+                "The columnar file '{}' was produced on a platform with a different size of the values"_format(path));
+        }
+
+        if (m_reg.get_size() != detail::columnar_file_size(m_vsize, m_n_rows, m_n_cols)) {
+            throw std::invalid_argument(
+                "The size of the columnar file '{}' is inconsistent with its header"_format(path));
+        }
+    }
+};
+
+columnar_file::columnar_file(const std::string &path, bool read_only)
+    : m_impl(std::make_unique<impl>(path, read_only))
+{
+}
+
+columnar_file::columnar_file(const std::string &path, columnar_type t, std::uint64_t n_rows, std::uint64_t n_cols)
+{
+    using namespace fmt::literals;
+
+    const auto vsize = detail::columnar_value_size(t);
+    const auto size = detail::columnar_file_size(vsize, n_rows, n_cols);
+
+    // Write the header.
+    std::array<char, detail::columnar_header_size> header{};
+    std::memcpy(header.data(), detail::columnar_magic.data(), detail::columnar_magic.size());
+    detail::columnar_write_field(header.data(), detail::columnar_version_offset, detail::columnar_version);
+    detail::columnar_write_field(header.data(), detail::columnar_endian_offset, detail::columnar_endian_marker);
+    detail::columnar_write_field(header.data(), detail::columnar_type_offset, static_cast<std::uint32_t>(t));
+    detail::columnar_write_field(header.data(), detail::columnar_vsize_offset, vsize);
+    detail::columnar_write_field(header.data(), detail::columnar_n_rows_offset, n_rows);
+    detail::columnar_write_field(header.data(), detail::columnar_n_cols_offset, n_cols);
+
+    {
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        if (!ofs.write(header.data(), static_cast<std::streamsize>(header.size()))) {
+            throw std::invalid_argument("Error writing the header of the columnar file '{}'"_format(path));
+        }
+    }
+
+    // Extend the file to its full size.
+    // NOTE: the extension is zero-filled.
+    boost::filesystem::resize_file(path, size);
+
+    m_impl = std::make_unique<impl>(path, false);
+}
+
+columnar_file::columnar_file(columnar_file &&) noexcept = default;
+
+columnar_file &columnar_file::operator=(columnar_file &&) noexcept = default;
+
+columnar_file::~columnar_file() = default;
+
+columnar_type columnar_file::get_type() const
+{
+    return m_impl->m_type;
+}
+
+std::uint64_t columnar_file::get_n_rows() const
+{
+    return m_impl->m_n_rows;
+}
+
+std::uint64_t columnar_file::get_n_cols() const
+{
+    return m_impl->m_n_cols;
+}
+
+bool columnar_file::is_read_only() const
+{
+    return m_impl->m_read_only;
+}
+
+void *columnar_file::column_ptr(columnar_type t, std::uint64_t j, bool mut) const
+{
+    using namespace fmt::literals;
+
+    if (t != m_impl->m_type) {
+        throw std::invalid_argument(
+            "Cannot access the values of type {} in a columnar file as values of type {}"_format(
+                static_cast<std::uint32_t>(m_impl->m_type), static_cast<std::uint32_t>(t)));
+    }
+
+    if (j >= m_impl->m_n_cols) {
+        throw std::out_of_range("Cannot access the column at index {} in a columnar file with {} column(s)"_format(
+            j, m_impl->m_n_cols));
+    }
+
+    if (mut && m_impl->m_read_only) {
+        throw std::invalid_argument("Cannot write to a columnar file which was mapped in read-only mode");
+    }
+
+    // NOTE: the file size was checked to be representable
+    // as a std::size_t on construction.
+    return static_cast<char *>(m_impl->m_reg.get_address()) + detail::columnar_header_size
+           + static_cast<std::size_t>(j * m_impl->m_n_rows * m_impl->m_vsize);
+}
+
+void columnar_file::flush()
+{
+    if (!m_impl->m_read_only && !m_impl->m_reg.flush()) {
+        throw std::invalid_argument("Error flushing a columnar file");
+    }
+}
+
+} // namespace heyoka
@@ -121,8 +121,37 @@ llvm::Type *to_llvm_type_impl(llvm::LLVMContext &c, const std::type_info &tp)
     }
 }
 
+namespace
+{
+
+// Alignment to be used when loading/storing a vector
+// from/to the pointer ptr to its scalar elements. Only the
+// alignment of the scalar elements is assumed.
+llvm::Align vector_memory_align(ir_builder &builder, llvm::PointerType *ptr_t)
+{
+    const auto &dl = builder.GetInsertBlock()->getModule()->getDataLayout();
+
+    return llvm::Align(dl.getABITypeAlignment(ptr_t->getElementType()));
+}
+
+// Check if a vector of the scalar type t can be loaded/stored directly
+// from/to an array of t. This is the case only if the elements of the array
+// are not padded: the elements of LLVM vectors are bit-packed, hence
+// for types such as x86_fp80 (whose size is 10 bytes but which is laid out
+// with a 16-byte stride in an array) the layouts of arrays and vectors differ.
+bool vector_memory_direct(ir_builder &builder, llvm::Type *t)
+{
+    const auto &dl = builder.GetInsertBlock()->getModule()->getDataLayout();
+
+    return dl.getTypeAllocSize(t) == dl.getTypeStoreSize(t);
+}
+
+} // namespace
+
 // Helper to load the data from pointer ptr as a vector of size vector_size. If vector_size is
-// 1, a scalar is loaded instead.
+// 1, a scalar is loaded instead. If possible, the vector is loaded with a single vector load which
+// assumes only the alignment of the scalar type (i.e., the load is an unaligned vector load).
+// Otherwise, the vector is assembled from scalar loads.
 llvm::Value *load_vector_from_memory(ir_builder &builder, llvm::Value *ptr, std::uint32_t vector_size)
 {
     assert(vector_size > 0u);
@@ -140,6 +169,16 @@ llvm::Value *load_vector_from_memory(ir_builder &builder, llvm::Value *ptr, std:
     auto vector_t = make_vector_type(ptr_t->getElementType(), vector_size);
     assert(vector_t != nullptr);
 
+    if (vector_memory_direct(builder, ptr_t->getElementType())) {
+        // Load the vector from the pointer cast to the vector type.
+        // NOTE: emitting directly the vector load (rather than relying on
+        // the load/store vectorizer pass to merge scalar loads) ensures
+        // that the load is vectorized regardless of the optimisation pipeline.
+        return builder.CreateAlignedLoad(vector_t,
+                                         builder.CreateBitCast(ptr, vector_t->getPointerTo(ptr_t->getAddressSpace())),
+                                         vector_memory_align(builder, ptr_t));
+    }
+
     // Create the output vector.
     auto ret = static_cast<llvm::Value *>(llvm::UndefValue::get(vector_t));
 
@@ -153,16 +192,24 @@ llvm::Value *load_vector_from_memory(ir_builder &builder, llvm::Value *ptr, std:
 }
 
 // Helper to store the content of vector vec to the pointer ptr. If vec is not a vector,
-// a plain store will be performed.
+// a plain store will be performed. The alignment of ptr is handled as in load_vector_from_memory().
 void store_vector_to_memory(ir_builder &builder, llvm::Value *ptr, llvm::Value *vec)
 {
-    if (auto v_ptr_t = llvm::dyn_cast<llvm::VectorType>(vec->getType())) {
-        // Determine the vector size.
-        const auto vector_size = boost::numeric_cast<std::uint32_t>(v_ptr_t->getNumElements());
-
-        for (std::uint32_t i = 0; i < vector_size; ++i) {
-            builder.CreateStore(builder.CreateExtractElement(vec, i),
-                                builder.CreateInBoundsGEP(ptr, {builder.getInt32(i)}));
+    if (auto vector_t = llvm::dyn_cast<llvm::VectorType>(vec->getType())) {
+        auto ptr_t = llvm::cast<llvm::PointerType>(ptr->getType());
+
+        if (vector_memory_direct(builder, ptr_t->getElementType())) {
+            builder.CreateAlignedStore(vec,
+                                       builder.CreateBitCast(ptr, vector_t->getPointerTo(ptr_t->getAddressSpace())),
+                                       vector_memory_align(builder, ptr_t));
+        } else {
+            // Determine the vector size.
+            const auto vector_size = boost::numeric_cast<std::uint32_t>(vector_t->getNumElements());
+
+            for (std::uint32_t i = 0; i < vector_size; ++i) {
+                builder.CreateStore(builder.CreateExtractElement(vec, i),
+                                    builder.CreateInBoundsGEP(ptr, {builder.getInt32(i)}));
+            }
         }
     } else {
         // Not a vector, store vec directly.
@@ -634,7 +681,9 @@ void llvm_if_then_else(llvm_state &s, llvm::Value *cond, const std::function<voi
 }
 
 // Helper to create a global zero-inited array variable in the module m
-// with type t. The array is mutable and with internal linkage.
+// with type t. The array is mutable and with internal linkage, and it is aligned
+// to a cache line boundary (so that vectors of scalar elements stored at offsets which
+// are multiples of the vector size never straddle cache lines).
 llvm::Value *make_global_zero_array(llvm::Module &m, llvm::ArrayType *t)
 {
     assert(t != nullptr);
@@ -642,6 +691,8 @@ llvm::Value *make_global_zero_array(llvm::Module &m, llvm::ArrayType *t)
     // Make the global array.
     auto gl_arr = new llvm::GlobalVariable(m, t, false, llvm::GlobalVariable::InternalLinkage,
                                            llvm::ConstantAggregateZero::get(t));
+    gl_arr->setAlignment(llvm::MaybeAlign(std::max<std::uint64_t>(
+        llvm_simd_alignment, m.getDataLayout().getABITypeAlignment(t->getElementType()))));
 
     // Return it.
     return gl_arr;
@@ -0,0 +1,34 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <atomic>
+#include <cstddef>
+
+#include <heyoka/detail/parallel.hpp>
+
+namespace heyoka::detail
+{
+
+namespace
+{
+
+std::atomic<std::size_t> parallel_n_threads_override{0};
+
+} // namespace
+
+void parallel_set_n_threads(std::size_t n)
+{
+    parallel_n_threads_override.store(n);
+}
+
+std::size_t parallel_get_n_threads_override()
+{
+    return parallel_n_threads_override.load();
+}
+
+} // namespace heyoka::detail
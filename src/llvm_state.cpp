@@ -7,9 +7,11 @@
 // with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <initializer_list>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <ostream>
@@ -19,10 +21,20 @@
 #include <system_error>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#if defined(__linux__)
+
+#include <cerrno>
+
+#include <sys/mman.h>
+
+#endif
+
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
@@ -38,10 +50,11 @@
 #include <llvm/ExecutionEngine/JITSymbol.h>
 #include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/Core.h>
-#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
 #include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
 #include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
 #include <llvm/IR/Attributes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
@@ -53,8 +66,11 @@
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IRReader/IRReader.h>
-#include <llvm/Pass.h>
+#include <llvm/Support/Casting.h>
 #include <llvm/Support/CodeGen.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Memory.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/TargetRegistry.h>
@@ -63,7 +79,6 @@
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
-#include <llvm/Transforms/Vectorize.h>
 
 #if LLVM_VERSION_MAJOR == 10
 
@@ -88,26 +103,213 @@ namespace
 // Make sure our definition of ir_builder matches llvm::IRBuilder<>.
 static_assert(std::is_same_v<ir_builder, llvm::IRBuilder<>>, "Inconsistent definition of the ir_builder type.");
 
-// Helper function to detect specific features
-// on the host machine via LLVM's machinery.
-target_features get_target_features_impl()
+std::once_flag nt_inited;
+
+// Fetch a const ref to the process-wide target machine builder
+// for the host system. The detection of the host (and the
+// initialisation of the native target) is done only once.
+const llvm::orc::JITTargetMachineBuilder &get_host_jtmb()
+{
+    static const auto retval = []() {
+        // NOTE: the native target initialization needs to be done only once
+        std::call_once(nt_inited, []() {
+            llvm::InitializeNativeTarget();
+            llvm::InitializeNativeTargetAsmPrinter();
+            llvm::InitializeNativeTargetAsmParser();
+        });
+
+        // Create the target machine builder.
+        auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+        if (!jtmb) {
+            throw std::invalid_argument("Error creating a JITTargetMachineBuilder for the host system");
+        }
+        // Set the codegen optimisation level to aggressive.
+        jtmb->setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+
+        // NOTE: make sure the current process is loaded as a permanent library,
+        // so that its symbols can be looked up by process_symbol_generator.
+        llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+
+        return std::move(*jtmb);
+    }();
+
+    return retval;
+}
+
+// Process-wide pool of target machines for the host system. The target machines
+// are used to fetch various properties of the host CPU and to set up the
+// optimisation and codegen pipelines outside the jit (which has its own
+// target machine).
+// NOTE: a target machine is not thread-safe, hence it is handed out
+// to a single user at a time via host_tm_lease. The pool grows up to
+// the maximum number of concurrent users, and the target machines
+// are reused across threads (e.g., the threads created by std::async()).
+struct host_tm_pool {
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<llvm::TargetMachine>> m_tms;
+};
+
+host_tm_pool &get_host_tm_pool()
+{
+    static host_tm_pool retval;
+
+    return retval;
+}
+
+// RAII lease of a target machine from the pool. A new target
+// machine is created only if the pool is empty, and the target
+// machine is returned to the pool on destruction.
+class host_tm_lease
 {
-    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
-    if (!jtmb) {
-        throw std::invalid_argument("Error creating a JITTargetMachineBuilder for the host system");
+    std::unique_ptr<llvm::TargetMachine> m_tm;
+
+public:
+    host_tm_lease()
+    {
+        auto &pool = get_host_tm_pool();
+
+        {
+            std::lock_guard<std::mutex> lock(pool.m_mutex);
+
+            if (!pool.m_tms.empty()) {
+                m_tm = std::move(pool.m_tms.back());
+                pool.m_tms.pop_back();
+
+                return;
+            }
+        }
+
+        auto jtmb = get_host_jtmb();
+
+        auto tm = jtmb.createTargetMachine();
+        if (!tm) {
+            throw std::invalid_argument("Error creating the target machine");
+        }
+
+        m_tm = std::move(*tm);
+    }
+    host_tm_lease(const host_tm_lease &) = delete;
+    host_tm_lease(host_tm_lease &&) = delete;
+    host_tm_lease &operator=(const host_tm_lease &) = delete;
+    host_tm_lease &operator=(host_tm_lease &&) = delete;
+    ~host_tm_lease()
+    {
+        auto &pool = get_host_tm_pool();
+
+        std::lock_guard<std::mutex> lock(pool.m_mutex);
+
+        // NOTE: if the push_back() fails, the target
+        // machine is simply destroyed.
+        try {
+            pool.m_tms.push_back(std::move(m_tm));
+        } catch (...) {
+        }
+    }
+
+    llvm::TargetMachine &operator*() const
+    {
+        return *m_tm;
     }
+    llvm::TargetMachine *operator->() const
+    {
+        return m_tm.get();
+    }
+};
+
+// Process-wide cache of the addresses of the symbols defined in the current process
+// which are invoked by the JIT-compiled code (e.g., the libm functions and
+// the heyoka runtime functions). The keys are the mangled symbol names.
+struct process_symbol_cache {
+    std::mutex m_mutex;
+    std::unordered_map<std::string, llvm::JITTargetAddress> m_map;
+};
+
+process_symbol_cache &get_process_symbol_cache()
+{
+    static process_symbol_cache retval;
+
+    return retval;
+}
+
+// Definition generator which resolves the symbols defined in the current process
+// via the process-wide cache, so that the symbols are looked up in the process
+// only the first time they are requested by any jit.
+class process_symbol_generator final :
+#if LLVM_VERSION_MAJOR == 10
+    public llvm::orc::JITDylib::DefinitionGenerator
+#else
+    public llvm::orc::DefinitionGenerator
+#endif
+{
+    char m_global_prefix;
+
+public:
+    explicit process_symbol_generator(char global_prefix) : m_global_prefix(global_prefix) {}
+
+    llvm::Error tryToGenerate(
+#if LLVM_VERSION_MAJOR > 10
+        llvm::orc::LookupState &,
+#endif
+        llvm::orc::LookupKind, llvm::orc::JITDylib &jd, llvm::orc::JITDylibLookupFlags,
+        const llvm::orc::SymbolLookupSet &symbols) override
+    {
+        auto &cache = get_process_symbol_cache();
+
+        llvm::orc::SymbolMap new_defs;
+
+        {
+            std::lock_guard<std::mutex> lock(cache.m_mutex);
+
+            for (const auto &sym : symbols) {
+                const auto &name = sym.first;
+                const auto name_str = (*name).str();
+
+                auto it = cache.m_map.find(name_str);
+
+                if (it == cache.m_map.end()) {
+                    // Strip the global prefix, if any.
+                    llvm::StringRef plain_name = *name;
+                    if (m_global_prefix != '\0') {
+                        if (plain_name.empty() || plain_name.front() != m_global_prefix) {
+                            continue;
+                        }
+                        plain_name = plain_name.drop_front();
+                    }
 
-    auto tm = jtmb->createTargetMachine();
-    if (!tm) {
-        throw std::invalid_argument("Error creating the target machine");
+                    auto *addr = llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(plain_name.str());
+                    if (addr == nullptr) {
+                        // NOTE: symbols which are not found are not cached, and they
+                        // are left to the other generators (if any).
+                        continue;
+                    }
+
+                    it = cache.m_map.emplace(name_str, llvm::pointerToJITTargetAddress(addr)).first;
+                }
+
+                new_defs[name] = llvm::JITEvaluatedSymbol(it->second, llvm::JITSymbolFlags::Exported);
+            }
+        }
+
+        if (new_defs.empty()) {
+            return llvm::Error::success();
+        }
+
+        return jd.define(llvm::orc::absoluteSymbols(std::move(new_defs)));
     }
+};
+
+// Helper function to detect specific features
+// on the host machine via LLVM's machinery.
+target_features get_target_features_impl()
+{
+    const host_tm_lease tm;
 
     target_features retval;
 
-    const auto target_name = std::string{(*tm)->getTarget().getName()};
+    const auto target_name = std::string{tm->getTarget().getName()};
 
     if (target_name == "x86-64" || target_name == "x86") {
-        const auto t_features = (*tm)->getTargetFeatureString();
+        const auto t_features = tm->getTargetFeatureString();
 
         if (boost::algorithm::contains(t_features, "+avx512f")) {
             retval.avx512f = true;
@@ -143,7 +345,118 @@ const target_features &get_target_features()
 namespace
 {
 
-std::once_flag nt_inited;
+#if defined(__linux__)
+
+// Memory mapper for the JIT which places the code sections in
+// (transparent) 2 MB huge pages. The memory for the other sections
+// is allocated via the default LLVM implementation.
+class huge_page_mapper final : public llvm::SectionMemoryManager::MemoryMapper
+{
+    static constexpr std::size_t huge_page_size = 2u * 1024u * 1024u;
+
+public:
+    llvm::sys::MemoryBlock allocateMappedMemory(llvm::SectionMemoryManager::AllocationPurpose purpose,
+                                                std::size_t num_bytes, const llvm::sys::MemoryBlock *const near_block,
+                                                unsigned flags, std::error_code &ec) override
+    {
+        if (purpose != llvm::SectionMemoryManager::AllocationPurpose::Code || num_bytes == 0u
+            || num_bytes > std::numeric_limits<std::size_t>::max() / 2u - huge_page_size) {
+            return llvm::sys::Memory::allocateMappedMemory(num_bytes, near_block, flags, ec);
+        }
+
+        ec = std::error_code();
+
+        // Round up the size to a multiple of the huge page size.
+        const auto size = (num_bytes + huge_page_size - 1u) / huge_page_size * huge_page_size;
+
+        // Map an extra huge page in order to be able to align the block.
+        auto *addr = ::mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            ec = std::error_code(errno, std::generic_category());
+            return llvm::sys::MemoryBlock();
+        }
+
+        // Unmap the unaligned head and tail of the mapping.
+        const auto start = reinterpret_cast<std::uintptr_t>(addr);
+        const auto aligned = (start + huge_page_size - 1u) / huge_page_size * huge_page_size;
+        if (aligned != start) {
+            ::munmap(addr, aligned - start);
+        }
+        if (const auto tail = start + size + huge_page_size - (aligned + size); tail != 0u) {
+            ::munmap(reinterpret_cast<void *>(aligned + size), tail);
+        }
+
+        // Request huge pages.
+        // NOTE: if transparent huge pages are not available,
+        // this fails and the regular pages are used.
+        ::madvise(reinterpret_cast<void *>(aligned), size, MADV_HUGEPAGE);
+
+        llvm::sys::MemoryBlock retval(reinterpret_cast<void *>(aligned), size);
+
+        // NOTE: the memory was mapped read/write, apply
+        // the requested protection flags if different.
+        if (flags != (llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE)) {
+            ec = llvm::sys::Memory::protectMappedMemory(retval, flags);
+            if (ec) {
+                ::munmap(reinterpret_cast<void *>(aligned), size);
+                return llvm::sys::MemoryBlock();
+            }
+        }
+
+        return retval;
+    }
+    std::error_code protectMappedMemory(const llvm::sys::MemoryBlock &block, unsigned flags) override
+    {
+        return llvm::sys::Memory::protectMappedMemory(block, flags);
+    }
+    std::error_code releaseMappedMemory(llvm::sys::MemoryBlock &m) override
+    {
+        return llvm::sys::Memory::releaseMappedMemory(m);
+    }
+};
+
+// NOTE: the mapper is stateless, a single
+// global instance is shared by all memory managers.
+huge_page_mapper hp_mapper;
+
+#endif
+
+// Reorder the function definitions in the module m so that the hot code is laid out
+// first and contiguously in memory. The hot code is approximated by the externally-visible
+// functions (i.e., the entry points invoked from C++, such as the steppers), followed by
+// the functions they call (in breadth-first order).
+void order_functions_hot_first(llvm::Module &m)
+{
+    std::vector<llvm::Function *> order;
+    std::unordered_set<llvm::Function *> visited;
+
+    for (auto &f : m) {
+        if (!f.isDeclaration() && !f.hasLocalLinkage()) {
+            order.push_back(&f);
+            visited.insert(&f);
+        }
+    }
+
+    for (decltype(order.size()) i = 0; i < order.size(); ++i) {
+        for (auto &bb : *order[i]) {
+            for (auto &inst : bb) {
+                if (auto *cb = llvm::dyn_cast<llvm::CallBase>(&inst)) {
+                    if (auto *callee = cb->getCalledFunction();
+                        callee != nullptr && !callee->isDeclaration() && visited.insert(callee).second) {
+                        order.push_back(callee);
+                    }
+                }
+            }
+        }
+    }
+
+    // Move the functions to the beginning of the module,
+    // in reverse order.
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        (*it)->removeFromParent();
+        m.getFunctionList().push_front(*it);
+    }
+}
 
 } // namespace
 
@@ -152,35 +465,33 @@ std::once_flag nt_inited;
 // Implementation of the jit class.
 struct llvm_state::jit {
     std::unique_ptr<llvm::orc::LLJIT> m_lljit;
-    std::unique_ptr<llvm::TargetMachine> m_tm;
     std::unique_ptr<llvm::orc::ThreadSafeContext> m_ctx;
-#if LLVM_VERSION_MAJOR == 10
-    std::unique_ptr<llvm::Triple> m_triple;
-#endif
 
-    jit()
+    explicit jit(bool huge_pages)
     {
-        // NOTE: the native target initialization needs to be done only once
-        std::call_once(detail::nt_inited, []() {
-            llvm::InitializeNativeTarget();
-            llvm::InitializeNativeTargetAsmPrinter();
-            llvm::InitializeNativeTargetAsmParser();
-        });
-
-        // Create the target machine builder.
-        auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
-        if (!jtmb) {
-            throw std::invalid_argument("Error creating a JITTargetMachineBuilder for the host system");
-        }
-        // Set the codegen optimisation level to aggressive.
-        jtmb->setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
-
         // Create the jit builder.
         llvm::orc::LLJITBuilder lljit_builder;
         // NOTE: other settable properties may
         // be of interest:
         // https://www.llvm.org/doxygen/classllvm_1_1orc_1_1LLJITBuilder.html
-        lljit_builder.setJITTargetMachineBuilder(*jtmb);
+        // NOTE: the detection of the host is done only once
+        // (see get_host_jtmb()).
+        lljit_builder.setJITTargetMachineBuilder(detail::get_host_jtmb());
+
+#if defined(__linux__)
+        if (huge_pages) {
+            // Use a custom object linking layer whose memory
+            // manager places the code in huge pages.
+            lljit_builder.setObjectLinkingLayerCreator(
+                [](llvm::orc::ExecutionSession &es, const llvm::Triple &) -> std::unique_ptr<llvm::orc::ObjectLayer> {
+                    return std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+                        es, []() { return std::make_unique<llvm::SectionMemoryManager>(&detail::hp_mapper); });
+                });
+        }
+#else
+        // NOTE: huge pages are supported only on Linux.
+        (void)huge_pages;
+#endif
 
         // Create the jit.
         auto lljit = lljit_builder.create();
@@ -190,30 +501,14 @@ struct llvm_state::jit {
         m_lljit = std::move(*lljit);
 
         // Setup the jit so that it can look up symbols from the current process.
-        auto dlsg = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
-            m_lljit->getDataLayout().getGlobalPrefix());
-        if (!dlsg) {
-            throw std::invalid_argument("Could not create the dynamic library search generator");
-        }
-        m_lljit->getMainJITDylib().addGenerator(std::move(*dlsg));
-
-        // Keep a target machine around to fetch various
-        // properties of the host CPU.
-        auto tm = jtmb->createTargetMachine();
-        if (!tm) {
-            throw std::invalid_argument("Error creating the target machine");
-        }
-        m_tm = std::move(*tm);
+        // NOTE: the addresses of the symbols are cached process-wide
+        // (see process_symbol_generator).
+        m_lljit->getMainJITDylib().addGenerator(
+            std::make_unique<detail::process_symbol_generator>(m_lljit->getDataLayout().getGlobalPrefix()));
 
         // Create the context.
         m_ctx = std::make_unique<llvm::orc::ThreadSafeContext>(std::make_unique<llvm::LLVMContext>());
 
-#if LLVM_VERSION_MAJOR == 10
-        // NOTE: on LLVM 10, we cannot fetch the target triple
-        // from the lljit class. Thus, we get it from the jtmb instead.
-        m_triple = std::make_unique<llvm::Triple>(jtmb->getTargetTriple());
-#endif
-
         // NOTE: by default, errors in the execution session are printed
         // to screen. A custom error reported can be specified, ideally
         // we would like th throw here but I am not sure whether throwing
@@ -237,25 +532,9 @@ struct llvm_state::jit {
     {
         return *m_ctx->getContext();
     }
-    std::string get_target_cpu() const
-    {
-        return m_tm->getTargetCPU().str();
-    }
-    std::string get_target_features() const
-    {
-        return m_tm->getTargetFeatureString().str();
-    }
-    llvm::TargetIRAnalysis get_target_ir_analysis() const
-    {
-        return m_tm->getTargetIRAnalysis();
-    }
     const llvm::Triple &get_target_triple() const
     {
-#if LLVM_VERSION_MAJOR == 10
-        return *m_triple;
-#else
-        return m_lljit->getTargetTriple();
-#endif
+        return detail::get_host_jtmb().getTargetTriple();
     }
 
     void add_module(std::unique_ptr<llvm::Module> &&m)
@@ -280,10 +559,10 @@ struct llvm_state::jit {
     }
 };
 
-llvm_state::llvm_state(std::tuple<std::string, unsigned, bool, bool, bool> &&tup)
-    : m_jitter(std::make_unique<jit>()), m_opt_level(std::get<1>(tup)), m_fast_math(std::get<2>(tup)),
+llvm_state::llvm_state(std::tuple<std::string, unsigned, bool, bool, bool, bool, bool> &&tup)
+    : m_jitter(std::make_unique<jit>(std::get<5>(tup))), m_opt_level(std::get<1>(tup)), m_fast_math(std::get<2>(tup)),
       m_module_name(std::move(std::get<0>(tup))), m_save_object_code(std::get<3>(tup)),
-      m_inline_functions(std::get<4>(tup))
+      m_inline_functions(std::get<4>(tup)), m_huge_pages(std::get<5>(tup)), m_compact_mode_simd(std::get<6>(tup))
 {
     // Create the module.
     m_module = std::make_unique<llvm::Module>(m_module_name, context());
@@ -317,9 +596,10 @@ llvm_state::llvm_state(std::tuple<std::string, unsigned, bool, bool, bool> &&tup
 llvm_state::llvm_state() : llvm_state(kw_args_ctor_impl()) {}
 
 llvm_state::llvm_state(const llvm_state &other)
-    : m_jitter(std::make_unique<jit>()), m_opt_level(other.m_opt_level), m_fast_math(other.m_fast_math),
-      m_module_name(other.m_module_name), m_save_object_code(other.m_save_object_code),
-      m_object_code(other.m_object_code), m_inline_functions(other.m_inline_functions)
+    : m_jitter(std::make_unique<jit>(other.m_huge_pages)), m_opt_level(other.m_opt_level),
+      m_fast_math(other.m_fast_math), m_module_name(other.m_module_name), m_save_object_code(other.m_save_object_code),
+      m_object_code(other.m_object_code), m_inline_functions(other.m_inline_functions),
+      m_huge_pages(other.m_huge_pages), m_compact_mode_simd(other.m_compact_mode_simd)
 {
     // Get the IR of other.
     auto other_ir = other.get_ir();
@@ -413,6 +693,11 @@ bool &llvm_state::inline_functions()
     return m_inline_functions;
 }
 
+bool &llvm_state::compact_mode_simd()
+{
+    return m_compact_mode_simd;
+}
+
 const llvm::Module &llvm_state::module() const
 {
     check_uncompiled(__func__);
@@ -445,6 +730,16 @@ const bool &llvm_state::inline_functions() const
     return m_inline_functions;
 }
 
+bool llvm_state::huge_pages() const
+{
+    return m_huge_pages;
+}
+
+const bool &llvm_state::compact_mode_simd() const
+{
+    return m_compact_mode_simd;
+}
+
 void llvm_state::check_uncompiled(const char *f) const
 {
     if (!m_module) {
@@ -499,6 +794,11 @@ void llvm_state::optimise()
     check_uncompiled(__func__);
 
     if (m_opt_level > 0u) {
+        // Lease a target machine for the host system.
+        // NOTE: the lease is declared before the pass managers,
+        // which refer to the target machine, so that it outlives them.
+        const detail::host_tm_lease tm;
+
         // NOTE: the logic here largely mimics (with a lot of simplifications)
         // the implementation of the 'opt' tool. See:
         // https://github.com/llvm/llvm-project/blob/release/10.x/llvm/tools/opt/opt.cpp
@@ -507,15 +807,15 @@ void llvm_state::optimise()
         // so that the codegen uses all the features available on
         // the host CPU.
 #if LLVM_VERSION_MAJOR == 10
-        ::setFunctionAttributes(m_jitter->get_target_cpu(), m_jitter->get_target_features(), *m_module);
+        ::setFunctionAttributes(tm->getTargetCPU().str(), tm->getTargetFeatureString().str(), *m_module);
 #else
         // NOTE: in LLVM > 10, the setFunctionAttributes() function is gone in favour of another
         // function in another namespace, which however does not seem to work out of the box
         // because (I think) it might be reading some non-existent command-line options. See:
         // https://llvm.org/doxygen/CommandFlags_8cpp_source.html#l00552
         // Here we are reproducing a trimmed-down version of the same function.
-        const auto cpu = m_jitter->get_target_cpu();
-        const auto features = m_jitter->get_target_features();
+        const auto cpu = tm->getTargetCPU().str();
+        const auto features = tm->getTargetFeatureString().str();
 
         for (auto &f : module()) {
             auto attrs = f.getAttributes();
@@ -562,23 +862,20 @@ void llvm_state::optimise()
         auto tliwp = std::make_unique<llvm::TargetLibraryInfoWrapperPass>(
             llvm::TargetLibraryInfoImpl(m_jitter->get_target_triple()));
         module_pm->add(tliwp.release());
-        module_pm->add(llvm::createTargetTransformInfoWrapperPass(m_jitter->get_target_ir_analysis()));
+        module_pm->add(llvm::createTargetTransformInfoWrapperPass(tm->getTargetIRAnalysis()));
 
         // NOTE: not sure what this does, presumably some target-specifc
         // configuration.
-        module_pm->add(static_cast<llvm::LLVMTargetMachine &>(*m_jitter->m_tm).createPassConfig(*module_pm));
+        module_pm->add(static_cast<llvm::LLVMTargetMachine &>(*tm).createPassConfig(*module_pm));
 
         // Init the function pass manager.
         auto f_pm = std::make_unique<llvm::legacy::FunctionPassManager>(m_module.get());
-        f_pm->add(llvm::createTargetTransformInfoWrapperPass(m_jitter->get_target_ir_analysis()));
+        f_pm->add(llvm::createTargetTransformInfoWrapperPass(tm->getTargetIRAnalysis()));
 
-        // Add an initial pass to vectorize load/stores.
-        // This is useful to ensure that the
-        // pattern adopted in load_vector_from_memory() and
-        // store_vector_to_memory() is translated to
-        // vectorized store/load instructions.
-        auto lsv_pass = std::unique_ptr<llvm::Pass>(llvm::createLoadStoreVectorizerPass());
-        f_pm->add(lsv_pass.release());
+        // NOTE: we used to add here an initial load/store vectorizer pass,
+        // in order to merge the scalar loads/stores emitted by
+        // load_vector_from_memory() and store_vector_to_memory(). These
+        // functions now emit vector loads/stores directly.
 
         // We use the helper class PassManagerBuilder to populate the module
         // pass manager with standard options.
@@ -595,7 +892,7 @@ void llvm_state::optimise()
             pm_builder.Inliner = llvm::createFunctionInliningPass(m_opt_level, 0, false);
         }
 
-        m_jitter->m_tm->adjustPassManager(pm_builder);
+        tm->adjustPassManager(pm_builder);
 
         // Populate both the function pass manager and the module pass manager.
         pm_builder.populateFunctionPassManager(*f_pm);
@@ -630,6 +927,12 @@ void llvm_state::compile()
         }
     }
 
+    // When the code is placed in huge pages, lay out
+    // the hot functions first.
+    if (m_huge_pages) {
+        detail::order_functions_hot_first(*m_module);
+    }
+
     // Store a snapshot of the IR before compiling.
     m_ir_snapshot = get_ir();
 
@@ -640,9 +943,10 @@ void llvm_state::compile()
         llvm::raw_svector_ostream buf_stream(buffer);
 
         // Setup the machinery for dumping the object code.
+        const detail::host_tm_lease tm;
         llvm::legacy::PassManager pass;
 
-        if (m_jitter->m_tm->addPassesToEmitFile(pass, buf_stream, nullptr, llvm::CGFT_ObjectFile)) {
+        if (tm->addPassesToEmitFile(pass, buf_stream, nullptr, llvm::CGFT_ObjectFile)) {
             throw std::invalid_argument("The target machine can't emit a file of this type");
         }
 
@@ -718,9 +1022,10 @@ void llvm_state::dump_object_code(const std::string &filename) const
     } else {
         // The module has not been compiled yet, run the JIT
         // and dump the object code.
+        const detail::host_tm_lease tm;
         llvm::legacy::PassManager pass;
 
-        if (m_jitter->m_tm->addPassesToEmitFile(pass, dest, nullptr, llvm::CGFT_ObjectFile)) {
+        if (tm->addPassesToEmitFile(pass, dest, nullptr, llvm::CGFT_ObjectFile)) {
             // Close and remove the file before throwing.
             dest.close();
             boost::filesystem::remove(boost::filesystem::path{filename});
@@ -747,9 +1052,15 @@ std::ostream &operator<<(std::ostream &os, const llvm_state &s)
     oss << "Fast math          : " << s.m_fast_math << '\n';
     oss << "Optimisation level : " << s.m_opt_level << '\n';
     oss << "Inline functions   : " << s.m_inline_functions << '\n';
+    oss << "Huge pages         : " << s.m_huge_pages << '\n';
+    oss << "Compact mode SIMD  : " << s.m_compact_mode_simd << '\n';
     oss << "Target triple      : " << s.m_jitter->get_target_triple().str() << '\n';
-    oss << "Target CPU         : " << s.m_jitter->get_target_cpu() << '\n';
-    oss << "Target features    : " << s.m_jitter->get_target_features() << '\n';
+    {
+        const detail::host_tm_lease tm;
+
+        oss << "Target CPU         : " << tm->getTargetCPU().str() << '\n';
+        oss << "Target features    : " << tm->getTargetFeatureString().str() << '\n';
+    }
     oss << "IR size            : " << s.get_ir().size() << '\n';
 
     return os << oss.str();
@@ -0,0 +1,402 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <heyoka/config.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Value.h>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/detail/llvm_helpers.hpp>
+#include <heyoka/detail/string_conv.hpp>
+#include <heyoka/detail/type_traits.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/llvm_state.hpp>
+#include <heyoka/math/lin_comb.hpp>
+#include <heyoka/number.hpp>
+#include <heyoka/param.hpp>
+#include <heyoka/taylor.hpp>
+#include <heyoka/variable.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// Flatten the (coefficient, term) pairs into the list of arguments,
+// checking that the coefficients are numbers or params.
+std::vector<expression> lin_comb_flatten_args(std::vector<std::pair<expression, expression>> terms)
+{
+    std::vector<expression> retval;
+    retval.reserve(terms.size() * 2u);
+
+    for (auto &[c, x] : terms) {
+        if (!std::holds_alternative<number>(c.value()) && !std::holds_alternative<param>(c.value())) {
+            throw std::invalid_argument("The coefficients of a linear combination must be numbers or params");
+        }
+
+        retval.push_back(std::move(c));
+        retval.push_back(std::move(x));
+    }
+
+    return retval;
+}
+
+template <typename T>
+llvm::Value *codegen_lin_comb(llvm_state &s, const std::vector<llvm::Value *> &args)
+{
+    assert(args.size() % 2u == 0u);
+
+    auto &builder = s.builder();
+
+    if (args.empty()) {
+        return codegen<T>(s, number{0.});
+    }
+
+    std::vector<llvm::Value *> terms;
+    for (decltype(args.size()) i = 0; i < args.size(); i += 2u) {
+        assert(args[i] != nullptr);
+        assert(args[i + 1u] != nullptr);
+
+        terms.push_back(builder.CreateFMul(args[i], args[i + 1u]));
+    }
+
+    return pairwise_sum(builder, terms);
+}
+
+} // namespace
+
+lin_comb_impl::lin_comb_impl(std::vector<std::pair<expression, expression>> terms)
+    : func_base("lin_comb", lin_comb_flatten_args(std::move(terms)))
+{
+}
+
+lin_comb_impl::lin_comb_impl() : lin_comb_impl(std::vector<std::pair<expression, expression>>{}) {}
+
+llvm::Value *lin_comb_impl::codegen_dbl(llvm_state &s, const std::vector<llvm::Value *> &args) const
+{
+    return codegen_lin_comb<double>(s, args);
+}
+
+llvm::Value *lin_comb_impl::codegen_ldbl(llvm_state &s, const std::vector<llvm::Value *> &args) const
+{
+    return codegen_lin_comb<long double>(s, args);
+}
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+llvm::Value *lin_comb_impl::codegen_f128(llvm_state &s, const std::vector<llvm::Value *> &args) const
+{
+    return codegen_lin_comb<mppp::real128>(s, args);
+}
+
+#endif
+
+namespace
+{
+
+// NOTE: the derivative of order n of a linear combination with constant
+// coefficients is the linear combination of the derivatives of order n
+// of the terms. The terms which are numbers or params contribute
+// only to the derivative of order 0.
+template <typename T>
+llvm::Value *taylor_diff_lin_comb(llvm_state &s, const lin_comb_impl &f, const std::vector<std::uint32_t> &deps,
+                                  const std::vector<llvm::Value *> &arr, llvm::Value *par_ptr, std::uint32_t n_uvars,
+                                  std::uint32_t order, std::uint32_t batch_size)
+{
+    assert(f.args().size() % 2u == 0u);
+
+    if (!deps.empty()) {
+        using namespace fmt::literals;
+
+        throw std::invalid_argument("An empty hidden dependency vector is expected in order to compute the Taylor "
+                                    "derivative of a linear combination, but a vector of size {} was passed "
+                                    "instead"_format(deps.size()));
+    }
+
+    auto &builder = s.builder();
+
+    std::vector<llvm::Value *> terms;
+    for (decltype(f.args().size()) i = 0; i < f.args().size(); i += 2u) {
+        auto c = std::visit(
+            [&](const auto &v) -> llvm::Value * {
+                if constexpr (is_num_param_v<uncvref_t<decltype(v)>>) {
+                    return taylor_codegen_numparam<T>(s, v, par_ptr, batch_size);
+                } else {
+                    throw std::invalid_argument("An invalid coefficient type was encountered while trying to build "
+                                                "the Taylor derivative of a linear combination");
+                }
+            },
+            f.args()[i].value());
+
+        std::visit(
+            [&](const auto &v) {
+                using type = uncvref_t<decltype(v)>;
+
+                if constexpr (std::is_same_v<type, variable>) {
+                    terms.push_back(
+                        builder.CreateFMul(c, taylor_fetch_diff(arr, uname_to_index(v.name()), order, n_uvars)));
+                } else if constexpr (is_num_param_v<type>) {
+                    if (order == 0u) {
+                        terms.push_back(builder.CreateFMul(c, taylor_codegen_numparam<T>(s, v, par_ptr, batch_size)));
+                    }
+                } else {
+                    throw std::invalid_argument("An invalid argument type was encountered while trying to build the "
+                                                "Taylor derivative of a linear combination");
+                }
+            },
+            f.args()[i + 1u].value());
+    }
+
+    if (terms.empty()) {
+        return vector_splat(builder, codegen<T>(s, number{0.}), batch_size);
+    }
+
+    return pairwise_sum(builder, terms);
+}
+
+} // namespace
+
+llvm::Value *lin_comb_impl::taylor_diff_dbl(llvm_state &s, const std::vector<std::uint32_t> &deps,
+                                            const std::vector<llvm::Value *> &arr, llvm::Value *par_ptr,
+                                            llvm::Value *, std::uint32_t n_uvars, std::uint32_t order, std::uint32_t,
+                                            std::uint32_t batch_size) const
+{
+    return taylor_diff_lin_comb<double>(s, *this, deps, arr, par_ptr, n_uvars, order, batch_size);
+}
+
+llvm::Value *lin_comb_impl::taylor_diff_ldbl(llvm_state &s, const std::vector<std::uint32_t> &deps,
+                                             const std::vector<llvm::Value *> &arr, llvm::Value *par_ptr,
+                                             llvm::Value *, std::uint32_t n_uvars, std::uint32_t order, std::uint32_t,
+                                             std::uint32_t batch_size) const
+{
+    return taylor_diff_lin_comb<long double>(s, *this, deps, arr, par_ptr, n_uvars, order, batch_size);
+}
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+llvm::Value *lin_comb_impl::taylor_diff_f128(llvm_state &s, const std::vector<std::uint32_t> &deps,
+                                             const std::vector<llvm::Value *> &arr, llvm::Value *par_ptr,
+                                             llvm::Value *, std::uint32_t n_uvars, std::uint32_t order, std::uint32_t,
+                                             std::uint32_t batch_size) const
+{
+    return taylor_diff_lin_comb<mppp::real128>(s, *this, deps, arr, par_ptr, n_uvars, order, batch_size);
+}
+
+#endif
+
+namespace
+{
+
+template <typename T>
+llvm::Function *taylor_c_diff_func_lin_comb(llvm_state &s, const lin_comb_impl &fn, std::uint32_t n_uvars,
+                                            std::uint32_t batch_size)
+{
+    assert(fn.args().size() % 2u == 0u);
+
+    auto &module = s.module();
+    auto &builder = s.builder();
+    auto &context = s.context();
+
+    // Fetch the floating-point type.
+    auto val_t = to_llvm_vector_type<T>(context, batch_size);
+
+    // The function arguments:
+    // - diff order,
+    // - idx of the u variable whose diff is being computed,
+    // - diff array,
+    // - par ptr,
+    // - time ptr,
+    // - the coefficients and the terms, in the same order
+    //   as in the arguments of the linear combination.
+    // NOTE: the name of the function is mangled with the types of all
+    // the arguments, so that linear combinations with the same
+    // structure share the same function.
+    std::vector<llvm::Type *> fargs{llvm::Type::getInt32Ty(context), llvm::Type::getInt32Ty(context),
+                                    llvm::PointerType::getUnqual(val_t),
+                                    llvm::PointerType::getUnqual(to_llvm_type<T>(context)),
+                                    llvm::PointerType::getUnqual(to_llvm_type<T>(context))};
+    std::string fname = "heyoka_taylor_diff_lin_comb";
+
+    for (const auto &arg : fn.args()) {
+        std::visit(
+            [&](const auto &v) {
+                using type = uncvref_t<decltype(v)>;
+
+                if constexpr (std::is_same_v<type, variable>) {
+                    fargs.push_back(llvm::Type::getInt32Ty(context));
+                    fname += "_var";
+                } else if constexpr (is_num_param_v<type>) {
+                    fargs.push_back(taylor_c_diff_numparam_argtype<T>(s, v));
+                    fname += "_" + taylor_c_diff_numparam_mangle(v);
+                } else {
+                    throw std::invalid_argument("An invalid argument type was encountered while trying to build the "
+                                                "Taylor derivative of a linear combination in compact mode");
+                }
+            },
+            arg.value());
+    }
+
+    fname += "_" + taylor_mangle_suffix(val_t) + "_n_uvars_" + li_to_string(n_uvars);
+
+    // Try to see if we already created the function.
+    auto f = module.getFunction(fname);
+
+    if (f == nullptr) {
+        // The function was not created before, do it now.
+
+        // Fetch the current insertion block.
+        auto orig_bb = builder.GetInsertBlock();
+
+        // The return type is val_t.
+        auto *ft = llvm::FunctionType::get(val_t, fargs, false);
+        // Create the function
+        f = llvm::Function::Create(ft, llvm::Function::InternalLinkage, fname, &module);
+        assert(f != nullptr);
+
+        // Fetch the necessary function arguments.
+        auto order = f->args().begin();
+        auto diff_arr = f->args().begin() + 2;
+        auto par_ptr = f->args().begin() + 3;
+
+        // Create a new basic block to start insertion into.
+        builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", f));
+
+        auto zero = vector_splat(builder, codegen<T>(s, number{0.}), batch_size);
+        auto is_order_zero = builder.CreateICmpEQ(order, builder.getInt32(0));
+
+        std::vector<llvm::Value *> terms;
+        for (decltype(fn.args().size()) i = 0; i < fn.args().size(); i += 2u) {
+            auto c_arg = f->args().begin() + 5 + i;
+            auto x_arg = c_arg + 1;
+
+            auto c = std::visit(
+                [&](const auto &v) -> llvm::Value * {
+                    if constexpr (is_num_param_v<uncvref_t<decltype(v)>>) {
+                        return taylor_c_diff_numparam_codegen(s, v, c_arg, par_ptr, batch_size);
+                    } else {
+                        // NOTE: the coefficients were checked above.
+                        assert(false);
+                        return nullptr;
+                    }
+                },
+                fn.args()[i].value());
+
+            auto x = std::visit(
+                [&](const auto &v) -> llvm::Value * {
+                    if constexpr (std::is_same_v<uncvref_t<decltype(v)>, variable>) {
+                        return taylor_c_load_diff(s, diff_arr, n_uvars, order, x_arg);
+                    } else if constexpr (is_num_param_v<uncvref_t<decltype(v)>>) {
+                        // Constant terms contribute only to the derivative of order 0.
+                        return builder.CreateSelect(
+                            is_order_zero, taylor_c_diff_numparam_codegen(s, v, x_arg, par_ptr, batch_size), zero);
+                    } else {
+                        assert(false);
+                        return nullptr;
+                    }
+                },
+                fn.args()[i + 1u].value());
+
+            terms.push_back(builder.CreateFMul(c, x));
+        }
+
+        // Create the return value.
+        builder.CreateRet(terms.empty() ? zero : pairwise_sum(builder, terms));
+
+        // Verify.
+        s.verify_function(f);
+
+        // Restore the original insertion block.
+        builder.SetInsertPoint(orig_bb);
+    } else {
+        // The function was created before. Check if the signatures match.
+        // NOTE: there could be a mismatch if the derivative function was created
+        // and then optimised - optimisation might remove arguments which are compile-time
+        // constants.
+        if (!compare_function_signature(f, val_t, fargs)) {
+            throw std::invalid_argument("Inconsistent function signature for the Taylor derivative of a linear "
+                                        "combination in compact mode detected");
+        }
+    }
+
+    return f;
+}
+
+} // namespace
+
+llvm::Function *lin_comb_impl::taylor_c_diff_func_dbl(llvm_state &s, std::uint32_t n_uvars,
+                                                      std::uint32_t batch_size) const
+{
+    return taylor_c_diff_func_lin_comb<double>(s, *this, n_uvars, batch_size);
+}
+
+llvm::Function *lin_comb_impl::taylor_c_diff_func_ldbl(llvm_state &s, std::uint32_t n_uvars,
+                                                       std::uint32_t batch_size) const
+{
+    return taylor_c_diff_func_lin_comb<long double>(s, *this, n_uvars, batch_size);
+}
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+llvm::Function *lin_comb_impl::taylor_c_diff_func_f128(llvm_state &s, std::uint32_t n_uvars,
+                                                       std::uint32_t batch_size) const
+{
+    return taylor_c_diff_func_lin_comb<mppp::real128>(s, *this, n_uvars, batch_size);
+}
+
+#endif
+
+expression lin_comb_impl::diff(const std::string &s) const
+{
+    assert(args().size() % 2u == 0u);
+
+    std::vector<std::pair<expression, expression>> terms;
+    for (decltype(args().size()) i = 0; i < args().size(); i += 2u) {
+        terms.emplace_back(args()[i], heyoka::diff(args()[i + 1u], s));
+    }
+
+    return lin_comb(std::move(terms));
+}
+
+} // namespace detail
+
+expression lin_comb(std::vector<std::pair<expression, expression>> terms)
+{
+    if (terms.empty()) {
+        return 0_dbl;
+    }
+
+    return expression{func{detail::lin_comb_impl(std::move(terms))}};
+}
+
+} // namespace heyoka
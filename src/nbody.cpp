@@ -10,6 +10,7 @@
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <initializer_list>
 #include <limits>
@@ -23,6 +24,7 @@
 
 #include <fmt/format.h>
 
+#include <heyoka/detail/parallel.hpp>
 #include <heyoka/detail/string_conv.hpp>
 #include <heyoka/expression.hpp>
 #include <heyoka/math.hpp>
@@ -342,24 +344,36 @@ auto dot(const T &a, const T &b)
     return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
 }
 
-} // namespace
+// Minimum number of elements per thread
+// in the batch conversion functions.
+constexpr std::size_t nbody_batch_grain = 1024;
 
-} // namespace detail
+// Helper to check that the pointers passed to
+// the batch conversion functions are not null.
+template <typename T>
+void check_batch_ptrs(std::size_t n, const std::array<T *, 6> &ptrs, const char *fname)
+{
+    using namespace fmt::literals;
 
-// Helper to generate a random elliptic orbit and convert it to cartesian variables. The min/max
-// values of a, e, i, om, Om and f are passed in the bounds array. mu is the gravitational parameter
-// of the two-body system.
-std::array<double, 6> random_elliptic_state(double mu, const std::array<std::pair<double, double>, 6> &bounds,
-                                            unsigned seed)
+    if (n > 0u && std::any_of(ptrs.begin(), ptrs.end(), [](const auto p) { return p == nullptr; })) {
+        throw std::invalid_argument("Null pointer(s) detected in the input/output arrays of {}()"_format(fname));
+    }
+}
+
+void check_mu(double mu, const char *fname)
 {
     using namespace fmt::literals;
 
-    // Validate input params.
     if (!std::isfinite(mu) || mu <= 0) {
         throw std::invalid_argument(
-            "Invalid mu parameter used in random_elliptic_state(): it must be positive and finite, but it is {} instead"_format(
-                mu));
+            "Invalid mu parameter used in {}(): it must be positive and finite, but it is {} instead"_format(fname,
+                                                                                                              mu));
     }
+}
+
+void validate_random_elliptic_bounds(const std::array<std::pair<double, double>, 6> &bounds)
+{
+    using namespace fmt::literals;
 
     for (const auto &b : bounds) {
         const auto &[lb, ub] = b;
@@ -410,27 +424,33 @@ std::array<double, 6> random_elliptic_state(double mu, const std::array<std::pai
     if ((f_max - f_min) > std::numeric_limits<double>::max()) {
         throw std::overflow_error("Overflow error in the true anomaly range passed to random_elliptic_state()");
     }
+}
 
-    // Setup the rng.
-    static thread_local std::mt19937 rng;
-    rng.seed(static_cast<decltype(rng())>(seed));
-
-    // Throw the dice for the orbital elements.
-    std::uniform_real_distribution rdist(a_min, a_max);
+// Throw the dice for the orbital elements.
+std::array<double, 6> random_oe(std::mt19937 &rng, const std::array<std::pair<double, double>, 6> &bounds)
+{
+    std::uniform_real_distribution rdist(bounds[0].first, bounds[0].second);
     using p_type = decltype(rdist.param());
-    const auto a = rdist(rng);
-    rdist.param(p_type(e_min, e_max));
-    const auto e = rdist(rng);
-    rdist.param(p_type(inc_min, inc_max));
-    const auto inc = rdist(rng);
-    rdist.param(p_type(om_min, om_max));
-    const auto om = rdist(rng);
-    rdist.param(p_type(Om_min, Om_max));
-    const auto Om = rdist(rng);
-    rdist.param(p_type(f_min, f_max));
-    const auto f = rdist(rng);
 
-    // Transform into cartesian state.
+    std::array<double, 6> retval{};
+    retval[0] = rdist(rng);
+    for (std::size_t i = 1; i < 6u; ++i) {
+        rdist.param(p_type(bounds[i].first, bounds[i].second));
+        retval[i] = rdist(rng);
+    }
+
+    return retval;
+}
+
+// NOTE: the conversion kernels below operate on scalars, and they
+// are shared by the scalar and batch conversion functions. The batch
+// functions split the SoA data across threads, but the loops are not
+// vectorised, because the kernels call the scalar libm functions.
+
+// Convert Keplerian orbital elements into a cartesian state.
+inline std::array<double, 6> oe_to_cartesian_kernel(double mu, double a, double e, double inc, double om, double Om,
+                                                    double f)
+{
     using std::atan;
     using std::cos;
     using std::sin;
@@ -456,21 +476,16 @@ std::array<double, 6> random_elliptic_state(double mu, const std::array<std::pai
     const auto r3 = std::array{sin(inc) * sin(om), sin(inc) * cos(om), cos(inc)};
 
     // Final position/velocity.
-    using detail::dot;
     const auto x = std::array{dot(r1, q), dot(r2, q), dot(r3, q)};
     const auto v = std::array{dot(r1, vq), dot(r2, vq), dot(r3, vq)};
 
     return {x[0], x[1], x[2], v[0], v[1], v[2]};
 }
 
-// Convert the input cartesian state into Keplerian orbital elements.
-std::array<double, 6> cartesian_to_oe(double mu, const std::array<double, 6> &s)
+// Convert a cartesian state into Keplerian orbital elements.
+inline std::array<double, 6> cartesian_to_oe_kernel(double mu, double x, double y, double z, double vx, double vy,
+                                                    double vz)
 {
-    if (std::any_of(s.begin(), s.end(), [](const auto &x) { return !std::isfinite(x); })) {
-        throw std::invalid_argument("Non-finite values detected in the cartesian state passed to cartesian_to_oe()");
-    }
-
-    const auto [x, y, z, vx, vy, vz] = s;
     const auto pos = std::array{x, y, z};
     const auto vel = std::array{vx, vy, vz};
 
@@ -494,34 +509,306 @@ std::array<double, 6> cartesian_to_oe(double mu, const std::array<double, 6> &s)
     // Array norm.
     auto norm = [norm2](const auto &a) { return std::sqrt(norm2(a)); };
 
+    const auto twopi = 2 * boost::math::constants::pi<double>();
+
     const auto h = cross(pos, vel);
     const auto e_v = sub(div(cross(vel, h), mu), div(pos, norm(pos)));
     const auto n = std::array{-h[1], h[0], 0.};
 
-    using detail::dot;
     using std::acos;
+
     auto f = acos(dot(e_v, pos) / (norm(e_v) * norm(pos)));
-    if (dot(pos, vel) < 0) {
-        f = 2 * boost::math::constants::pi<double>() - f;
-    }
+    f = dot(pos, vel) < 0 ? twopi - f : f;
 
     const auto inc = acos(h[2] / norm(h));
 
     const auto e = norm(e_v);
 
     auto Om = acos(n[0] / norm(n));
-    if (n[1] < 0) {
-        Om = 2 * boost::math::constants::pi<double>() - Om;
-    }
+    Om = n[1] < 0 ? twopi - Om : Om;
 
     auto om = acos(dot(n, e_v) / (norm(n) * norm(e_v)));
-    if (e_v[2] < 0) {
-        om = 2 * boost::math::constants::pi<double>() - om;
-    }
+    om = e_v[2] < 0 ? twopi - om : om;
 
     const auto a = 1 / (2 / norm(pos) - norm2(vel) / mu);
 
     return {a, e, inc, om, Om, f};
 }
 
+// Solve Kepler's equation for n elements, using Newton's
+// method with Danby's starting guess. The elements are processed
+// in small blocks, and the Newton iterations are performed in lockstep
+// over each block until all elements in the block have converged
+// (that is, either the Newton correction or the residual of the equation
+// is below the tolerance). If some element does not converge within
+// max_iter iterations, an error is raised.
+// NOTE: for elliptic orbits, Newton's method with Danby's starting
+// guess is guaranteed to converge, hence the error should
+// never be raised in practice.
+void kepE_impl(std::size_t n, const double *e, const double *M, double *E)
+{
+    constexpr std::size_t block_size = 64;
+    constexpr unsigned max_iter = 50;
+
+    const auto pi = boost::math::constants::pi<double>();
+    const auto twopi = 2 * pi;
+    const auto tol = 4 * std::numeric_limits<double>::epsilon() * pi;
+
+    for (std::size_t b = 0; b < n; b += block_size) {
+        const auto bs = std::min(block_size, n - b);
+
+        // The mean anomalies reduced to the [-pi, pi] range,
+        // and the multiples of 2*pi subtracted from them.
+        std::array<double, block_size> Mr, k;
+
+        for (std::size_t i = 0; i < bs; ++i) {
+            k[i] = std::nearbyint(M[b + i] / twopi);
+            Mr[i] = M[b + i] - k[i] * twopi;
+
+            // Danby's starting guess.
+            E[b + i] = Mr[i] + (Mr[i] >= 0 ? 0.85 : -0.85) * e[b + i];
+        }
+
+        // Index of the first element in the block
+        // which has not converged yet.
+        auto first_nc = bs;
+
+        for (unsigned it = 0; it < max_iter; ++it) {
+            first_nc = bs;
+
+            for (std::size_t i = 0; i < bs; ++i) {
+                const auto cur_E = E[b + i], cur_e = e[b + i];
+                const auto res = cur_E - cur_e * std::sin(cur_E) - Mr[i];
+                const auto delta = res / (1 - cur_e * std::cos(cur_E));
+
+                E[b + i] = cur_E - delta;
+
+                if (first_nc == bs && std::abs(delta) > tol && std::abs(res) > tol) {
+                    first_nc = i;
+                }
+            }
+
+            if (first_nc == bs) {
+                break;
+            }
+        }
+
+        if (first_nc != bs) {
+            using namespace fmt::literals;
+
+            throw std::runtime_error("The solution of Kepler's equation did not converge after {} iterations for the "
+                                     "eccentricity {} and the mean anomaly {}"_format(max_iter, e[b + first_nc],
+                                                                                      M[b + first_nc]));
+        }
+
+        // Add back the multiples of 2*pi.
+        for (std::size_t i = 0; i < bs; ++i) {
+            E[b + i] += k[i] * twopi;
+        }
+    }
+}
+
+} // namespace
+
+} // namespace detail
+
+// Helper to generate a random elliptic orbit and convert it to cartesian variables. The min/max
+// values of a, e, i, om, Om and f are passed in the bounds array. mu is the gravitational parameter
+// of the two-body system.
+std::array<double, 6> random_elliptic_state(double mu, const std::array<std::pair<double, double>, 6> &bounds,
+                                            unsigned seed)
+{
+    // Validate input params.
+    detail::check_mu(mu, "random_elliptic_state");
+    detail::validate_random_elliptic_bounds(bounds);
+
+    // Setup the rng.
+    static thread_local std::mt19937 rng;
+    rng.seed(static_cast<decltype(rng())>(seed));
+
+    // Throw the dice for the orbital elements.
+    const auto [a, e, inc, om, Om, f] = detail::random_oe(rng, bounds);
+
+    // Transform into cartesian state.
+    return detail::oe_to_cartesian_kernel(mu, a, e, inc, om, Om, f);
+}
+
+// Batch version of random_elliptic_state(): generate n random states
+// and write them in SoA format into out. The rng is seeded only once,
+// thus the first state is identical to the state produced by
+// random_elliptic_state() with the same seed.
+void random_elliptic_state_batch(double mu, const std::array<std::pair<double, double>, 6> &bounds, std::size_t n,
+                                 const std::array<double *, 6> &out, unsigned seed)
+{
+    // Validate input params.
+    detail::check_mu(mu, "random_elliptic_state_batch");
+    detail::validate_random_elliptic_bounds(bounds);
+    detail::check_batch_ptrs(n, out, "random_elliptic_state_batch");
+
+    // Throw the dice for the orbital elements.
+    // NOTE: this needs to be done serially in order
+    // to ensure reproducibility.
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+    std::array<std::vector<double>, 6> oe;
+    for (auto &v : oe) {
+        v.resize(boost::numeric_cast<decltype(v.size())>(n));
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto cur_oe = detail::random_oe(rng, bounds);
+
+        for (std::size_t j = 0; j < 6u; ++j) {
+            oe[j][i] = cur_oe[j];
+        }
+    }
+
+    // Transform into cartesian states.
+    oe_to_cartesian_batch(mu, n, {oe[0].data(), oe[1].data(), oe[2].data(), oe[3].data(), oe[4].data(), oe[5].data()},
+                          out);
+}
+
+// Convert the input cartesian state into Keplerian orbital elements.
+std::array<double, 6> cartesian_to_oe(double mu, const std::array<double, 6> &s)
+{
+    if (std::any_of(s.begin(), s.end(), [](const auto &x) { return !std::isfinite(x); })) {
+        throw std::invalid_argument("Non-finite values detected in the cartesian state passed to cartesian_to_oe()");
+    }
+
+    const auto [x, y, z, vx, vy, vz] = s;
+
+    return detail::cartesian_to_oe_kernel(mu, x, y, z, vx, vy, vz);
+}
+
+// Batch version of cartesian_to_oe(), operating on n states in SoA format.
+void cartesian_to_oe_batch(double mu, std::size_t n, const std::array<const double *, 6> &s,
+                           const std::array<double *, 6> &oe)
+{
+    detail::check_batch_ptrs(n, s, "cartesian_to_oe_batch");
+    detail::check_batch_ptrs(n, oe, "cartesian_to_oe_batch");
+
+    detail::parallel_for_blocks(n, detail::nbody_batch_grain, [mu, &s, &oe](std::size_t begin, std::size_t end) {
+        // Check the input values.
+        for (const auto ptr : s) {
+            if (std::any_of(ptr + begin, ptr + end, [](double x) { return !std::isfinite(x); })) {
+                throw std::invalid_argument(
+                    "Non-finite values detected in the cartesian states passed to cartesian_to_oe_batch()");
+            }
+        }
+
+        const auto [x, y, z, vx, vy, vz] = s;
+        const auto [a, e, inc, om, Om, f] = oe;
+
+        for (auto i = begin; i < end; ++i) {
+            const auto res = detail::cartesian_to_oe_kernel(mu, x[i], y[i], z[i], vx[i], vy[i], vz[i]);
+
+            a[i] = res[0];
+            e[i] = res[1];
+            inc[i] = res[2];
+            om[i] = res[3];
+            Om[i] = res[4];
+            f[i] = res[5];
+        }
+    });
+}
+
+namespace detail
+{
+
+namespace
+{
+
+// Validation of orbital elements for the conversion to cartesian state.
+bool oe_is_valid(double a, double e, double inc, double om, double Om, double f)
+{
+    return std::isfinite(a) && std::isfinite(e) && std::isfinite(inc) && std::isfinite(om) && std::isfinite(Om)
+           && std::isfinite(f) && a > 0 && e >= 0 && e < 1;
+}
+
+} // namespace
+
+} // namespace detail
+
+// Convert Keplerian orbital elements (a, e, i, om, Om, f) into
+// a cartesian state. Only elliptic orbits are supported.
+std::array<double, 6> oe_to_cartesian(double mu, const std::array<double, 6> &oe)
+{
+    detail::check_mu(mu, "oe_to_cartesian");
+
+    const auto [a, e, inc, om, Om, f] = oe;
+
+    if (!detail::oe_is_valid(a, e, inc, om, Om, f)) {
+        throw std::invalid_argument("Invalid orbital elements passed to oe_to_cartesian(): the elements must be "
+                                    "finite, the semi-major axis must be positive and the eccentricity must be in "
+                                    "the [0, 1) range");
+    }
+
+    return detail::oe_to_cartesian_kernel(mu, a, e, inc, om, Om, f);
+}
+
+// Batch version of oe_to_cartesian(), operating on n sets of elements in SoA format.
+void oe_to_cartesian_batch(double mu, std::size_t n, const std::array<const double *, 6> &oe,
+                           const std::array<double *, 6> &s)
+{
+    detail::check_mu(mu, "oe_to_cartesian_batch");
+    detail::check_batch_ptrs(n, oe, "oe_to_cartesian_batch");
+    detail::check_batch_ptrs(n, s, "oe_to_cartesian_batch");
+
+    detail::parallel_for_blocks(n, detail::nbody_batch_grain, [mu, &oe, &s](std::size_t begin, std::size_t end) {
+        const auto [a, e, inc, om, Om, f] = oe;
+        const auto [x, y, z, vx, vy, vz] = s;
+
+        for (auto i = begin; i < end; ++i) {
+            if (!detail::oe_is_valid(a[i], e[i], inc[i], om[i], Om[i], f[i])) {
+                throw std::invalid_argument(
+                    "Invalid orbital elements passed to oe_to_cartesian_batch(): the elements must be "
+                    "finite, the semi-major axis must be positive and the eccentricity must be in "
+                    "the [0, 1) range");
+            }
+        }
+
+        for (auto i = begin; i < end; ++i) {
+            const auto res = detail::oe_to_cartesian_kernel(mu, a[i], e[i], inc[i], om[i], Om[i], f[i]);
+
+            x[i] = res[0];
+            y[i] = res[1];
+            z[i] = res[2];
+            vx[i] = res[3];
+            vy[i] = res[4];
+            vz[i] = res[5];
+        }
+    });
+}
+
+// Solve Kepler's equation E - e*sin(E) = M for the eccentric anomaly E.
+double kepE(double e, double M)
+{
+    if (!std::isfinite(e) || e < 0 || e >= 1 || !std::isfinite(M)) {
+        throw std::invalid_argument("Invalid arguments passed to kepE(): the eccentricity must be in the [0, 1) range "
+                                    "and the mean anomaly must be finite");
+    }
+
+    double E;
+    detail::kepE_impl(1, &e, &M, &E);
+
+    return E;
+}
+
+// Batch version of kepE(). E must not overlap with e.
+void kepE_batch(std::size_t n, const double *e, const double *M, double *E)
+{
+    if (n > 0u && (e == nullptr || M == nullptr || E == nullptr)) {
+        throw std::invalid_argument("Null pointer(s) detected in the input/output arrays of kepE_batch()");
+    }
+
+    detail::parallel_for_blocks(n, detail::nbody_batch_grain, [e, M, E](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            if (!std::isfinite(e[i]) || e[i] < 0 || e[i] >= 1 || !std::isfinite(M[i])) {
+                throw std::invalid_argument("Invalid arguments passed to kepE_batch(): the eccentricities must be in "
+                                            "the [0, 1) range and the mean anomalies must be finite");
+            }
+        }
+
+        detail::kepE_impl(end - begin, e + begin, M + begin, E + begin);
+    });
+}
+
 } // namespace heyoka
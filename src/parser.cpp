@@ -0,0 +1,498 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <boost/numeric/conversion/cast.hpp>
+
+#include <heyoka/binary_operator.hpp>
+#include <heyoka/detail/string_conv.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/math/time.hpp>
+#include <heyoka/number.hpp>
+#include <heyoka/param.hpp>
+#include <heyoka/parser.hpp>
+#include <heyoka/serialization.hpp>
+#include <heyoka/variable.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// Operator-precedence parser operating directly
+// on a stream buffer. Each character is read exactly
+// once (with a single character of lookahead),
+// thus the parsing runs in linear time.
+class expr_parser
+{
+    using traits_t = std::char_traits<char>;
+
+    std::streambuf *m_sb;
+    unsigned long m_line = 1, m_col = 1;
+
+public:
+    explicit expr_parser(std::istream &is) : m_sb(is.rdbuf())
+    {
+        if (m_sb == nullptr) {
+            throw std::invalid_argument("Cannot parse from an input stream without an associated stream buffer");
+        }
+    }
+
+private:
+    int peek()
+    {
+        return m_sb->sgetc();
+    }
+    int get()
+    {
+        const auto c = m_sb->sbumpc();
+
+        if (c == '\n') {
+            ++m_line;
+            m_col = 1;
+        } else if (c != traits_t::eof()) {
+            ++m_col;
+        }
+
+        return c;
+    }
+
+    [[noreturn]] void error(const std::string &msg) const
+    {
+        throw std::invalid_argument("Parse error at line " + std::to_string(m_line) + ", column "
+                                    + std::to_string(m_col) + ": " + msg);
+    }
+
+    static bool is_space(int c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+    static bool is_digit(int c)
+    {
+        return c >= '0' && c <= '9';
+    }
+    static bool is_ident_start(int c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+    static bool is_ident_char(int c)
+    {
+        return is_ident_start(c) || is_digit(c);
+    }
+
+    // Skip whitespaces and comments.
+    void skip_ws()
+    {
+        while (true) {
+            const auto c = peek();
+
+            if (is_space(c)) {
+                get();
+            } else if (c == '#') {
+                while (peek() != '\n' && peek() != traits_t::eof()) {
+                    get();
+                }
+            } else {
+                break;
+            }
+        }
+    }
+
+    void expect(char c)
+    {
+        skip_ws();
+
+        if (peek() != c) {
+            error(std::string("'") + c + "' was expected");
+        }
+
+        get();
+    }
+
+    std::string parse_ident()
+    {
+        std::string retval;
+
+        while (is_ident_char(peek())) {
+            retval.push_back(static_cast<char>(get()));
+        }
+
+        return retval;
+    }
+
+    number parse_number()
+    {
+        std::string str;
+
+        while (is_digit(peek()) || peek() == '.') {
+            str.push_back(static_cast<char>(get()));
+        }
+
+        // Exponent.
+        if (peek() == 'e' || peek() == 'E') {
+            str.push_back(static_cast<char>(get()));
+
+            if (peek() == '+' || peek() == '-') {
+                str.push_back(static_cast<char>(get()));
+            }
+
+            while (is_digit(peek())) {
+                str.push_back(static_cast<char>(get()));
+            }
+        }
+
+        try {
+            return number{li_from_string<double>(str)};
+        } catch (...) {
+            error("invalid numerical constant '" + str + "'");
+        }
+    }
+
+    // The entries of the operator stack.
+    enum class op_kind { lparen, call, neg, add, sub, mul, div };
+    struct op_entry {
+        op_kind kind;
+        // The name and the arguments parsed so far
+        // of a function call.
+        std::string name;
+        std::vector<expression> args;
+    };
+
+    // NOTE: parentheses and function calls are
+    // given the lowest precedence, so that they are
+    // never popped when reducing operators.
+    static int op_prec(op_kind k)
+    {
+        switch (k) {
+            case op_kind::neg:
+                return 3;
+            case op_kind::mul:
+            case op_kind::div:
+                return 2;
+            case op_kind::add:
+            case op_kind::sub:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    // Apply the operator at the top of ops to the
+    // operand(s) at the top of operands.
+    static void reduce(std::vector<op_entry> &ops, std::vector<expression> &operands)
+    {
+        assert(!ops.empty());
+        assert(op_prec(ops.back().kind) > 0);
+
+        const auto kind = ops.back().kind;
+        ops.pop_back();
+
+        if (kind == op_kind::neg) {
+            assert(!operands.empty());
+            auto &arg = operands.back();
+
+            // NOTE: negative numbers are printed with a leading
+            // minus sign, thus we need to fold the negation
+            // into numerical constants in order to ensure
+            // round-tripping.
+            if (auto n_ptr = std::get_if<number>(&arg.value())) {
+                arg = expression{-std::move(*n_ptr)};
+            } else {
+                // NOTE: this mirrors the implementation
+                // of the unary minus operator for expression.
+                arg = expression{
+                    binary_operator{binary_operator::type::mul, expression{number{-1.}}, std::move(arg)}};
+            }
+
+            return;
+        }
+
+        assert(operands.size() >= 2u);
+        auto rhs = std::move(operands.back());
+        operands.pop_back();
+        auto &lhs = operands.back();
+
+        binary_operator::type type{};
+        switch (kind) {
+            case op_kind::add:
+                type = binary_operator::type::add;
+                break;
+            case op_kind::sub:
+                type = binary_operator::type::sub;
+                break;
+            case op_kind::mul:
+                type = binary_operator::type::mul;
+                break;
+            default:
+                assert(kind == op_kind::div);
+                type = binary_operator::type::div;
+        }
+
+        lhs = expression{binary_operator{type, std::move(lhs), std::move(rhs)}};
+    }
+
+    // Parse a number, a parameter, a variable or the beginning of
+    // a function call. Returns true if an operand was pushed to operands,
+    // false if a function call with arguments was pushed to ops.
+    bool parse_operand(std::vector<op_entry> &ops, std::vector<expression> &operands)
+    {
+        const auto c = peek();
+
+        if (is_digit(c) || c == '.') {
+            operands.emplace_back(parse_number());
+            return true;
+        }
+
+        if (!is_ident_start(c)) {
+            if (c == traits_t::eof()) {
+                error("unexpected end of input");
+            } else {
+                error(std::string("unexpected character '") + static_cast<char>(c) + "'");
+            }
+        }
+
+        auto name = parse_ident();
+
+        skip_ws();
+
+        if (name == "par" && peek() == '[') {
+            get();
+            skip_ws();
+
+            std::string idx;
+            while (is_digit(peek())) {
+                idx.push_back(static_cast<char>(get()));
+            }
+            if (idx.empty()) {
+                error("a parameter index was expected");
+            }
+            expect(']');
+
+            std::uint32_t n;
+            try {
+                n = boost::numeric_cast<std::uint32_t>(li_from_string<unsigned long long>(idx));
+            } catch (...) {
+                error("invalid parameter index '" + idx + "'");
+            }
+
+            operands.emplace_back(param{n});
+            return true;
+        }
+
+        if (peek() == '(') {
+            // Function call.
+            get();
+
+            skip_ws();
+            if (peek() == ')') {
+                get();
+                operands.emplace_back(func_from_registry(name, {}));
+                return true;
+            }
+
+            ops.push_back(op_entry{op_kind::call, std::move(name), {}});
+            return false;
+        }
+
+        // NOTE: this is how time, infinities and NaNs
+        // are printed by the stream operators.
+        if (name == "t") {
+            operands.push_back(heyoka::time);
+        } else if (name == "inf") {
+            operands.emplace_back(number{std::numeric_limits<double>::infinity()});
+        } else if (name == "nan") {
+            operands.emplace_back(number{std::numeric_limits<double>::quiet_NaN()});
+        } else {
+            operands.emplace_back(variable{std::move(name)});
+        }
+
+        return true;
+    }
+
+public:
+    // NOTE: the operators, the parentheses and the function calls
+    // are kept in explicit stacks (shunting-yard algorithm), so that
+    // the nesting depth of the input does not affect the depth
+    // of the call stack. The stream operator of expression fully parenthesises
+    // binary operators, thus printed large sums are deeply nested.
+    expression parse_expr()
+    {
+        std::vector<expression> operands;
+        std::vector<op_entry> ops;
+
+        // Reduce the operators at the top of the stack
+        // whose precedence is not lower than prec.
+        auto reduce_ops = [&](int prec) {
+            while (!ops.empty() && op_prec(ops.back().kind) >= prec) {
+                reduce(ops, operands);
+            }
+        };
+
+        // NOTE: the parser alternates between expecting an operand
+        // (possibly preceded by unary operators and open parentheses)
+        // and expecting a binary operator (or the closing of a
+        // parenthesis/function call).
+        auto expect_operand = true;
+
+        while (true) {
+            skip_ws();
+
+            const auto c = peek();
+
+            if (expect_operand) {
+                if (c == '+') {
+                    // Unary plus.
+                    get();
+                } else if (c == '-') {
+                    get();
+                    ops.push_back(op_entry{op_kind::neg, {}, {}});
+                } else if (c == '(') {
+                    get();
+                    ops.push_back(op_entry{op_kind::lparen, {}, {}});
+                } else {
+                    expect_operand = !parse_operand(ops, operands);
+                }
+
+                continue;
+            }
+
+            if (c == '+' || c == '-' || c == '*' || c == '/') {
+                get();
+
+                const auto kind = c == '+'   ? op_kind::add
+                                  : c == '-' ? op_kind::sub
+                                  : c == '*' ? op_kind::mul
+                                             : op_kind::div;
+
+                // NOTE: all binary operators are left-associative.
+                reduce_ops(op_prec(kind));
+                ops.push_back(op_entry{kind, {}, {}});
+
+                expect_operand = true;
+                continue;
+            }
+
+            // Complete the innermost parenthesis/function call.
+            reduce_ops(1);
+
+            if (ops.empty()) {
+                // End of the expression.
+                break;
+            }
+
+            auto &top = ops.back();
+            assert(!operands.empty());
+
+            if (top.kind == op_kind::call && c == ',') {
+                get();
+                top.args.push_back(std::move(operands.back()));
+                operands.pop_back();
+
+                expect_operand = true;
+                continue;
+            }
+
+            expect(')');
+
+            if (top.kind == op_kind::call) {
+                top.args.push_back(std::move(operands.back()));
+                operands.back() = expression{func_from_registry(top.name, std::move(top.args))};
+            }
+
+            ops.pop_back();
+        }
+
+        assert(operands.size() == 1u);
+
+        return std::move(operands.back());
+    }
+
+    bool at_end()
+    {
+        skip_ws();
+
+        return peek() == traits_t::eof();
+    }
+
+    std::vector<std::pair<expression, expression>> parse_sys()
+    {
+        std::vector<std::pair<expression, expression>> retval;
+
+        while (!at_end()) {
+            if (!is_ident_start(peek()) || parse_ident() != "prime") {
+                error("a statement of the form 'prime(x) = ...' was expected");
+            }
+
+            expect('(');
+            skip_ws();
+            if (!is_ident_start(peek())) {
+                error("a variable name was expected");
+            }
+            auto name = parse_ident();
+            expect(')');
+            expect('=');
+
+            retval.push_back(prime(expression{variable{std::move(name)}}) = parse_expr());
+
+            skip_ws();
+            if (peek() == ';') {
+                get();
+            }
+        }
+
+        return retval;
+    }
+};
+
+} // namespace
+
+} // namespace detail
+
+expression parse_expression(const std::string &s)
+{
+    std::istringstream iss(s);
+    detail::expr_parser p(iss);
+
+    auto retval = p.parse_expr();
+
+    if (!p.at_end()) {
+        throw std::invalid_argument("Trailing characters detected after parsing the expression '" + s + "'");
+    }
+
+    return retval;
+}
+
+std::vector<std::pair<expression, expression>> parse_sys(std::istream &is)
+{
+    return detail::expr_parser(is).parse_sys();
+}
+
+std::vector<std::pair<expression, expression>> parse_sys(const std::string &s)
+{
+    std::istringstream iss(s);
+
+    return parse_sys(iss);
+}
+
+} // namespace heyoka
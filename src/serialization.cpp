@@ -0,0 +1,579 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <heyoka/config.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <boost/numeric/conversion/cast.hpp>
+
+#include <fmt/format.h>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/binary_operator.hpp>
+#include <heyoka/detail/type_traits.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/math.hpp>
+#include <heyoka/number.hpp>
+#include <heyoka/param.hpp>
+#include <heyoka/serialization.hpp>
+#include <heyoka/sph_harm.hpp>
+#include <heyoka/variable.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// NOTE: the binary format is meant for caching
+// on the same machine/build, it is not a portable
+// exchange format. The header records the endianness
+// and the size of long double, and reading a stream
+// produced on an incompatible platform will fail.
+constexpr std::array<char, 8> s11n_magic = {'h', 'e', 'y', 'o', 'k', 'a', 'b', 'n'};
+constexpr std::uint32_t s11n_version = 1;
+constexpr std::uint32_t s11n_endian_marker = 0x01020304ul;
+
+// Tags for the alternatives in expression.
+enum class s11n_expr_tag : std::uint8_t { number, variable, binary_operator, func, param };
+
+// Tags for the alternatives in number.
+enum class s11n_num_tag : std::uint8_t { dbl, ldbl, f128 };
+
+template <typename T>
+void s11n_write_raw(std::ostream &os, const T &x)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    std::array<char, sizeof(T)> buffer;
+    std::memcpy(buffer.data(), &x, sizeof(T));
+
+    if (!os.write(buffer.data(), static_cast<std::streamsize>(sizeof(T)))) {
+        throw std::invalid_argument("Error writing to a binary output stream");
+    }
+}
+
+template <typename T>
+T s11n_read_raw(std::istream &is)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    std::array<char, sizeof(T)> buffer;
+    if (!is.read(buffer.data(), static_cast<std::streamsize>(sizeof(T)))) {
+        throw std::invalid_argument("Error reading from a binary input stream: unexpected end of data");
+    }
+
+    T retval;
+    std::memcpy(&retval, buffer.data(), sizeof(T));
+
+    return retval;
+}
+
+void s11n_write_string(std::ostream &os, const std::string &s)
+{
+    s11n_write_raw(os, static_cast<std::uint64_t>(s.size()));
+
+    if (!os.write(s.data(), boost::numeric_cast<std::streamsize>(s.size()))) {
+        throw std::invalid_argument("Error writing to a binary output stream");
+    }
+}
+
+std::string s11n_read_string(std::istream &is)
+{
+    auto size = boost::numeric_cast<std::string::size_type>(s11n_read_raw<std::uint64_t>(is));
+
+    // NOTE: read the string in chunks of bounded size, rather than
+    // resizing it upfront to the size read from the stream, in order
+    // to avoid huge allocations in case of corrupted data.
+    std::string retval;
+    std::array<char, 4096> buffer;
+    while (size > 0u) {
+        const auto chunk_size = std::min(size, static_cast<std::string::size_type>(buffer.size()));
+
+        if (!is.read(buffer.data(), static_cast<std::streamsize>(chunk_size))) {
+            throw std::invalid_argument("Error reading from a binary input stream: unexpected end of data");
+        }
+
+        retval.append(buffer.data(), chunk_size);
+        size -= chunk_size;
+    }
+
+    return retval;
+}
+
+void s11n_write_number(std::ostream &os, const number &n)
+{
+    std::visit(
+        [&os](const auto &v) {
+            using type = uncvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<type, double>) {
+                s11n_write_raw(os, s11n_num_tag::dbl);
+                s11n_write_raw(os, v);
+            } else if constexpr (std::is_same_v<type, long double>) {
+                s11n_write_raw(os, s11n_num_tag::ldbl);
+                s11n_write_raw(os, v);
+#if defined(HEYOKA_HAVE_REAL128)
+            } else if constexpr (std::is_same_v<type, mppp::real128>) {
+                s11n_write_raw(os, s11n_num_tag::f128);
+                s11n_write_raw(os, v.m_value);
+#endif
+            } else {
+                static_assert(always_false_v<type>, "Unhandled type.");
+            }
+        },
+        n.value());
+}
+
+number s11n_read_number(std::istream &is)
+{
+    switch (s11n_read_raw<s11n_num_tag>(is)) {
+        case s11n_num_tag::dbl:
+            return number{s11n_read_raw<double>(is)};
+        case s11n_num_tag::ldbl:
+            return number{s11n_read_raw<long double>(is)};
+        case s11n_num_tag::f128:
+#if defined(HEYOKA_HAVE_REAL128)
+            return number{mppp::real128{s11n_read_raw<__float128>(is)}};
+#else
+            throw std::invalid_argument("Cannot read a quadruple-precision number from a binary input stream: "
+                                        "heyoka was built without support for quadruple-precision computations");
+#endif
+        default:
+            throw std::invalid_argument("Invalid number tag detected in a binary input stream");
+    }
+}
+
+void s11n_write_expression(std::ostream &, const expression &);
+expression s11n_read_expression(std::istream &);
+
+void s11n_write_expression(std::ostream &os, const expression &e)
+{
+    std::visit(
+        [&os](const auto &v) {
+            using type = uncvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<type, number>) {
+                s11n_write_raw(os, s11n_expr_tag::number);
+                s11n_write_number(os, v);
+            } else if constexpr (std::is_same_v<type, variable>) {
+                s11n_write_raw(os, s11n_expr_tag::variable);
+                s11n_write_string(os, v.name());
+            } else if constexpr (std::is_same_v<type, binary_operator>) {
+                s11n_write_raw(os, s11n_expr_tag::binary_operator);
+                s11n_write_raw(os, static_cast<std::uint8_t>(v.op()));
+                s11n_write_expression(os, v.lhs());
+                s11n_write_expression(os, v.rhs());
+            } else if constexpr (std::is_same_v<type, func>) {
+                if (!is_registered_func_type(v.get_name())) {
+                    throw std::invalid_argument("Cannot serialise the function '" + v.get_name()
+                                                + "': the function type has not been registered");
+                }
+
+                s11n_write_raw(os, s11n_expr_tag::func);
+                s11n_write_string(os, v.get_name());
+                s11n_write_raw(os, static_cast<std::uint64_t>(v.args().size()));
+                for (const auto &arg : v.args()) {
+                    s11n_write_expression(os, arg);
+                }
+            } else if constexpr (std::is_same_v<type, param>) {
+                s11n_write_raw(os, s11n_expr_tag::param);
+                s11n_write_raw(os, v.idx());
+            } else {
+                static_assert(always_false_v<type>, "Unhandled type.");
+            }
+        },
+        e.value());
+}
+
+// Helper to build the factory for one of the builtin
+// unary functions.
+template <typename F>
+func_factory_t make_unary_factory()
+{
+    return [](std::vector<expression> args) {
+        if (args.size() != 1u) {
+            throw std::invalid_argument(
+                "Invalid number of arguments detected when deserialising a unary function: 1 was expected, but "
+                + std::to_string(args.size()) + " were provided instead");
+        }
+
+        return func{F(std::move(args[0]))};
+    };
+}
+
+// Build the map of factories for the
+// builtin functions.
+std::unordered_map<std::string, func_factory_t> make_builtin_func_map()
+{
+    std::unordered_map<std::string, func_factory_t> m;
+
+    m.emplace("acos", make_unary_factory<acos_impl>());
+    m.emplace("acosh", make_unary_factory<acosh_impl>());
+    m.emplace("asin", make_unary_factory<asin_impl>());
+    m.emplace("asinh", make_unary_factory<asinh_impl>());
+    m.emplace("atan", make_unary_factory<atan_impl>());
+    m.emplace("atanh", make_unary_factory<atanh_impl>());
+    m.emplace("cos", make_unary_factory<cos_impl>());
+    m.emplace("cosh", make_unary_factory<cosh_impl>());
+    m.emplace("erf", make_unary_factory<erf_impl>());
+    m.emplace("exp", make_unary_factory<exp_impl>());
+    m.emplace("log", make_unary_factory<log_impl>());
+    m.emplace("sigmoid", make_unary_factory<sigmoid_impl>());
+    m.emplace("sin", make_unary_factory<sin_impl>());
+    m.emplace("sinh", make_unary_factory<sinh_impl>());
+    m.emplace("sqrt", make_unary_factory<sqrt_impl>());
+    m.emplace("square", make_unary_factory<square_impl>());
+    m.emplace("tan", make_unary_factory<tan_impl>());
+    m.emplace("tanh", make_unary_factory<tanh_impl>());
+
+    m.emplace("pow", [](std::vector<expression> args) {
+        if (args.size() != 2u) {
+            throw std::invalid_argument(
+                "Invalid number of arguments detected when deserialising the pow() function: 2 were expected, but "
+                + std::to_string(args.size()) + " were provided instead");
+        }
+
+        return func{pow_impl(std::move(args[0]), std::move(args[1]))};
+    });
+
+    m.emplace("lin_comb", [](std::vector<expression> args) {
+        if (args.size() % 2u != 0u) {
+            throw std::invalid_argument("Invalid number of arguments detected when deserialising a linear "
+                                        "combination: an even number was expected, but "
+                                        + std::to_string(args.size()) + " were provided instead");
+        }
+
+        std::vector<std::pair<expression, expression>> terms;
+        for (decltype(args.size()) i = 0; i < args.size(); i += 2u) {
+            terms.emplace_back(std::move(args[i]), std::move(args[i + 1u]));
+        }
+
+        return func{lin_comb_impl(std::move(terms))};
+    });
+
+    m.emplace("time", [](std::vector<expression> args) {
+        if (!args.empty()) {
+            throw std::invalid_argument(
+                "Invalid number of arguments detected when deserialising the time function: 0 were expected, but "
+                + std::to_string(args.size()) + " were provided instead");
+        }
+
+        return func{time_impl{}};
+    });
+
+    // NOTE: the component of a spherical harmonics gravity
+    // field is encoded in the name of the function.
+    for (std::uint32_t comp = 0; comp < 3u; ++comp) {
+        m.emplace(std::string{"sph_harm_gravity_"} + "xyz"[comp],
+                  [comp](std::vector<expression> args) { return func{sph_harm_impl(comp, std::move(args))}; });
+    }
+
+    return m;
+}
+
+// Registry of function factories.
+struct func_registry {
+    std::mutex mut;
+    std::unordered_map<std::string, func_factory_t> map = make_builtin_func_map();
+};
+
+func_registry &get_func_registry()
+{
+    static func_registry reg;
+
+    return reg;
+}
+
+expression s11n_read_expression(std::istream &is)
+{
+    switch (s11n_read_raw<s11n_expr_tag>(is)) {
+        case s11n_expr_tag::number:
+            return expression{s11n_read_number(is)};
+        case s11n_expr_tag::variable:
+            return expression{variable{s11n_read_string(is)}};
+        case s11n_expr_tag::binary_operator: {
+            const auto op = s11n_read_raw<std::uint8_t>(is);
+            if (op > static_cast<std::uint8_t>(binary_operator::type::div)) {
+                throw std::invalid_argument("Invalid binary operator type detected in a binary input stream");
+            }
+
+            auto lhs = s11n_read_expression(is);
+            auto rhs = s11n_read_expression(is);
+
+            return expression{
+                binary_operator{static_cast<binary_operator::type>(op), std::move(lhs), std::move(rhs)}};
+        }
+        case s11n_expr_tag::func: {
+            auto name = s11n_read_string(is);
+            const auto nargs = boost::numeric_cast<std::vector<expression>::size_type>(
+                s11n_read_raw<std::uint64_t>(is));
+
+            // NOTE: don't reserve based on the number of arguments
+            // read from the stream (see s11n_load_vector()).
+            std::vector<expression> args;
+            for (decltype(args.size()) i = 0; i < nargs; ++i) {
+                args.push_back(s11n_read_expression(is));
+            }
+
+            return expression{func_from_registry(name, std::move(args))};
+        }
+        case s11n_expr_tag::param:
+            return expression{param{s11n_read_raw<std::uint32_t>(is)}};
+        default:
+            throw std::invalid_argument("Invalid expression tag detected in a binary input stream");
+    }
+}
+
+} // namespace
+
+} // namespace detail
+
+void register_func_type(const std::string &name, func_factory_t fac)
+{
+    if (!fac) {
+        throw std::invalid_argument("Cannot register the function type '" + name + "' with an empty factory");
+    }
+
+    auto &reg = detail::get_func_registry();
+    std::lock_guard lock{reg.mut};
+
+    reg.map.insert_or_assign(name, std::move(fac));
+}
+
+bool is_registered_func_type(const std::string &name)
+{
+    auto &reg = detail::get_func_registry();
+    std::lock_guard lock{reg.mut};
+
+    return reg.map.find(name) != reg.map.end();
+}
+
+func func_from_registry(const std::string &name, std::vector<expression> args)
+{
+    func_factory_t fac;
+    {
+        auto &reg = detail::get_func_registry();
+        std::lock_guard lock{reg.mut};
+
+        const auto it = reg.map.find(name);
+        if (it == reg.map.end()) {
+            throw std::invalid_argument("Cannot construct the function '" + name
+                                        + "': the function type has not been registered");
+        }
+        fac = it->second;
+    }
+
+    // NOTE: invoke the factory outside the lock, so that
+    // a factory can itself access the registry.
+    auto f = fac(std::move(args));
+    if (f.get_name() != name) {
+        throw std::invalid_argument("The factory registered for the function '" + name
+                                    + "' produced a function called '" + f.get_name() + "' instead");
+    }
+
+    return f;
+}
+
+binary_writer::binary_writer(std::ostream &os) : m_os(os)
+{
+    for (auto c : detail::s11n_magic) {
+        detail::s11n_write_raw(m_os, c);
+    }
+    detail::s11n_write_raw(m_os, detail::s11n_version);
+    detail::s11n_write_raw(m_os, detail::s11n_endian_marker);
+    detail::s11n_write_raw(m_os, static_cast<std::uint8_t>(sizeof(long double)));
+}
+
+binary_writer::~binary_writer() = default;
+
+void binary_writer::write(const expression &e)
+{
+    detail::s11n_write_expression(m_os, e);
+}
+
+void binary_writer::write(const std::pair<expression, std::vector<std::uint32_t>> &p)
+{
+    detail::s11n_write_expression(m_os, p.first);
+
+    write_size(p.second.size());
+    for (auto idx : p.second) {
+        detail::s11n_write_raw(m_os, idx);
+    }
+}
+
+void binary_writer::write(const std::pair<expression, expression> &p)
+{
+    detail::s11n_write_expression(m_os, p.first);
+    detail::s11n_write_expression(m_os, p.second);
+}
+
+void binary_writer::write_size(std::uint64_t n)
+{
+    detail::s11n_write_raw(m_os, n);
+}
+
+binary_reader::binary_reader(std::istream &is) : m_is(is)
+{
+    using namespace fmt::literals;
+
+    for (auto c : detail::s11n_magic) {
+        if (detail::s11n_read_raw<char>(m_is) != c) {
+            throw std::invalid_argument("Invalid header detected in a binary input stream");
+        }
+    }
+
+    if (const auto ver = detail::s11n_read_raw<std::uint32_t>(m_is); ver != detail::s11n_version) {
+        throw std::invalid_argument("Unsupported binary format version detected in a binary input stream: {} was "
+                                    "expected, but {} was read instead"_format(detail::s11n_version, ver));
+    }
+
+    if (detail::s11n_read_raw<std::uint32_t>(m_is) != detail::s11n_endian_marker) {
+        throw std::invalid_argument(
+            "The binary input stream was produced on a platform with a different endianness");
+    }
+
+    if (detail::s11n_read_raw<std::uint8_t>(m_is) != sizeof(long double)) {
+        throw std::invalid_argument(
+            "The binary input stream was produced on a platform with a different long double type");
+    }
+}
+
+binary_reader::~binary_reader() = default;
+
+expression binary_reader::read_expression()
+{
+    return detail::s11n_read_expression(m_is);
+}
+
+std::pair<expression, std::vector<std::uint32_t>> binary_reader::read_dc_entry()
+{
+    auto ex = detail::s11n_read_expression(m_is);
+
+    const auto n_deps = boost::numeric_cast<std::vector<std::uint32_t>::size_type>(read_size());
+
+    // NOTE: don't resize based on the number of dependencies
+    // read from the stream (see s11n_load_vector()).
+    std::vector<std::uint32_t> deps;
+    for (decltype(deps.size()) i = 0; i < n_deps; ++i) {
+        deps.push_back(detail::s11n_read_raw<std::uint32_t>(m_is));
+    }
+
+    return std::pair{std::move(ex), std::move(deps)};
+}
+
+std::pair<expression, expression> binary_reader::read_eq()
+{
+    auto lhs = detail::s11n_read_expression(m_is);
+    auto rhs = detail::s11n_read_expression(m_is);
+
+    return std::pair{std::move(lhs), std::move(rhs)};
+}
+
+std::uint64_t binary_reader::read_size()
+{
+    return detail::s11n_read_raw<std::uint64_t>(m_is);
+}
+
+namespace detail
+{
+
+namespace
+{
+
+template <typename V>
+void s11n_save_vector(std::ostream &os, const V &v)
+{
+    binary_writer bw(os);
+
+    bw.write_size(v.size());
+    for (const auto &x : v) {
+        bw.write(x);
+    }
+}
+
+template <typename V, typename F>
+V s11n_load_vector(std::istream &is, const F &f)
+{
+    binary_reader br(is);
+
+    const auto size = boost::numeric_cast<typename V::size_type>(br.read_size());
+
+    // NOTE: don't reserve based on the size read from the
+    // stream, in order to avoid huge allocations
+    // in case of corrupted data.
+    V retval;
+    for (typename V::size_type i = 0; i < size; ++i) {
+        retval.push_back(f(br));
+    }
+
+    return retval;
+}
+
+} // namespace
+
+} // namespace detail
+
+void save_binary(std::ostream &os, const std::vector<expression> &v)
+{
+    detail::s11n_save_vector(os, v);
+}
+
+void save_binary(std::ostream &os, const std::vector<std::pair<expression, expression>> &v)
+{
+    detail::s11n_save_vector(os, v);
+}
+
+void save_binary(std::ostream &os, const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &v)
+{
+    detail::s11n_save_vector(os, v);
+}
+
+std::vector<expression> load_binary_expressions(std::istream &is)
+{
+    return detail::s11n_load_vector<std::vector<expression>>(is,
+                                                             [](binary_reader &br) { return br.read_expression(); });
+}
+
+std::vector<std::pair<expression, expression>> load_binary_sys(std::istream &is)
+{
+    return detail::s11n_load_vector<std::vector<std::pair<expression, expression>>>(
+        is, [](binary_reader &br) { return br.read_eq(); });
+}
+
+std::vector<std::pair<expression, std::vector<std::uint32_t>>> load_binary_dc(std::istream &is)
+{
+    return detail::s11n_load_vector<std::vector<std::pair<expression, std::vector<std::uint32_t>>>>(
+        is, [](binary_reader &br) { return br.read_dc_entry(); });
+}
+
+} // namespace heyoka
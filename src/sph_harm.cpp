@@ -0,0 +1,420 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <heyoka/binary_operator.hpp>
+#include <heyoka/detail/string_conv.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/math/sqrt.hpp>
+#include <heyoka/math/square.hpp>
+#include <heyoka/number.hpp>
+#include <heyoka/param.hpp>
+#include <heyoka/sph_harm.hpp>
+#include <heyoka/variable.hpp>
+
+namespace heyoka
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// Max degree supported by the recursions.
+constexpr std::uint32_t sph_harm_max_degree = 120;
+
+bool sph_harm_is_zero(const expression &ex)
+{
+    return std::holds_alternative<number>(ex.value()) && is_zero(std::get<number>(ex.value()));
+}
+
+// Normalisation factor of the harmonic coefficients of degree n and order m,
+// i.e., sqrt((2 - delta_0m) * (2n + 1) * (n - m)! / (n + m)!).
+// NOTE: the ratio of the factorials is computed as a product
+// in order to avoid overflows.
+double sph_harm_norm_factor(std::uint32_t n, std::uint32_t m)
+{
+    auto retval = std::sqrt((m == 0u ? 1. : 2.) * (2. * n + 1.));
+
+    for (auto k = n - m + 1u; k <= n + m; ++k) {
+        retval /= std::sqrt(static_cast<double>(k));
+    }
+
+    return retval;
+}
+
+std::string sph_harm_name(std::uint32_t comp)
+{
+    if (comp >= 3u) {
+        throw std::invalid_argument("Invalid component index " + std::to_string(comp)
+                                    + " for a spherical harmonics gravity field: the index must be less than 3");
+    }
+
+    return std::string{"sph_harm_gravity_"} + "xyz"[comp];
+}
+
+// Number of pairs of coefficients (C_nm, S_nm) of a field
+// of the given degree and order.
+std::uint32_t sph_harm_n_coeffs(std::uint32_t degree, std::uint32_t order)
+{
+    std::uint32_t retval = 0;
+
+    for (std::uint32_t n = 0; n <= degree; ++n) {
+        retval += std::min(n, order) + 1u;
+    }
+
+    return retval;
+}
+
+// Fetch the value of the degree or of the order of a field from
+// the argument ex of a sph_harm_impl.
+std::uint32_t sph_harm_uint_arg(const expression &ex, const std::string &name)
+{
+    if (const auto *nptr = std::get_if<number>(&ex.value())) {
+        const auto v = std::visit([](const auto &x) { return static_cast<double>(x); }, nptr->value());
+
+        if (std::isfinite(v) && v >= 0 && v <= sph_harm_max_degree && std::trunc(v) == v) {
+            return static_cast<std::uint32_t>(v);
+        }
+    }
+
+    throw std::invalid_argument("The " + name
+                                + " of a spherical harmonics gravity field must be an integral number between 0 and "
+                                + std::to_string(sph_harm_max_degree));
+}
+
+} // namespace
+
+sph_harm_impl::sph_harm_impl()
+    : sph_harm_impl(0, std::vector{0_dbl, 0_dbl, 0_dbl, 1_dbl, 1_dbl, 0_dbl, 0_dbl, 1_dbl, 0_dbl, 0_dbl})
+{
+}
+
+sph_harm_impl::sph_harm_impl(std::uint32_t comp, std::vector<expression> args)
+    : func_base(sph_harm_name(comp), std::move(args))
+{
+    const auto &a = this->args();
+
+    if (a.size() < 8u) {
+        throw std::invalid_argument("A spherical harmonics gravity field needs at least 8 arguments, but only "
+                                    + std::to_string(a.size()) + " were provided");
+    }
+
+    if (!std::holds_alternative<number>(a[3].value()) || !std::holds_alternative<number>(a[4].value())
+        || !std::holds_alternative<number>(a[7].value())) {
+        throw std::invalid_argument("The gravitational parameter, the reference radius and the normalisation flag "
+                                    "of a spherical harmonics gravity field must be numbers");
+    }
+
+    const auto degree = sph_harm_uint_arg(a[5], "degree"), order = sph_harm_uint_arg(a[6], "order");
+
+    if (order > degree) {
+        throw std::invalid_argument("The order of a spherical harmonics gravity field (" + std::to_string(order)
+                                    + ") cannot be greater than its degree (" + std::to_string(degree) + ")");
+    }
+
+    const auto n_coeffs = sph_harm_n_coeffs(degree, order);
+    if (a.size() != 8u + 2u * static_cast<decltype(a.size())>(n_coeffs)) {
+        throw std::invalid_argument("A spherical harmonics gravity field of degree " + std::to_string(degree)
+                                    + " and order " + std::to_string(order) + " needs "
+                                    + std::to_string(8u + 2u * n_coeffs) + " arguments, but "
+                                    + std::to_string(a.size()) + " were provided");
+    }
+
+    for (auto it = a.begin() + 8, e = a.end(); it != e; ++it) {
+        if (!std::holds_alternative<number>(it->value()) && !std::holds_alternative<param>(it->value())) {
+            throw std::invalid_argument(
+                "The coefficients of a spherical harmonics gravity field must be numbers or params");
+        }
+    }
+}
+
+std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type
+sph_harm_impl::taylor_decompose(std::vector<std::pair<expression, std::vector<std::uint32_t>>> &u_vars_defs) &&
+{
+    assert(args().size() >= 8u);
+
+    // Decompose the position. The other arguments
+    // are numbers or params, and they are left as they are.
+    const auto b = get_mutable_args_it().first;
+    for (auto it = b; it != b + 3; ++it) {
+        if (const auto dres = taylor_decompose_in_place(std::move(*it), u_vars_defs)) {
+            *it = expression{variable{"u_" + li_to_string(dres)}};
+        }
+    }
+
+    const auto &x = args()[0], &y = args()[1], &z = args()[2];
+    const auto &mu = std::get<number>(args()[3].value()), &radius = std::get<number>(args()[4].value());
+    const auto degree = sph_harm_uint_arg(args()[5], "degree"), order = sph_harm_uint_arg(args()[6], "order");
+    const auto normalised = !is_zero(std::get<number>(args()[7].value()));
+    const auto comp = static_cast<std::uint32_t>(get_name().back() - 'x');
+    assert(comp < 3u);
+
+    // Helpers to append the definition of a new u variable
+    // and to return the corresponding variable.
+    auto emit = [&u_vars_defs](expression ex) {
+        u_vars_defs.emplace_back(std::move(ex), std::vector<std::uint32_t>{});
+
+        return expression{variable{"u_" + li_to_string(u_vars_defs.size() - 1u)}};
+    };
+    // NOTE: the binary operators are created directly (rather than via
+    // the arithmetic operators of expression) in order to prevent
+    // any simplification.
+    auto emit_bo = [&emit](binary_operator::type t, expression a, expression b) {
+        return emit(expression{binary_operator{t, std::move(a), std::move(b)}});
+    };
+    auto add = [&emit_bo](expression a, expression b) {
+        return emit_bo(binary_operator::type::add, std::move(a), std::move(b));
+    };
+    auto sub = [&emit_bo](expression a, expression b) {
+        return emit_bo(binary_operator::type::sub, std::move(a), std::move(b));
+    };
+    auto mul = [&emit_bo](expression a, expression b) {
+        return emit_bo(binary_operator::type::mul, std::move(a), std::move(b));
+    };
+    auto div = [&emit_bo](expression a, expression b) {
+        return emit_bo(binary_operator::type::div, std::move(a), std::move(b));
+    };
+
+    const auto R = expression{radius};
+
+    // The auxiliary quantities of the recursions.
+    const auto r2 = add(add(emit(square(x)), emit(square(y))), emit(square(z)));
+    const auto fac = div(R, r2);
+    const auto x0 = mul(fac, x), y0 = mul(fac, y), z0 = mul(fac, z);
+    const auto rho = mul(R, fac);
+
+    // The solid spherical harmonics V_nm and W_nm, for n <= degree + 1
+    // and m <= min(n, order + 1). W_n0 is always zero and it is not used.
+    std::vector<std::vector<expression>> V(degree + 2u), W(degree + 2u);
+
+    V[0].push_back(div(R, emit(sqrt(r2))));
+    W[0].emplace_back(0.);
+
+    for (std::uint32_t m = 0; m <= order + 1u; ++m) {
+        if (m > 0u) {
+            // The sectorial terms.
+            const auto Vp = V[m - 1u][m - 1u];
+
+            if (m == 1u) {
+                V[1].push_back(mul(x0, Vp));
+                W[1].push_back(mul(y0, Vp));
+            } else {
+                const auto Wp = W[m - 1u][m - 1u];
+                const auto c = expression{2. * m - 1.};
+
+                V[m].push_back(mul(c, sub(mul(x0, Vp), mul(y0, Wp))));
+                W[m].push_back(mul(c, add(mul(x0, Wp), mul(y0, Vp))));
+            }
+        }
+
+        // The other terms of order m.
+        for (auto n = m + 1u; n <= degree + 1u; ++n) {
+            const auto c1 = expression{(2. * n - 1.) / (n - m)};
+            const auto c2 = expression{(n + m - 1.) / (n - m)};
+
+            auto v = mul(c1, mul(z0, V[n - 1u][m]));
+            if (n >= m + 2u) {
+                v = sub(v, mul(c2, mul(rho, V[n - 2u][m])));
+            }
+            V[n].push_back(std::move(v));
+
+            if (m == 0u) {
+                W[n].emplace_back(0.);
+            } else {
+                auto w = mul(c1, mul(z0, W[n - 1u][m]));
+                if (n >= m + 2u) {
+                    w = sub(w, mul(c2, mul(rho, W[n - 2u][m])));
+                }
+                W[n].push_back(std::move(w));
+            }
+        }
+    }
+
+    // Assemble the terms of the acceleration. Each term is the product
+    // of a numerical factor, of a coefficient and of a solid harmonic.
+    std::vector<expression> terms;
+    auto add_term = [&](double f, const expression &coeff, double nf, const expression &h) {
+        if (sph_harm_is_zero(coeff)) {
+            return;
+        }
+
+        if (std::holds_alternative<number>(coeff.value())) {
+            // Fold the coefficient into the numerical factor.
+            terms.push_back(mul(expression{number{f * nf} * std::get<number>(coeff.value())}, h));
+        } else {
+            terms.push_back(mul(expression{f * nf}, mul(coeff, h)));
+        }
+    };
+
+    // NOTE: the coefficients start at index 8 in the arguments.
+    decltype(args().size()) idx = 8;
+    for (std::uint32_t n = 0; n <= degree; ++n) {
+        for (std::uint32_t m = 0; m <= std::min(n, order); ++m, idx += 2u) {
+            assert(idx + 1u < args().size());
+
+            const auto &C = args()[idx], &S = args()[idx + 1u];
+            const auto nf = normalised ? sph_harm_norm_factor(n, m) : 1.;
+
+            if (m == 0u) {
+                switch (comp) {
+                    case 0:
+                        add_term(-1., C, nf, V[n + 1u][1]);
+                        break;
+                    case 1:
+                        add_term(-1., C, nf, W[n + 1u][1]);
+                        break;
+                    default:
+                        add_term(-(n + 1.), C, nf, V[n + 1u][0]);
+                }
+
+                continue;
+            }
+
+            const auto f = 0.5 * (n - m + 2.) * (n - m + 1.);
+
+            switch (comp) {
+                case 0:
+                    add_term(-0.5, C, nf, V[n + 1u][m + 1u]);
+                    add_term(-0.5, S, nf, W[n + 1u][m + 1u]);
+                    add_term(f, C, nf, V[n + 1u][m - 1u]);
+                    if (m > 1u) {
+                        add_term(f, S, nf, W[n + 1u][m - 1u]);
+                    }
+                    break;
+                case 1:
+                    add_term(-0.5, C, nf, W[n + 1u][m + 1u]);
+                    add_term(0.5, S, nf, V[n + 1u][m + 1u]);
+                    if (m > 1u) {
+                        add_term(-f, C, nf, W[n + 1u][m - 1u]);
+                    }
+                    add_term(f, S, nf, V[n + 1u][m - 1u]);
+                    break;
+                default:
+                    add_term(-(n - m + 1.), C, nf, V[n + 1u][m]);
+                    add_term(-(n - m + 1.), S, nf, W[n + 1u][m]);
+            }
+        }
+    }
+
+    if (terms.empty()) {
+        // All the coefficients are zero.
+        terms.push_back(mul(0_dbl, r2));
+    }
+
+    // Sum the terms pairwise.
+    while (terms.size() != 1u) {
+        std::vector<expression> new_terms;
+
+        for (decltype(terms.size()) i = 0; i < terms.size(); i += 2u) {
+            if (i + 1u == terms.size()) {
+                new_terms.push_back(std::move(terms[i]));
+            } else {
+                new_terms.push_back(add(std::move(terms[i]), std::move(terms[i + 1u])));
+            }
+        }
+
+        terms = std::move(new_terms);
+    }
+
+    // Multiply by mu / R**2. The result is the
+    // last u variable in the decomposition.
+    mul(expression{mu / (radius * radius)}, terms[0]);
+
+    return u_vars_defs.size() - 1u;
+}
+
+std::vector<expression> sph_harm_gravity_impl(expression x, expression y, expression z, std::uint32_t degree,
+                                              std::uint32_t order, number mu, number radius,
+                                              std::vector<std::vector<number>> cnm,
+                                              std::vector<std::vector<number>> snm, bool normalised,
+                                              std::uint32_t par_offset)
+{
+    if (order > degree) {
+        throw std::invalid_argument("The order of a spherical harmonics gravity field (" + std::to_string(order)
+                                    + ") cannot be greater than its degree (" + std::to_string(degree) + ")");
+    }
+
+    if (degree > sph_harm_max_degree) {
+        throw std::invalid_argument("The degree of a spherical harmonics gravity field (" + std::to_string(degree)
+                                    + ") cannot be greater than " + std::to_string(sph_harm_max_degree));
+    }
+
+    const auto use_pars = cnm.empty() && snm.empty();
+
+    if (!use_pars) {
+        // Check the coefficient tables.
+        if (cnm.size() <= degree || snm.size() <= degree) {
+            throw std::invalid_argument("The tables of the coefficients of a spherical harmonics gravity field of "
+                                        "degree "
+                                        + std::to_string(degree) + " must contain at least "
+                                        + std::to_string(degree + 1u) + " rows");
+        }
+
+        for (std::uint32_t n = 0; n <= degree; ++n) {
+            if (cnm[n].size() <= std::min(n, order) || snm[n].size() <= std::min(n, order)) {
+                throw std::invalid_argument("The row " + std::to_string(n)
+                                            + " of the tables of the coefficients of a spherical harmonics gravity "
+                                              "field contains too few coefficients");
+            }
+        }
+    }
+
+    // Build the list of arguments.
+    std::vector<expression> args{std::move(x),
+                                 std::move(y),
+                                 std::move(z),
+                                 expression{std::move(mu)},
+                                 expression{std::move(radius)},
+                                 expression{static_cast<double>(degree)},
+                                 expression{static_cast<double>(order)},
+                                 expression{normalised ? 1. : 0.}};
+
+    auto par_idx = par_offset;
+    for (std::uint32_t n = 0; n <= degree; ++n) {
+        for (std::uint32_t m = 0; m <= std::min(n, order); ++m) {
+            if (use_pars) {
+                if (par_idx > std::numeric_limits<std::uint32_t>::max() - 2u) {
+                    throw std::overflow_error("Overflow detected in the computation of the parameter indices of a "
+                                              "spherical harmonics gravity field");
+                }
+
+                args.emplace_back(param{par_idx});
+                args.push_back(m == 0u ? 0_dbl : expression{param{par_idx + 1u}});
+
+                par_idx += 2u;
+            } else {
+                args.emplace_back(cnm[n][m]);
+                args.push_back(m == 0u ? 0_dbl : expression{snm[n][m]});
+            }
+        }
+    }
+
+    std::vector<expression> retval;
+    for (std::uint32_t comp = 0; comp < 3u; ++comp) {
+        retval.emplace_back(func{sph_harm_impl{comp, args}});
+    }
+
+    return retval;
+}
+
+} // namespace detail
+
+} // namespace heyoka
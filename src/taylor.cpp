@@ -14,11 +14,15 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <deque>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <locale>
+#include <map>
+#include <memory>
+#include <new>
 #include <numeric>
 #include <optional>
 #include <ostream>
@@ -34,7 +38,6 @@
 #include <variant>
 #include <vector>
 
-#include <boost/graph/adjacency_list.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 
 #include <fmt/format.h>
@@ -60,6 +63,7 @@
 #include <heyoka/binary_operator.hpp>
 #include <heyoka/detail/llvm_fwd.hpp>
 #include <heyoka/detail/llvm_helpers.hpp>
+#include <heyoka/detail/parallel.hpp>
 #include <heyoka/detail/sleef.hpp>
 #include <heyoka/detail/string_conv.hpp>
 #include <heyoka/detail/type_traits.hpp>
@@ -67,6 +71,7 @@
 #include <heyoka/expression.hpp>
 #include <heyoka/func.hpp>
 #include <heyoka/llvm_state.hpp>
+#include <heyoka/math/lin_comb.hpp>
 #include <heyoka/number.hpp>
 #include <heyoka/param.hpp>
 #include <heyoka/taylor.hpp>
@@ -218,107 +223,273 @@ llvm::Value *taylor_c_diff_numparam_codegen(llvm_state &s, const param &, llvm::
 namespace
 {
 
+// Run the decomposition of the equations in v_ex, appending
+// the definitions of the u variables to u_vars_defs (which,
+// on input, must contain only the definitions of the state
+// variables). The return value contains, for each equation,
+// the index of the u variable representing it (or zero if the
+// equation was not decomposed).
+// NOTE: the equations are split into contiguous blocks which are
+// decomposed in parallel into separate local decompositions. The local
+// decompositions are then renumbered and concatenated in order, so that
+// the end result is identical to the serial decomposition.
+std::vector<std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type>
+taylor_decompose_eqs(std::vector<expression> v_ex,
+                     std::vector<std::pair<expression, std::vector<std::uint32_t>>> &u_vars_defs)
+{
+    using dc_t = std::vector<std::pair<expression, std::vector<std::uint32_t>>>;
+    using idx_t = dc_t::size_type;
+
+    const auto n_eq = u_vars_defs.size();
+
+    std::vector<idx_t> retval(v_ex.size());
+
+    const auto blocks = parallel_split(v_ex.size(), 64);
+    const auto n_blocks = blocks.size() - 1u;
+
+    if (n_blocks == 1u) {
+        // Serial implementation.
+        for (decltype(v_ex.size()) i = 0; i < v_ex.size(); ++i) {
+            retval[i] = taylor_decompose_in_place(std::move(v_ex[i]), u_vars_defs);
+        }
+
+        return retval;
+    }
+
+    // Decompose each block of equations into a local
+    // decomposition beginning with the state variables.
+    std::vector<dc_t> local_dcs(n_blocks);
+    parallel_for(n_blocks, 1, [&](std::size_t b) {
+        auto &ldc = local_dcs[b];
+        ldc.insert(ldc.end(), u_vars_defs.begin(), u_vars_defs.end());
+
+        for (auto i = blocks[b]; i < blocks[b + 1u]; ++i) {
+            retval[i] = taylor_decompose_in_place(std::move(v_ex[i]), ldc);
+        }
+    });
+
+    // Compute the offsets that need to be applied
+    // to the indices of the u variables in each local
+    // decomposition.
+    std::vector<idx_t> offsets(n_blocks);
+    for (decltype(offsets.size()) b = 1; b < n_blocks; ++b) {
+        offsets[b] = offsets[b - 1u] + (local_dcs[b - 1u].size() - n_eq);
+    }
+
+    // Renumber the u variables.
+    parallel_for(n_blocks, 1, [&](std::size_t b) {
+        const auto off = offsets[b];
+        if (off == 0u) {
+            return;
+        }
+
+        auto &ldc = local_dcs[b];
+
+        std::unordered_map<std::string, std::string> repl_map;
+        for (auto j = n_eq; j < ldc.size(); ++j) {
+            repl_map.emplace("u_" + li_to_string(j), "u_" + li_to_string(j + off));
+        }
+
+        for (auto j = n_eq; j < ldc.size(); ++j) {
+            auto &[ex, deps] = ldc[j];
+
+            rename_variables(ex, repl_map);
+
+            for (auto &idx : deps) {
+                if (idx >= n_eq) {
+                    idx = boost::numeric_cast<std::uint32_t>(idx + off);
+                }
+            }
+        }
+
+        // NOTE: a nonzero index means that the
+        // equation was decomposed.
+        for (auto i = blocks[b]; i < blocks[b + 1u]; ++i) {
+            if (retval[i] != 0u) {
+                retval[i] += off;
+            }
+        }
+    });
+
+    // Concatenate the local decompositions.
+    for (auto &ldc : local_dcs) {
+        u_vars_defs.insert(u_vars_defs.end(), std::make_move_iterator(ldc.begin() + static_cast<std::ptrdiff_t>(n_eq)),
+                           std::make_move_iterator(ldc.end()));
+    }
+
+    return retval;
+}
+
+// Helper to determine the indices of the u variables
+// appearing in the definitions of the u variables
+// in the range [n_eq, n_eq + n) of a decomposition.
+// The return value is indexed starting from n_eq.
+std::vector<std::vector<std::uint32_t>>
+taylor_dc_uvar_args(const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc,
+                    std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_eq,
+                    std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n)
+{
+    std::vector<std::vector<std::uint32_t>> retval(n);
+
+    parallel_for(n, 1024, [&](std::size_t i) {
+        for (const auto &var : get_variables(dc[n_eq + i].first)) {
+            retval[i].push_back(uname_to_index(var));
+        }
+    });
+
+    return retval;
+}
+
 // Simplify a Taylor decomposition by removing
 // common subexpressions.
 // NOTE: the hidden deps are not considered for CSE
 // purposes, only the actual subexpressions.
+// NOTE: the u variables are processed in layers of
+// increasing depth in the dependency graph, so that
+// the renaming of all the u variables within a layer can be
+// performed in parallel. Within each layer, the expressions are
+// inserted into the expression -> index map in index order, so that
+// the result is the same as in a serial left-to-right scan.
+// NOTE: n_tail is the number of entries at the end of the
+// decomposition which are not definitions of u variables (i.e., the
+// derivatives of the state variables, possibly followed by the
+// functions of the state variables, see taylor_decompose()).
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_decompose_cse(std::vector<std::pair<expression, std::vector<std::uint32_t>>> &v_ex,
-                     std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_eq)
+                     std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_eq,
+                     std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_tail)
 {
     using idx_t = std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type;
 
     // A Taylor decomposition is supposed
     // to have n_eq variables at the beginning,
-    // n_eq variables at the end and possibly
+    // n_tail entries at the end and possibly
     // extra variables in the middle.
-    assert(v_ex.size() >= n_eq * 2u);
+    assert(v_ex.size() >= n_eq + n_tail);
+
+    // Total number of u variables.
+    const auto n_uvars = v_ex.size() - n_tail;
+
+    // Determine the u variables appearing
+    // in the definitions of the u variables
+    // which do not correspond to state variables.
+    const auto uvar_args = taylor_dc_uvar_args(v_ex, n_eq, n_uvars - n_eq);
+
+    // Group the u variables in layers. The state
+    // variables are at depth zero, the depth of all other
+    // u variables is one plus the max depth of their arguments.
+    std::vector<idx_t> depth(n_uvars);
+    std::vector<std::vector<idx_t>> layers;
+    for (auto i = n_eq; i < n_uvars; ++i) {
+        idx_t d = 0;
+        for (auto idx : uvar_args[i - n_eq]) {
+            assert(idx < i);
+            d = std::max(d, depth[idx]);
+        }
+        depth[i] = d + 1u;
 
-    // Init the return value.
-    std::vector<std::pair<expression, std::vector<std::uint32_t>>> retval;
+        if (layers.size() < depth[i]) {
+            layers.resize(depth[i]);
+        }
+        layers[depth[i] - 1u].push_back(i);
+    }
+
+    // Representatives: for each u variable, the index
+    // of the first u variable with an identical definition.
+    std::vector<idx_t> rep(n_uvars);
+    std::iota(rep.begin(), rep.end(), idx_t(0));
 
     // expression -> idx map. This will end up containing
     // all the unique expressions from v_ex, and it will
-    // map them to their indices in retval (which will
-    // in general differ from their indices in v_ex).
+    // map them to the index of their representative.
     std::unordered_map<expression, idx_t> ex_map;
 
-    // Map for the renaming of u variables
-    // in the expressions.
+    // Map for the renaming of the redundant u variables
+    // into their representatives.
     std::unordered_map<std::string, std::string> uvars_rename;
 
+    for (const auto &layer : layers) {
+        // Rename the u variables in the current layer.
+        // NOTE: uvars_rename is read-only here.
+        parallel_for(layer.size(), 1024, [&](std::size_t j) { rename_variables(v_ex[layer[j]].first, uvars_rename); });
+
+        for (auto i : layer) {
+            if (const auto [it, inserted] = ex_map.try_emplace(v_ex[i].first, i); !inserted) {
+                // ex is redundant. Remap the variable name 'u_i' to
+                // the name of the representative.
+                rep[i] = it->second;
+
+                [[maybe_unused]] const auto res
+                    = uvars_rename.emplace("u_" + li_to_string(i), "u_" + li_to_string(it->second));
+                assert(res.second);
+            }
+        }
+    }
+
+    // Init the return value. Alongside, compute the indices
+    // of the u variables in the simplified decomposition.
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> retval;
+    std::vector<idx_t> new_idx(n_uvars);
+
     // The first n_eq definitions are just renaming
     // of the state variables into u variables.
     for (idx_t i = 0; i < n_eq; ++i) {
         assert(std::holds_alternative<variable>(v_ex[i].first.value()));
         // NOTE: no hidden deps allowed here.
         assert(v_ex[i].second.empty());
+        new_idx[i] = i;
         retval.push_back(std::move(v_ex[i]));
     }
 
     // Handle the u variables which do not correspond to state variables.
-    for (auto i = n_eq; i < v_ex.size() - n_eq; ++i) {
-        auto &[ex, deps] = v_ex[i];
-
-        // Rename the u variables in ex.
-        rename_variables(ex, uvars_rename);
-
-        if (auto it = ex_map.find(ex); it == ex_map.end()) {
-            // This is the first occurrence of ex in the
-            // decomposition. Add it to retval.
-            retval.emplace_back(ex, std::move(deps));
-
-            // Add ex to ex_map, mapping it to
-            // the index it corresponds to in retval
-            // (let's call it j).
-            ex_map.emplace(std::move(ex), retval.size() - 1u);
-
-            // Update uvars_rename. This will ensure that
-            // occurrences of the variable 'u_i' in the next
-            // elements of v_ex will be renamed to 'u_j'.
-            [[maybe_unused]] const auto res
-                = uvars_rename.emplace("u_" + li_to_string(i), "u_" + li_to_string(retval.size() - 1u));
-            assert(res.second);
+    for (auto i = n_eq; i < n_uvars; ++i) {
+        if (rep[i] == i) {
+            new_idx[i] = retval.size();
+            retval.push_back(std::move(v_ex[i]));
         } else {
-            // ex is redundant. This means
-            // that it already appears in retval at index
-            // it->second. Don't add anything to retval,
-            // and remap the variable name 'u_i' to
-            // 'u_{it->second}'.
-            [[maybe_unused]] const auto res
-                = uvars_rename.emplace("u_" + li_to_string(i), "u_" + li_to_string(it->second));
-            assert(res.second);
+            assert(rep[i] < i);
+            new_idx[i] = new_idx[rep[i]];
         }
     }
 
-    // Handle the derivatives of the state variables at the
-    // end of the decomposition. We just need to ensure that
-    // the u variables in their definitions are renamed with
-    // the new indices.
-    for (auto i = v_ex.size() - n_eq; i < v_ex.size(); ++i) {
-        auto &[ex, deps] = v_ex[i];
-
+    // Handle the derivatives of the state variables (and the functions
+    // of the state variables) at the end of the decomposition.
+    for (auto i = n_uvars; i < v_ex.size(); ++i) {
         // NOTE: here we expect only vars, numbers or params,
         // and no hidden dependencies.
-        assert(std::holds_alternative<variable>(ex.value()) || std::holds_alternative<number>(ex.value())
-               || std::holds_alternative<param>(ex.value()));
-        assert(deps.empty());
+        assert(std::holds_alternative<variable>(v_ex[i].first.value())
+               || std::holds_alternative<number>(v_ex[i].first.value())
+               || std::holds_alternative<param>(v_ex[i].first.value()));
+        assert(v_ex[i].second.empty());
 
-        rename_variables(ex, uvars_rename);
+        retval.push_back(std::move(v_ex[i]));
+    }
 
-        retval.emplace_back(std::move(ex), std::move(deps));
+    // Build the map for the final renaming of the u variables.
+    // NOTE: the definitions of the unique u variables refer
+    // to the original indices of the representatives, while the
+    // derivatives of the state variables refer to the original
+    // indices of arbitrary u variables. In both cases, the new
+    // index is new_idx[idx].
+    std::unordered_map<std::string, std::string> uvars_final_rename;
+    for (auto i = n_eq; i < n_uvars; ++i) {
+        if (new_idx[i] != i) {
+            uvars_final_rename.emplace("u_" + li_to_string(i), "u_" + li_to_string(new_idx[i]));
+        }
     }
 
-    // The last step is to re-adjust all indices
-    // in the hidden dependencies in order to account
-    // for the renaming of the uvars.
-    for (auto &[_, deps] : retval) {
+    // Do the final renaming, and re-adjust all indices
+    // in the hidden dependencies.
+    parallel_for(retval.size() - n_eq, 1024, [&](std::size_t j) {
+        auto &[ex, deps] = retval[n_eq + j];
+
+        rename_variables(ex, uvars_final_rename);
+
         for (auto &idx : deps) {
-            auto it = uvars_rename.find("u_" + li_to_string(idx));
-            assert(it != uvars_rename.end());
-            idx = uname_to_index(it->second);
+            assert(idx >= n_eq && idx < n_uvars);
+            idx = static_cast<std::uint32_t>(new_idx[idx]);
         }
-    }
+    });
 
     return retval;
 }
@@ -336,80 +507,69 @@ taylor_decompose_cse(std::vector<std::pair<expression, std::vector<std::uint32_t
 // expressions which are dependent on each other. By doing another topological
 // sort, this time based on breadth-first search, we determine another valid
 // sorting in which independent operations tend to be clustered together.
+// NOTE: n_tail has the same meaning as in taylor_decompose_cse().
 auto taylor_sort_dc(std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc,
-                    std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_eq)
+                    std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_eq,
+                    std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_tail)
 {
     // A Taylor decomposition is supposed
     // to have n_eq variables at the beginning,
-    // n_eq variables at the end and possibly
+    // n_tail entries at the end and possibly
     // extra variables in the middle
-    assert(dc.size() >= n_eq * 2u);
-
-    // The graph type that we will use for the topological sorting.
-    using graph_t = boost::adjacency_list<boost::vecS,           // std::vector for list of adjacent vertices
-                                          boost::vecS,           // std::vector for the list of vertices
-                                          boost::bidirectionalS, // directed graph with efficient access
-                                                                 // to in-edges
-                                          boost::no_property,    // no vertex properties
-                                          boost::no_property,    // no edge properties
-                                          boost::no_property,    // no graph properties
-                                          boost::listS           // std::list for of the graph's edge list
-                                          >;
-
-    graph_t g;
-
-    // Add the root node.
-    const auto root_v = boost::add_vertex(g);
-
-    // Add the nodes corresponding to the state variables.
+    assert(dc.size() >= n_eq + n_tail);
+
+    // Number of vertices in the graph: the root
+    // node plus all the u variables.
+    const auto n_vertices = dc.size() - n_tail + 1u;
+
+    // Determine (in parallel) the u variables appearing
+    // in the definitions of the u variables.
+    const auto uvar_args = taylor_dc_uvar_args(dc, n_eq, dc.size() - n_eq - n_tail);
+
+    // Build the graph in compressed form. The graph is stored
+    // as a list of out-edges for each vertex, and the number
+    // of in-edges for each vertex. Vertex 0 is the root node,
+    // the i-th vertex corresponds to the (i-1)-th u variable.
+    // NOTE: the out-edges are added in increasing order
+    // of the target vertex.
+    std::vector<std::vector<decltype(dc.size())>> out_edges(n_vertices);
+    std::vector<decltype(dc.size())> in_degree(n_vertices);
+
+    // The state variables depend on the root node.
     for (decltype(n_eq) i = 0; i < n_eq; ++i) {
-        auto v = boost::add_vertex(g);
-
-        // Add a dependency on the root node.
-        boost::add_edge(root_v, v, g);
+        out_edges[0].push_back(i + 1u);
+        ++in_degree[i + 1u];
     }
 
     // Add the rest of the u variables.
-    for (decltype(n_eq) i = n_eq; i < dc.size() - n_eq; ++i) {
-        auto v = boost::add_vertex(g);
+    for (decltype(n_eq) i = n_eq; i < dc.size() - n_tail; ++i) {
+        const auto v = i + 1u;
+        const auto &args = uvar_args[i - n_eq];
 
-        // Fetch the list of variables in the current expression.
-        const auto vars = get_variables(dc[i].first);
-
-        if (vars.empty()) {
+        if (args.empty()) {
             // The current expression does not contain
             // any variable: make it depend on the root
             // node. This means that in the topological
             // sort below, the current u var will appear
             // immediately after the state variables.
-            boost::add_edge(root_v, v, g);
+            out_edges[0].push_back(v);
+            ++in_degree[v];
         } else {
             // Mark the current u variable as depending on all the
             // variables in the current expression.
-            for (const auto &var : vars) {
-                // Extract the index.
-                const auto idx = uname_to_index(var);
-
-                // Add the dependency.
-                // NOTE: add +1 because the i-th vertex
-                // corresponds to the (i-1)-th u variable
-                // due to the presence of the root node.
-                boost::add_edge(boost::vertex(idx + 1u, g), v, g);
+            for (auto idx : args) {
+                out_edges[idx + 1u].push_back(v);
+                ++in_degree[v];
             }
         }
     }
 
-    assert(boost::num_vertices(g) - 1u == dc.size() - n_eq);
-
     // Run the BF topological sort on the graph. This is Kahn's algorithm:
     // https://en.wikipedia.org/wiki/Topological_sorting
 
     // The result of the sort.
     std::vector<decltype(dc.size())> v_idx;
 
-    // Temp variable used to sort a list of edges in the loop below.
-    std::vector<boost::graph_traits<graph_t>::edge_descriptor> tmp_edges;
-
     // The set of all nodes with no incoming edge.
     std::deque<decltype(dc.size())> tmp;
     // The root node has no incoming edge.
@@ -423,68 +583,55 @@ auto taylor_sort_dc(std::vector<std::pair<expression, std::vector<std::uint32_t>
         tmp.pop_front();
         v_idx.push_back(v);
 
-        // Fetch all the out edges of v and sort them according
-        // to the target vertex.
-        // NOTE: the sorting is important to ensure that all the state
-        // variables are insered into v_idx in the correct order.
-        const auto e_range = boost::out_edges(v, g);
-        tmp_edges.assign(e_range.first, e_range.second);
-        std::sort(tmp_edges.begin(), tmp_edges.end(),
-                  [&g](const auto &e1, const auto &e2) { return boost::target(e1, g) < boost::target(e2, g); });
-
-        // For each out edge of v:
+        // For each out edge of v (sorted according to the target
+        // vertex, which is important to ensure that all the state
+        // variables are insered into v_idx in the correct order):
         // - eliminate it;
         // - check if the target vertex of the edge
         //   has other incoming edges;
         // - if it does not, insert it into tmp.
-        for (auto &e : tmp_edges) {
-            // Fetch the target of the edge.
-            const auto t = boost::target(e, g);
+        for (auto t : out_edges[v]) {
+            assert(in_degree[t] > 0u);
 
-            // Remove the edge.
-            boost::remove_edge(e, g);
-
-            // Get the range of vertices connecting to t.
-            const auto iav = boost::inv_adjacent_vertices(t, g);
-
-            if (iav.first == iav.second) {
-                // t does not have any incoming edges, add it to tmp.
+            if (--in_degree[t] == 0u) {
                 tmp.push_back(t);
             }
         }
     }
 
-    assert(v_idx.size() == boost::num_vertices(g));
-    assert(boost::num_edges(g) == 0u);
+    assert(v_idx.size() == n_vertices);
 
     // Adjust v_idx: remove the index of the root node,
     // decrease by one all other indices, insert the final
-    // n_eq indices.
+    // n_tail indices.
     for (decltype(v_idx.size()) i = 0; i < v_idx.size() - 1u; ++i) {
         v_idx[i] = v_idx[i + 1u] - 1u;
     }
     v_idx.resize(boost::numeric_cast<decltype(v_idx.size())>(dc.size()));
-    std::iota(v_idx.data() + dc.size() - n_eq, v_idx.data() + dc.size(), dc.size() - n_eq);
+    std::iota(v_idx.data() + dc.size() - n_tail, v_idx.data() + dc.size(), dc.size() - n_tail);
 
-    // Create the remapping dictionary.
+    // Create the remapping dictionaries.
     std::unordered_map<std::string, std::string> remap;
-    for (decltype(v_idx.size()) i = n_eq; i < v_idx.size() - n_eq; ++i) {
+    std::vector<std::uint32_t> remap_idx(dc.size() - n_tail);
+    for (decltype(v_idx.size()) i = n_eq; i < v_idx.size() - n_tail; ++i) {
         [[maybe_unused]] const auto res = remap.emplace("u_" + li_to_string(v_idx[i]), "u_" + li_to_string(i));
         assert(res.second);
+        remap_idx[v_idx[i]] = boost::numeric_cast<std::uint32_t>(i);
     }
 
     // Do the remap.
-    for (auto it = dc.data() + n_eq; it != dc.data() + dc.size(); ++it) {
+    parallel_for(dc.size() - n_eq, 1024, [&](std::size_t j) {
+        auto &[ex, deps] = dc[n_eq + j];
+
         // Remap the expression.
-        rename_variables(it->first, remap);
+        rename_variables(ex, remap);
 
         // Remap the hidden dependencies.
-        for (auto &idx : it->second) {
-            auto it_remap = remap.find("u_" + li_to_string(idx));
-            assert(it_remap != remap.end());
-            idx = uname_to_index(it_remap->second);
+        for (auto &idx : deps) {
+            assert(idx >= n_eq && idx < dc.size() - n_tail);
+            idx = remap_idx[idx];
         }
-    }
+    });
 
     // Reorder the decomposition.
     std::vector<std::pair<expression, std::vector<std::uint32_t>>> retval;
@@ -495,17 +642,311 @@ auto taylor_sort_dc(std::vector<std::pair<expression, std::vector<std::uint32_t>
     return retval;
 }
 
+// Deduce the state variables of a system of equations
+// in which the left-hand sides are implicit. The variables
+// are returned in alphabetical order.
+std::vector<std::string> taylor_deduce_vars(const std::vector<expression> &v_ex)
+{
+    if (v_ex.empty()) {
+        throw std::invalid_argument("Cannot decompose a system of zero equations");
+    }
+
+    std::vector<std::string> vars;
+    for (const auto &ex : v_ex) {
+        auto ex_vars = get_variables(ex);
+        vars.insert(vars.end(), std::make_move_iterator(ex_vars.begin()), std::make_move_iterator(ex_vars.end()));
+        std::sort(vars.begin(), vars.end());
+        vars.erase(std::unique(vars.begin(), vars.end()), vars.end());
+    }
+
+    if (vars.size() != v_ex.size()) {
+        throw std::invalid_argument("The number of deduced variables for a Taylor decomposition ("
+                                    + std::to_string(vars.size()) + ") differs from the number of equations ("
+                                    + std::to_string(v_ex.size()) + ")");
+    }
+
+    return vars;
+}
+
+// Minimum number of variables in a linear right-hand side
+// for it to be turned into a linear combination.
+constexpr std::size_t taylor_lin_comb_min_vars = 3;
+
+// The scale factor of a subexpression of a linear form: a number,
+// possibly multiplied by the param with the given index.
+using taylor_lin_scale_t = std::pair<number, std::optional<std::uint32_t>>;
+
+// The key of a term of a linear form: the name of the variable (none
+// for the constant terms) and the index of the param multiplying
+// the variable (none for numerical coefficients).
+using taylor_lin_key_t = std::pair<std::optional<std::string>, std::optional<std::uint32_t>>;
+
+// The terms of a linear form, in order of first appearance, each
+// with the numerical factor multiplying it. terms_idx maps the keys
+// of the terms to their positions in terms.
+using taylor_lin_terms_t = std::vector<std::pair<taylor_lin_key_t, number>>;
+using taylor_lin_terms_idx_t = std::map<taylor_lin_key_t, taylor_lin_terms_t::size_type>;
+
+void taylor_lin_accumulate(taylor_lin_key_t key, const number &c, taylor_lin_terms_t &terms,
+                           taylor_lin_terms_idx_t &terms_idx)
+{
+    if (auto it = terms_idx.find(key); it == terms_idx.end()) {
+        terms_idx.emplace(key, terms.size());
+        terms.emplace_back(std::move(key), c);
+    } else {
+        terms[it->second].second = terms[it->second].second + c;
+    }
+}
+
+// Helper to multiply f by ex, if ex is a product of numbers and
+// of at most one param (including the param possibly already in f).
+// The return value is false (and f is left in an unspecified state) otherwise.
+bool taylor_lin_factor(const expression &ex, taylor_lin_scale_t &f)
+{
+    return std::visit(
+        [&f](const auto &v) -> bool {
+            using type = uncvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<type, number>) {
+                f.first = f.first * v;
+
+                return true;
+            } else if constexpr (std::is_same_v<type, param>) {
+                if (f.second) {
+                    return false;
+                }
+
+                f.second = v.idx();
+
+                return true;
+            } else if constexpr (std::is_same_v<type, binary_operator>) {
+                switch (v.op()) {
+                    case binary_operator::type::mul:
+                        return taylor_lin_factor(v.lhs(), f) && taylor_lin_factor(v.rhs(), f);
+                    case binary_operator::type::div:
+                        if (const auto *n_rhs = std::get_if<number>(&v.rhs().value());
+                            n_rhs != nullptr && taylor_lin_factor(v.lhs(), f)) {
+                            f.first = f.first / *n_rhs;
+
+                            return true;
+                        }
+                        return false;
+                    default:
+                        return false;
+                }
+            } else {
+                return false;
+            }
+        },
+        ex.value());
+}
+
+// Helper to accumulate into terms the expression scale * ex, if ex is a
+// linear combination of variables and of a constant, whose coefficients are
+// products of numbers and of at most one param.
+// The return value is false if ex is not linear.
+bool taylor_linear_form(const expression &ex, const taylor_lin_scale_t &scale, taylor_lin_terms_t &terms,
+                        taylor_lin_terms_idx_t &terms_idx)
+{
+    return std::visit(
+        [&](const auto &v) -> bool {
+            using type = uncvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<type, number>) {
+                taylor_lin_accumulate({std::nullopt, scale.second}, scale.first * v, terms, terms_idx);
+
+                return true;
+            } else if constexpr (std::is_same_v<type, param>) {
+                if (scale.second) {
+                    return false;
+                }
+
+                taylor_lin_accumulate({std::nullopt, v.idx()}, scale.first, terms, terms_idx);
+
+                return true;
+            } else if constexpr (std::is_same_v<type, variable>) {
+                taylor_lin_accumulate({v.name(), scale.second}, scale.first, terms, terms_idx);
+
+                return true;
+            } else if constexpr (std::is_same_v<type, binary_operator>) {
+                switch (v.op()) {
+                    case binary_operator::type::add:
+                        return taylor_linear_form(v.lhs(), scale, terms, terms_idx)
+                               && taylor_linear_form(v.rhs(), scale, terms, terms_idx);
+                    case binary_operator::type::sub:
+                        return taylor_linear_form(v.lhs(), scale, terms, terms_idx)
+                               && taylor_linear_form(v.rhs(), {-scale.first, scale.second}, terms, terms_idx);
+                    case binary_operator::type::mul: {
+                        // NOTE: one of the two operands must be a constant factor.
+                        auto f = scale;
+                        if (taylor_lin_factor(v.lhs(), f)) {
+                            return taylor_linear_form(v.rhs(), f, terms, terms_idx);
+                        }
+
+                        f = scale;
+                        if (taylor_lin_factor(v.rhs(), f)) {
+                            return taylor_linear_form(v.lhs(), f, terms, terms_idx);
+                        }
+
+                        return false;
+                    }
+                    default:
+                        if (const auto *n_rhs = std::get_if<number>(&v.rhs().value())) {
+                            return taylor_linear_form(v.lhs(), {scale.first / *n_rhs, scale.second}, terms,
+                                                      terms_idx);
+                        }
+                        return false;
+                }
+            } else {
+                return false;
+            }
+        },
+        ex.value());
+}
+
+// Helper to turn the right-hand side of an equation into a linear combination,
+// if it is linear in the variables and it contains at least taylor_lin_comb_min_vars
+// variables. The coefficients of the variables must be either numbers or single params
+// (e.g., par[0] * x is accepted, while 2. * par[0] * x is not).
+// NOTE: in the standard decomposition, a linear right-hand side with n
+// variables results in up to 2n - 1 u variables (n multiplications and n - 1 additions),
+// whose derivatives are computed and stored separately. A linear combination
+// is instead represented by a single u variable, whose derivatives are computed
+// as a pairwise sum of products reading the derivatives of the variables directly.
+void taylor_rewrite_linear(expression &ex)
+{
+    taylor_lin_terms_t terms;
+    taylor_lin_terms_idx_t terms_idx;
+
+    if (!taylor_linear_form(ex, {number{1.}, std::nullopt}, terms, terms_idx)) {
+        return;
+    }
+
+    // NOTE: the constant terms are put at the end.
+    std::vector<std::pair<expression, expression>> lc, lc_cst;
+    for (auto &[key, c] : terms) {
+        // NOTE: skip the terms which cancelled out.
+        if (is_zero(c)) {
+            continue;
+        }
+
+        auto &[var, par_idx] = key;
+
+        if (var) {
+            if (par_idx) {
+                // NOTE: a param coefficient cannot be
+                // multiplied by a number in a linear combination.
+                if (!is_one(c)) {
+                    return;
+                }
+
+                lc.emplace_back(expression{param{*par_idx}}, expression{variable{std::move(*var)}});
+            } else {
+                lc.emplace_back(expression{std::move(c)}, expression{variable{std::move(*var)}});
+            }
+        } else if (par_idx) {
+            lc_cst.emplace_back(expression{param{*par_idx}}, expression{std::move(c)});
+        } else {
+            lc_cst.emplace_back(expression{std::move(c)}, 1_dbl);
+        }
+    }
+
+    if (lc.size() < taylor_lin_comb_min_vars) {
+        return;
+    }
+
+    lc.insert(lc.end(), std::make_move_iterator(lc_cst.begin()), std::make_move_iterator(lc_cst.end()));
+
+    ex = lin_comb(std::move(lc));
+}
+
 #if !defined(NDEBUG)
 
-// Helper to verify a Taylor decomposition.
+// Helper to check that the expression ex, reconstructed from
+// a Taylor decomposition, is the linear combination into which
+// the original expression orig was rewritten by taylor_rewrite_linear().
+bool taylor_lin_equivalent(const expression &ex, const expression &orig)
+{
+    const auto *fptr = std::get_if<func>(&ex.value());
+    if (fptr == nullptr || fptr->get_name() != "lin_comb") {
+        return false;
+    }
+
+    // Expand the linear combination into a sum of products.
+    // NOTE: the binary operators are created directly in
+    // order to prevent any simplification.
+    const auto &args = fptr->args();
+    assert(args.size() % 2u == 0u);
+
+    std::optional<expression> sum;
+    for (decltype(args.size()) i = 0; i < args.size(); i += 2u) {
+        expression prod{binary_operator{binary_operator::type::mul, args[i], args[i + 1u]}};
+
+        sum = sum ? expression{binary_operator{binary_operator::type::add, std::move(*sum), std::move(prod)}}
+                  : std::move(prod);
+    }
+
+    // Compare the nonzero coefficients of the linear forms.
+    auto coeffs = [](const expression &e) {
+        taylor_lin_terms_t terms;
+        taylor_lin_terms_idx_t terms_idx;
+
+        [[maybe_unused]] const auto ret = taylor_linear_form(e, {number{1.}, std::nullopt}, terms, terms_idx);
+        assert(ret);
+
+        std::map<taylor_lin_key_t, number> retval;
+        for (auto &[key, c] : terms) {
+            if (!is_zero(c)) {
+                retval.emplace(std::move(key), std::move(c));
+            }
+        }
+
+        return retval;
+    };
+
+    return sum && coeffs(*sum) == coeffs(orig);
+}
+
+// Helper to detect if ex contains spherical harmonics gravity fields.
+// NOTE: the Taylor decomposition of these functions consists of a recursion
+// of elementary operations (rather than of the function itself applied to
+// u variables), hence the original expression cannot be reconstructed
+// from the decomposition. Moreover, the size of the expansion
+// of the recursion grows exponentially with the degree.
+bool taylor_has_sph_harm(const expression &ex)
+{
+    return std::visit(
+        [](const auto &v) -> bool {
+            using type = uncvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<type, func>) {
+                if (v.get_name().rfind("sph_harm_gravity_", 0) == 0) {
+                    return true;
+                }
+
+                return std::any_of(v.args().begin(), v.args().end(),
+                                   [](const auto &arg) { return taylor_has_sph_harm(arg); });
+            } else if constexpr (std::is_same_v<type, binary_operator>) {
+                return taylor_has_sph_harm(v.lhs()) || taylor_has_sph_harm(v.rhs());
+            } else {
+                return false;
+            }
+        },
+        ex.value());
+}
+
+// Helper to verify a Taylor decomposition. orig contains
+// the expressions corresponding to the entries at the end
+// of the decomposition, n_eq is the number of state variables.
 void verify_taylor_dec(const std::vector<expression> &orig,
-                       const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc)
+                       const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc,
+                       std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type n_eq)
 {
     using idx_t = std::vector<std::pair<expression, std::vector<std::uint32_t>>>::size_type;
 
-    const auto n_eq = orig.size();
+    const auto n_tail = orig.size();
 
-    assert(dc.size() >= n_eq * 2u);
+    assert(dc.size() >= n_eq + n_tail);
 
     // The first n_eq expressions of u variables
     // must be just variables. No hidden dependencies
@@ -515,13 +956,13 @@ void verify_taylor_dec(const std::vector<expression> &orig,
         assert(dc[i].second.empty());
     }
 
-    // From n_eq to dc.size() - n_eq, the expressions
+    // From n_eq to dc.size() - n_tail, the expressions
     // must be binary operators or functions whose arguments
     // are either variables in the u_n form,
     // where n < i, or numbers/params.
     // The hidden dependencies must contain indices
-    // only in the [n_eq, dc.size() - n_eq) range.
-    for (auto i = n_eq; i < dc.size() - n_eq; ++i) {
+    // only in the [n_eq, dc.size() - n_tail) range.
+    for (auto i = n_eq; i < dc.size() - n_tail; ++i) {
         std::visit(
             [i](const auto &v) {
                 using type = detail::uncvref_t<decltype(v)>;
@@ -548,17 +989,17 @@ void verify_taylor_dec(const std::vector<expression> &orig,
 
         for (auto idx : dc[i].second) {
             assert(idx >= n_eq);
-            assert(idx < dc.size() - n_eq);
+            assert(idx < dc.size() - n_tail);
 
             // Hidden dep onto itself does not make any sense.
             assert(idx != i);
         }
     }
 
-    // From dc.size() - n_eq to dc.size(), the expressions
+    // From dc.size() - n_tail to dc.size(), the expressions
     // must be either variables in the u_n form, where n < i,
     // or numbers/params.
-    for (auto i = dc.size() - n_eq; i < dc.size(); ++i) {
+    for (auto i = dc.size() - n_tail; i < dc.size(); ++i) {
         std::visit(
             [i](const auto &v) {
                 using type = detail::uncvref_t<decltype(v)>;
@@ -576,19 +1017,30 @@ void verify_taylor_dec(const std::vector<expression> &orig,
         assert(dc[i].second.empty());
     }
 
+    // NOTE: skip the reconstruction of the original
+    // expressions if it is not possible (see above).
+    if (std::any_of(orig.begin(), orig.end(), [](const auto &ex) { return taylor_has_sph_harm(ex); })) {
+        return;
+    }
+
     std::unordered_map<std::string, expression> subs_map;
 
     // For each u variable, expand its definition
     // in terms of state variables or other u variables,
     // and store it in subs_map.
-    for (idx_t i = 0; i < dc.size() - n_eq; ++i) {
+    for (idx_t i = 0; i < dc.size() - n_tail; ++i) {
         subs_map.emplace("u_" + li_to_string(i), subs(dc[i].first, subs_map));
     }
 
     // Reconstruct the right-hand sides of the system
     // and compare them to the original ones.
-    for (auto i = dc.size() - n_eq; i < dc.size(); ++i) {
-        assert(subs(dc[i].first, subs_map) == orig[i - (dc.size() - n_eq)]);
+    for (auto i = dc.size() - n_tail; i < dc.size(); ++i) {
+        const auto rec = subs(dc[i].first, subs_map);
+        const auto &orig_ex = orig[i - (dc.size() - n_tail)];
+
+        // NOTE: the linear right-hand sides have been
+        // rewritten as linear combinations.
+        assert(rec == orig_ex || taylor_lin_equivalent(rec, orig_ex));
     }
 }
 
@@ -611,24 +1063,8 @@ void verify_taylor_dec(const std::vector<expression> &orig,
 // of a u variable depends only on numbers/params.
 std::vector<std::pair<expression, std::vector<std::uint32_t>>> taylor_decompose(std::vector<expression> v_ex)
 {
-    if (v_ex.empty()) {
-        throw std::invalid_argument("Cannot decompose a system of zero equations");
-    }
-
     // Determine the variables in the system of equations.
-    std::vector<std::string> vars;
-    for (const auto &ex : v_ex) {
-        auto ex_vars = get_variables(ex);
-        vars.insert(vars.end(), std::make_move_iterator(ex_vars.begin()), std::make_move_iterator(ex_vars.end()));
-        std::sort(vars.begin(), vars.end());
-        vars.erase(std::unique(vars.begin(), vars.end()), vars.end());
-    }
-
-    if (vars.size() != v_ex.size()) {
-        throw std::invalid_argument("The number of deduced variables for a Taylor decomposition ("
-                                    + std::to_string(vars.size()) + ") differs from the number of equations ("
-                                    + std::to_string(v_ex.size()) + ")");
-    }
+    const auto vars = detail::taylor_deduce_vars(v_ex);
 
     // Cache the number of equations/variables
     // for later use.
@@ -647,6 +1083,11 @@ std::vector<std::pair<expression, std::vector<std::uint32_t>>> taylor_decompose(
     const auto orig_v_ex = v_ex;
 #endif
 
+    // Turn the linear right-hand sides into linear combinations.
+    for (auto &ex : v_ex) {
+        detail::taylor_rewrite_linear(ex);
+    }
+
     // Rename the variables in the original equations.
     for (auto &ex : v_ex) {
         rename_variables(ex, repl_map);
@@ -665,16 +1106,17 @@ std::vector<std::pair<expression, std::vector<std::uint32_t>>> taylor_decompose(
     auto v_ex_copy = v_ex;
 
     // Run the decomposition on each equation.
-    for (decltype(v_ex.size()) i = 0; i < v_ex.size(); ++i) {
-        // Decompose the current equation.
-        if (const auto dres = taylor_decompose_in_place(std::move(v_ex[i]), u_vars_defs)) {
+    const auto dres = detail::taylor_decompose_eqs(std::move(v_ex), u_vars_defs);
+
+    for (decltype(dres.size()) i = 0; i < dres.size(); ++i) {
+        if (dres[i] != 0u) {
             // NOTE: if the equation was decomposed
             // (that is, it is not constant or a single variable),
             // we have to update the original definition
             // of the equation in v_ex_copy
             // so that it points to the u variable
             // that now represents it.
-            v_ex_copy[i] = expression{variable{"u_" + detail::li_to_string(dres)}};
+            v_ex_copy[i] = expression{variable{"u_" + detail::li_to_string(dres[i])}};
         }
     }
 
@@ -686,22 +1128,22 @@ std::vector<std::pair<expression, std::vector<std::uint32_t>>> taylor_decompose(
 
 #if !defined(NDEBUG)
     // Verify the decomposition.
-    detail::verify_taylor_dec(orig_v_ex, u_vars_defs);
+    detail::verify_taylor_dec(orig_v_ex, u_vars_defs, n_eq);
 #endif
 
     // Simplify the decomposition.
-    u_vars_defs = detail::taylor_decompose_cse(u_vars_defs, n_eq);
+    u_vars_defs = detail::taylor_decompose_cse(u_vars_defs, n_eq, n_eq);
 
 #if !defined(NDEBUG)
     // Verify the simplified decomposition.
-    detail::verify_taylor_dec(orig_v_ex, u_vars_defs);
+    detail::verify_taylor_dec(orig_v_ex, u_vars_defs, n_eq);
 #endif
 
-    u_vars_defs = detail::taylor_sort_dc(u_vars_defs, n_eq);
+    u_vars_defs = detail::taylor_sort_dc(u_vars_defs, n_eq, n_eq);
 
 #if !defined(NDEBUG)
     // Verify the reordered decomposition.
-    detail::verify_taylor_dec(orig_v_ex, u_vars_defs);
+    detail::verify_taylor_dec(orig_v_ex, u_vars_defs, n_eq);
 #endif
 
     return u_vars_defs;
@@ -711,6 +1153,35 @@ std::vector<std::pair<expression, std::vector<std::uint32_t>>> taylor_decompose(
 // of a system of equations.
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_decompose(std::vector<std::pair<expression, expression>> sys)
+{
+    return taylor_decompose(std::move(sys), std::vector<expression>{}).first;
+}
+
+// Taylor decomposition with automatic deduction of variables,
+// including functions of the state variables.
+std::pair<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>>
+taylor_decompose(std::vector<expression> v_ex, std::vector<expression> sv_funcs)
+{
+    const auto vars = detail::taylor_deduce_vars(v_ex);
+
+    // NOTE: the variables are renamed in alphabetical order,
+    // which corresponds to writing the system in explicit
+    // form with the lhs variables sorted alphabetically.
+    std::vector<std::pair<expression, expression>> sys;
+    for (decltype(vars.size()) i = 0; i < vars.size(); ++i) {
+        sys.emplace_back(variable{vars[i]}, std::move(v_ex[i]));
+    }
+
+    return taylor_decompose(std::move(sys), std::move(sv_funcs));
+}
+
+// Taylor decomposition from lhs and rhs of a system of equations,
+// including functions of the state variables. The functions of the
+// state variables are decomposed alongside the equations, and the
+// second member of the return value contains the indices of the u variables
+// which represent them in the decomposition.
+std::pair<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>>
+taylor_decompose(std::vector<std::pair<expression, expression>> sys, std::vector<expression> sv_funcs)
 {
     if (sys.empty()) {
         throw std::invalid_argument("Cannot decompose a system of zero equations");
@@ -769,6 +1240,14 @@ taylor_decompose(std::vector<std::pair<expression, expression>> sys)
         }
     }
 
+    // The variables in the functions of the state
+    // variables must also appear in the lhs.
+    for (const auto &sv_ex : sv_funcs) {
+        for (auto &var : get_variables(sv_ex)) {
+            rhs_vars_set.emplace(std::move(var));
+        }
+    }
+
     // Check that all variables in the rhs appear in the lhs.
     for (const auto &var : rhs_vars_set) {
         if (lhs_vars_set.find(var) == lhs_vars_set.end()) {
@@ -790,18 +1269,33 @@ taylor_decompose(std::vector<std::pair<expression, expression>> sys)
         assert(eres.second);
     }
 
+    // Cache the number of functions of the state variables.
+    const auto n_sv_funcs = sv_funcs.size();
+
 #if !defined(NDEBUG)
-    // Store a copy of the original rhs for checking later.
+    // Store a copy of the original rhs and of the
+    // functions of the state variables for checking later.
     std::vector<expression> orig_rhs;
     for (const auto &[_, rhs_ex] : sys) {
         orig_rhs.push_back(rhs_ex);
     }
+    orig_rhs.insert(orig_rhs.end(), sv_funcs.begin(), sv_funcs.end());
 #endif
 
-    // Rename the variables in the original equations.
+    // Turn the linear right-hand sides into linear combinations.
+    // NOTE: the functions of the state variables are left as they are.
+    for (auto &[_, rhs_ex] : sys) {
+        detail::taylor_rewrite_linear(rhs_ex);
+    }
+
+    // Rename the variables in the original equations
+    // and in the functions of the state variables.
     for (auto &[_, rhs_ex] : sys) {
         rename_variables(rhs_ex, repl_map);
     }
+    for (auto &sv_ex : sv_funcs) {
+        rename_variables(sv_ex, repl_map);
+    }
 
     // Init the vector containing the definitions
     // of the u variables. It begins with a list
@@ -815,47 +1309,134 @@ taylor_decompose(std::vector<std::pair<expression, expression>> sys)
     // We will be reusing this below.
     auto sys_copy = sys;
 
-    // Run the decomposition on each equation.
-    for (decltype(sys.size()) i = 0; i < sys.size(); ++i) {
-        // Decompose the current equation.
-        if (const auto dres = taylor_decompose_in_place(std::move(sys[i].second), u_vars_defs)) {
+    auto sv_funcs_copy = sv_funcs;
+
+    // Run the decomposition on each equation and
+    // on each function of the state variables.
+    std::vector<expression> v_rhs;
+    v_rhs.reserve(sys.size() + n_sv_funcs);
+    for (auto &[_, rhs_ex] : sys) {
+        v_rhs.push_back(std::move(rhs_ex));
+    }
+    for (auto &sv_ex : sv_funcs) {
+        v_rhs.push_back(std::move(sv_ex));
+    }
+    const auto dres = detail::taylor_decompose_eqs(std::move(v_rhs), u_vars_defs);
+
+    for (decltype(dres.size()) i = 0; i < dres.size(); ++i) {
+        if (dres[i] != 0u) {
             // NOTE: if the equation was decomposed
             // (that is, it is not constant or a single variable),
             // we have to update the original definition
             // of the equation in sys_copy
             // so that it points to the u variable
             // that now represents it.
-            sys_copy[i].second = expression{variable{"u_" + detail::li_to_string(dres)}};
-        }
+            auto new_ex = expression{variable{"u_" + detail::li_to_string(dres[i])}};
+
+            if (i < n_eq) {
+                sys_copy[i].second = std::move(new_ex);
+            } else {
+                sv_funcs_copy[i - n_eq] = std::move(new_ex);
+            }
+        }
     }
 
     // Append the (possibly updated) definitions of the diff equations
-    // in terms of u variables.
+    // in terms of u variables, followed by the functions of the state
+    // variables.
     for (auto &[_, rhs] : sys_copy) {
         u_vars_defs.emplace_back(std::move(rhs), std::vector<std::uint32_t>{});
     }
+    for (auto &sv_ex : sv_funcs_copy) {
+        u_vars_defs.emplace_back(std::move(sv_ex), std::vector<std::uint32_t>{});
+    }
 
 #if !defined(NDEBUG)
     // Verify the decomposition.
-    detail::verify_taylor_dec(orig_rhs, u_vars_defs);
+    detail::verify_taylor_dec(orig_rhs, u_vars_defs, n_eq);
 #endif
 
     // Simplify the decomposition.
-    u_vars_defs = detail::taylor_decompose_cse(u_vars_defs, n_eq);
+    u_vars_defs = detail::taylor_decompose_cse(u_vars_defs, n_eq, n_eq + n_sv_funcs);
 
 #if !defined(NDEBUG)
     // Verify the simplified decomposition.
-    detail::verify_taylor_dec(orig_rhs, u_vars_defs);
+    detail::verify_taylor_dec(orig_rhs, u_vars_defs, n_eq);
 #endif
 
-    u_vars_defs = detail::taylor_sort_dc(u_vars_defs, n_eq);
+    u_vars_defs = detail::taylor_sort_dc(u_vars_defs, n_eq, n_eq + n_sv_funcs);
 
 #if !defined(NDEBUG)
     // Verify the reordered decomposition.
-    detail::verify_taylor_dec(orig_rhs, u_vars_defs);
+    detail::verify_taylor_dec(orig_rhs, u_vars_defs, n_eq);
 #endif
 
-    return u_vars_defs;
+    // Extract the functions of the state variables
+    // from the end of the decomposition.
+    std::vector<std::uint32_t> sv_funcs_idx;
+    for (auto i = u_vars_defs.size() - n_sv_funcs; i < u_vars_defs.size(); ++i) {
+        if (auto p_var = std::get_if<variable>(&u_vars_defs[i].first.value())) {
+            sv_funcs_idx.push_back(detail::uname_to_index(p_var->name()));
+        } else {
+            std::ostringstream oss;
+            oss << sv_funcs_copy[i - (u_vars_defs.size() - n_sv_funcs)];
+
+            throw std::invalid_argument("The function of the state variables '" + oss.str()
+                                        + "' is a constant, which cannot be used in a Taylor decomposition");
+        }
+    }
+    u_vars_defs.resize(u_vars_defs.size() - n_sv_funcs);
+
+    return std::pair{std::move(u_vars_defs), std::move(sv_funcs_idx)};
+}
+
+// Create a first-order system from a system of second-order ODEs.
+std::vector<std::pair<expression, expression>>
+make_second_order_sys(std::vector<std::tuple<expression, expression, expression>> sys)
+{
+    if (sys.empty()) {
+        throw std::invalid_argument("Cannot create a second-order system of zero equations");
+    }
+
+    // Check that the coordinates and the velocities
+    // are all variables, with no duplicates.
+    std::unordered_set<std::string> vars_set;
+    auto check_var = [&vars_set](const expression &ex) {
+        if (auto p_var = std::get_if<variable>(&ex.value())) {
+            if (!vars_set.emplace(p_var->name()).second) {
+                throw std::invalid_argument("Error in the creation of a second-order system: the variable '"
+                                            + p_var->name() + "' appears more than once");
+            }
+        } else {
+            std::ostringstream oss;
+            oss << ex;
+
+            throw std::invalid_argument("Error in the creation of a second-order system: the expression '"
+                                        + oss.str() + "' is not a variable");
+        }
+    };
+
+    for (const auto &[x, v, _] : sys) {
+        check_var(x);
+        check_var(v);
+    }
+
+    std::vector<std::pair<expression, expression>> retval;
+    retval.reserve(sys.size() * 2u);
+
+    // NOTE: the equations x_i' = v_i have a variable
+    // as rhs, so that their derivatives are computed
+    // from the derivatives of v_i in taylor_compute_sv_diff()
+    // and taylor_c_compute_sv_diffs().
+    for (const auto &[x, v, _] : sys) {
+        retval.push_back(prime(x) = v);
+    }
+
+    for (auto &[_, v, f] : sys) {
+        retval.push_back(prime(v) = std::move(f));
+    }
+
+    return retval;
 }
 
 namespace detail
@@ -882,12 +1463,134 @@ std::uint32_t n_pars_in_sys(const T &sys)
     return retval;
 }
 
+// Add to the state s a function with the given name for the evaluation
+// of the invariants inv of a system of ODEs whose state variables
+// are listed in sv. The function has the signature
+//
+// void (T *out, const T *state, const T *pars, const T *time)
+//
+// and it writes the values of the invariants into out.
+template <typename T>
+void taylor_add_inv_func(llvm_state &s, const std::string &name, const std::vector<expression> &sv,
+                         std::vector<expression> inv)
+{
+    auto &builder = s.builder();
+
+    // Decompose the invariants as functions of the state
+    // variables of a dummy system with a zero rhs.
+    // NOTE: this ensures that the state variables are indexed
+    // in the same order as in the state vector of the integrator.
+    std::vector<std::pair<expression, expression>> sys;
+    for (const auto &ex : sv) {
+        sys.emplace_back(ex, 0_dbl);
+    }
+    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
+
+    const auto [dc, inv_idx] = taylor_decompose(std::move(sys), std::move(inv));
+    const auto n_uvars = boost::numeric_cast<std::uint32_t>(dc.size() - n_eq);
+
+    // Prepare the function prototype.
+    std::vector<llvm::Type *> fargs(4, llvm::PointerType::getUnqual(to_llvm_type<T>(s.context())));
+    auto *ft = llvm::FunctionType::get(builder.getVoidTy(), fargs, false);
+    assert(ft != nullptr);
+    auto *f = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, name, &s.module());
+    if (f == nullptr) {
+        throw std::invalid_argument("Unable to create a function for the evaluation of the invariants with name '"
+                                    + name + "'");
+    }
+
+    auto out_ptr = f->args().begin();
+    out_ptr->setName("out_ptr");
+    out_ptr->addAttr(llvm::Attribute::NoCapture);
+    out_ptr->addAttr(llvm::Attribute::NoAlias);
+    out_ptr->addAttr(llvm::Attribute::WriteOnly);
+
+    auto state_ptr = out_ptr + 1;
+    state_ptr->setName("state_ptr");
+    state_ptr->addAttr(llvm::Attribute::NoCapture);
+    state_ptr->addAttr(llvm::Attribute::NoAlias);
+    state_ptr->addAttr(llvm::Attribute::ReadOnly);
+
+    auto par_ptr = state_ptr + 1;
+    par_ptr->setName("par_ptr");
+    par_ptr->addAttr(llvm::Attribute::NoCapture);
+    par_ptr->addAttr(llvm::Attribute::NoAlias);
+    par_ptr->addAttr(llvm::Attribute::ReadOnly);
+
+    auto time_ptr = par_ptr + 1;
+    time_ptr->setName("time_ptr");
+    time_ptr->addAttr(llvm::Attribute::NoCapture);
+    time_ptr->addAttr(llvm::Attribute::NoAlias);
+    time_ptr->addAttr(llvm::Attribute::ReadOnly);
+
+    auto *bb = llvm::BasicBlock::Create(s.context(), "entry", f);
+    assert(bb != nullptr);
+    builder.SetInsertPoint(bb);
+
+    // Load the state variables.
+    std::vector<llvm::Value *> diff_arr;
+    for (std::uint32_t i = 0; i < n_eq; ++i) {
+        diff_arr.push_back(
+            load_vector_from_memory(builder, builder.CreateInBoundsGEP(state_ptr, {builder.getInt32(i)}), 1));
+    }
+
+    // Compute the values of the other u variables. These are
+    // the order-0 derivatives in the Taylor decomposition.
+    for (auto i = n_eq; i < n_uvars; ++i) {
+        diff_arr.push_back(taylor_diff<T>(s, dc[i].first, dc[i].second, diff_arr, par_ptr, time_ptr, n_uvars, 0, i, 1));
+    }
+
+    // Write out the invariants.
+    for (decltype(inv_idx.size()) i = 0; i < inv_idx.size(); ++i) {
+        assert(inv_idx[i] < diff_arr.size());
+
+        store_vector_to_memory(
+            builder, builder.CreateInBoundsGEP(out_ptr, {builder.getInt32(static_cast<std::uint32_t>(i))}),
+            diff_arr[inv_idx[i]]);
+    }
+
+    builder.CreateRetVoid();
+
+    s.verify_function(f);
+
+    s.optimise();
+}
+
+// Weight of a call to a transcendental function, in units
+// of floating-point operations, in the cost of a timestep
+// used for the selection of the order in variable-order mode.
+constexpr double taylor_vo_trans_cost = 20;
+
+// Static estimate of the computational cost of a timestep at the given
+// order for the Taylor decomposition dc of a system with n_eq equations,
+// according to the cost model of taylor_estimate_cost().
+template <typename T>
+T taylor_vo_cost(const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc, std::uint32_t n_eq,
+                 std::uint32_t order)
+{
+    const auto est = taylor_estimate_cost_impl(dc, n_eq, order, 1, sizeof(T));
+
+    return static_cast<T>(static_cast<double>(est.step_flops)
+                          + static_cast<double>(est.step_transcendentals) * taylor_vo_trans_cost);
+}
+
+template <typename T, typename U>
+std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>, std::size_t>
+taylor_add_vo_steppers(llvm_state &, U, T, bool, bool, const std::vector<expression> &, const std::vector<T> &);
+
+template <typename T, typename U>
+std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>>
+taylor_add_mt_steppers(llvm_state &, U, const std::vector<T> &, bool, bool, const std::vector<expression> &,
+                       const std::vector<T> &);
+
 } // namespace
 
 template <typename T>
 template <typename U>
 void taylor_adaptive_impl<T>::finalise_ctor_impl(U sys, std::vector<T> state, T time, T tol, bool high_accuracy,
-                                                 bool compact_mode, std::vector<T> pars)
+                                                 bool compact_mode, std::vector<T> pars, std::vector<expression> obs,
+                                                 std::vector<expression> invariants, T inv_tol, std::vector<T> weights,
+                                                 bool variable_order, std::vector<T> extra_tols)
 {
     using std::isfinite;
 
@@ -920,8 +1623,38 @@ void taylor_adaptive_impl<T>::finalise_ctor_impl(U sys, std::vector<T> state, T
             + " instead");
     }
 
+    for (const auto &etol : extra_tols) {
+        if (!isfinite(etol) || etol <= 0) {
+            throw std::invalid_argument("The additional tolerances in an adaptive Taylor integrator must be finite "
+                                        "and positive, but a tolerance of "
+                                        + li_to_string(etol) + " was detected");
+        }
+    }
+
+    if (variable_order && !extra_tols.empty()) {
+        throw std::invalid_argument(
+            "The variable-order mode of an adaptive Taylor integrator cannot be used with multiple tolerances");
+    }
+
+    // NOTE: an infinite tolerance on the drift
+    // of the invariants is allowed.
+    using std::isnan;
+    if (isnan(inv_tol) || inv_tol <= 0) {
+        throw std::invalid_argument("The tolerance on the drift of the invariants in an adaptive Taylor integrator "
+                                    "must be positive, but it is "
+                                    + li_to_string(inv_tol) + " instead");
+    }
+
     // Fix m_pars' size, if necessary.
-    const auto npars = n_pars_in_sys(sys);
+    // NOTE: the observables and the invariants
+    // may contain parameters as well.
+    auto npars = n_pars_in_sys(sys);
+    for (const auto &ex : obs) {
+        npars = std::max(npars, get_param_size(ex));
+    }
+    for (const auto &ex : invariants) {
+        npars = std::max(npars, get_param_size(ex));
+    }
     if (m_pars.size() < npars) {
         m_pars.resize(boost::numeric_cast<decltype(m_pars.size())>(npars));
     } else if (m_pars.size() > npars) {
@@ -936,35 +1669,111 @@ void taylor_adaptive_impl<T>::finalise_ctor_impl(U sys, std::vector<T> state, T
     // Store the dimension of the system.
     m_dim = boost::numeric_cast<std::uint32_t>(sys.size());
 
-    // Add the stepper function.
-    std::tie(m_dc, m_order)
-        = taylor_add_adaptive_step<T>(m_llvm, "step", std::move(sys), tol, 1, high_accuracy, compact_mode);
+    // Store the tolerances.
+    m_tols.push_back(tol);
+    m_tols.insert(m_tols.end(), extra_tols.begin(), extra_tols.end());
+
+    // Add the stepper function(s).
+    m_obs = std::move(obs);
+    m_weights = std::move(weights);
+    if (variable_order) {
+        std::tie(m_dc, m_vo_orders, m_vo_nom_idx)
+            = taylor_add_vo_steppers<T>(m_llvm, std::move(sys), tol, high_accuracy, compact_mode, m_obs, m_weights);
+        m_vo_idx = m_vo_nom_idx;
+
+        // NOTE: the Taylor coefficients are stored
+        // according to the layout at the largest order.
+        m_order = m_vo_orders.back();
+
+        for (auto k : m_vo_orders) {
+            m_vo_costs.push_back(taylor_vo_cost<T>(m_dc, m_dim, k));
+        }
+    } else if (m_tols.size() > 1u) {
+        std::tie(m_dc, m_mt_orders)
+            = taylor_add_mt_steppers<T>(m_llvm, std::move(sys), m_tols, high_accuracy, compact_mode, m_obs, m_weights);
+
+        // NOTE: as in the variable-order mode, the Taylor coefficients
+        // are stored according to the layout at the largest order.
+        m_order = *std::max_element(m_mt_orders.begin(), m_mt_orders.end());
+    } else {
+        std::tie(m_dc, m_order) = taylor_add_adaptive_step<T>(m_llvm, "step", std::move(sys), tol, 1, high_accuracy,
+                                                              compact_mode, m_obs, m_weights);
+    }
+
+    // Add the function for the evaluation of the invariants, if needed.
+    m_inv = std::move(invariants);
+    m_inv_tol = inv_tol;
+    if (!m_inv.empty()) {
+        std::vector<expression> sv;
+        for (std::uint32_t i = 0; i < m_dim; ++i) {
+            sv.push_back(m_dc[i].first);
+        }
+
+        taylor_add_inv_func<T>(m_llvm, "inv", sv, m_inv);
+    }
 
     // Run the jit.
     m_llvm.compile();
 
-    // Fetch the stepper.
-    m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+    // Fetch the stepper(s).
+    if (variable_order) {
+        for (auto k : m_vo_orders) {
+            m_vo_step_f.push_back(reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step_o" + std::to_string(k))));
+        }
+        m_step_f = m_vo_step_f[m_vo_idx];
+    } else if (!m_mt_orders.empty()) {
+        for (decltype(m_tols.size()) i = 0; i < m_tols.size(); ++i) {
+            m_mt_step_f.push_back(reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step_t" + std::to_string(i))));
+        }
+        m_step_f = m_mt_step_f[m_mt_idx];
+    } else {
+        m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+    }
 
-    // Setup the vector for the Taylor coefficients.
-    // LCOV_EXCL_START
-    if (m_order == std::numeric_limits<std::uint32_t>::max()
-        || m_state.size() > std::numeric_limits<decltype(m_tc.size())>::max() / (m_order + 1u)) {
-        throw std::overflow_error("Overflow detected in the initialisation of an adaptive Taylor integrator: the order "
-                                  "or the state size is too large");
+    // Fetch the invariants function and compute
+    // the reference values of the invariants.
+    if (!m_inv.empty()) {
+        m_inv_f = reinterpret_cast<inv_f_t>(m_llvm.jit_lookup("inv"));
+
+        m_inv_values.resize(m_inv.size());
+        m_inv_drift.resize(m_inv.size());
+        reset_inv_drift();
     }
-    // LCOV_EXCL_STOP
 
-    m_tc.resize(m_state.size() * (m_order + 1u));
+    // Setup the vector for the Taylor coefficients
+    // of the state variables and of the observables.
+    // NOTE: the stepper already checked that the total
+    // size is representable as a 32-bit unsigned integer.
+    m_tc.resize((m_state.size() + m_obs.size()) * (m_order + 1u));
 }
 
 template <typename T>
 taylor_adaptive_impl<T>::taylor_adaptive_impl(const taylor_adaptive_impl &other)
     // NOTE: make a manual copy of all members, apart from the function pointer.
     : m_state(other.m_state), m_time(other.m_time), m_llvm(other.m_llvm), m_dim(other.m_dim), m_dc(other.m_dc),
-      m_order(other.m_order), m_pars(other.m_pars), m_tc(other.m_tc)
+      m_order(other.m_order), m_pars(other.m_pars), m_tc(other.m_tc), m_obs(other.m_obs), m_inv(other.m_inv),
+      m_inv_ref(other.m_inv_ref), m_inv_values(other.m_inv_values), m_inv_drift(other.m_inv_drift),
+      m_inv_tol(other.m_inv_tol), m_weights(other.m_weights), m_vo_orders(other.m_vo_orders),
+      m_vo_costs(other.m_vo_costs), m_vo_idx(other.m_vo_idx), m_vo_nom_idx(other.m_vo_nom_idx), m_tols(other.m_tols),
+      m_mt_orders(other.m_mt_orders), m_mt_idx(other.m_mt_idx)
 {
-    m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+    if (!m_vo_orders.empty()) {
+        for (auto k : m_vo_orders) {
+            m_vo_step_f.push_back(reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step_o" + std::to_string(k))));
+        }
+        m_step_f = m_vo_step_f[m_vo_idx];
+    } else if (!m_mt_orders.empty()) {
+        for (decltype(m_tols.size()) i = 0; i < m_tols.size(); ++i) {
+            m_mt_step_f.push_back(reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step_t" + std::to_string(i))));
+        }
+        m_step_f = m_mt_step_f[m_mt_idx];
+    } else {
+        m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+    }
+
+    if (!m_inv.empty()) {
+        m_inv_f = reinterpret_cast<inv_f_t>(m_llvm.jit_lookup("inv"));
+    }
 }
 
 template <typename T>
@@ -1007,8 +1816,10 @@ std::tuple<taylor_outcome, T> taylor_adaptive_impl<T>::step_impl(T max_delta_t,
 #endif
 
     // Invoke the stepper.
+    // NOTE: in variable-order mode, the Taylor coefficients
+    // are always needed for the selection of the order.
     auto h = max_delta_t;
-    m_step_f(m_state.data(), m_pars.data(), &m_time, &h, wtc ? m_tc.data() : nullptr);
+    m_step_f(m_state.data(), m_pars.data(), &m_time, &h, (wtc || !m_vo_orders.empty()) ? m_tc.data() : nullptr);
 
     // Update the time.
     m_time += h;
@@ -1020,9 +1831,193 @@ std::tuple<taylor_outcome, T> taylor_adaptive_impl<T>::step_impl(T max_delta_t,
         return std::tuple{taylor_outcome::err_nf_state, h};
     }
 
+    // Select the order for the next timestep or, with multiple
+    // tolerances, rearrange the Taylor coefficients if needed.
+    if (!m_vo_orders.empty()) {
+        vo_select_order(wtc);
+    } else if (wtc && !m_mt_orders.empty()) {
+        tc_relayout(m_mt_orders[m_mt_idx]);
+    }
+
+    // Update the invariants and check their drifts.
+    if (m_inv_f != nullptr && update_inv()) {
+        return std::tuple{taylor_outcome::err_inv_drift, h};
+    }
+
     return std::tuple{h == max_delta_t ? taylor_outcome::time_limit : taylor_outcome::success, h};
 }
 
+// Select the order for the next timestep in variable-order mode,
+// using the Taylor coefficients of the state variables computed in the
+// last timestep. For each candidate order, the timestep is estimated
+// as in the stepper, and the norms of the derivatives above the order
+// of the last timestep are extrapolated from the radius of convergence.
+// The order minimising the ratio between the estimated cost of a timestep
+// and the estimated timestep is then selected. If wtc is true, the Taylor
+// coefficients are rearranged according to the layout at the largest order.
+template <typename T>
+void taylor_adaptive_impl<T>::vo_select_order(bool wtc)
+{
+    using std::abs;
+    using std::exp;
+    using std::isnan;
+    using std::pow;
+
+    assert(!m_vo_orders.empty());
+
+    const auto cur_order = m_vo_orders[m_vo_idx];
+    assert(cur_order >= 2u && cur_order <= m_order);
+
+    using su_t = typename std::vector<T>::size_type;
+
+    // Weighted norm infinity of the normalised
+    // derivatives of order j of the state variables.
+    auto norm = [this, cur_order](std::uint32_t j) {
+        T retval(0);
+
+        for (std::uint32_t i = 0; i < m_dim; ++i) {
+            auto val = abs(m_tc[static_cast<su_t>(i) * (cur_order + 1u) + j]);
+            if (!m_weights.empty()) {
+                val *= m_weights[i];
+            }
+
+            retval = std::max(retval, val);
+        }
+
+        return retval;
+    };
+
+    // NOTE: as in the stepper, the tolerance is absolute if the
+    // norm infinity of the state vector is not greater than 1,
+    // relative otherwise.
+    const auto max_abs_state = norm(0);
+    const auto num_rho = (max_abs_state <= 1) ? T(1) : max_abs_state;
+
+    // Estimate of the radius of convergence.
+    const auto rho = std::min(pow(num_rho / norm(cur_order - 1u), T(1) / (cur_order - 1u)),
+                              pow(num_rho / norm(cur_order), T(1) / cur_order));
+
+    // Estimate of (tol * num_rho / norm(j))**(1 / j).
+    auto rho_j = [&](std::uint32_t j) {
+        if (j <= cur_order) {
+            return pow(m_tols[0] * num_rho / norm(j), T(1) / j);
+        } else {
+            return pow(m_tols[0], T(1) / j) * rho;
+        }
+    };
+
+    std::optional<std::size_t> best_idx;
+    T best_work(0);
+    for (decltype(m_vo_orders.size()) i = 0; i < m_vo_orders.size(); ++i) {
+        const auto k = m_vo_orders[i];
+
+        const auto h = exp((T(-7) / T(10)) / (k - 1u)) * std::min(rho_j(k - 1u), rho_j(k));
+        const auto work = m_vo_costs[i] / h;
+
+        // NOTE: in case of ties, prefer lower orders.
+        if (!isnan(work) && (!best_idx || work < best_work)) {
+            best_idx = i;
+            best_work = work;
+        }
+    }
+
+    // NOTE: if all the estimates are NaN,
+    // keep the current order.
+    if (best_idx) {
+        m_vo_idx = *best_idx;
+        m_step_f = m_vo_step_f[m_vo_idx];
+    }
+
+    // Rearrange the Taylor coefficients, if needed.
+    if (wtc) {
+        tc_relayout(cur_order);
+    }
+}
+
+// Rearrange the Taylor coefficients computed at the order
+// cur_order according to the layout at the order m_order,
+// setting to zero the coefficients above cur_order.
+template <typename T>
+void taylor_adaptive_impl<T>::tc_relayout(std::uint32_t cur_order)
+{
+    assert(cur_order <= m_order);
+
+    if (cur_order == m_order) {
+        return;
+    }
+
+    using su_t = typename std::vector<T>::size_type;
+
+    const auto n_rows = static_cast<su_t>(m_dim) + m_obs.size();
+
+    // NOTE: iterate backwards so that the coefficients
+    // are never overwritten before being moved.
+    for (auto i = n_rows; i-- > 0u;) {
+        for (auto j = m_order + 1u; j-- > 0u;) {
+            m_tc[i * (m_order + 1u) + j] = (j <= cur_order) ? m_tc[i * (cur_order + 1u) + j] : T(0);
+        }
+    }
+}
+
+template <typename T>
+void taylor_adaptive_impl<T>::select_tol(std::size_t idx)
+{
+    if (idx >= m_tols.size()) {
+        throw std::invalid_argument("Cannot select the tolerance at index " + std::to_string(idx)
+                                    + " in an adaptive Taylor integrator with " + std::to_string(m_tols.size())
+                                    + " tolerance(s)");
+    }
+
+    if (!m_mt_orders.empty()) {
+        m_mt_idx = idx;
+        m_step_f = m_mt_step_f[idx];
+    }
+}
+
+// Evaluate the invariants on the current state and update
+// their max drifts. Returns true if the drift of
+// at least one invariant exceeds the tolerance.
+template <typename T>
+bool taylor_adaptive_impl<T>::update_inv()
+{
+    using std::abs;
+
+    assert(m_inv_f != nullptr);
+
+    m_inv_f(m_inv_values.data(), m_state.data(), m_pars.data(), &m_time);
+
+    bool retval = false;
+    for (decltype(m_inv_values.size()) i = 0; i < m_inv_values.size(); ++i) {
+        auto drift = abs(m_inv_values[i] - m_inv_ref[i]);
+        if (m_inv_ref[i] != 0) {
+            drift /= abs(m_inv_ref[i]);
+        }
+
+        m_inv_drift[i] = std::max(m_inv_drift[i], drift);
+
+        // NOTE: this is not triggered by NaN drifts.
+        retval = retval || drift > m_inv_tol;
+    }
+
+    return retval;
+}
+
+// Reset the reference values of the invariants
+// to their values for the current state, and
+// zero out their max drifts.
+template <typename T>
+void taylor_adaptive_impl<T>::reset_inv_drift()
+{
+    if (m_inv_f == nullptr) {
+        return;
+    }
+
+    m_inv_f(m_inv_values.data(), m_state.data(), m_pars.data(), &m_time);
+
+    m_inv_ref = m_inv_values;
+    std::fill(m_inv_drift.begin(), m_inv_drift.end(), T(0));
+}
+
 template <typename T>
 std::tuple<taylor_outcome, T> taylor_adaptive_impl<T>::step(bool wtc)
 {
@@ -1058,6 +2053,13 @@ std::tuple<taylor_outcome, T, T, std::size_t> taylor_adaptive_impl<T>::propagate
 
 template <typename T>
 std::tuple<taylor_outcome, T, T, std::size_t> taylor_adaptive_impl<T>::propagate_until(T t, std::size_t max_steps)
+{
+    return propagate_until(t, max_steps, [](taylor_adaptive_impl &) { return true; });
+}
+
+// Check the preconditions of propagate_until().
+template <typename T>
+void taylor_adaptive_impl<T>::propagate_check(T t) const
 {
     using std::isfinite;
 
@@ -1072,52 +2074,6 @@ std::tuple<taylor_outcome, T, T, std::size_t> taylor_adaptive_impl<T>::propagate
         throw std::invalid_argument(
             "A non-finite time was passed to the propagate_until() function of an adaptive Taylor integrator");
     }
-
-    // Initial values for the counters,
-    // the min/max abs of the integration
-    // timesteps, and min/max Taylor orders.
-    // NOTE: iter_counter is for keeping track of the max_steps
-    // limits, step_counter counts the number of timesteps performed
-    // with a non-zero h. Most of the time these two quantities
-    // will be identical, apart from corner cases.
-    std::size_t iter_counter = 0, step_counter = 0;
-    T min_h = std::numeric_limits<T>::infinity(), max_h(0);
-
-    while (true) {
-        // NOTE: t - m_time is guaranteed not to be nan: t is never non-finite,
-        // and at the first iteration we have checked above the value of m_time.
-        // At successive iterations, we know that m_time must be finite because
-        // otherwise we would have exited the loop when checking res.
-        const auto [res, h] = step_impl(t - m_time, false);
-
-        if (res != taylor_outcome::success && res != taylor_outcome::time_limit) {
-            // Something went wrong in the propagation of the timestep, exit.
-            return std::tuple{res, min_h, max_h, step_counter};
-        }
-
-        // Update the number of iterations.
-        ++iter_counter;
-
-        // Update the number of steps.
-        step_counter += static_cast<std::size_t>(h != 0);
-
-        // Break out if the time limit is reached,
-        // *before* updating the min_h/max_h values.
-        if (res == taylor_outcome::time_limit) {
-            return std::tuple{taylor_outcome::time_limit, min_h, max_h, step_counter};
-        }
-
-        // Update min_h/max_h.
-        using std::abs;
-        const auto abs_h = abs(h);
-        min_h = std::min(min_h, abs_h);
-        max_h = std::max(max_h, abs_h);
-
-        // Check the iteration limit.
-        if (max_steps != 0u && iter_counter == max_steps) {
-            return std::tuple{taylor_outcome::step_limit, min_h, max_h, step_counter};
-        }
-    }
 }
 
 template <typename T>
@@ -1148,35 +2104,45 @@ std::uint32_t taylor_adaptive_impl<T>::get_dim() const
 // NOTE: on Windows apparently it is necessary to declare that
 // these instantiations are meant to be dll-exported.
 template class taylor_adaptive_impl<double>;
-template HEYOKA_DLL_PUBLIC void taylor_adaptive_impl<double>::finalise_ctor_impl(std::vector<expression>,
-                                                                                 std::vector<double>, double, double,
-                                                                                 bool, bool, std::vector<double>);
+template HEYOKA_DLL_PUBLIC void
+taylor_adaptive_impl<double>::finalise_ctor_impl(std::vector<expression>, std::vector<double>, double, double, bool,
+                                                 bool, std::vector<double>, std::vector<expression>,
+                                                 std::vector<expression>, double, std::vector<double>, bool,
+                                                 std::vector<double>);
 template HEYOKA_DLL_PUBLIC void
 taylor_adaptive_impl<double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>, std::vector<double>,
-                                                 double, double, bool, bool, std::vector<double>);
+                                                 double, double, bool, bool, std::vector<double>,
+                                                 std::vector<expression>, std::vector<expression>, double,
+                                                 std::vector<double>, bool, std::vector<double>);
 
 template class taylor_adaptive_impl<long double>;
-template HEYOKA_DLL_PUBLIC void taylor_adaptive_impl<long double>::finalise_ctor_impl(std::vector<expression>,
-                                                                                      std::vector<long double>,
-                                                                                      long double, long double, bool,
-                                                                                      bool, std::vector<long double>);
+template HEYOKA_DLL_PUBLIC void
+taylor_adaptive_impl<long double>::finalise_ctor_impl(std::vector<expression>, std::vector<long double>, long double,
+                                                      long double, bool, bool, std::vector<long double>,
+                                                      std::vector<expression>, std::vector<expression>, long double,
+                                                      std::vector<long double>, bool, std::vector<long double>);
 template HEYOKA_DLL_PUBLIC void
 taylor_adaptive_impl<long double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
                                                       std::vector<long double>, long double, long double, bool, bool,
-                                                      std::vector<long double>);
+                                                      std::vector<long double>, std::vector<expression>,
+                                                      std::vector<expression>, long double, std::vector<long double>,
+                                                      bool, std::vector<long double>);
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 template class taylor_adaptive_impl<mppp::real128>;
-template HEYOKA_DLL_PUBLIC void taylor_adaptive_impl<mppp::real128>::finalise_ctor_impl(std::vector<expression>,
-                                                                                        std::vector<mppp::real128>,
-                                                                                        mppp::real128, mppp::real128,
-                                                                                        bool, bool,
-                                                                                        std::vector<mppp::real128>);
+template HEYOKA_DLL_PUBLIC void
+taylor_adaptive_impl<mppp::real128>::finalise_ctor_impl(std::vector<expression>, std::vector<mppp::real128>,
+                                                        mppp::real128, mppp::real128, bool, bool,
+                                                        std::vector<mppp::real128>, std::vector<expression>,
+                                                        std::vector<expression>, mppp::real128,
+                                                        std::vector<mppp::real128>, bool, std::vector<mppp::real128>);
 template HEYOKA_DLL_PUBLIC void
 taylor_adaptive_impl<mppp::real128>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
                                                         std::vector<mppp::real128>, mppp::real128, mppp::real128, bool,
-                                                        bool, std::vector<mppp::real128>);
+                                                        bool, std::vector<mppp::real128>, std::vector<expression>,
+                                                        std::vector<expression>, mppp::real128,
+                                                        std::vector<mppp::real128>, bool, std::vector<mppp::real128>);
 
 #endif
 
@@ -1189,7 +2155,8 @@ template <typename T>
 template <typename U>
 void taylor_adaptive_batch_impl<T>::finalise_ctor_impl(U sys, std::vector<T> state, std::uint32_t batch_size,
                                                        std::vector<T> time, T tol, bool high_accuracy,
-                                                       bool compact_mode, std::vector<T> pars)
+                                                       bool compact_mode, std::vector<T> pars,
+                                                       std::vector<expression> obs, std::vector<T> weights)
 {
     using std::isfinite;
 
@@ -1242,7 +2209,11 @@ void taylor_adaptive_batch_impl<T>::finalise_ctor_impl(U sys, std::vector<T> sta
     }
 
     // Fix m_pars' size, if necessary.
-    const auto npars = n_pars_in_sys(sys);
+    // NOTE: the observables may contain parameters as well.
+    auto npars = n_pars_in_sys(sys);
+    for (const auto &ex : obs) {
+        npars = std::max(npars, get_param_size(ex));
+    }
     if (npars > std::numeric_limits<std::uint32_t>::max() / m_batch_size) {
         throw std::overflow_error(
             "Overflow detected when computing the size of the parameter array in an adaptive Taylor integrator");
@@ -1262,8 +2233,10 @@ void taylor_adaptive_batch_impl<T>::finalise_ctor_impl(U sys, std::vector<T> sta
     m_dim = boost::numeric_cast<std::uint32_t>(sys.size());
 
     // Add the stepper function.
-    std::tie(m_dc, m_order)
-        = taylor_add_adaptive_step<T>(m_llvm, "step", std::move(sys), tol, m_batch_size, high_accuracy, compact_mode);
+    m_obs = std::move(obs);
+    m_weights = std::move(weights);
+    std::tie(m_dc, m_order) = taylor_add_adaptive_step<T>(m_llvm, "step", std::move(sys), tol, m_batch_size,
+                                                          high_accuracy, compact_mode, m_obs, m_weights);
 
     // Run the jit.
     m_llvm.compile();
@@ -1271,18 +2244,13 @@ void taylor_adaptive_batch_impl<T>::finalise_ctor_impl(U sys, std::vector<T> sta
     // Fetch the stepper.
     m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
 
-    // Setup the vector for the Taylor coefficients.
-    // LCOV_EXCL_START
-    if (m_order == std::numeric_limits<std::uint32_t>::max()
-        || m_state.size() > std::numeric_limits<decltype(m_tc.size())>::max() / (m_order + 1u)) {
-        throw std::overflow_error("Overflow detected in the initialisation of an adaptive Taylor integrator: the order "
-                                  "or the state size is too large");
-    }
-    // LCOV_EXCL_STOP
-
+    // Setup the vector for the Taylor coefficients
+    // of the state variables and of the observables.
+    // NOTE: the stepper already checked that the total
+    // size is representable as a 32-bit unsigned integer.
     // NOTE: the size of m_state.size() already takes
     // into account the batch size.
-    m_tc.resize(m_state.size() * (m_order + 1u));
+    m_tc.resize((m_state.size() + m_obs.size() * m_batch_size) * (m_order + 1u));
 
     // Prepare the temp vectors.
     m_pinf.resize(m_batch_size, std::numeric_limits<T>::infinity());
@@ -1305,9 +2273,10 @@ taylor_adaptive_batch_impl<T>::taylor_adaptive_batch_impl(const taylor_adaptive_
     // NOTE: make a manual copy of all members, apart from the function pointers.
     : m_batch_size(other.m_batch_size), m_state(other.m_state), m_time(other.m_time), m_llvm(other.m_llvm),
       m_dim(other.m_dim), m_dc(other.m_dc), m_order(other.m_order), m_pars(other.m_pars), m_tc(other.m_tc),
-      m_pinf(other.m_pinf), m_minf(other.m_minf), m_delta_ts(other.m_delta_ts), m_step_res(other.m_step_res),
-      m_prop_res(other.m_prop_res), m_ts_count(other.m_ts_count), m_min_abs_h(other.m_min_abs_h),
-      m_max_abs_h(other.m_max_abs_h), m_cur_max_delta_ts(other.m_cur_max_delta_ts), m_pfor_ts(other.m_pfor_ts)
+      m_obs(other.m_obs), m_weights(other.m_weights), m_pinf(other.m_pinf), m_minf(other.m_minf),
+      m_delta_ts(other.m_delta_ts), m_step_res(other.m_step_res), m_prop_res(other.m_prop_res),
+      m_ts_count(other.m_ts_count), m_min_abs_h(other.m_min_abs_h), m_max_abs_h(other.m_max_abs_h),
+      m_cur_max_delta_ts(other.m_cur_max_delta_ts), m_pfor_ts(other.m_pfor_ts)
 {
     m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
 }
@@ -1432,9 +2401,9 @@ taylor_adaptive_batch_impl<T>::step(const std::vector<T> &max_delta_ts, bool wtc
     return step_impl(max_delta_ts, wtc);
 }
 
+// Compute the final times for propagate_for().
 template <typename T>
-const std::vector<std::tuple<taylor_outcome, T, T, std::size_t>> &
-taylor_adaptive_batch_impl<T>::propagate_for(const std::vector<T> &delta_ts, std::size_t max_steps)
+const std::vector<T> &taylor_adaptive_batch_impl<T>::propagate_for_ts(const std::vector<T> &delta_ts)
 {
     // Check the dimensionality of delta_ts.
     if (delta_ts.size() != m_batch_size) {
@@ -1448,12 +2417,26 @@ taylor_adaptive_batch_impl<T>::propagate_for(const std::vector<T> &delta_ts, std
         m_pfor_ts[i] = m_time[i] + delta_ts[i];
     }
 
-    return propagate_until(m_pfor_ts, max_steps);
+    return m_pfor_ts;
+}
+
+template <typename T>
+const std::vector<std::tuple<taylor_outcome, T, T, std::size_t>> &
+taylor_adaptive_batch_impl<T>::propagate_for(const std::vector<T> &delta_ts, std::size_t max_steps)
+{
+    return propagate_until(propagate_for_ts(delta_ts), max_steps);
 }
 
 template <typename T>
 const std::vector<std::tuple<taylor_outcome, T, T, std::size_t>> &
 taylor_adaptive_batch_impl<T>::propagate_until(const std::vector<T> &ts, std::size_t max_steps)
+{
+    return propagate_until(ts, max_steps, [](taylor_adaptive_batch_impl &) { return true; });
+}
+
+// Check the preconditions of propagate_until().
+template <typename T>
+void taylor_adaptive_batch_impl<T>::propagate_check(const std::vector<T> &ts) const
 {
     using std::isfinite;
 
@@ -1477,105 +2460,20 @@ taylor_adaptive_batch_impl<T>::propagate_until(const std::vector<T> &ts, std::si
         throw std::invalid_argument("A non-finite time was passed to the propagate_until() function of an adaptive "
                                     "Taylor integrator in batch mode");
     }
+}
 
-    // Reset the counters and the min/max abs(h) vectors.
-    std::size_t iter_counter = 0;
-    for (std::uint32_t i = 0; i < m_batch_size; ++i) {
-        m_ts_count[i] = 0;
-        m_min_abs_h[i] = std::numeric_limits<T>::infinity();
-        m_max_abs_h[i] = 0;
-    }
-
-    while (true) {
-        // Compute the max integration times for this timestep.
-        // NOTE: ts[i] - m_time[i] is guaranteed not to be nan: ts[i] is never non-finite,
-        // and at the first iteration we have checked above the value of m_time.
-        // At successive iterations, we know that m_time[i] must be finite because
-        // otherwise we would have exited the loop when checking m_step_res.
-        for (std::uint32_t i = 0; i < m_batch_size; ++i) {
-            m_cur_max_delta_ts[i] = ts[i] - m_time[i];
-        }
+template <typename T>
+const llvm_state &taylor_adaptive_batch_impl<T>::get_llvm_state() const
+{
+    return m_llvm;
+}
 
-        // Run the integration timestep.
-        step_impl(m_cur_max_delta_ts, false);
-
-        // Check if the integration timestep produced an error condition.
-        if (std::any_of(m_step_res.begin(), m_step_res.end(), [](const auto &tup) {
-                return std::get<0>(tup) != taylor_outcome::success && std::get<0>(tup) != taylor_outcome::time_limit;
-            })) {
-            break;
-        }
-
-        // Update the iteration counter.
-        ++iter_counter;
-
-        // Update the local step counters.
-        for (std::uint32_t i = 0; i < m_batch_size; ++i) {
-            // NOTE: the local step counters increase only if we integrated
-            // for a non-zero time.
-            m_ts_count[i] += static_cast<std::size_t>(std::get<1>(m_step_res[i]) != 0);
-        }
-
-        // Break out if we have reached the time limit for all
-        // batch elements.
-        if (std::all_of(m_step_res.begin(), m_step_res.end(),
-                        [](const auto &tup) { return std::get<0>(tup) == taylor_outcome::time_limit; })) {
-            break;
-        }
-
-        // Update min_h/max_h.
-        for (std::uint32_t i = 0; i < m_batch_size; ++i) {
-            // Don't update if we reached the time limit.
-            if (std::get<0>(m_step_res[i]) == taylor_outcome::time_limit) {
-                continue;
-            }
-
-            using std::abs;
-            const auto abs_h = abs(std::get<1>(m_step_res[i]));
-            m_min_abs_h[i] = std::min(m_min_abs_h[i], abs_h);
-            m_max_abs_h[i] = std::max(m_max_abs_h[i], abs_h);
-        }
-
-        // Check the iteration limit.
-        if (max_steps != 0u && iter_counter == max_steps) {
-            break;
-        }
-    }
-
-    // Assemble the return value.
-    if (max_steps != 0u && iter_counter == max_steps) {
-        // We exited because we reached the max_steps limit: if the last integration step was successful
-        // return step_limit, otherwise time_limit.
-        for (std::uint32_t i = 0; i < m_batch_size; ++i) {
-            m_prop_res[i]
-                = std::tuple{std::get<0>(m_step_res[i]) == taylor_outcome::success ? taylor_outcome::step_limit
-                                                                                   : taylor_outcome::time_limit,
-                             m_min_abs_h[i], m_max_abs_h[i], m_ts_count[i]};
-        }
-    } else {
-        // We exited either because of an error, or because all the batch
-        // elements reached the time limits. In this case, we just use the
-        // outcome of the last timestep.
-        for (std::uint32_t i = 0; i < m_batch_size; ++i) {
-            m_prop_res[i] = std::tuple{std::get<0>(m_step_res[i]), m_min_abs_h[i], m_max_abs_h[i], m_ts_count[i]};
-        }
-    }
-
-    return m_prop_res;
-}
-
-template <typename T>
-const llvm_state &taylor_adaptive_batch_impl<T>::get_llvm_state() const
-{
-    return m_llvm;
-}
-
-template <typename T>
-const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &
-taylor_adaptive_batch_impl<T>::get_decomposition() const
-{
-    return m_dc;
-}
+template <typename T>
+const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &
+taylor_adaptive_batch_impl<T>::get_decomposition() const
+{
+    return m_dc;
+}
 
 template <typename T>
 std::uint32_t taylor_adaptive_batch_impl<T>::get_order() const
@@ -1599,20 +2497,26 @@ std::uint32_t taylor_adaptive_batch_impl<T>::get_dim() const
 template class taylor_adaptive_batch_impl<double>;
 template HEYOKA_DLL_PUBLIC void
 taylor_adaptive_batch_impl<double>::finalise_ctor_impl(std::vector<expression>, std::vector<double>, std::uint32_t,
-                                                       std::vector<double>, double, bool, bool, std::vector<double>);
+                                                       std::vector<double>, double, bool, bool, std::vector<double>,
+                                                       std::vector<expression>, std::vector<double>);
 template HEYOKA_DLL_PUBLIC void
 taylor_adaptive_batch_impl<double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
                                                        std::vector<double>, std::uint32_t, std::vector<double>, double,
-                                                       bool, bool, std::vector<double>);
+                                                       bool, bool, std::vector<double>, std::vector<expression>,
+                                                       std::vector<double>);
 
 template class taylor_adaptive_batch_impl<long double>;
 template HEYOKA_DLL_PUBLIC void
 taylor_adaptive_batch_impl<long double>::finalise_ctor_impl(std::vector<expression>, std::vector<long double>,
                                                             std::uint32_t, std::vector<long double>, long double, bool,
-                                                            bool, std::vector<long double>);
-template HEYOKA_DLL_PUBLIC void taylor_adaptive_batch_impl<long double>::finalise_ctor_impl(
-    std::vector<std::pair<expression, expression>>, std::vector<long double>, std::uint32_t, std::vector<long double>,
-    long double, bool, bool, std::vector<long double>);
+                                                            bool, std::vector<long double>, std::vector<expression>,
+                                                            std::vector<long double>);
+template HEYOKA_DLL_PUBLIC void
+taylor_adaptive_batch_impl<long double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                            std::vector<long double>, std::uint32_t,
+                                                            std::vector<long double>, long double, bool, bool,
+                                                            std::vector<long double>, std::vector<expression>,
+                                                            std::vector<long double>);
 
 #if defined(HEYOKA_HAVE_REAL128)
 
@@ -1620,10 +2524,14 @@ template class taylor_adaptive_batch_impl<mppp::real128>;
 template HEYOKA_DLL_PUBLIC void
 taylor_adaptive_batch_impl<mppp::real128>::finalise_ctor_impl(std::vector<expression>, std::vector<mppp::real128>,
                                                               std::uint32_t, std::vector<mppp::real128>, mppp::real128,
-                                                              bool, bool, std::vector<mppp::real128>);
-template HEYOKA_DLL_PUBLIC void taylor_adaptive_batch_impl<mppp::real128>::finalise_ctor_impl(
-    std::vector<std::pair<expression, expression>>, std::vector<mppp::real128>, std::uint32_t,
-    std::vector<mppp::real128>, mppp::real128, bool, bool, std::vector<mppp::real128>);
+                                                              bool, bool, std::vector<mppp::real128>,
+                                                              std::vector<expression>, std::vector<mppp::real128>);
+template HEYOKA_DLL_PUBLIC void
+taylor_adaptive_batch_impl<mppp::real128>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                              std::vector<mppp::real128>, std::uint32_t,
+                                                              std::vector<mppp::real128>, mppp::real128, bool, bool,
+                                                              std::vector<mppp::real128>, std::vector<expression>,
+                                                              std::vector<mppp::real128>);
 
 #endif
 
@@ -2354,14 +3262,167 @@ auto taylor_build_function_maps(llvm_state &s,
     return retval;
 }
 
+// Number of values of type T fitting in a SIMD register
+// on the host machine (1 if SIMD is not available for T).
+// NOTE: LLVM currently prefers 256-bit vectors
+// even when AVX-512 is available (see llvm_state),
+// hence we do not special-case AVX-512 here.
+template <typename T>
+std::uint32_t taylor_simd_size()
+{
+    if constexpr (std::is_same_v<T, double>) {
+        const auto &tf = get_target_features();
+
+        if (tf.avx) {
+            return 4;
+        }
+
+        if (tf.sse2) {
+            return 2;
+        }
+    }
+
+    return 1;
+}
+
+// Vectorised variant of a function for the computation of a Taylor
+// derivative in compact mode. In scalar compact mode, the same function
+// is often called many times (e.g., the same mul or pow pattern in an N-body
+// system) with different arguments. The vectorised variant is the batch-mode
+// version (with batch size equal to the SIMD size) of the function, which
+// operates on a small jet in which each element packs the derivatives of
+// the arguments of several calls (gathered from the main jet of derivatives).
+// The variables/params in the arguments of the function are mapped
+// to consecutive slots in the small jet/params array: the slot 0
+// of the small jet is reserved to the u variable whose derivative
+// is being computed.
+// NOTE: each function has its own small jet, which is split into regions
+// (one per group of calls). Each region keeps the derivatives up to the
+// current order of the variables in the slots, so that only the derivatives
+// of the current order need to be gathered from the main jet.
+struct taylor_c_vfunc {
+    // The vectorised function.
+    llvm::Function *func = nullptr;
+    // The kinds of the arguments of the function (excluding the
+    // u variable whose derivative is being computed): 0 for a variable,
+    // 1 for a param, 2 for a number.
+    std::vector<int> arg_kinds;
+    // The number of variable slots (including the slot 0)
+    // and the number of param slots.
+    std::uint32_t n_var_slots = 1, n_par_slots = 0;
+    // The number of groups of calls to the function.
+    std::uint32_t n_groups = 0;
+};
+
+// For each segment in s_dc, this function will return a dict mapping the LLVM functions
+// in the corresponding segment of the return value of taylor_build_function_maps()
+// to their vectorised variants. Only the functions which are called at least
+// vsize times in a segment, and whose numerical arguments are the same in
+// all calls, are vectorised.
+template <typename T>
+auto taylor_build_vfunc_maps(llvm_state &s,
+                             const std::vector<std::vector<std::pair<expression, std::vector<std::uint32_t>>>> &s_dc,
+                             std::uint32_t n_uvars, std::uint32_t vsize)
+{
+    assert(vsize > 1u);
+
+    std::vector<std::unordered_map<llvm::Function *, taylor_c_vfunc>> retval;
+
+    for (const auto &seg : s_dc) {
+        // For each function, the index in seg of its first call,
+        // the number of calls and a flag signalling whether
+        // the numerical arguments are the same in all calls.
+        std::unordered_map<llvm::Function *, std::tuple<decltype(seg.size()), std::uint32_t, bool>> tmp_map;
+
+        for (decltype(seg.size()) i = 0; i < seg.size(); ++i) {
+            // NOTE: the scalar function was already created by
+            // taylor_build_function_maps(), here we are just
+            // looking it up.
+            auto func = taylor_c_diff_func<T>(s, seg[i].first, n_uvars, 1);
+
+            const auto [it, is_new_func] = tmp_map.try_emplace(func, i, 0, true);
+            ++std::get<1>(it->second);
+
+            if (!is_new_func && std::get<2>(it->second)) {
+                const auto cur_args = taylor_udef_to_variants(seg[i].first, seg[i].second);
+                const auto first_args
+                    = taylor_udef_to_variants(seg[std::get<0>(it->second)].first, seg[std::get<0>(it->second)].second);
+                assert(cur_args.size() == first_args.size());
+
+                for (decltype(cur_args.size()) j = 0; j < cur_args.size(); ++j) {
+                    if (std::holds_alternative<number>(cur_args[j]) && !(cur_args[j] == first_args[j])) {
+                        std::get<2>(it->second) = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        auto &a_map = retval.emplace_back();
+
+        for (const auto &[sfunc, tup] : tmp_map) {
+            if (std::get<1>(tup) < vsize || !std::get<2>(tup)) {
+                continue;
+            }
+
+            const auto &ex = seg[std::get<0>(tup)];
+
+            taylor_c_vfunc vf;
+
+            // NOTE: the structure of ex was already validated
+            // by taylor_udef_to_variants().
+            std::visit(
+                [&vf](const auto &v) {
+                    using type = detail::uncvref_t<decltype(v)>;
+
+                    if constexpr (std::is_same_v<type, func> || std::is_same_v<type, binary_operator>) {
+                        for (const auto &arg : v.args()) {
+                            std::visit(
+                                [&vf](const auto &x) {
+                                    using tp = detail::uncvref_t<decltype(x)>;
+
+                                    if constexpr (std::is_same_v<tp, variable>) {
+                                        vf.arg_kinds.push_back(0);
+                                        ++vf.n_var_slots;
+                                    } else if constexpr (std::is_same_v<tp, param>) {
+                                        vf.arg_kinds.push_back(1);
+                                        ++vf.n_par_slots;
+                                    } else {
+                                        vf.arg_kinds.push_back(2);
+                                    }
+                                },
+                                arg.value());
+                        }
+                    }
+                },
+                ex.first.value());
+
+            // The hidden deps are variables.
+            for (decltype(ex.second.size()) i = 0; i < ex.second.size(); ++i) {
+                vf.arg_kinds.push_back(0);
+                ++vf.n_var_slots;
+            }
+
+            vf.func = taylor_c_diff_func<T>(s, ex.first, vf.n_var_slots, vsize);
+            vf.n_groups = std::get<1>(tup) / vsize;
+
+            a_map.emplace(sfunc, std::move(vf));
+        }
+    }
+
+    return retval;
+}
+
 // Helper for the computation of a jet of derivatives in compact mode,
-// used in taylor_compute_jet() below.
+// used in taylor_compute_jet() below. If last_uvars is true, the derivatives
+// of order 'order' will be computed for all u variables (and not only
+// for the state variables).
 template <typename T>
 llvm::Value *taylor_compute_jet_compact_mode(llvm_state &s, llvm::Value *order0, llvm::Value *par_ptr,
                                              llvm::Value *time_ptr,
                                              const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc,
                                              std::uint32_t n_eq, std::uint32_t n_uvars, std::uint32_t order,
-                                             std::uint32_t batch_size)
+                                             std::uint32_t batch_size, bool last_uvars)
 {
     auto &builder = s.builder();
 
@@ -2371,6 +3432,14 @@ llvm::Value *taylor_compute_jet_compact_mode(llvm_state &s, llvm::Value *order0,
     // Generate the function maps.
     const auto f_maps = taylor_build_function_maps<T>(s, s_dc, n_eq, n_uvars, batch_size);
 
+    // In scalar mode, generate also the vectorised variants
+    // of the functions (if SIMD is available and it was
+    // not disabled in s).
+    const auto vsize = taylor_simd_size<T>();
+    const auto vf_maps = (batch_size == 1u && vsize > 1u && s.compact_mode_simd())
+                             ? taylor_build_vfunc_maps<T>(s, s_dc, n_uvars, vsize)
+                             : std::vector<std::unordered_map<llvm::Function *, taylor_c_vfunc>>{};
+
     // Generate the global arrays for the computation of the derivatives
     // of the state variables.
     const auto sv_diff_gl = taylor_c_make_sv_diff_globals<T>(s, dc, n_uvars);
@@ -2378,14 +3447,16 @@ llvm::Value *taylor_compute_jet_compact_mode(llvm_state &s, llvm::Value *order0,
     // Prepare the array that will contain the jet of derivatives.
     // We will be storing all the derivatives of the u variables
     // up to order 'order - 1', plus the derivatives of order
-    // 'order' of the state variables only.
+    // 'order' of the state variables only (or of all the
+    // u variables, if last_uvars is true).
     // NOTE: the array size is specified as a 64-bit integer in the
     // LLVM API.
     // NOTE: fp_type is the original, scalar floating-point type.
     // It will be turned into a vector type (if necessary) by
     // make_vector_type() below.
     auto fp_type = llvm::cast<llvm::PointerType>(order0->getType())->getElementType();
-    auto array_type = llvm::ArrayType::get(make_vector_type(fp_type, batch_size), n_uvars * order + n_eq);
+    auto array_type = llvm::ArrayType::get(make_vector_type(fp_type, batch_size),
+                                           last_uvars ? n_uvars * (order + 1u) : n_uvars * order + n_eq);
 
     // Make the global array and fetch a pointer to its first element.
     // NOTE: we use a global array rather than a local one here because
@@ -2395,6 +3466,48 @@ llvm::Value *taylor_compute_jet_compact_mode(llvm_state &s, llvm::Value *order0,
     auto diff_arr = builder.CreateInBoundsGEP(make_global_zero_array(s.module(), array_type),
                                               {builder.getInt32(0), builder.getInt32(0)});
 
+    // Prepare the small jets, the params array and the time array
+    // for the vectorised functions.
+    std::vector<std::unordered_map<llvm::Function *, llvm::Value *>> vdiff_arrs;
+    llvm::Value *vpar_arr = nullptr, *vtime_arr = nullptr;
+    std::uint32_t max_par_slots = 0;
+    bool has_vfuncs = false;
+    for (const auto &map : vf_maps) {
+        auto &a_map = vdiff_arrs.emplace_back();
+
+        for (const auto &[sfunc, vf] : map) {
+            // NOTE: the small jet contains n_groups regions, each one containing
+            // the derivatives up to order 'order' of n_var_slots variables.
+            if (vf.n_var_slots > std::numeric_limits<std::uint32_t>::max() / (order + 1u)
+                || vf.n_groups > std::numeric_limits<std::uint32_t>::max() / ((order + 1u) * vf.n_var_slots)
+                || vf.n_par_slots > std::numeric_limits<std::uint32_t>::max() / vsize) {
+                throw std::overflow_error("An overflow condition was detected in the computation of a jet of Taylor "
+                                          "derivatives in compact mode");
+            }
+
+            auto vdiff_arr_type = llvm::ArrayType::get(make_vector_type(fp_type, vsize),
+                                                       (order + 1u) * vf.n_var_slots * vf.n_groups);
+            a_map.emplace(sfunc, builder.CreateInBoundsGEP(make_global_zero_array(s.module(), vdiff_arr_type),
+                                                           {builder.getInt32(0), builder.getInt32(0)}));
+
+            max_par_slots = std::max(max_par_slots, vf.n_par_slots);
+            has_vfuncs = true;
+        }
+    }
+    if (has_vfuncs) {
+        vpar_arr = builder.CreateInBoundsGEP(
+            make_global_zero_array(s.module(), llvm::ArrayType::get(fp_type, std::max(max_par_slots, 1u) * vsize)),
+            {builder.getInt32(0), builder.getInt32(0)});
+        vtime_arr = builder.CreateInBoundsGEP(make_global_zero_array(s.module(), llvm::ArrayType::get(fp_type, vsize)),
+                                              {builder.getInt32(0), builder.getInt32(0)});
+
+        // The time array contains vsize copies of the time value.
+        auto time_val = builder.CreateLoad(time_ptr);
+        for (std::uint32_t i = 0; i < vsize; ++i) {
+            builder.CreateStore(time_val, builder.CreateInBoundsGEP(vtime_arr, {builder.getInt32(i)}));
+        }
+    }
+
     // Copy over the order-0 derivatives of the state variables.
     // NOTE: overflow checking is already done in the parent function.
     llvm_loop_u32(s, builder.getInt32(0), builder.getInt32(n_eq), [&](llvm::Value *cur_var_idx) {
@@ -2411,8 +3524,8 @@ llvm::Value *taylor_compute_jet_compact_mode(llvm_state &s, llvm::Value *order0,
     // Helper to compute and store the derivatives of order cur_order
     // of the u variables which are not state variables.
     auto compute_u_diffs = [&](llvm::Value *cur_order) {
-        for (const auto &map : f_maps) {
-            for (const auto &p : map) {
+        for (decltype(f_maps.size()) seg_idx = 0; seg_idx < f_maps.size(); ++seg_idx) {
+            for (const auto &p : f_maps[seg_idx]) {
                 // The LLVM function for the computation of the
                 // derivative in compact mpde.
                 const auto &func = p.first;
@@ -2427,8 +3540,102 @@ llvm::Value *taylor_compute_jet_compact_mode(llvm_state &s, llvm::Value *order0,
                 assert(!gens.empty());
                 assert(std::all_of(gens.begin(), gens.end(), [](const auto &f) { return static_cast<bool>(f); }));
 
-                // Loop over the number of calls.
-                llvm_loop_u32(s, builder.getInt32(0), builder.getInt32(ncalls), [&](llvm::Value *cur_call_idx) {
+                // The index of the first call which will
+                // be performed via the scalar function.
+                std::uint32_t scal_begin = 0;
+
+                if (!vf_maps.empty()) {
+                    if (const auto vit = vf_maps[seg_idx].find(func); vit != vf_maps[seg_idx].end()) {
+                        const auto &vf = vit->second;
+                        assert(vf.arg_kinds.size() + 1u == gens.size());
+                        assert(vf.n_groups == ncalls / vsize);
+
+                        // Loop over the groups of vsize calls.
+                        const auto n_groups = vf.n_groups;
+                        llvm_loop_u32(s, builder.getInt32(0), builder.getInt32(n_groups), [&](llvm::Value *cur_group) {
+                            auto base_idx = builder.CreateMul(cur_group, builder.getInt32(vsize));
+
+                            // The region of the small jet for the current group.
+                            auto vdiff_arr = builder.CreateInBoundsGEP(
+                                vdiff_arrs[seg_idx].at(func),
+                                {builder.CreateMul(cur_group, builder.getInt32((order + 1u) * vf.n_var_slots))});
+
+                            // Compute the u indices of the variables in the
+                            // slots of the small jet for each call in the group,
+                            // gather the params and build the arguments for
+                            // the vectorised function.
+                            std::vector<std::vector<llvm::Value *>> var_idx(vf.n_var_slots);
+                            std::vector<llvm::Value *> args{cur_order, builder.getInt32(0), vdiff_arr, vpar_arr,
+                                                            vtime_arr};
+                            std::uint32_t var_slot = 1, par_slot = 0;
+
+                            for (std::uint32_t j = 0; j < vsize; ++j) {
+                                var_idx[0].push_back(gens[0](builder.CreateAdd(base_idx, builder.getInt32(j))));
+                            }
+
+                            for (decltype(vf.arg_kinds.size()) i = 0; i < vf.arg_kinds.size(); ++i) {
+                                switch (vf.arg_kinds[i]) {
+                                    case 0:
+                                        for (std::uint32_t j = 0; j < vsize; ++j) {
+                                            var_idx[var_slot].push_back(
+                                                gens[i + 1u](builder.CreateAdd(base_idx, builder.getInt32(j))));
+                                        }
+                                        args.push_back(builder.getInt32(var_slot++));
+                                        break;
+                                    case 1:
+                                        for (std::uint32_t j = 0; j < vsize; ++j) {
+                                            auto par_idx
+                                                = gens[i + 1u](builder.CreateAdd(base_idx, builder.getInt32(j)));
+                                            builder.CreateStore(
+                                                builder.CreateLoad(builder.CreateInBoundsGEP(par_ptr, {par_idx})),
+                                                builder.CreateInBoundsGEP(vpar_arr,
+                                                                          {builder.getInt32(par_slot * vsize + j)}));
+                                        }
+                                        args.push_back(builder.getInt32(par_slot++));
+                                        break;
+                                    default:
+                                        // NOTE: the numerical arguments are the same in all calls.
+                                        args.push_back(gens[i + 1u](base_idx));
+                                }
+                            }
+
+                            assert(var_slot == vf.n_var_slots);
+                            assert(par_slot == vf.n_par_slots);
+
+                            // Gather the derivatives of order cur_order of the variables
+                            // in the slots other than 0. The derivatives of lower orders
+                            // were gathered in the previous orders.
+                            // NOTE: this relies on the derivatives being computed
+                            // order by order, starting from order 0.
+                            for (std::uint32_t k = 1; k < vf.n_var_slots; ++k) {
+                                llvm::Value *vec = llvm::UndefValue::get(make_vector_type(fp_type, vsize));
+                                for (std::uint32_t j = 0; j < vsize; ++j) {
+                                    vec = builder.CreateInsertElement(
+                                        vec, taylor_c_load_diff(s, diff_arr, n_uvars, cur_order, var_idx[k][j]), j);
+                                }
+                                taylor_c_store_diff(s, vdiff_arr, vf.n_var_slots, cur_order, builder.getInt32(k), vec);
+                            }
+
+                            // Compute the derivatives, store them in the slot 0
+                            // (where they will be used in the next orders) and
+                            // scatter them into the jet.
+                            // NOTE: the derivative of order cur_order of the variable
+                            // in the slot 0 is not used by the vectorised function.
+                            auto ret = builder.CreateCall(vf.func, args);
+                            taylor_c_store_diff(s, vdiff_arr, vf.n_var_slots, cur_order, builder.getInt32(0), ret);
+                            for (std::uint32_t j = 0; j < vsize; ++j) {
+                                taylor_c_store_diff(s, diff_arr, n_uvars, cur_order, var_idx[0][j],
+                                                    builder.CreateExtractElement(ret, j));
+                            }
+                        });
+
+                        scal_begin = n_groups * vsize;
+                    }
+                }
+
+                // Loop over the remaining calls.
+                llvm_loop_u32(s, builder.getInt32(scal_begin), builder.getInt32(ncalls),
+                              [&](llvm::Value *cur_call_idx) {
                     // Create the u variable index from the first generator.
                     auto u_idx = gens[0](cur_call_idx);
 
@@ -2469,6 +3676,11 @@ llvm::Value *taylor_compute_jet_compact_mode(llvm_state &s, llvm::Value *order0,
     // Compute the last-order derivatives for the state variables.
     taylor_c_compute_sv_diffs<T>(s, sv_diff_gl, diff_arr, par_ptr, n_uvars, builder.getInt32(order), batch_size);
 
+    // Compute the last-order derivatives for the other u variables, if requested.
+    if (last_uvars) {
+        compute_u_diffs(builder.getInt32(order));
+    }
+
     // Return the array of derivatives of the u variables.
     return diff_arr;
 }
@@ -2501,19 +3713,25 @@ auto taylor_load_values(llvm_state &s, llvm::Value *in, std::uint32_t n, std::ui
 // order0 is a pointer to an array of (at least) n_eq * batch_size scalar elements
 // containing the derivatives of order 0. par_ptr is a pointer to an array containing
 // the numerical values of the parameters, time_ptr a pointer to the time value(s).
+// sv_funcs_dc contains the indices, in dc, of the u variables representing
+// functions of the state variables whose jets are also requested.
 //
 // The return value is a variant containing either:
 // - in compact mode, the array containing the derivatives of all u variables,
-// - otherwise, the jet of derivatives of the state variables up to order 'order'.
+// - otherwise, the jet of derivatives of the state variables up to order 'order',
+//   followed by the jet of derivatives of the functions of the state variables
+//   up to order 'order'.
 template <typename T>
 std::variant<llvm::Value *, std::vector<llvm::Value *>>
 taylor_compute_jet(llvm_state &s, llvm::Value *order0, llvm::Value *par_ptr, llvm::Value *time_ptr,
-                   const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc, std::uint32_t n_eq,
-                   std::uint32_t n_uvars, std::uint32_t order, std::uint32_t batch_size, bool compact_mode)
+                   const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc,
+                   const std::vector<std::uint32_t> &sv_funcs_dc, std::uint32_t n_eq, std::uint32_t n_uvars,
+                   std::uint32_t order, std::uint32_t batch_size, bool compact_mode)
 {
     assert(batch_size > 0u);
     assert(n_eq > 0u);
     assert(order > 0u);
+    assert(std::all_of(sv_funcs_dc.begin(), sv_funcs_dc.end(), [n_uvars](auto idx) { return idx < n_uvars; }));
 
     // Make sure we can represent a size of n_uvars * order + n_eq as a 32-bit
     // unsigned integer. This is the total number of derivatives we will have to compute
@@ -2524,6 +3742,14 @@ taylor_compute_jet(llvm_state &s, llvm::Value *order0, llvm::Value *par_ptr, llv
             "An overflow condition was detected in the computation of a jet of Taylor derivatives");
     }
 
+    // If we need the jets of functions of the state variables, we will
+    // compute the derivatives of order 'order' for all the u variables.
+    const auto last_uvars = !sv_funcs_dc.empty();
+    if (last_uvars && n_uvars * order > std::numeric_limits<std::uint32_t>::max() - n_uvars) {
+        throw std::overflow_error(
+            "An overflow condition was detected in the computation of a jet of Taylor derivatives");
+    }
+
     // We also need to be able to index up to n_eq * batch_size in order0.
     if (n_eq > std::numeric_limits<std::uint32_t>::max() / batch_size) {
         throw std::overflow_error(
@@ -2544,7 +3770,8 @@ taylor_compute_jet(llvm_state &s, llvm::Value *order0, llvm::Value *par_ptr, llv
                 "An overflow condition was detected in the computation of a jet of Taylor derivatives in compact mode");
         }
 
-        return taylor_compute_jet_compact_mode<T>(s, order0, par_ptr, time_ptr, dc, n_eq, n_uvars, order, batch_size);
+        return taylor_compute_jet_compact_mode<T>(s, order0, par_ptr, time_ptr, dc, n_eq, n_uvars, order, batch_size,
+                                                  last_uvars);
     } else {
         // Init the derivatives array with the order 0 of the state variables.
         auto diff_arr = taylor_load_values(s, order0, n_eq, batch_size);
@@ -2582,6 +3809,14 @@ taylor_compute_jet(llvm_state &s, llvm::Value *order0, llvm::Value *par_ptr, llv
 
         assert(diff_arr.size() == static_cast<decltype(diff_arr.size())>(n_uvars) * order + n_eq);
 
+        // Compute the last-order derivatives for the other u variables, if needed.
+        if (last_uvars) {
+            for (auto i = n_eq; i < n_uvars; ++i) {
+                diff_arr.push_back(taylor_diff<T>(s, dc[i].first, dc[i].second, diff_arr, par_ptr, time_ptr, n_uvars,
+                                                  order, i, batch_size));
+            }
+        }
+
         // Extract the derivatives of the state variables from diff_arr.
         std::vector<llvm::Value *> retval;
         for (std::uint32_t o = 0; o <= order; ++o) {
@@ -2590,6 +3825,13 @@ taylor_compute_jet(llvm_state &s, llvm::Value *order0, llvm::Value *par_ptr, llv
             }
         }
 
+        // Extract the derivatives of the functions of the state variables.
+        for (std::uint32_t o = 0; o <= order; ++o) {
+            for (auto idx : sv_funcs_dc) {
+                retval.push_back(taylor_fetch_diff(diff_arr, idx, o, n_uvars));
+            }
+        }
+
         return retval;
     }
 }
@@ -2604,7 +3846,7 @@ taylor_compute_jet(llvm_state &s, llvm::Value *order0, llvm::Value *par_ptr, llv
 // NOTE: document this eventually.
 template <typename T, typename U>
 auto taylor_add_jet_impl(llvm_state &s, const std::string &name, U sys, std::uint32_t order, std::uint32_t batch_size,
-                         bool, bool compact_mode)
+                         bool, bool compact_mode, std::vector<expression> sv_funcs)
 {
     if (s.is_compiled()) {
         throw std::invalid_argument("A function for the computation of the jet of Taylor derivatives cannot be added "
@@ -2624,8 +3866,13 @@ auto taylor_add_jet_impl(llvm_state &s, const std::string &name, U sys, std::uin
     // Record the number of equations/variables.
     const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
 
+    // Record the number of functions of the state variables.
+    const auto n_sv_funcs = boost::numeric_cast<std::uint32_t>(sv_funcs.size());
+
     // Decompose the system of equations.
-    auto dc = taylor_decompose(std::move(sys));
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> dc;
+    std::vector<std::uint32_t> sv_funcs_dc;
+    std::tie(dc, sv_funcs_dc) = taylor_decompose(std::move(sys), std::move(sv_funcs));
 
     // Compute the number of u variables.
     assert(dc.size() > n_eq);
@@ -2670,18 +3917,22 @@ auto taylor_add_jet_impl(llvm_state &s, const std::string &name, U sys, std::uin
     s.builder().SetInsertPoint(bb);
 
     // Compute the jet of derivatives.
-    auto diff_variant
-        = taylor_compute_jet<T>(s, in_out, par_ptr, time_ptr, dc, n_eq, n_uvars, order, batch_size, compact_mode);
+    auto diff_variant = taylor_compute_jet<T>(s, in_out, par_ptr, time_ptr, dc, sv_funcs_dc, n_eq, n_uvars, order,
+                                              batch_size, compact_mode);
 
     // Write the derivatives to in_out.
-    // NOTE: overflow checking. We need to be able to index into the jet array (size n_eq * (order + 1) * batch_size)
-    // using uint32_t.
+    // NOTE: overflow checking. We need to be able to index into the jet array
+    // (size (n_eq + n_sv_funcs) * (order + 1) * batch_size) using uint32_t.
     if (order == std::numeric_limits<std::uint32_t>::max()
         || (order + 1u) > std::numeric_limits<std::uint32_t>::max() / batch_size
-        || n_eq > std::numeric_limits<std::uint32_t>::max() / ((order + 1u) * batch_size)) {
+        || n_sv_funcs > std::numeric_limits<std::uint32_t>::max() - n_eq
+        || n_eq + n_sv_funcs > std::numeric_limits<std::uint32_t>::max() / ((order + 1u) * batch_size)) {
         throw std::overflow_error("An overflow condition was detected while adding a Taylor jet");
     }
 
+    // The total number of variables in each order of the jet.
+    const auto n_tot = n_eq + n_sv_funcs;
+
     if (compact_mode) {
         auto diff_arr = std::get<llvm::Value *>(diff_variant);
 
@@ -2692,14 +3943,30 @@ auto taylor_add_jet_impl(llvm_state &s, const std::string &name, U sys, std::uin
                               auto diff_val = taylor_c_load_diff(s, diff_arr, n_uvars, cur_order, cur_idx);
 
                               // Compute the index in the output pointer.
-                              auto out_idx
-                                  = builder.CreateAdd(builder.CreateMul(builder.getInt32(n_eq * batch_size), cur_order),
-                                                      builder.CreateMul(cur_idx, builder.getInt32(batch_size)));
+                              auto out_idx = builder.CreateAdd(
+                                  builder.CreateMul(builder.getInt32(n_tot * batch_size), cur_order),
+                                  builder.CreateMul(cur_idx, builder.getInt32(batch_size)));
 
                               // Store into in_out.
                               store_vector_to_memory(builder, builder.CreateInBoundsGEP(in_out, {out_idx}), diff_val);
                           });
                       });
+
+        // Write out the jets of the functions of the state variables,
+        // including the order-0 values.
+        for (std::uint32_t j = 0; j < n_sv_funcs; ++j) {
+            llvm_loop_u32(
+                s, builder.getInt32(0), builder.CreateAdd(builder.getInt32(order), builder.getInt32(1)),
+                [&](llvm::Value *cur_order) {
+                    auto diff_val
+                        = taylor_c_load_diff(s, diff_arr, n_uvars, cur_order, builder.getInt32(sv_funcs_dc[j]));
+
+                    auto out_idx = builder.CreateAdd(builder.CreateMul(builder.getInt32(n_tot * batch_size), cur_order),
+                                                     builder.getInt32((n_eq + j) * batch_size));
+
+                    store_vector_to_memory(builder, builder.CreateInBoundsGEP(in_out, {out_idx}), diff_val);
+                });
+        }
     } else {
         const auto &diff_arr = std::get<std::vector<llvm::Value *>>(diff_variant);
 
@@ -2713,12 +3980,28 @@ auto taylor_add_jet_impl(llvm_state &s, const std::string &name, U sys, std::uin
                 const auto val = diff_arr[arr_idx];
 
                 // Index in the output array.
-                const auto out_idx = n_eq * batch_size * cur_order + j * batch_size;
+                const auto out_idx = n_tot * batch_size * cur_order + j * batch_size;
                 auto out_ptr
                     = builder.CreateInBoundsGEP(in_out, {builder.getInt32(static_cast<std::uint32_t>(out_idx))});
                 store_vector_to_memory(builder, out_ptr, val);
             }
         }
+
+        // Write out the jets of the functions of the state variables,
+        // including the order-0 values.
+        // NOTE: these are stored in diff_arr after the jet of
+        // the state variables.
+        for (std::uint32_t cur_order = 0; cur_order <= order; ++cur_order) {
+            for (std::uint32_t j = 0; j < n_sv_funcs; ++j) {
+                const auto arr_idx
+                    = static_cast<decltype(diff_arr.size())>(order + 1u) * n_eq + cur_order * n_sv_funcs + j;
+                assert(arr_idx < diff_arr.size());
+
+                const auto out_idx = n_tot * batch_size * cur_order + (n_eq + j) * batch_size;
+                store_vector_to_memory(builder, builder.CreateInBoundsGEP(in_out, {builder.getInt32(out_idx)}),
+                                       diff_arr[arr_idx]);
+            }
+        }
     }
 
     // Finish off the function.
@@ -2739,54 +4022,59 @@ auto taylor_add_jet_impl(llvm_state &s, const std::string &name, U sys, std::uin
 
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_dbl(llvm_state &s, const std::string &name, std::vector<expression> sys, std::uint32_t order,
-                   std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                   std::uint32_t batch_size, bool high_accuracy, bool compact_mode, std::vector<expression> sv_funcs)
 {
-    return detail::taylor_add_jet_impl<double>(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+    return detail::taylor_add_jet_impl<double>(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                               std::move(sv_funcs));
 }
 
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_ldbl(llvm_state &s, const std::string &name, std::vector<expression> sys, std::uint32_t order,
-                    std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                    std::uint32_t batch_size, bool high_accuracy, bool compact_mode, std::vector<expression> sv_funcs)
 {
     return detail::taylor_add_jet_impl<long double>(s, name, std::move(sys), order, batch_size, high_accuracy,
-                                                    compact_mode);
+                                                    compact_mode, std::move(sv_funcs));
 }
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_f128(llvm_state &s, const std::string &name, std::vector<expression> sys, std::uint32_t order,
-                    std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                    std::uint32_t batch_size, bool high_accuracy, bool compact_mode, std::vector<expression> sv_funcs)
 {
     return detail::taylor_add_jet_impl<mppp::real128>(s, name, std::move(sys), order, batch_size, high_accuracy,
-                                                      compact_mode);
+                                                      compact_mode, std::move(sv_funcs));
 }
 
 #endif
 
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_dbl(llvm_state &s, const std::string &name, std::vector<std::pair<expression, expression>> sys,
-                   std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                   std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                   std::vector<expression> sv_funcs)
 {
-    return detail::taylor_add_jet_impl<double>(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode);
+    return detail::taylor_add_jet_impl<double>(s, name, std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                               std::move(sv_funcs));
 }
 
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_ldbl(llvm_state &s, const std::string &name, std::vector<std::pair<expression, expression>> sys,
-                    std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                    std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                    std::vector<expression> sv_funcs)
 {
     return detail::taylor_add_jet_impl<long double>(s, name, std::move(sys), order, batch_size, high_accuracy,
-                                                    compact_mode);
+                                                    compact_mode, std::move(sv_funcs));
 }
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 std::vector<std::pair<expression, std::vector<std::uint32_t>>>
 taylor_add_jet_f128(llvm_state &s, const std::string &name, std::vector<std::pair<expression, expression>> sys,
-                    std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                    std::uint32_t order, std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                    std::vector<expression> sv_funcs)
 {
     return detail::taylor_add_jet_impl<mppp::real128>(s, name, std::move(sys), order, batch_size, high_accuracy,
-                                                      compact_mode);
+                                                      compact_mode, std::move(sv_funcs));
 }
 
 #endif
@@ -3400,6 +4688,66 @@ void taylor_run_ceval_state_updater(llvm_state &s, llvm::Value *jet_ptr, llvm::V
     }
 }
 
+// Write the new state computed by taylor_run_ceval()/taylor_run_multihorner()
+// into state_ptr.
+// NOTE: no need to perform overflow check on n_eq * batch_size,
+// as in taylor_compute_jet() we already checked.
+void taylor_write_new_state(llvm_state &s, const std::variant<llvm::Value *, std::vector<llvm::Value *>> &new_state_var,
+                            llvm::Value *state_ptr, std::uint32_t n_eq, std::uint32_t batch_size, bool compact_mode)
+{
+    auto &builder = s.builder();
+
+    if (compact_mode) {
+        auto new_state = std::get<llvm::Value *>(new_state_var);
+
+        llvm_loop_u32(s, builder.getInt32(0), builder.getInt32(n_eq), [&](llvm::Value *cur_var_idx) {
+            auto val = builder.CreateLoad(builder.CreateInBoundsGEP(new_state, {cur_var_idx}));
+            store_vector_to_memory(
+                builder,
+                builder.CreateInBoundsGEP(state_ptr, builder.CreateMul(cur_var_idx, builder.getInt32(batch_size))),
+                val);
+        });
+    } else {
+        const auto &new_state = std::get<std::vector<llvm::Value *>>(new_state_var);
+
+        assert(new_state.size() == n_eq);
+
+        for (std::uint32_t var_idx = 0; var_idx < n_eq; ++var_idx) {
+            store_vector_to_memory(builder,
+                                   builder.CreateInBoundsGEP(state_ptr, builder.getInt32(var_idx * batch_size)),
+                                   new_state[var_idx]);
+        }
+    }
+}
+
+// Determine the Taylor order corresponding to the (positive and finite) tolerance tol.
+template <typename T>
+std::uint32_t taylor_order_from_tol(T tol)
+{
+    using std::ceil;
+    using std::isfinite;
+    using std::log;
+
+    assert(isfinite(tol) && tol > 0);
+
+    auto order_f = ceil(-log(tol) / 2 + 1);
+    if (!isfinite(order_f)) {
+        throw std::invalid_argument(
+            "The computation of the Taylor order from the tolerance produced a non-finite value");
+    }
+    // NOTE: min order is 2.
+    order_f = std::max(T(2), order_f);
+
+    // NOTE: static cast is safe because we know that T is at least
+    // a double-precision IEEE type.
+    if (order_f > static_cast<T>(std::numeric_limits<std::uint32_t>::max())) {
+        throw std::overflow_error(
+            "The computation of the Taylor order from the tolerance resulted in an overflow condition");
+    }
+
+    return static_cast<std::uint32_t>(order_f);
+}
+
 // NOTE: in compact mode, care must be taken when adding multiple stepper functions to the same llvm state
 // with the same floating-point type, batch size and number of u variables. The potential issue there
 // is that when the first stepper is added, the compact mode AD functions are created and then optimised.
@@ -3409,15 +4757,22 @@ void taylor_run_ceval_state_updater(llvm_state &s, llvm::Value *jet_ptr, llvm::V
 // in the state, add the 2 steppers and then run a single optimisation pass.
 // NOTE: document this eventually.
 // NOTE: this is not an issue in the Taylor integrators, where we are certain that only 1 stepper
-// is ever added to the LLVM state.
-template <typename T, typename U>
-auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys, T tol, std::uint32_t batch_size,
-                                   bool high_accuracy, bool compact_mode)
+// is ever added to the LLVM state (apart from the variable-order mode, which uses the workaround).
+// NOTE: if vo_order is nonzero, it will be used as the Taylor order instead of the order
+// deduced from the tolerance. In this case, the tolerance appears explicitly in the estimation
+// of the timestep, because it is not implied anymore by the order.
+// NOTE: this overload takes as input the Taylor decomposition dc of a system with n_eq equations,
+// and the indices sv_funcs_dc of the functions of the state variables in dc. It returns the order
+// of the stepper.
+template <typename T>
+std::uint32_t taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name,
+                                            const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc,
+                                            const std::vector<std::uint32_t> &sv_funcs_dc, std::uint32_t n_eq, T tol,
+                                            std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                                            const std::vector<T> &weights, std::uint32_t vo_order = 0)
 {
-    using std::ceil;
     using std::exp;
     using std::isfinite;
-    using std::log;
 
     if (s.is_compiled()) {
         throw std::invalid_argument("An adaptive Taylor stepper cannot be added to an llvm_state after compilation");
@@ -3433,33 +4788,47 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
             + " instead");
     }
 
-    // Determine the order from the tolerance.
-    auto order_f = ceil(-log(tol) / 2 + 1);
-    if (!isfinite(order_f)) {
-        throw std::invalid_argument(
-            "The computation of the Taylor order in an adaptive Taylor stepper produced a non-finite value");
+    // Determine the order from the tolerance, if
+    // an explicit order was not provided.
+    const auto order = (vo_order == 0u) ? taylor_order_from_tol(tol) : vo_order;
+    if (order < 2u) {
+        throw std::invalid_argument("The order of an adaptive Taylor stepper must be at least 2, but it is "
+                                    + std::to_string(order) + " instead");
     }
-    // NOTE: min order is 2.
-    order_f = std::max(T(2), order_f);
 
-    // NOTE: static cast is safe because we know that T is at least
-    // a double-precision IEEE type.
-    if (order_f > static_cast<T>(std::numeric_limits<std::uint32_t>::max())) {
-        throw std::overflow_error("The computation of the Taylor order in an adaptive Taylor stepper resulted "
-                                  "in an overflow condition");
-    }
-    const auto order = static_cast<std::uint32_t>(order_f);
+    // Check the weights.
+    if (!weights.empty()) {
+        if (weights.size() != n_eq) {
+            throw std::invalid_argument("The number of weights in an adaptive Taylor stepper ("
+                                        + std::to_string(weights.size())
+                                        + ") differs from the number of equations (" + std::to_string(n_eq) + ")");
+        }
 
-    // Record the number of equations/variables.
-    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
+        for (const auto &w : weights) {
+            if (!isfinite(w) || w <= 0) {
+                throw std::invalid_argument(
+                    "The weights in an adaptive Taylor stepper must be finite and positive, but a weight of "
+                    + li_to_string(w) + " was detected");
+            }
+        }
+    }
 
-    // Decompose the system of equations.
-    auto dc = taylor_decompose(std::move(sys));
+    // Record the number of functions of the state variables.
+    const auto n_sv_funcs = boost::numeric_cast<std::uint32_t>(sv_funcs_dc.size());
 
     // Compute the number of u variables.
     assert(dc.size() > n_eq);
     const auto n_uvars = boost::numeric_cast<std::uint32_t>(dc.size() - n_eq);
 
+    // NOTE: we need to be able to index into the Taylor coefficients
+    // output (size (n_eq + n_sv_funcs) * (order + 1) * batch_size) using uint32_t.
+    if (order == std::numeric_limits<std::uint32_t>::max()
+        || (order + 1u) > std::numeric_limits<std::uint32_t>::max() / batch_size
+        || n_sv_funcs > std::numeric_limits<std::uint32_t>::max() - n_eq
+        || n_eq + n_sv_funcs > std::numeric_limits<std::uint32_t>::max() / ((order + 1u) * batch_size)) {
+        throw std::overflow_error("An overflow condition was detected while adding an adaptive Taylor stepper");
+    }
+
     auto &builder = s.builder();
     auto &context = s.context();
 
@@ -3518,47 +4887,79 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
     // Compute the jet of derivatives at the given order.
     // NOTE: in taylor_compute_jet() we ensure that n_uvars * order + n_eq
     // is representable as a 32-bit unsigned integer.
-    auto diff_variant
-        = taylor_compute_jet<T>(s, state_ptr, par_ptr, time_ptr, dc, n_eq, n_uvars, order, batch_size, compact_mode);
+    auto diff_variant = taylor_compute_jet<T>(s, state_ptr, par_ptr, time_ptr, dc, sv_funcs_dc, n_eq, n_uvars, order,
+                                              batch_size, compact_mode);
 
     llvm::Value *max_abs_state, *max_abs_diff_o, *max_abs_diff_om1;
 
     if (compact_mode) {
         auto diff_arr = std::get<llvm::Value *>(diff_variant);
 
-        // Compute the norm infinity of the state vector and the norm infinity of the derivatives
-        // at orders order and order - 1.
+        // Compute the norm infinity of the weighted state vector and the norm infinity of the weighted
+        // derivatives at orders order and order - 1.
         max_abs_state = builder.CreateAlloca(to_llvm_vector_type<T>(context, batch_size));
         max_abs_diff_o = builder.CreateAlloca(to_llvm_vector_type<T>(context, batch_size));
         max_abs_diff_om1 = builder.CreateAlloca(to_llvm_vector_type<T>(context, batch_size));
 
+        // Helper to apply the weight of the state variable
+        // at index var_idx to the value x.
+        // NOTE: the weights are stored in a global read-only array.
+        llvm::Value *g_weights = nullptr;
+        if (!weights.empty()) {
+            std::vector<llvm::Constant *> w_consts;
+            for (const auto &w : weights) {
+                w_consts.push_back(llvm::cast<llvm::Constant>(codegen<T>(s, number{w})));
+            }
+
+            auto w_arr_type = llvm::ArrayType::get(to_llvm_type<T>(context), n_eq);
+            auto w_arr = llvm::ConstantArray::get(w_arr_type, w_consts);
+            g_weights = new llvm::GlobalVariable(s.module(), w_arr->getType(), true,
+                                                 llvm::GlobalVariable::InternalLinkage, w_arr);
+        }
+        auto weigh = [&](llvm::Value *x, llvm::Value *var_idx) -> llvm::Value * {
+            if (g_weights == nullptr) {
+                return x;
+            }
+
+            auto w = builder.CreateLoad(builder.CreateInBoundsGEP(g_weights, {builder.getInt32(0), var_idx}));
+
+            return builder.CreateFMul(x, vector_splat(builder, w, batch_size));
+        };
+
         // Initialise with the abs(derivatives) of the first state variable at orders 0, 'order' and 'order - 1'.
         builder.CreateStore(
-            taylor_step_abs(s, builder.CreateLoad(builder.CreateInBoundsGEP(diff_arr, {builder.getInt32(0)}))),
+            taylor_step_abs(s, weigh(builder.CreateLoad(builder.CreateInBoundsGEP(diff_arr, {builder.getInt32(0)})),
+                                     builder.getInt32(0))),
             max_abs_state);
         // NOTE: in compact mode diff_arr contains the derivatives for *all* uvars,
         // hence the indexing is order * n_uvars.
-        builder.CreateStore(taylor_step_abs(s, builder.CreateLoad(builder.CreateInBoundsGEP(
-                                                   diff_arr, {builder.getInt32(order * n_uvars)}))),
+        builder.CreateStore(taylor_step_abs(s, weigh(builder.CreateLoad(builder.CreateInBoundsGEP(
+                                                         diff_arr, {builder.getInt32(order * n_uvars)})),
+                                                     builder.getInt32(0))),
                             max_abs_diff_o);
-        builder.CreateStore(taylor_step_abs(s, builder.CreateLoad(builder.CreateInBoundsGEP(
-                                                   diff_arr, {builder.getInt32((order - 1u) * n_uvars)}))),
+        builder.CreateStore(taylor_step_abs(s, weigh(builder.CreateLoad(builder.CreateInBoundsGEP(
+                                                         diff_arr, {builder.getInt32((order - 1u) * n_uvars)})),
+                                                     builder.getInt32(0))),
                             max_abs_diff_om1);
 
         llvm_loop_u32(s, builder.getInt32(1), builder.getInt32(n_eq), [&](llvm::Value *cur_idx) {
-            builder.CreateStore(taylor_step_maxabs(s, builder.CreateLoad(max_abs_state),
-                                                   builder.CreateLoad(builder.CreateInBoundsGEP(diff_arr, {cur_idx}))),
-                                max_abs_state);
             builder.CreateStore(
-                taylor_step_maxabs(s, builder.CreateLoad(max_abs_diff_o),
-                                   builder.CreateLoad(builder.CreateInBoundsGEP(
-                                       diff_arr, {builder.CreateAdd(builder.getInt32(order * n_uvars), cur_idx)}))),
+                taylor_step_maxabs(s, builder.CreateLoad(max_abs_state),
+                                   weigh(builder.CreateLoad(builder.CreateInBoundsGEP(diff_arr, {cur_idx})), cur_idx)),
+                max_abs_state);
+            builder.CreateStore(
+                taylor_step_maxabs(
+                    s, builder.CreateLoad(max_abs_diff_o),
+                    weigh(builder.CreateLoad(builder.CreateInBoundsGEP(
+                              diff_arr, {builder.CreateAdd(builder.getInt32(order * n_uvars), cur_idx)})),
+                          cur_idx)),
                 max_abs_diff_o);
             builder.CreateStore(
                 taylor_step_maxabs(
                     s, builder.CreateLoad(max_abs_diff_om1),
-                    builder.CreateLoad(builder.CreateInBoundsGEP(
-                        diff_arr, {builder.CreateAdd(builder.getInt32((order - 1u) * n_uvars), cur_idx)}))),
+                    weigh(builder.CreateLoad(builder.CreateInBoundsGEP(
+                              diff_arr, {builder.CreateAdd(builder.getInt32((order - 1u) * n_uvars), cur_idx)})),
+                          cur_idx)),
                 max_abs_diff_om1);
         });
 
@@ -3569,17 +4970,27 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
     } else {
         const auto &diff_arr = std::get<std::vector<llvm::Value *>>(diff_variant);
 
-        // Compute the norm infinity of the state vector and the norm infinity of the derivatives
-        // at orders order and order - 1.
-        max_abs_state = taylor_step_abs(s, diff_arr[0]);
+        // Helper to apply the weight of the state variable
+        // at index var_idx to the value x.
+        auto weigh = [&](llvm::Value *x, std::uint32_t var_idx) -> llvm::Value * {
+            if (weights.empty()) {
+                return x;
+            }
+
+            return builder.CreateFMul(x, vector_splat(builder, codegen<T>(s, number{weights[var_idx]}), batch_size));
+        };
+
+        // Compute the norm infinity of the weighted state vector and the norm infinity of the weighted
+        // derivatives at orders order and order - 1.
+        max_abs_state = taylor_step_abs(s, weigh(diff_arr[0], 0));
         // NOTE: in non-compact mode, diff_arr contains the derivatives only of the
         // state variables (not all u vars), hence the indexing is order * n_eq.
-        max_abs_diff_o = taylor_step_abs(s, diff_arr[order * n_eq]);
-        max_abs_diff_om1 = taylor_step_abs(s, diff_arr[(order - 1u) * n_eq]);
+        max_abs_diff_o = taylor_step_abs(s, weigh(diff_arr[order * n_eq], 0));
+        max_abs_diff_om1 = taylor_step_abs(s, weigh(diff_arr[(order - 1u) * n_eq], 0));
         for (std::uint32_t i = 1; i < n_eq; ++i) {
-            max_abs_state = taylor_step_maxabs(s, max_abs_state, diff_arr[i]);
-            max_abs_diff_o = taylor_step_maxabs(s, max_abs_diff_o, diff_arr[order * n_eq + i]);
-            max_abs_diff_om1 = taylor_step_maxabs(s, max_abs_diff_om1, diff_arr[(order - 1u) * n_eq + i]);
+            max_abs_state = taylor_step_maxabs(s, max_abs_state, weigh(diff_arr[i], i));
+            max_abs_diff_o = taylor_step_maxabs(s, max_abs_diff_o, weigh(diff_arr[order * n_eq + i], i));
+            max_abs_diff_om1 = taylor_step_maxabs(s, max_abs_diff_om1, weigh(diff_arr[(order - 1u) * n_eq + i], i));
         }
     }
 
@@ -3590,6 +5001,9 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
     // Estimate rho at orders order - 1 and order.
     auto num_rho
         = builder.CreateSelect(abs_or_rel, vector_splat(builder, codegen<T>(s, number{1.}), batch_size), max_abs_state);
+    if (vo_order != 0u) {
+        num_rho = builder.CreateFMul(num_rho, vector_splat(builder, codegen<T>(s, number{tol}), batch_size));
+    }
     auto rho_o = taylor_step_pow(s, builder.CreateFDiv(num_rho, max_abs_diff_o),
                                  vector_splat(builder, codegen<T>(s, number{T(1) / order}), batch_size));
     auto rho_om1 = taylor_step_pow(s, builder.CreateFDiv(num_rho, max_abs_diff_om1),
@@ -3599,7 +5013,10 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
     auto rho_m = taylor_step_min(s, rho_o, rho_om1);
 
     // Compute the scaling + safety factor.
-    const auto rhofac = exp((T(-7) / T(10)) / (order - 1u)) / (exp(T(1)) * exp(T(1)));
+    // NOTE: the 1 / e**2 scaling accounts for the tolerance
+    // implied by the order deduced from the tolerance.
+    const auto rhofac = (vo_order == 0u) ? exp((T(-7) / T(10)) / (order - 1u)) / (exp(T(1)) * exp(T(1)))
+                                         : exp((T(-7) / T(10)) / (order - 1u));
 
     // Determine the step size in absolute value.
     auto h = builder.CreateFMul(rho_m, vector_splat(builder, codegen<T>(s, number{rhofac}), batch_size));
@@ -3621,29 +5038,7 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
               : taylor_run_multihorner(s, diff_variant, h, n_eq, n_uvars, order, batch_size, compact_mode);
 
     // Store the new state.
-    // NOTE: no need to perform overflow check on n_eq * batch_size,
-    // as in taylor_compute_jet() we already checked.
-    if (compact_mode) {
-        auto new_state = std::get<llvm::Value *>(new_state_var);
-
-        llvm_loop_u32(s, builder.getInt32(0), builder.getInt32(n_eq), [&](llvm::Value *cur_var_idx) {
-            auto val = builder.CreateLoad(builder.CreateInBoundsGEP(new_state, {cur_var_idx}));
-            store_vector_to_memory(
-                builder,
-                builder.CreateInBoundsGEP(state_ptr, builder.CreateMul(cur_var_idx, builder.getInt32(batch_size))),
-                val);
-        });
-    } else {
-        const auto &new_state = std::get<std::vector<llvm::Value *>>(new_state_var);
-
-        assert(new_state.size() == n_eq);
-
-        for (std::uint32_t var_idx = 0; var_idx < n_eq; ++var_idx) {
-            store_vector_to_memory(builder,
-                                   builder.CreateInBoundsGEP(state_ptr, builder.getInt32(var_idx * batch_size)),
-                                   new_state[var_idx]);
-        }
-    }
+    taylor_write_new_state(s, new_state_var, state_ptr, n_eq, batch_size, compact_mode);
 
     // Store the timesteps that were used.
     store_vector_to_memory(builder, h_ptr, h);
@@ -3674,6 +5069,23 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
                             store_vector_to_memory(builder, builder.CreateInBoundsGEP(tc_ptr, {out_idx}), diff_val);
                         });
                 });
+
+                // Copy the Taylor coefficients for the functions
+                // of the state variables.
+                for (std::uint32_t j = 0; j < n_sv_funcs; ++j) {
+                    llvm_loop_u32(
+                        s, builder.getInt32(0), builder.CreateAdd(builder.getInt32(order), builder.getInt32(1)),
+                        [&](llvm::Value *cur_order) {
+                            auto diff_val
+                                = taylor_c_load_diff(s, diff_arr, n_uvars, cur_order, builder.getInt32(sv_funcs_dc[j]));
+
+                            auto out_idx
+                                = builder.CreateAdd(builder.getInt32((order + 1u) * batch_size * (n_eq + j)),
+                                                    builder.CreateMul(cur_order, builder.getInt32(batch_size)));
+
+                            store_vector_to_memory(builder, builder.CreateInBoundsGEP(tc_ptr, {out_idx}), diff_val);
+                        });
+                }
             } else {
                 const auto &diff_arr = std::get<std::vector<llvm::Value *>>(diff_variant);
 
@@ -3695,6 +5107,23 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
                         store_vector_to_memory(builder, out_ptr, val);
                     }
                 }
+
+                // Copy the Taylor coefficients for the functions
+                // of the state variables.
+                // NOTE: these are stored in diff_arr after the jet
+                // of the state variables.
+                for (std::uint32_t j = 0; j < n_sv_funcs; ++j) {
+                    for (std::uint32_t cur_order = 0; cur_order <= order; ++cur_order) {
+                        const auto arr_idx
+                            = static_cast<decltype(diff_arr.size())>(order + 1u) * n_eq + cur_order * n_sv_funcs + j;
+                        assert(arr_idx < diff_arr.size());
+
+                        const auto out_idx = (order + 1u) * batch_size * (n_eq + j) + cur_order * batch_size;
+
+                        store_vector_to_memory(builder, builder.CreateInBoundsGEP(tc_ptr, {builder.getInt32(out_idx)}),
+                                               diff_arr[arr_idx]);
+                    }
+                }
             }
         },
         [&]() {
@@ -3711,6 +5140,25 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
     // Run the optimisation pass.
     s.optimise();
 
+    return order;
+}
+
+template <typename T, typename U>
+auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys, T tol, std::uint32_t batch_size,
+                                   bool high_accuracy, bool compact_mode, std::vector<expression> sv_funcs,
+                                   std::vector<T> weights)
+{
+    // Record the number of equations/variables.
+    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
+
+    // Decompose the system of equations.
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> dc;
+    std::vector<std::uint32_t> sv_funcs_dc;
+    std::tie(dc, sv_funcs_dc) = taylor_decompose(std::move(sys), std::move(sv_funcs));
+
+    const auto order = taylor_add_adaptive_step_impl<T>(s, name, dc, sv_funcs_dc, n_eq, tol, batch_size,
+                                                        high_accuracy, compact_mode, weights);
+
     return std::tuple{std::move(dc), order};
 }
 
@@ -3720,47 +5168,52 @@ auto taylor_add_adaptive_step_impl(llvm_state &s, const std::string &name, U sys
 
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_dbl(llvm_state &s, const std::string &name, std::vector<expression> sys, double tol,
-                             std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                             std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                             std::vector<expression> sv_funcs, std::vector<double> weights)
 {
     return detail::taylor_add_adaptive_step_impl<double>(s, name, std::move(sys), tol, batch_size, high_accuracy,
-                                                         compact_mode);
+                                                         compact_mode, std::move(sv_funcs), std::move(weights));
 }
 
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_ldbl(llvm_state &s, const std::string &name, std::vector<expression> sys, long double tol,
-                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                              std::vector<expression> sv_funcs, std::vector<long double> weights)
 {
     return detail::taylor_add_adaptive_step_impl<long double>(s, name, std::move(sys), tol, batch_size, high_accuracy,
-                                                              compact_mode);
+                                                              compact_mode, std::move(sv_funcs), std::move(weights));
 }
 
 #if defined(HEYOKA_HAVE_REAL128)
 
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_f128(llvm_state &s, const std::string &name, std::vector<expression> sys, mppp::real128 tol,
-                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                              std::vector<expression> sv_funcs, std::vector<mppp::real128> weights)
 {
     return detail::taylor_add_adaptive_step_impl<mppp::real128>(s, name, std::move(sys), tol, batch_size, high_accuracy,
-                                                                compact_mode);
+                                                                compact_mode, std::move(sv_funcs), std::move(weights));
 }
 
 #endif
 
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_dbl(llvm_state &s, const std::string &name, std::vector<std::pair<expression, expression>> sys,
-                             double tol, std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                             double tol, std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                             std::vector<expression> sv_funcs, std::vector<double> weights)
 {
     return detail::taylor_add_adaptive_step_impl<double>(s, name, std::move(sys), tol, batch_size, high_accuracy,
-                                                         compact_mode);
+                                                         compact_mode, std::move(sv_funcs), std::move(weights));
 }
 
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_ldbl(llvm_state &s, const std::string &name,
                               std::vector<std::pair<expression, expression>> sys, long double tol,
-                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                              std::vector<expression> sv_funcs, std::vector<long double> weights)
 {
     return detail::taylor_add_adaptive_step_impl<long double>(s, name, std::move(sys), tol, batch_size, high_accuracy,
-                                                              compact_mode);
+                                                              compact_mode, std::move(sv_funcs), std::move(weights));
 }
 
 #if defined(HEYOKA_HAVE_REAL128)
@@ -3768,10 +5221,11 @@ taylor_add_adaptive_step_ldbl(llvm_state &s, const std::string &name,
 std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::uint32_t>
 taylor_add_adaptive_step_f128(llvm_state &s, const std::string &name,
                               std::vector<std::pair<expression, expression>> sys, mppp::real128 tol,
-                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
+                              std::uint32_t batch_size, bool high_accuracy, bool compact_mode,
+                              std::vector<expression> sv_funcs, std::vector<mppp::real128> weights)
 {
     return detail::taylor_add_adaptive_step_impl<mppp::real128>(s, name, std::move(sys), tol, batch_size, high_accuracy,
-                                                                compact_mode);
+                                                                compact_mode, std::move(sv_funcs), std::move(weights));
 }
 
 #endif
@@ -3885,7 +5339,8 @@ auto taylor_add_custom_step_impl(llvm_state &s, const std::string &name, U sys,
     od.emplace(s);
 
     // Add the function for the computation of the jet of derivatives.
-    auto dc = taylor_add_jet_impl<T>(s, name + "_jet", std::move(sys), order, batch_size, high_accuracy, compact_mode);
+    auto dc = taylor_add_jet_impl<T>(s, name + "_jet", std::move(sys), order, batch_size, high_accuracy, compact_mode,
+                                     {});
 
     // Add the function for the state update.
     taylor_add_state_updater_impl<T>(s, name + "_updater", n_vars, order, batch_size, high_accuracy, compact_mode);
@@ -3899,6 +5354,99 @@ auto taylor_add_custom_step_impl(llvm_state &s, const std::string &name, U sys,
     return dc;
 }
 
+// Add to s the scalar steppers for the variable-order mode of the adaptive
+// integrator. The candidate orders are spaced by 2 around the order deduced
+// from the tolerance, and the stepper at order k is named "step_o<k>".
+// The return values are the Taylor decomposition (which is computed
+// once and used for all the steppers), the candidate orders and the
+// index of the order deduced from the tolerance.
+// NOTE: the steppers are added with the optimisations disabled, and
+// a single optimisation pass is run at the end. This allows the steppers
+// to share the AD functions in compact mode (see the notes in
+// taylor_add_adaptive_step_impl()).
+template <typename T, typename U>
+std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>, std::size_t>
+taylor_add_vo_steppers(llvm_state &s, U sys, T tol, bool high_accuracy, bool compact_mode,
+                       const std::vector<expression> &sv_funcs, const std::vector<T> &weights)
+{
+    const auto order = taylor_order_from_tol(tol);
+    if (order > std::numeric_limits<std::uint32_t>::max() - 4u) {
+        throw std::overflow_error("An overflow condition was detected in the computation of the candidate orders "
+                                  "for the variable-order mode of an adaptive Taylor integrator");
+    }
+
+    // Determine the candidate orders.
+    std::vector<std::uint32_t> orders;
+    std::size_t nom_idx = 0;
+    for (std::uint32_t i = 0; i < 5u; ++i) {
+        if (order + 2u * i >= 6u) {
+            if (i == 2u) {
+                nom_idx = orders.size();
+            }
+
+            orders.push_back(order + 2u * i - 4u);
+        }
+    }
+
+    // Decompose the system of equations.
+    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> dc;
+    std::vector<std::uint32_t> sv_funcs_dc;
+    std::tie(dc, sv_funcs_dc) = taylor_decompose(std::move(sys), sv_funcs);
+
+    // Temporarily disable optimisations in s.
+    std::optional<opt_disabler> od;
+    od.emplace(s);
+
+    for (auto k : orders) {
+        taylor_add_adaptive_step_impl<T>(s, "step_o" + std::to_string(k), dc, sv_funcs_dc, n_eq, tol, 1, high_accuracy,
+                                         compact_mode, weights, k);
+    }
+
+    // Restore the original optimisation level in s.
+    od.reset();
+
+    // Run the optimisation pass.
+    s.optimise();
+
+    return std::tuple{std::move(dc), std::move(orders), nom_idx};
+}
+
+// Add to s the scalar steppers for the tolerances tols of an adaptive integrator.
+// The stepper for the tolerance at index i is named "step_t<i>". The return values
+// are the Taylor decomposition (which is computed once and used for all the steppers)
+// and the orders of the steppers.
+// NOTE: the same caveats about compact mode of taylor_add_vo_steppers() apply.
+template <typename T, typename U>
+std::tuple<std::vector<std::pair<expression, std::vector<std::uint32_t>>>, std::vector<std::uint32_t>>
+taylor_add_mt_steppers(llvm_state &s, U sys, const std::vector<T> &tols, bool high_accuracy, bool compact_mode,
+                       const std::vector<expression> &sv_funcs, const std::vector<T> &weights)
+{
+    // Decompose the system of equations.
+    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
+    std::vector<std::pair<expression, std::vector<std::uint32_t>>> dc;
+    std::vector<std::uint32_t> sv_funcs_dc;
+    std::tie(dc, sv_funcs_dc) = taylor_decompose(std::move(sys), sv_funcs);
+
+    // Temporarily disable optimisations in s.
+    std::optional<opt_disabler> od;
+    od.emplace(s);
+
+    std::vector<std::uint32_t> orders;
+    for (decltype(tols.size()) i = 0; i < tols.size(); ++i) {
+        orders.push_back(taylor_add_adaptive_step_impl<T>(s, "step_t" + std::to_string(i), dc, sv_funcs_dc, n_eq,
+                                                          tols[i], 1, high_accuracy, compact_mode, weights));
+    }
+
+    // Restore the original optimisation level in s.
+    od.reset();
+
+    // Run the optimisation pass.
+    s.optimise();
+
+    return std::tuple{std::move(dc), std::move(orders)};
+}
+
 } // namespace
 
 } // namespace detail
@@ -3965,135 +5513,1293 @@ namespace detail
 namespace
 {
 
-// Implementation of the streaming operator for the scalar integrators.
-template <typename T>
-std::ostream &taylor_adaptive_stream_impl(std::ostream &os, const taylor_adaptive_impl<T> &ta)
+// Add to s a function, called name, which advances the state of the ODE system sys
+// by k fixed steps of size h, using Taylor polynomials of order order.
+// NOTE: the same caveats about compact mode of taylor_add_adaptive_step_impl() apply.
+template <typename T, typename U>
+auto taylor_add_fixed_step_impl(llvm_state &s, const std::string &name, U sys, std::uint32_t order,
+                                std::uint32_t batch_size, bool high_accuracy, bool compact_mode)
 {
-    std::ostringstream oss;
-    oss.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-    oss.imbue(std::locale::classic());
-    oss << std::showpoint;
-    oss.precision(std::numeric_limits<T>::max_digits10);
+    if (s.is_compiled()) {
+        throw std::invalid_argument("A fixed-step Taylor stepper cannot be added to an llvm_state after compilation");
+    }
 
-    oss << "Taylor order: " << ta.get_order() << '\n';
-    oss << "Dimension   : " << ta.get_dim() << '\n';
-    oss << "Time        : " << ta.get_time() << '\n';
-    oss << "State       : [";
-    for (decltype(ta.get_state().size()) i = 0; i < ta.get_state().size(); ++i) {
-        oss << ta.get_state()[i];
-        if (i != ta.get_state().size() - 1u) {
-            oss << ", ";
-        }
+    if (batch_size == 0u) {
+        throw std::invalid_argument("The batch size of a Taylor stepper cannot be zero");
     }
-    oss << "]\n";
 
-    if (!ta.get_pars().empty()) {
-        oss << "Parameters  : [";
-        for (decltype(ta.get_pars().size()) i = 0; i < ta.get_pars().size(); ++i) {
-            oss << ta.get_pars()[i];
-            if (i != ta.get_pars().size() - 1u) {
-                oss << ", ";
-            }
-        }
-        oss << "]\n";
+    if (order == 0u) {
+        throw std::invalid_argument("The order of a fixed-step Taylor stepper cannot be zero");
     }
 
-    return os << oss.str();
-}
+    // Record the number of equations/variables.
+    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
 
-// Implementation of the streaming operator for the batch integrators.
-template <typename T>
-std::ostream &taylor_adaptive_batch_stream_impl(std::ostream &os, const taylor_adaptive_batch_impl<T> &ta)
-{
-    std::ostringstream oss;
-    oss.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-    oss.imbue(std::locale::classic());
-    oss << std::showpoint;
-    oss.precision(std::numeric_limits<T>::max_digits10);
+    // Decompose the system of equations.
+    auto dc = taylor_decompose(std::move(sys));
 
-    oss << "Taylor order: " << ta.get_order() << '\n';
-    oss << "Dimension   : " << ta.get_dim() << '\n';
-    oss << "Batch size  : " << ta.get_batch_size() << '\n';
-    oss << "Time        : [";
-    for (decltype(ta.get_time().size()) i = 0; i < ta.get_time().size(); ++i) {
-        oss << ta.get_time()[i];
-        if (i != ta.get_time().size() - 1u) {
-            oss << ", ";
-        }
-    }
-    oss << "]\n";
-    oss << "State       : [";
-    for (decltype(ta.get_state().size()) i = 0; i < ta.get_state().size(); ++i) {
-        oss << ta.get_state()[i];
-        if (i != ta.get_state().size() - 1u) {
-            oss << ", ";
-        }
+    // Compute the number of u variables.
+    assert(dc.size() > n_eq);
+    const auto n_uvars = boost::numeric_cast<std::uint32_t>(dc.size() - n_eq);
+
+    auto &builder = s.builder();
+    auto fp_ptr_t = llvm::PointerType::getUnqual(to_llvm_type<T>(s.context()));
+
+    // Temporarily disable optimisations in s, so that
+    // the single-step function is optimised only after
+    // the loop function has been added.
+    std::optional<opt_disabler> od;
+    od.emplace(s);
+
+    // Add the function for a single step. The arguments are:
+    // - pointer to the current state vector (read & write),
+    // - pointer to the parameters (read only),
+    // - pointer to the time value(s) (read only),
+    // - pointer to the timestep(s) (read only).
+    // NOTE: the function has internal linkage, so that it can be inlined
+    // into the loop function and then discarded.
+    auto *ft = llvm::FunctionType::get(builder.getVoidTy(), std::vector<llvm::Type *>(4, fp_ptr_t), false);
+    assert(ft != nullptr);
+    auto *sf = llvm::Function::Create(ft, llvm::Function::InternalLinkage, name + "_single", &s.module());
+    if (sf == nullptr) {
+        throw std::invalid_argument("Unable to create a function for a fixed-step Taylor stepper with name '" + name
+                                    + "_single'");
     }
-    oss << "]\n";
 
-    if (!ta.get_pars().empty()) {
-        oss << "Parameters  : [";
-        for (decltype(ta.get_pars().size()) i = 0; i < ta.get_pars().size(); ++i) {
-            oss << ta.get_pars()[i];
-            if (i != ta.get_pars().size() - 1u) {
-                oss << ", ";
-            }
-        }
-        oss << "]\n";
+    auto state_ptr = sf->args().begin();
+    state_ptr->setName("state_ptr");
+    state_ptr->addAttr(llvm::Attribute::NoCapture);
+    state_ptr->addAttr(llvm::Attribute::NoAlias);
+
+    auto par_ptr = state_ptr + 1;
+    par_ptr->setName("par_ptr");
+    par_ptr->addAttr(llvm::Attribute::NoCapture);
+    par_ptr->addAttr(llvm::Attribute::NoAlias);
+    par_ptr->addAttr(llvm::Attribute::ReadOnly);
+
+    auto time_ptr = par_ptr + 1;
+    time_ptr->setName("time_ptr");
+    time_ptr->addAttr(llvm::Attribute::NoCapture);
+    time_ptr->addAttr(llvm::Attribute::NoAlias);
+    time_ptr->addAttr(llvm::Attribute::ReadOnly);
+
+    auto h_ptr = time_ptr + 1;
+    h_ptr->setName("h_ptr");
+    h_ptr->addAttr(llvm::Attribute::NoCapture);
+    h_ptr->addAttr(llvm::Attribute::NoAlias);
+    h_ptr->addAttr(llvm::Attribute::ReadOnly);
+
+    auto *bb = llvm::BasicBlock::Create(s.context(), "entry", sf);
+    assert(bb != nullptr);
+    builder.SetInsertPoint(bb);
+
+    // Compute the jet of derivatives.
+    auto diff_variant = taylor_compute_jet<T>(s, state_ptr, par_ptr, time_ptr, dc, {}, n_eq, n_uvars, order,
+                                              batch_size, compact_mode);
+
+    // Evaluate the Taylor polynomials at the fixed timestep.
+    auto h = load_vector_from_memory(builder, h_ptr, batch_size);
+    auto new_state_var
+        = high_accuracy
+              ? taylor_run_ceval<T>(s, diff_variant, h, n_eq, n_uvars, order, batch_size, high_accuracy, compact_mode)
+              : taylor_run_multihorner(s, diff_variant, h, n_eq, n_uvars, order, batch_size, compact_mode);
+
+    // Store the new state.
+    taylor_write_new_state(s, new_state_var, state_ptr, n_eq, batch_size, compact_mode);
+
+    builder.CreateRetVoid();
+
+    s.verify_function(sf);
+
+    // Add the loop function. The arguments are:
+    // - pointer to the current state vector (read & write),
+    // - pointer to the parameters (read only),
+    // - pointer to the time value(s) (read & write),
+    // - pointer to the timestep(s) (read only),
+    // - the number of steps.
+    std::vector<llvm::Type *> fargs(4, fp_ptr_t);
+    fargs.push_back(builder.getInt32Ty());
+    ft = llvm::FunctionType::get(builder.getVoidTy(), fargs, false);
+    assert(ft != nullptr);
+    auto *f = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, name, &s.module());
+    if (f == nullptr) {
+        throw std::invalid_argument("Unable to create a function for a fixed-step Taylor stepper with name '" + name
+                                    + "'");
     }
 
-    return os << oss.str();
-}
+    state_ptr = f->args().begin();
+    state_ptr->setName("state_ptr");
+    state_ptr->addAttr(llvm::Attribute::NoCapture);
+    state_ptr->addAttr(llvm::Attribute::NoAlias);
 
-} // namespace
+    par_ptr = state_ptr + 1;
+    par_ptr->setName("par_ptr");
+    par_ptr->addAttr(llvm::Attribute::NoCapture);
+    par_ptr->addAttr(llvm::Attribute::NoAlias);
+    par_ptr->addAttr(llvm::Attribute::ReadOnly);
 
-template <>
-std::ostream &operator<<(std::ostream &os, const taylor_adaptive_impl<double> &ta)
-{
-    return taylor_adaptive_stream_impl(os, ta);
-}
+    time_ptr = par_ptr + 1;
+    time_ptr->setName("time_ptr");
+    time_ptr->addAttr(llvm::Attribute::NoCapture);
+    time_ptr->addAttr(llvm::Attribute::NoAlias);
 
-template <>
-std::ostream &operator<<(std::ostream &os, const taylor_adaptive_impl<long double> &ta)
-{
-    return taylor_adaptive_stream_impl(os, ta);
-}
+    h_ptr = time_ptr + 1;
+    h_ptr->setName("h_ptr");
+    h_ptr->addAttr(llvm::Attribute::NoCapture);
+    h_ptr->addAttr(llvm::Attribute::NoAlias);
+    h_ptr->addAttr(llvm::Attribute::ReadOnly);
 
-#if defined(HEYOKA_HAVE_REAL128)
+    auto n_steps = h_ptr + 1;
+    n_steps->setName("n_steps");
 
-template <>
-std::ostream &operator<<(std::ostream &os, const taylor_adaptive_impl<mppp::real128> &ta)
-{
-    return taylor_adaptive_stream_impl(os, ta);
-}
+    bb = llvm::BasicBlock::Create(s.context(), "entry", f);
+    assert(bb != nullptr);
+    builder.SetInsertPoint(bb);
 
-#endif
+    h = load_vector_from_memory(builder, h_ptr, batch_size);
 
-template <>
-std::ostream &operator<<(std::ostream &os, const taylor_adaptive_batch_impl<double> &ta)
-{
-    return taylor_adaptive_batch_stream_impl(os, ta);
-}
+    // NOTE: there is no step-size control and no check on the state
+    // within the loop, so that the cost of an invocation depends
+    // only on the number of steps.
+    llvm_loop_u32(s, builder.getInt32(0), n_steps, [&](llvm::Value *) {
+        builder.CreateCall(sf, {state_ptr, par_ptr, time_ptr, h_ptr});
 
-template <>
-std::ostream &operator<<(std::ostream &os, const taylor_adaptive_batch_impl<long double> &ta)
-{
-    return taylor_adaptive_batch_stream_impl(os, ta);
-}
+        // Update the time.
+        // NOTE: in order to limit the accumulation of rounding errors,
+        // the time is re-synchronised by the integrator class
+        // at the end of each invocation.
+        store_vector_to_memory(builder, time_ptr,
+                               builder.CreateFAdd(load_vector_from_memory(builder, time_ptr, batch_size), h));
+    });
 
-#if defined(HEYOKA_HAVE_REAL128)
+    builder.CreateRetVoid();
 
-template <>
-std::ostream &operator<<(std::ostream &os, const taylor_adaptive_batch_impl<mppp::real128> &ta)
-{
-    return taylor_adaptive_batch_stream_impl(os, ta);
-}
+    s.verify_function(f);
 
-#endif
+    // Restore the original optimisation level in s
+    // and run the optimisation pass.
+    od.reset();
+    s.optimise();
 
-} // namespace detail
+    return dc;
+}
 
-std::ostream &operator<<(std::ostream &os, taylor_outcome oc)
+} // namespace
+
+template <typename T>
+template <typename U>
+void taylor_fixed_impl<T>::finalise_ctor_impl(U sys, std::vector<T> state, T time, T h, std::uint32_t order, T tol,
+                                              bool high_accuracy, bool compact_mode, std::vector<T> pars)
+{
+    using std::isfinite;
+
+    // Assign the data members.
+    m_state = std::move(state);
+    m_time = time;
+    m_pars = std::move(pars);
+
+    // Check input params.
+    if (std::any_of(m_state.begin(), m_state.end(), [](const auto &x) { return !isfinite(x); })) {
+        throw std::invalid_argument(
+            "A non-finite value was detected in the initial state of a fixed-step Taylor integrator");
+    }
+
+    if (m_state.size() != sys.size()) {
+        throw std::invalid_argument("Inconsistent sizes detected in the initialization of a fixed-step Taylor "
+                                    "integrator: the state vector has a dimension of "
+                                    + std::to_string(m_state.size()) + ", while the number of equations is "
+                                    + std::to_string(sys.size()));
+    }
+
+    if (!isfinite(m_time)) {
+        throw std::invalid_argument(
+            "Cannot initialise a fixed-step Taylor integrator with a non-finite initial time of "
+            + detail::li_to_string(m_time));
+    }
+
+    set_h(h);
+
+    // NOTE: the tolerance is used only to deduce
+    // the order, if the order was not specified.
+    if (order == 0u) {
+        if (!isfinite(tol) || tol <= 0) {
+            throw std::invalid_argument(
+                "The tolerance in a fixed-step Taylor integrator must be finite and positive, but it is "
+                + li_to_string(tol) + " instead");
+        }
+
+        order = taylor_order_from_tol(tol);
+    }
+
+    // Fix m_pars' size, if necessary.
+    const auto npars = n_pars_in_sys(sys);
+    if (m_pars.size() < npars) {
+        m_pars.resize(boost::numeric_cast<decltype(m_pars.size())>(npars));
+    } else if (m_pars.size() > npars) {
+        using namespace fmt::literals;
+
+        throw std::invalid_argument(
+            "Excessive number of parameter values passed to the constructor of a fixed-step "
+            "Taylor integrator: {} parameter values were passed, but the ODE system contains only {} parameters"_format(
+                m_pars.size(), npars));
+    }
+
+    // Store the dimension of the system and the order.
+    m_dim = boost::numeric_cast<std::uint32_t>(sys.size());
+    m_order = order;
+
+    // Add the stepper function.
+    m_dc = taylor_add_fixed_step_impl<T>(m_llvm, "step", std::move(sys), m_order, 1, high_accuracy, compact_mode);
+
+    // Run the jit.
+    m_llvm.compile();
+
+    // Fetch the stepper.
+    m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+}
+
+template <typename T>
+taylor_fixed_impl<T>::taylor_fixed_impl(const taylor_fixed_impl &other)
+    // NOTE: make a manual copy of all members, apart from the function pointer.
+    : m_state(other.m_state), m_time(other.m_time), m_h(other.m_h), m_llvm(other.m_llvm), m_dim(other.m_dim),
+      m_dc(other.m_dc), m_order(other.m_order), m_pars(other.m_pars)
+{
+    m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+}
+
+template <typename T>
+taylor_fixed_impl<T>::taylor_fixed_impl(taylor_fixed_impl &&) noexcept = default;
+
+template <typename T>
+taylor_fixed_impl<T> &taylor_fixed_impl<T>::operator=(const taylor_fixed_impl &other)
+{
+    if (this != &other) {
+        *this = taylor_fixed_impl(other);
+    }
+
+    return *this;
+}
+
+template <typename T>
+taylor_fixed_impl<T> &taylor_fixed_impl<T>::operator=(taylor_fixed_impl &&) noexcept = default;
+
+template <typename T>
+taylor_fixed_impl<T>::~taylor_fixed_impl() = default;
+
+template <typename T>
+void taylor_fixed_impl<T>::set_h(T h)
+{
+    using std::isfinite;
+
+    if (!isfinite(h)) {
+        throw std::invalid_argument("The timestep of a fixed-step Taylor integrator must be finite, but it is "
+                                    + li_to_string(h) + " instead");
+    }
+
+    m_h = h;
+}
+
+template <typename T>
+taylor_outcome taylor_fixed_impl<T>::step(std::uint32_t n)
+{
+    using std::isfinite;
+
+    const auto t0 = m_time;
+
+    m_step_f(m_state.data(), m_pars.data(), &m_time, &m_h, n);
+
+    // NOTE: recompute the final time from the initial
+    // time, so that it does not depend on the way
+    // the steps are split across invocations of step().
+    m_time = t0 + static_cast<T>(n) * m_h;
+
+    if (!isfinite(m_time)
+        || std::any_of(m_state.cbegin(), m_state.cend(), [](const auto &x) { return !isfinite(x); })) {
+        return taylor_outcome::err_nf_state;
+    }
+
+    return taylor_outcome::success;
+}
+
+template <typename T>
+const llvm_state &taylor_fixed_impl<T>::get_llvm_state() const
+{
+    return m_llvm;
+}
+
+template <typename T>
+const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &taylor_fixed_impl<T>::get_decomposition() const
+{
+    return m_dc;
+}
+
+template <typename T>
+std::uint32_t taylor_fixed_impl<T>::get_order() const
+{
+    return m_order;
+}
+
+template <typename T>
+std::uint32_t taylor_fixed_impl<T>::get_dim() const
+{
+    return m_dim;
+}
+
+// Explicit instantiation of the implementation classes/functions.
+template class taylor_fixed_impl<double>;
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_impl<double>::finalise_ctor_impl(std::vector<expression>, std::vector<double>, double, double,
+                                              std::uint32_t, double, bool, bool, std::vector<double>);
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_impl<double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>, std::vector<double>,
+                                              double, double, std::uint32_t, double, bool, bool, std::vector<double>);
+
+template class taylor_fixed_impl<long double>;
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_impl<long double>::finalise_ctor_impl(std::vector<expression>, std::vector<long double>, long double,
+                                                   long double, std::uint32_t, long double, bool, bool,
+                                                   std::vector<long double>);
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_impl<long double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                   std::vector<long double>, long double, long double, std::uint32_t,
+                                                   long double, bool, bool, std::vector<long double>);
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template class taylor_fixed_impl<mppp::real128>;
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_impl<mppp::real128>::finalise_ctor_impl(std::vector<expression>, std::vector<mppp::real128>,
+                                                     mppp::real128, mppp::real128, std::uint32_t, mppp::real128, bool,
+                                                     bool, std::vector<mppp::real128>);
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_impl<mppp::real128>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                     std::vector<mppp::real128>, mppp::real128, mppp::real128,
+                                                     std::uint32_t, mppp::real128, bool, bool,
+                                                     std::vector<mppp::real128>);
+
+#endif
+
+template <typename T>
+template <typename U>
+void taylor_fixed_batch_impl<T>::finalise_ctor_impl(U sys, std::vector<T> state, std::uint32_t batch_size,
+                                                    std::vector<T> time, std::vector<T> h, std::uint32_t order, T tol,
+                                                    bool high_accuracy, bool compact_mode, std::vector<T> pars)
+{
+    using std::isfinite;
+
+    // Init the data members.
+    m_batch_size = batch_size;
+    m_state = std::move(state);
+    m_time = std::move(time);
+    m_pars = std::move(pars);
+
+    // Check input params.
+    if (m_batch_size == 0u) {
+        throw std::invalid_argument("The batch size in a fixed-step Taylor integrator cannot be zero");
+    }
+
+    if (std::any_of(m_state.begin(), m_state.end(), [](const auto &x) { return !isfinite(x); })) {
+        throw std::invalid_argument(
+            "A non-finite value was detected in the initial state of a fixed-step Taylor integrator");
+    }
+
+    if (m_state.size() % m_batch_size != 0u) {
+        throw std::invalid_argument("Invalid size detected in the initialization of a fixed-step Taylor "
+                                    "integrator: the state vector has a size of "
+                                    + std::to_string(m_state.size()) + ", which is not a multiple of the batch size ("
+                                    + std::to_string(m_batch_size) + ")");
+    }
+
+    if (m_state.size() / m_batch_size != sys.size()) {
+        throw std::invalid_argument("Inconsistent sizes detected in the initialization of a fixed-step Taylor "
+                                    "integrator: the state vector has a dimension of "
+                                    + std::to_string(m_state.size() / m_batch_size)
+                                    + ", while the number of equations is " + std::to_string(sys.size()));
+    }
+
+    if (m_time.size() != m_batch_size) {
+        throw std::invalid_argument("Invalid size detected in the initialization of a fixed-step Taylor "
+                                    "integrator: the time vector has a size of "
+                                    + std::to_string(m_time.size()) + ", which is not equal to the batch size ("
+                                    + std::to_string(m_batch_size) + ")");
+    }
+
+    if (std::any_of(m_time.begin(), m_time.end(), [](const auto &x) { return !isfinite(x); })) {
+        throw std::invalid_argument(
+            "A non-finite initial time was detected in the initialisation of a fixed-step Taylor integrator");
+    }
+
+    set_h(std::move(h));
+
+    // NOTE: the tolerance is used only to deduce
+    // the order, if the order was not specified.
+    if (order == 0u) {
+        if (!isfinite(tol) || tol <= 0) {
+            throw std::invalid_argument(
+                "The tolerance in a fixed-step Taylor integrator must be finite and positive, but it is "
+                + li_to_string(tol) + " instead");
+        }
+
+        order = taylor_order_from_tol(tol);
+    }
+
+    // Fix m_pars' size, if necessary.
+    const auto npars = n_pars_in_sys(sys);
+    if (npars > std::numeric_limits<std::uint32_t>::max() / m_batch_size) {
+        throw std::overflow_error(
+            "Overflow detected when computing the size of the parameter array in a fixed-step Taylor integrator");
+    }
+    if (m_pars.size() < npars * m_batch_size) {
+        m_pars.resize(boost::numeric_cast<decltype(m_pars.size())>(npars * m_batch_size));
+    } else if (m_pars.size() > npars * m_batch_size) {
+        using namespace fmt::literals;
+
+        throw std::invalid_argument(
+            "Excessive number of parameter values passed to the constructor of a fixed-step "
+            "Taylor integrator: {} parameter values were passed, but the ODE system contains only {} parameters "
+            "(in batches of {})"_format(m_pars.size(), npars, m_batch_size));
+    }
+
+    // Store the dimension of the system and the order.
+    m_dim = boost::numeric_cast<std::uint32_t>(sys.size());
+    m_order = order;
+
+    // Add the stepper function.
+    m_dc = taylor_add_fixed_step_impl<T>(m_llvm, "step", std::move(sys), m_order, m_batch_size, high_accuracy,
+                                         compact_mode);
+
+    // Run the jit.
+    m_llvm.compile();
+
+    // Fetch the stepper.
+    m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+
+    // Prepare the temp vectors.
+    m_step_res.resize(boost::numeric_cast<decltype(m_step_res.size())>(m_batch_size));
+    m_time_copy.resize(m_batch_size);
+}
+
+template <typename T>
+taylor_fixed_batch_impl<T>::taylor_fixed_batch_impl(const taylor_fixed_batch_impl &other)
+    // NOTE: make a manual copy of all members, apart from the function pointer.
+    : m_batch_size(other.m_batch_size), m_state(other.m_state), m_time(other.m_time), m_h(other.m_h),
+      m_llvm(other.m_llvm), m_dim(other.m_dim), m_dc(other.m_dc), m_order(other.m_order), m_pars(other.m_pars),
+      m_step_res(other.m_step_res), m_time_copy(other.m_time_copy)
+{
+    m_step_f = reinterpret_cast<step_f_t>(m_llvm.jit_lookup("step"));
+}
+
+template <typename T>
+taylor_fixed_batch_impl<T>::taylor_fixed_batch_impl(taylor_fixed_batch_impl &&) noexcept = default;
+
+template <typename T>
+taylor_fixed_batch_impl<T> &taylor_fixed_batch_impl<T>::operator=(const taylor_fixed_batch_impl &other)
+{
+    if (this != &other) {
+        *this = taylor_fixed_batch_impl(other);
+    }
+
+    return *this;
+}
+
+template <typename T>
+taylor_fixed_batch_impl<T> &taylor_fixed_batch_impl<T>::operator=(taylor_fixed_batch_impl &&) noexcept = default;
+
+template <typename T>
+taylor_fixed_batch_impl<T>::~taylor_fixed_batch_impl() = default;
+
+template <typename T>
+void taylor_fixed_batch_impl<T>::set_h(std::vector<T> h)
+{
+    using std::isfinite;
+
+    if (h.size() != m_batch_size) {
+        throw std::invalid_argument("Invalid number of timesteps passed to a fixed-step Taylor integrator: "
+                                    + std::to_string(h.size()) + " timesteps were passed, but the batch size is "
+                                    + std::to_string(m_batch_size));
+    }
+
+    if (std::any_of(h.begin(), h.end(), [](const auto &x) { return !isfinite(x); })) {
+        throw std::invalid_argument("A non-finite timestep was passed to a fixed-step Taylor integrator");
+    }
+
+    m_h = std::move(h);
+}
+
+template <typename T>
+const std::vector<taylor_outcome> &taylor_fixed_batch_impl<T>::step(std::uint32_t n)
+{
+    using std::isfinite;
+
+    std::copy(m_time.begin(), m_time.end(), m_time_copy.begin());
+
+    m_step_f(m_state.data(), m_pars.data(), m_time.data(), m_h.data(), n);
+
+    for (std::uint32_t i = 0; i < m_batch_size; ++i) {
+        // NOTE: see the scalar implementation.
+        m_time[i] = m_time_copy[i] + static_cast<T>(n) * m_h[i];
+
+        // Check if the time or the state vector are non-finite at the
+        // end of the last step.
+        bool nf = !isfinite(m_time[i]);
+        for (std::uint32_t j = 0; !nf && j < m_dim; ++j) {
+            nf = !isfinite(m_state[j * m_batch_size + i]);
+        }
+
+        m_step_res[i] = nf ? taylor_outcome::err_nf_state : taylor_outcome::success;
+    }
+
+    return m_step_res;
+}
+
+template <typename T>
+const llvm_state &taylor_fixed_batch_impl<T>::get_llvm_state() const
+{
+    return m_llvm;
+}
+
+template <typename T>
+const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &
+taylor_fixed_batch_impl<T>::get_decomposition() const
+{
+    return m_dc;
+}
+
+template <typename T>
+std::uint32_t taylor_fixed_batch_impl<T>::get_batch_size() const
+{
+    return m_batch_size;
+}
+
+template <typename T>
+std::uint32_t taylor_fixed_batch_impl<T>::get_order() const
+{
+    return m_order;
+}
+
+template <typename T>
+std::uint32_t taylor_fixed_batch_impl<T>::get_dim() const
+{
+    return m_dim;
+}
+
+// Explicit instantiation of the batch implementation classes.
+template class taylor_fixed_batch_impl<double>;
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_batch_impl<double>::finalise_ctor_impl(std::vector<expression>, std::vector<double>, std::uint32_t,
+                                                    std::vector<double>, std::vector<double>, std::uint32_t, double,
+                                                    bool, bool, std::vector<double>);
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_batch_impl<double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                    std::vector<double>, std::uint32_t, std::vector<double>,
+                                                    std::vector<double>, std::uint32_t, double, bool, bool,
+                                                    std::vector<double>);
+
+template class taylor_fixed_batch_impl<long double>;
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_batch_impl<long double>::finalise_ctor_impl(std::vector<expression>, std::vector<long double>,
+                                                         std::uint32_t, std::vector<long double>,
+                                                         std::vector<long double>, std::uint32_t, long double, bool,
+                                                         bool, std::vector<long double>);
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_batch_impl<long double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                         std::vector<long double>, std::uint32_t,
+                                                         std::vector<long double>, std::vector<long double>,
+                                                         std::uint32_t, long double, bool, bool,
+                                                         std::vector<long double>);
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template class taylor_fixed_batch_impl<mppp::real128>;
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_batch_impl<mppp::real128>::finalise_ctor_impl(std::vector<expression>, std::vector<mppp::real128>,
+                                                           std::uint32_t, std::vector<mppp::real128>,
+                                                           std::vector<mppp::real128>, std::uint32_t, mppp::real128,
+                                                           bool, bool, std::vector<mppp::real128>);
+template HEYOKA_DLL_PUBLIC void
+taylor_fixed_batch_impl<mppp::real128>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                           std::vector<mppp::real128>, std::uint32_t,
+                                                           std::vector<mppp::real128>, std::vector<mppp::real128>,
+                                                           std::uint32_t, mppp::real128, bool, bool,
+                                                           std::vector<mppp::real128>);
+
+#endif
+
+} // namespace detail
+
+namespace detail
+{
+
+namespace
+{
+
+// Minimum number of batches processed
+// by each thread in taylor_jet_driver.
+constexpr std::size_t taylor_jet_driver_grain = 16;
+
+// Deleter for the buffers created by taylor_make_aligned_buffer().
+struct taylor_aligned_deleter {
+    void operator()(void *ptr) const
+    {
+        ::operator delete(ptr, std::align_val_t{llvm_simd_alignment});
+    }
+};
+
+// Create a zero-initialised buffer of n values of type T aligned to llvm_simd_alignment.
+// The size of the buffer is padded to a multiple of llvm_simd_alignment, so that buffers
+// belonging to different threads never share a cache line.
+// NOTE: this is used only with trivial types.
+template <typename T>
+std::unique_ptr<T[], taylor_aligned_deleter> taylor_make_aligned_buffer(std::size_t n)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    if (n > (std::numeric_limits<std::size_t>::max() - llvm_simd_alignment) / sizeof(T)) {
+        throw std::overflow_error("Overflow detected in the creation of an aligned buffer");
+    }
+
+    const auto size = (n * sizeof(T) + llvm_simd_alignment - 1u) / llvm_simd_alignment * llvm_simd_alignment;
+
+    auto *ptr = ::operator new(std::max(size, llvm_simd_alignment), std::align_val_t{llvm_simd_alignment});
+    std::memset(ptr, 0, std::max(size, llvm_simd_alignment));
+
+    return std::unique_ptr<T[], taylor_aligned_deleter>(static_cast<T *>(ptr));
+}
+
+} // namespace
+
+template <typename T>
+template <typename U>
+void taylor_jet_driver_impl<T>::finalise_ctor_impl(U sys, std::uint32_t order, std::uint32_t batch_size,
+                                                   bool high_accuracy, bool compact_mode, std::vector<expression> obs)
+{
+    if (batch_size == 0u) {
+        batch_size = taylor_simd_size<T>();
+    }
+
+    // Determine the number of parameters.
+    auto npars = n_pars_in_sys(sys);
+    for (const auto &ex : obs) {
+        npars = std::max(npars, get_param_size(ex));
+    }
+
+    m_dim = boost::numeric_cast<std::uint32_t>(sys.size());
+    m_order = order;
+    m_batch_size = batch_size;
+    m_n_pars = npars;
+    m_compact_mode = compact_mode;
+    m_obs = std::move(obs);
+
+    // Add the jet function.
+    // NOTE: this will take care of checking the order
+    // and the batch size, and of checking that the size of the jet
+    // is representable as a 32-bit unsigned integer.
+    m_dc = taylor_add_jet<T>(m_llvm, "jet", std::move(sys), order, batch_size, high_accuracy, compact_mode, m_obs);
+
+    // Run the jit.
+    m_llvm.compile();
+
+    // Fetch the jet function.
+    m_jet_f = reinterpret_cast<jet_f_t>(m_llvm.jit_lookup("jet"));
+}
+
+template <typename T>
+taylor_jet_driver_impl<T>::taylor_jet_driver_impl(const taylor_jet_driver_impl &other)
+    // NOTE: make a manual copy of all members, apart from the function pointer.
+    : m_llvm(other.m_llvm), m_dim(other.m_dim), m_order(other.m_order), m_batch_size(other.m_batch_size),
+      m_n_pars(other.m_n_pars), m_compact_mode(other.m_compact_mode), m_dc(other.m_dc), m_obs(other.m_obs)
+{
+    m_jet_f = reinterpret_cast<jet_f_t>(m_llvm.jit_lookup("jet"));
+}
+
+template <typename T>
+taylor_jet_driver_impl<T>::taylor_jet_driver_impl(taylor_jet_driver_impl &&) noexcept = default;
+
+template <typename T>
+taylor_jet_driver_impl<T> &taylor_jet_driver_impl<T>::operator=(const taylor_jet_driver_impl &other)
+{
+    if (this != &other) {
+        *this = taylor_jet_driver_impl(other);
+    }
+
+    return *this;
+}
+
+template <typename T>
+taylor_jet_driver_impl<T> &taylor_jet_driver_impl<T>::operator=(taylor_jet_driver_impl &&) noexcept = default;
+
+template <typename T>
+taylor_jet_driver_impl<T>::~taylor_jet_driver_impl() = default;
+
+template <typename T>
+void taylor_jet_driver_impl<T>::operator()(T *out, const T *in, std::size_t n, const T *pars, const T *time) const
+{
+    if (n == 0u) {
+        return;
+    }
+
+    if (out == nullptr || in == nullptr) {
+        throw std::invalid_argument("Null input/output pointers were passed to a Taylor jet driver");
+    }
+
+    if (m_n_pars > 0u && pars == nullptr) {
+        throw std::invalid_argument("A null pointer to the parameter values was passed to a Taylor jet driver, but the "
+                                    "system contains "
+                                    + std::to_string(m_n_pars) + " parameter(s)");
+    }
+
+    const auto bs = m_batch_size;
+
+    // Number of rows in the output array (and in the jet).
+    // NOTE: taylor_add_jet() checked that the total size of the jet
+    // is representable as a 32-bit unsigned integer.
+    const auto n_rows = static_cast<std::size_t>(m_dim + static_cast<std::uint32_t>(m_obs.size())) * (m_order + 1u);
+
+    // NOTE: we need to be able to index into the output array using std::size_t.
+    if (n_rows > std::numeric_limits<std::size_t>::max() / n) {
+        throw std::overflow_error("An overflow condition was detected in a Taylor jet driver");
+    }
+
+    // NOTE: the last batch may be partial.
+    const auto n_batches = n / bs + static_cast<std::size_t>(n % bs != 0u);
+
+    // Copy the values of nv variables for the batch beginning at the
+    // index i0 from the SoA array src into the batch buffer dest.
+    // The lanes of a partial batch are filled with copies of the last sample.
+    auto gather = [n, bs](T *dest, const T *src, std::uint32_t nv, std::size_t i0, std::uint32_t cur_n) {
+        for (std::uint32_t v = 0; v < nv; ++v) {
+            const auto s_ptr = src + v * n + i0;
+            const auto d_ptr = dest + static_cast<std::size_t>(v) * bs;
+
+            std::copy(s_ptr, s_ptr + cur_n, d_ptr);
+            std::fill(d_ptr + cur_n, d_ptr + bs, s_ptr[cur_n - 1u]);
+        }
+    };
+
+    // Compute the jets for the batches in the [begin, end) range.
+    auto process = [&](std::size_t begin, std::size_t end) {
+        // Per-thread scratch memory.
+        // NOTE: the buffers are aligned and padded to cache lines,
+        // so that the buffers of different threads never share a cache line.
+        // NOTE: the time buffer is zero-initialised, which
+        // is the value used if time is null.
+        auto jet_ptr = taylor_make_aligned_buffer<T>(n_rows * bs);
+        auto p_buf_ptr = taylor_make_aligned_buffer<T>(static_cast<std::size_t>(m_n_pars) * bs);
+        auto t_buf_ptr = taylor_make_aligned_buffer<T>(bs);
+        auto *jet = jet_ptr.get(), *p_buf = p_buf_ptr.get(), *t_buf = t_buf_ptr.get();
+
+        for (auto b = begin; b < end; ++b) {
+            const auto i0 = b * bs;
+            const auto cur_n = static_cast<std::uint32_t>(std::min(static_cast<std::size_t>(bs), n - i0));
+
+            gather(jet, in, m_dim, i0, cur_n);
+            if (m_n_pars > 0u) {
+                gather(p_buf, pars, m_n_pars, i0, cur_n);
+            }
+            if (time != nullptr) {
+                gather(t_buf, time, 1, i0, cur_n);
+            }
+
+            m_jet_f(jet, p_buf, t_buf);
+
+            // Write out the jet.
+            for (std::size_t r = 0; r < n_rows; ++r) {
+                const auto j_ptr = jet + r * bs;
+
+                std::copy(j_ptr, j_ptr + cur_n, out + r * n + i0);
+            }
+        }
+    };
+
+    if (m_compact_mode) {
+        // NOTE: in compact mode the jet function writes the derivatives
+        // into global arrays, hence the batches must be processed serially.
+        process(0, n_batches);
+    } else {
+        parallel_for_blocks(n_batches, taylor_jet_driver_grain, process);
+    }
+}
+
+template <typename T>
+const llvm_state &taylor_jet_driver_impl<T>::get_llvm_state() const
+{
+    return m_llvm;
+}
+
+template <typename T>
+const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &
+taylor_jet_driver_impl<T>::get_decomposition() const
+{
+    return m_dc;
+}
+
+template <typename T>
+std::uint32_t taylor_jet_driver_impl<T>::get_order() const
+{
+    return m_order;
+}
+
+template <typename T>
+std::uint32_t taylor_jet_driver_impl<T>::get_dim() const
+{
+    return m_dim;
+}
+
+template <typename T>
+std::uint32_t taylor_jet_driver_impl<T>::get_batch_size() const
+{
+    return m_batch_size;
+}
+
+template <typename T>
+std::uint32_t taylor_jet_driver_impl<T>::get_n_pars() const
+{
+    return m_n_pars;
+}
+
+template <typename T>
+const std::vector<expression> &taylor_jet_driver_impl<T>::get_observables() const
+{
+    return m_obs;
+}
+
+// Explicit instantiation of the implementation classes/functions.
+template class taylor_jet_driver_impl<double>;
+template HEYOKA_DLL_PUBLIC void
+taylor_jet_driver_impl<double>::finalise_ctor_impl(std::vector<expression>, std::uint32_t, std::uint32_t, bool, bool,
+                                                   std::vector<expression>);
+template HEYOKA_DLL_PUBLIC void
+taylor_jet_driver_impl<double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>, std::uint32_t,
+                                                   std::uint32_t, bool, bool, std::vector<expression>);
+
+template class taylor_jet_driver_impl<long double>;
+template HEYOKA_DLL_PUBLIC void
+taylor_jet_driver_impl<long double>::finalise_ctor_impl(std::vector<expression>, std::uint32_t, std::uint32_t, bool,
+                                                        bool, std::vector<expression>);
+template HEYOKA_DLL_PUBLIC void
+taylor_jet_driver_impl<long double>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>, std::uint32_t,
+                                                        std::uint32_t, bool, bool, std::vector<expression>);
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template class taylor_jet_driver_impl<mppp::real128>;
+template HEYOKA_DLL_PUBLIC void
+taylor_jet_driver_impl<mppp::real128>::finalise_ctor_impl(std::vector<expression>, std::uint32_t, std::uint32_t, bool,
+                                                          bool, std::vector<expression>);
+template HEYOKA_DLL_PUBLIC void
+taylor_jet_driver_impl<mppp::real128>::finalise_ctor_impl(std::vector<std::pair<expression, expression>>,
+                                                          std::uint32_t, std::uint32_t, bool, bool,
+                                                          std::vector<expression>);
+
+#endif
+
+} // namespace detail
+
+namespace detail
+{
+
+namespace
+{
+
+// Heuristic sizes (in LLVM instructions) of the code in compact mode:
+// the body of a function for the computation of the Taylor
+// derivatives of a u variable, the loop invoking such function
+// within a segment, and the driver of the timestep.
+constexpr std::uint64_t taylor_cost_c_func_size = 64;
+constexpr std::uint64_t taylor_cost_c_loop_size = 16;
+constexpr std::uint64_t taylor_cost_c_driver_size = 128;
+
+// The estimated code size in unrolled mode above which
+// compact mode is recommended.
+constexpr std::uint64_t taylor_cost_max_unrolled_code_size = 50000;
+
+// Kinds of the arguments of a u variable definition ('v' for variables,
+// 'n' for numbers, 'p' for params), used to tell apart the functions
+// for the computation of the Taylor derivatives in compact mode.
+template <typename V>
+std::string taylor_cost_arg_kinds(const V &v)
+{
+    std::string retval;
+
+    for (const auto &arg : v.args()) {
+        retval += std::visit(
+            [](const auto &x) -> char {
+                using type = uncvref_t<decltype(x)>;
+
+                if constexpr (std::is_same_v<type, variable>) {
+                    return 'v';
+                } else if constexpr (std::is_same_v<type, number>) {
+                    return 'n';
+                } else if constexpr (std::is_same_v<type, param>) {
+                    return 'p';
+                } else {
+                    throw std::invalid_argument("Invalid argument encountered in an element of a Taylor "
+                                                "decomposition: the argument is not a variable or a number/param");
+                }
+            },
+            arg.value());
+    }
+
+    return retval;
+}
+
+// Key identifying the function for the computation of the
+// Taylor derivatives of the u variable defined by ex in compact mode.
+std::string taylor_cost_c_func_key(const expression &ex)
+{
+    return std::visit(
+        [](const auto &v) -> std::string {
+            using type = uncvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<type, binary_operator>) {
+                return "bo_" + std::to_string(static_cast<int>(v.op())) + "_" + taylor_cost_arg_kinds(v);
+            } else if constexpr (std::is_same_v<type, func>) {
+                return "f_" + v.get_name() + "_" + taylor_cost_arg_kinds(v);
+            } else {
+                throw std::invalid_argument("Invalid expression encountered in a Taylor decomposition: the "
+                                            "expression is not a function or a binary operator");
+            }
+        },
+        ex.value());
+}
+
+// Number of floating-point operations and of calls to transcendental functions
+// (per batch element) for the computation of the Taylor derivative
+// of order k of the u variable defined by ex. The counts follow the
+// formulae implemented in taylor_diff() for binary operators and
+// elementary functions (e.g., a Cauchy product for a multiplication,
+// and a sum of k terms for the functions defined via an ODE).
+std::pair<double, double> taylor_cost_udef(const expression &ex, std::uint32_t k)
+{
+    const auto dk = static_cast<double>(k);
+
+    auto is_const = [](const expression &e) {
+        return std::holds_alternative<number>(e.value()) || std::holds_alternative<param>(e.value());
+    };
+
+    return std::visit(
+        [&](const auto &v) -> std::pair<double, double> {
+            using type = uncvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<type, binary_operator>) {
+                switch (v.op()) {
+                    case binary_operator::type::add:
+                    case binary_operator::type::sub:
+                        return {1., 0.};
+                    case binary_operator::type::mul:
+                        if (is_const(v.lhs()) || is_const(v.rhs())) {
+                            return {1., 0.};
+                        }
+                        return {k == 0u ? 1. : 2. * dk + 1., 0.};
+                    default:
+                        if (is_const(v.rhs())) {
+                            return {1., 0.};
+                        }
+                        return {k == 0u ? 1. : 2. * dk + 1., 0.};
+                }
+            } else if constexpr (std::is_same_v<type, func>) {
+                const auto &name = v.get_name();
+
+                if (name == "time") {
+                    return {0., 0.};
+                }
+
+                // The derivatives of order > 0 of a function
+                // of numbers/params are zero.
+                if (k > 0u && std::all_of(v.args().begin(), v.args().end(), is_const)) {
+                    return {0., 0.};
+                }
+
+                if (name == "square") {
+                    return {k == 0u ? 1. : dk + 2., 0.};
+                } else if (name == "sqrt") {
+                    return {k == 0u ? 1. : 3. * dk + 1., 0.};
+                } else if (name == "pow") {
+                    return k == 0u ? std::pair{0., 1.} : std::pair{5. * dk + 2., 0.};
+                } else if (name == "lin_comb") {
+                    // One multiplication and one addition per term. At orders > 0,
+                    // only the non-constant terms contribute.
+                    double n_terms = 0;
+                    for (decltype(v.args().size()) i = 1; i < v.args().size(); i += 2u) {
+                        if (k == 0u || !is_const(v.args()[i])) {
+                            n_terms += 1;
+                        }
+                    }
+                    return {n_terms == 0 ? 0. : 2. * n_terms - 1., 0.};
+                } else {
+                    return k == 0u ? std::pair{0., 1.} : std::pair{3. * dk + 1., 0.};
+                }
+            } else {
+                return {0., 0.};
+            }
+        },
+        ex.value());
+}
+
+std::uint64_t taylor_cost_to_u64(double x)
+{
+    if (!std::isfinite(x) || x >= static_cast<double>(std::numeric_limits<std::uint64_t>::max())) {
+        throw std::overflow_error("Overflow detected in the estimation of the cost of a Taylor integrator");
+    }
+
+    return static_cast<std::uint64_t>(x);
+}
+
+} // namespace
+
+taylor_cost_estimate
+taylor_estimate_cost_impl(const std::vector<std::pair<expression, std::vector<std::uint32_t>>> &dc,
+                          std::uint32_t n_eq, std::uint32_t order, std::uint32_t batch_size, std::size_t value_size)
+{
+    if (n_eq == 0u) {
+        throw std::invalid_argument("Cannot estimate the cost of a Taylor integrator for a system of zero equations");
+    }
+
+    if (dc.size() < 2u * static_cast<decltype(dc.size())>(n_eq)) {
+        throw std::invalid_argument("Invalid Taylor decomposition detected in the estimation of the cost of a Taylor "
+                                    "integrator: the size of the decomposition ("
+                                    + std::to_string(dc.size()) + ") is less than twice the number of equations ("
+                                    + std::to_string(n_eq) + ")");
+    }
+
+    if (order == 0u) {
+        throw std::invalid_argument("The order of a Taylor integrator cannot be zero");
+    }
+
+    if (batch_size == 0u) {
+        throw std::invalid_argument("The batch size of a Taylor integrator cannot be zero");
+    }
+
+    const auto n_uvars = dc.size() - n_eq;
+    const auto d_n_eq = static_cast<double>(n_eq), d_order = static_cast<double>(order),
+               d_batch_size = static_cast<double>(batch_size);
+
+    taylor_cost_estimate retval;
+
+    // The Taylor derivatives.
+    double step_flops = 0, step_trans = 0;
+    for (std::uint32_t k = 0; k <= order; ++k) {
+        // NOTE: the derivatives of order k > 0 of the state variables
+        // are the derivatives of order k - 1 of the right-hand sides
+        // divided by k.
+        double cur_flops = k == 0u ? 0. : d_n_eq;
+
+        // NOTE: at the last order, only the derivatives of the state
+        // variables are computed (see taylor_compute_jet()).
+        if (k < order) {
+            for (auto i = static_cast<decltype(dc.size())>(n_eq); i < n_uvars; ++i) {
+                const auto [fl, tr] = taylor_cost_udef(dc[i].first, k);
+
+                cur_flops += fl;
+                step_trans += tr;
+            }
+        }
+
+        retval.order_flops.push_back(taylor_cost_to_u64(cur_flops * d_batch_size));
+        step_flops += cur_flops;
+    }
+
+    // The instructions in unrolled mode are roughly the operations
+    // on a single batch element, plus the stores of the
+    // Taylor coefficients of the state variables.
+    const auto unrolled_size = step_flops + step_trans + d_n_eq * (d_order + 1.);
+
+    // The determination of the timestep size: the infinity norms of
+    // the state vector and of the last two Taylor coefficients,
+    // and two exponentiations.
+    step_flops += 6. * d_n_eq + 8.;
+    step_trans += 2.;
+
+    // The evaluation of the Taylor polynomials via Horner's scheme.
+    step_flops += 2. * d_order * d_n_eq;
+
+    retval.step_flops = taylor_cost_to_u64(step_flops * d_batch_size);
+    retval.step_transcendentals = taylor_cost_to_u64(step_trans * d_batch_size);
+    retval.jet_bytes = taylor_cost_to_u64(static_cast<double>(n_uvars) * (d_order + 1.) * d_batch_size
+                                          * static_cast<double>(value_size));
+    retval.unrolled_code_size = taylor_cost_to_u64(unrolled_size + 8. * d_n_eq);
+
+    // In compact mode, the code consists of one function per kind of
+    // u variable definition, and of one loop per kind within each segment.
+    std::unordered_set<std::string> c_funcs;
+    std::uint64_t n_loops = 0;
+    for (const auto &seg : taylor_segment_dc(dc, n_eq)) {
+        std::unordered_set<std::string> seg_funcs;
+
+        for (const auto &[ex, _] : seg) {
+            auto key = taylor_cost_c_func_key(ex);
+
+            c_funcs.insert(key);
+            seg_funcs.insert(std::move(key));
+        }
+
+        n_loops += seg_funcs.size();
+    }
+
+    retval.compact_code_size = c_funcs.size() * taylor_cost_c_func_size + n_loops * taylor_cost_c_loop_size
+                               + taylor_cost_c_driver_size;
+
+    return retval;
+}
+
+taylor_cost_estimate taylor_estimate_cost_impl(std::vector<expression> sys, std::uint32_t order,
+                                               std::uint32_t batch_size, std::size_t value_size)
+{
+    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
+
+    return taylor_estimate_cost_impl(taylor_decompose(std::move(sys)), n_eq, order, batch_size, value_size);
+}
+
+taylor_cost_estimate taylor_estimate_cost_impl(std::vector<std::pair<expression, expression>> sys,
+                                               std::uint32_t order, std::uint32_t batch_size, std::size_t value_size)
+{
+    const auto n_eq = boost::numeric_cast<std::uint32_t>(sys.size());
+
+    return taylor_estimate_cost_impl(taylor_decompose(std::move(sys)), n_eq, order, batch_size, value_size);
+}
+
+} // namespace detail
+
+bool taylor_cost_estimate::compact_mode_recommended() const
+{
+    return unrolled_code_size > detail::taylor_cost_max_unrolled_code_size;
+}
+
+namespace detail
+{
+
+namespace
+{
+
+// Implementation of the streaming operator for the scalar integrators.
+template <typename T>
+std::ostream &taylor_adaptive_stream_impl(std::ostream &os, const taylor_adaptive_impl<T> &ta)
+{
+    std::ostringstream oss;
+    oss.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+    oss.imbue(std::locale::classic());
+    oss << std::showpoint;
+    oss.precision(std::numeric_limits<T>::max_digits10);
+
+    oss << "Taylor order: " << ta.get_order() << '\n';
+    oss << "Dimension   : " << ta.get_dim() << '\n';
+    oss << "Time        : " << ta.get_time() << '\n';
+    oss << "State       : [";
+    for (decltype(ta.get_state().size()) i = 0; i < ta.get_state().size(); ++i) {
+        oss << ta.get_state()[i];
+        if (i != ta.get_state().size() - 1u) {
+            oss << ", ";
+        }
+    }
+    oss << "]\n";
+
+    if (!ta.get_pars().empty()) {
+        oss << "Parameters  : [";
+        for (decltype(ta.get_pars().size()) i = 0; i < ta.get_pars().size(); ++i) {
+            oss << ta.get_pars()[i];
+            if (i != ta.get_pars().size() - 1u) {
+                oss << ", ";
+            }
+        }
+        oss << "]\n";
+    }
+
+    return os << oss.str();
+}
+
+// Implementation of the streaming operator for the batch integrators.
+template <typename T>
+std::ostream &taylor_adaptive_batch_stream_impl(std::ostream &os, const taylor_adaptive_batch_impl<T> &ta)
+{
+    std::ostringstream oss;
+    oss.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+    oss.imbue(std::locale::classic());
+    oss << std::showpoint;
+    oss.precision(std::numeric_limits<T>::max_digits10);
+
+    oss << "Taylor order: " << ta.get_order() << '\n';
+    oss << "Dimension   : " << ta.get_dim() << '\n';
+    oss << "Batch size  : " << ta.get_batch_size() << '\n';
+    oss << "Time        : [";
+    for (decltype(ta.get_time().size()) i = 0; i < ta.get_time().size(); ++i) {
+        oss << ta.get_time()[i];
+        if (i != ta.get_time().size() - 1u) {
+            oss << ", ";
+        }
+    }
+    oss << "]\n";
+    oss << "State       : [";
+    for (decltype(ta.get_state().size()) i = 0; i < ta.get_state().size(); ++i) {
+        oss << ta.get_state()[i];
+        if (i != ta.get_state().size() - 1u) {
+            oss << ", ";
+        }
+    }
+    oss << "]\n";
+
+    if (!ta.get_pars().empty()) {
+        oss << "Parameters  : [";
+        for (decltype(ta.get_pars().size()) i = 0; i < ta.get_pars().size(); ++i) {
+            oss << ta.get_pars()[i];
+            if (i != ta.get_pars().size() - 1u) {
+                oss << ", ";
+            }
+        }
+        oss << "]\n";
+    }
+
+    return os << oss.str();
+}
+
+} // namespace
+
+template <>
+std::ostream &operator<<(std::ostream &os, const taylor_adaptive_impl<double> &ta)
+{
+    return taylor_adaptive_stream_impl(os, ta);
+}
+
+template <>
+std::ostream &operator<<(std::ostream &os, const taylor_adaptive_impl<long double> &ta)
+{
+    return taylor_adaptive_stream_impl(os, ta);
+}
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template <>
+std::ostream &operator<<(std::ostream &os, const taylor_adaptive_impl<mppp::real128> &ta)
+{
+    return taylor_adaptive_stream_impl(os, ta);
+}
+
+#endif
+
+template <>
+std::ostream &operator<<(std::ostream &os, const taylor_adaptive_batch_impl<double> &ta)
+{
+    return taylor_adaptive_batch_stream_impl(os, ta);
+}
+
+template <>
+std::ostream &operator<<(std::ostream &os, const taylor_adaptive_batch_impl<long double> &ta)
+{
+    return taylor_adaptive_batch_stream_impl(os, ta);
+}
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+template <>
+std::ostream &operator<<(std::ostream &os, const taylor_adaptive_batch_impl<mppp::real128> &ta)
+{
+    return taylor_adaptive_batch_stream_impl(os, ta);
+}
+
+#endif
+
+} // namespace detail
+
+std::ostream &operator<<(std::ostream &os, taylor_outcome oc)
 {
     switch (oc) {
         case taylor_outcome::success:
@@ -4108,6 +6814,12 @@ std::ostream &operator<<(std::ostream &os, taylor_outcome oc)
         case taylor_outcome::err_nf_state:
             os << "err_nf_state";
             break;
+        case taylor_outcome::cb_stop:
+            os << "cb_stop";
+            break;
+        case taylor_outcome::err_inv_drift:
+            os << "err_inv_drift";
+            break;
     }
 
     return os;
@@ -0,0 +1,141 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <heyoka/config.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/batch_utils.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/math.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+const auto fp_types = std::tuple<double, long double
+#if defined(HEYOKA_HAVE_REAL128)
+                                 ,
+                                 mppp::real128
+#endif
+                                 >{};
+
+TEST_CASE("gather scatter")
+{
+    auto tester = [](auto fp_x) {
+        using fp_t = decltype(fp_x);
+
+        // NOTE: test sizes which are not multiples
+        // of the tile size, as well as full tiles.
+        for (std::uint32_t n_vars : {1u, 3u, 8u, 17u}) {
+            for (std::uint32_t batch_size : {1u, 4u, 8u, 19u}) {
+                for (std::uint32_t n_samples = 1; n_samples <= batch_size; ++n_samples) {
+                    std::vector<fp_t> aos(n_samples * n_vars), batch(n_vars * batch_size);
+                    for (decltype(aos.size()) i = 0; i < aos.size(); ++i) {
+                        aos[i] = static_cast<fp_t>(i);
+                    }
+
+                    batch_gather(batch.data(), aos.data(), n_vars, batch_size, n_samples);
+
+                    for (std::uint32_t v = 0; v < n_vars; ++v) {
+                        for (std::uint32_t l = 0; l < batch_size; ++l) {
+                            // The lanes of a partial batch contain the last sample.
+                            const auto s = std::min(l, n_samples - 1u);
+
+                            REQUIRE(batch[v * batch_size + l] == aos[s * n_vars + v]);
+                        }
+                    }
+
+                    std::vector<fp_t> aos2(aos.size());
+                    batch_scatter(aos2.data(), batch.data(), n_vars, batch_size, n_samples);
+                    REQUIRE(aos2 == aos);
+                }
+            }
+        }
+
+        std::vector<fp_t> aos(8), batch(8);
+        REQUIRE_THROWS_AS(batch_gather(batch.data(), aos.data(), 2, 4, 0), std::invalid_argument);
+        REQUIRE_THROWS_AS(batch_gather(batch.data(), aos.data(), 2, 4, 5), std::invalid_argument);
+        REQUIRE_THROWS_AS(batch_gather(batch.data(), aos.data(), 2, 0, 1), std::invalid_argument);
+        REQUIRE_THROWS_AS(batch_scatter(static_cast<fp_t *>(nullptr), batch.data(), 2, 4, 1), std::invalid_argument);
+    };
+
+    tuple_for_each(fp_types, tester);
+}
+
+TEST_CASE("batch integrator")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const std::uint32_t batch_size = 4;
+
+    auto ta = taylor_adaptive_batch<double>{
+        {prime(x) = v, prime(v) = -par[0] * sin(x) + par[1]}, std::vector<double>(2u * batch_size), batch_size};
+
+    // Three samples (i.e., a partial batch).
+    const std::vector<double> states{0.1, 0.2, 0.3, 0.4, 0.5, 0.6};
+    const std::vector<double> pars{1., 0., 2., 0.1, 3., 0.2};
+    const std::vector<double> times{1., 2., 3.};
+
+    gather_state(ta, states.data(), 3);
+    gather_pars(ta, pars.data(), 3);
+    gather_time(ta, times.data(), 3);
+
+    REQUIRE(ta.get_state() == std::vector<double>{0.1, 0.3, 0.5, 0.5, 0.2, 0.4, 0.6, 0.6});
+    REQUIRE(ta.get_pars() == std::vector<double>{1., 2., 3., 3., 0., 0.1, 0.2, 0.2});
+    REQUIRE(ta.get_time() == std::vector<double>{1., 2., 3., 3.});
+
+    // Lane views.
+    auto sl = state_lane(ta, 1);
+    REQUIRE(sl.size() == 2u);
+    REQUIRE(sl[0] == 0.3);
+    REQUIRE(sl[1] == 0.4);
+    REQUIRE(std::distance(sl.begin(), sl.end()) == 2);
+    REQUIRE(std::vector<double>(sl.begin(), sl.end()) == std::vector<double>{0.3, 0.4});
+
+    sl[1] = 0.45;
+    REQUIRE(ta.get_state()[5] == 0.45);
+
+    const auto &cta = ta;
+    auto pl = pars_lane(cta, 2);
+    REQUIRE(std::vector<double>(pl.begin(), pl.end()) == std::vector<double>{3., 0.2});
+
+    REQUIRE_THROWS_AS(state_lane(ta, 4), std::invalid_argument);
+
+    // Propagate the batch and check the scattered
+    // states against the state lanes.
+    ta.propagate_until(std::vector<double>(batch_size, 10.));
+
+    std::vector<double> out_states(6), out_pars(6), out_times(3);
+    scatter_state(out_states.data(), ta, 3);
+    scatter_pars(out_pars.data(), ta, 3);
+    scatter_time(out_times.data(), ta, 3);
+
+    for (std::uint32_t i = 0; i < 3u; ++i) {
+        auto cur_sl = state_lane(cta, i);
+
+        REQUIRE(std::equal(cur_sl.begin(), cur_sl.end(), out_states.begin() + i * 2u));
+        REQUIRE(out_times[i] == 10.);
+    }
+
+    REQUIRE(out_pars == pars);
+}
@@ -0,0 +1,102 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <heyoka/chaos.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/math/sin.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+TEST_CASE("chaos linear")
+{
+    auto x = "x"_var;
+
+    // For x' = a * x, the stretching rate is a, so that
+    // the accumulators can be computed exactly.
+    const auto a = .3;
+
+    for (auto ind : {chaos_indicator::megno, chaos_indicator::fli}) {
+        const auto sys = make_chaos_sys({prime(x) = a * x}, ind);
+
+        REQUIRE(sys.size() == 3u);
+        REQUIRE(sys[0].first == x);
+        REQUIRE(sys[1].first == "d_x"_var);
+        REQUIRE(sys[2].first == (ind == chaos_indicator::megno ? "megno"_var : "fli"_var));
+
+        auto ta = taylor_adaptive<double>{sys, {1., 1., 0.}};
+        ta.propagate_until(5.);
+
+        if (ind == chaos_indicator::megno) {
+            // MEGNO = 2 * y / t = a * t.
+            REQUIRE(2. * ta.get_state()[2] / 5. == approximately(a * 5., 1000.));
+        } else {
+            // FLI = a * t.
+            REQUIRE(ta.get_state()[2] == approximately(a * 5., 1000.));
+        }
+    }
+}
+
+TEST_CASE("chaos pendulum")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const auto sys_fli = make_chaos_sys({prime(x) = v, prime(v) = -9.8 * sin(x)}, chaos_indicator::fli);
+    REQUIRE(sys_fli.size() == 5u);
+
+    // Regular orbit: the tangent vector grows linearly,
+    // and so the FLI grows logarithmically.
+    auto ta = taylor_adaptive<double>{sys_fli, {0.5, 0., 1., 0., 0.}};
+    ta.propagate_until(1000.);
+
+    const auto &st = ta.get_state();
+    REQUIRE(st[4] > 3.);
+    REQUIRE(st[4] < 8.);
+
+    // The FLI is the logarithm of the norm of the tangent vector.
+    REQUIRE(st[4] == approximately(std::log(std::sqrt(st[2] * st[2] + st[3] * st[3])), 100000000.));
+
+    const auto sys = make_chaos_sys({prime(x) = v, prime(v) = -9.8 * sin(x)}, chaos_indicator::megno);
+
+    // Batch mode.
+    const std::uint32_t batch_size = 2;
+    auto tab = taylor_adaptive_batch<double>{sys, {0.5, 0.6, 0., 0., 1., 1., 0., 0., 0., 0.}, batch_size};
+    tab.propagate_until(std::vector<double>(batch_size, 10.));
+
+    for (std::uint32_t j = 0; j < batch_size; ++j) {
+        auto ta_s = taylor_adaptive<double>{sys, {j == 0u ? 0.5 : 0.6, 0., 1., 0., 0.}};
+        ta_s.propagate_until(10.);
+
+        for (auto i = 0u; i < 5u; ++i) {
+            REQUIRE(tab.get_state()[i * batch_size + j] == approximately(ta_s.get_state()[i], 1000.));
+        }
+    }
+}
+
+TEST_CASE("chaos errors")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    REQUIRE_THROWS_AS(make_chaos_sys({}, chaos_indicator::fli), std::invalid_argument);
+    REQUIRE_THROWS_AS(make_chaos_sys({{x + v, v}}, chaos_indicator::fli), std::invalid_argument);
+    REQUIRE_THROWS_AS(make_chaos_sys({prime(x) = v, prime(x) = x}, chaos_indicator::fli), std::invalid_argument);
+    REQUIRE_THROWS_AS(make_chaos_sys({prime(x) = "d_x"_var, prime("d_x"_var) = x}, chaos_indicator::fli),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(make_chaos_sys({prime(x) = "fli"_var, prime("fli"_var) = x}, chaos_indicator::fli),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(make_chaos_sys({prime(x) = x}, static_cast<chaos_indicator>(10)), std::invalid_argument);
+}
@@ -0,0 +1,169 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <heyoka/close_approach.hpp>
+#include <heyoka/nbody.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+namespace
+{
+
+// Minimum distance between the bodies i and j over a timestep,
+// computed by sampling the Taylor polynomials.
+double sampled_min_dist(const std::vector<double> &tc, std::uint32_t order, std::uint32_t i, std::uint32_t j,
+                        double h)
+{
+    auto eval = [&](std::uint32_t var, double t) {
+        double retval = 0;
+        for (auto k = order + 1u; k > 0u; --k) {
+            retval = tc[var * (order + 1u) + k - 1u] + retval * t;
+        }
+        return retval;
+    };
+
+    auto retval = std::numeric_limits<double>::infinity();
+    for (auto n = 0; n <= 10000; ++n) {
+        const auto t = h * n / 10000.;
+
+        double r2 = 0;
+        for (auto c = 0u; c < 3u; ++c) {
+            const auto d = eval(j * 6u + c, t) - eval(i * 6u + c, t);
+            r2 += d * d;
+        }
+
+        retval = std::min(retval, std::sqrt(r2));
+    }
+
+    return retval;
+}
+
+} // namespace
+
+TEST_CASE("close approach linear")
+{
+    // Three bodies in uniform rectilinear motion, order 2: the
+    // bodies 0 and 2 approach each other and reach the minimum
+    // distance 0.2 at t = 1, the body 1 is far away.
+    const std::uint32_t order = 2;
+    std::vector<double> tc(18u * (order + 1u));
+    auto set_pos = [&](std::uint32_t i, std::uint32_t c, double x0, double v) {
+        tc[(i * 6u + c) * (order + 1u)] = x0;
+        tc[(i * 6u + c) * (order + 1u) + 1u] = v;
+    };
+    set_pos(0, 0, -1., 1.);
+    set_pos(0, 1, .1, 0.);
+    set_pos(1, 0, 50., 0.);
+    set_pos(1, 1, 50., 0.);
+    set_pos(1, 2, 50., 0.);
+    set_pos(2, 0, 1., -1.);
+    set_pos(2, 1, -.1, 0.);
+
+    auto res = nbody_close_approaches(tc.data(), order, 3, 0., 2., .5);
+    REQUIRE(res.size() == 1u);
+    REQUIRE(res[0].i == 0u);
+    REQUIRE(res[0].j == 2u);
+    REQUIRE(res[0].t == approximately(1.));
+    REQUIRE(res[0].dist == approximately(.2));
+
+    // Backwards in time, with the Taylor expansions at t = 2.
+    auto tc_back = tc;
+    std::swap(tc_back[0], tc_back[12u * (order + 1u)]);
+    res = nbody_close_approaches(tc_back.data(), order, 3, 2., -2., .5);
+    REQUIRE(res.size() == 1u);
+    REQUIRE(res[0].t == approximately(1.));
+    REQUIRE(res[0].dist == approximately(.2));
+
+    // The minimum distance is attained at the end of the timestep.
+    res = nbody_close_approaches(tc.data(), order, 3, 0., .5, 1.5);
+    REQUIRE(res.size() == 1u);
+    REQUIRE(res[0].t == approximately(.5));
+    REQUIRE(res[0].dist == approximately(std::sqrt(1. + .04)));
+
+    // Threshold smaller than the minimum distance.
+    REQUIRE(nbody_close_approaches(tc.data(), order, 3, 0., 2., .1).empty());
+
+    // Less than 2 bodies.
+    REQUIRE(nbody_close_approaches(tc.data(), order, 1, 0., 2., .5).empty());
+    REQUIRE(nbody_close_approaches(tc.data(), order, 0, 0., 2., .5).empty());
+
+    // Error handling.
+    REQUIRE_THROWS_AS(nbody_close_approaches(tc.data(), 0, 3, 0., 2., .5), std::invalid_argument);
+    REQUIRE_THROWS_AS(nbody_close_approaches(tc.data(), order, 3, 0., 2., 0.), std::invalid_argument);
+    REQUIRE_THROWS_AS(nbody_close_approaches(tc.data(), order, 3, 0., 2., -1.), std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        nbody_close_approaches(tc.data(), order, 3, 0., 2., std::numeric_limits<double>::infinity()),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(nbody_close_approaches(tc.data(), order, 3, 0., std::numeric_limits<double>::quiet_NaN(), .5),
+                      std::invalid_argument);
+}
+
+TEST_CASE("close approach integrator")
+{
+    // Two test particles on counter-rotating circular orbits of
+    // radii 1 and 1.05 around a central body: the minimum distance
+    // between them is 0.05, attained whenever they are aligned.
+    const auto v2 = std::sqrt(1. / 1.05);
+
+    auto ta = taylor_adaptive<double>{make_nbody_sys(3, kw::masses = {1., 0., 0.}),
+                                      {0., 0., 0., 0., 0., 0., 1., 0., 0., 0., 1., 0., 1.05, 0., 0., 0., -v2, 0.}};
+
+    REQUIRE_THROWS_AS(nbody_close_approaches(ta, 4, 1., .1), std::invalid_argument);
+
+    const auto threshold = .1;
+    const auto order = ta.get_order();
+
+    std::uint32_t n_found = 0;
+    auto min_dist = std::numeric_limits<double>::infinity();
+
+    while (ta.get_time() < 10.) {
+        const auto h = std::get<1>(ta.step(true));
+        const auto res = nbody_close_approaches(ta, 3, h, threshold);
+
+        for (std::uint32_t i = 0; i < 3u; ++i) {
+            for (auto j = i + 1u; j < 3u; ++j) {
+                const auto it = std::find_if(res.begin(), res.end(),
+                                             [i, j](const auto &ca) { return ca.i == i && ca.j == j; });
+                const auto s_dist = sampled_min_dist(ta.get_tc(), order, i, j, h);
+
+                if (it == res.end()) {
+                    REQUIRE(s_dist >= threshold);
+                } else {
+                    // The central body never gets close.
+                    REQUIRE(i == 1u);
+                    REQUIRE(j == 2u);
+
+                    REQUIRE(it->t >= ta.get_time() - h);
+                    REQUIRE(it->t <= ta.get_time());
+                    REQUIRE(it->dist <= s_dist * (1 + 1E-10));
+                    REQUIRE(it->dist >= s_dist - 1E-6);
+
+                    ++n_found;
+                    min_dist = std::min(min_dist, it->dist);
+                }
+            }
+        }
+    }
+
+    REQUIRE(n_found > 0u);
+    REQUIRE(std::abs(min_dist - .05) < 1E-8);
+}
@@ -0,0 +1,172 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <heyoka/columnar.hpp>
+#include <heyoka/ensemble.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/math/sin.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+TEST_CASE("columnar file")
+{
+    using Catch::Matchers::Message;
+
+    const std::string path = "heyoka_columnar_test_0.bin";
+
+    {
+        columnar_file cf(path, columnar_type::dbl, 10, 3);
+
+        REQUIRE(cf.get_type() == columnar_type::dbl);
+        REQUIRE(cf.get_n_rows() == 10u);
+        REQUIRE(cf.get_n_cols() == 3u);
+        REQUIRE(!cf.is_read_only());
+
+        for (std::uint64_t j = 0; j < 3u; ++j) {
+            auto col = cf.mutable_column<double>(j);
+            for (std::uint64_t i = 0; i < 10u; ++i) {
+                // Zero initialisation.
+                REQUIRE(col[i] == 0.);
+
+                col[i] = static_cast<double>(j * 10u + i);
+            }
+        }
+
+        // The columns are contiguous.
+        REQUIRE(cf.column<double>(1) == cf.column<double>(0) + 10);
+
+        cf.flush();
+    }
+
+    {
+        columnar_file cf(path);
+
+        REQUIRE(cf.is_read_only());
+        REQUIRE(cf.get_n_rows() == 10u);
+        REQUIRE(cf.get_n_cols() == 3u);
+
+        for (std::uint64_t j = 0; j < 3u; ++j) {
+            const auto col = cf.column<double>(j);
+            for (std::uint64_t i = 0; i < 10u; ++i) {
+                REQUIRE(col[i] == static_cast<double>(j * 10u + i));
+            }
+        }
+
+        // Move semantics.
+        auto cf2 = std::move(cf);
+        REQUIRE(cf2.column<double>(2)[9] == 29.);
+
+        // Error handling.
+        REQUIRE_THROWS_AS(cf2.mutable_column<double>(0), std::invalid_argument);
+        REQUIRE_THROWS_AS(cf2.column<long double>(0), std::invalid_argument);
+        REQUIRE_THROWS_AS(cf2.column<double>(3), std::out_of_range);
+    }
+
+    // Empty tables.
+    {
+        columnar_file cf(path, columnar_type::i64, 0, 5);
+        REQUIRE(cf.get_n_rows() == 0u);
+    }
+    REQUIRE(columnar_file(path).get_type() == columnar_type::i64);
+
+    // Invalid files.
+    {
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs << "not a columnar file, but long enough to contain a full header of 64 bytes";
+    }
+    REQUIRE_THROWS_AS(columnar_file(path), std::invalid_argument);
+
+    // Simulate a file produced on a platform with a different
+    // endianness by byte-swapping the version and the endianness
+    // marker. The endianness mismatch must be detected before
+    // the version is read.
+    {
+        columnar_file cf(path, columnar_type::dbl, 1, 1);
+    }
+    {
+        std::fstream fs(path, std::ios::binary | std::ios::in | std::ios::out);
+        std::array<char, 8> buf{};
+        fs.seekg(8);
+        fs.read(buf.data(), 8);
+        std::reverse(buf.begin(), buf.begin() + 4);
+        std::reverse(buf.begin() + 4, buf.end());
+        fs.seekp(8);
+        fs.write(buf.data(), 8);
+    }
+    REQUIRE_THROWS_MATCHES(
+        columnar_file(path), std::invalid_argument,
+        Message("The columnar file '" + path + "' was produced on a platform with a different endianness"));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("columnar ensemble")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    auto ta = taylor_adaptive<double>{{prime(x) = v, prime(v) = -par[0] * sin(x)}, {0.05, 0.025}, kw::pars = {9.8}};
+
+    const std::string in_path = "heyoka_columnar_test_1.bin", out_path = "heyoka_columnar_test_2.bin",
+                      stats_path = "heyoka_columnar_test_3.bin", bad_path = "heyoka_columnar_test_4.bin";
+
+    const std::uint64_t n_iter = 50;
+
+    {
+        columnar_file in(in_path, columnar_type::dbl, n_iter, 3);
+        for (std::uint64_t i = 0; i < n_iter; ++i) {
+            in.mutable_column<double>(0)[i] = 0.05 + static_cast<double>(i) / 1000.;
+            in.mutable_column<double>(1)[i] = 0.025;
+            in.mutable_column<double>(2)[i] = 9.8 + static_cast<double>(i) / 100.;
+        }
+    }
+
+    {
+        columnar_file in(in_path);
+        columnar_file out(out_path, columnar_type::dbl, n_iter, 2);
+        columnar_file stats(stats_path, columnar_type::i64, n_iter, 2);
+
+        ensemble_propagate_until(ta, 10., in, out, stats);
+
+        for (std::uint64_t i = 0; i < n_iter; ++i) {
+            auto ta_s = taylor_adaptive<double>{{prime(x) = v, prime(v) = -par[0] * sin(x)},
+                                                {0.05 + static_cast<double>(i) / 1000., 0.025},
+                                                kw::pars = {9.8 + static_cast<double>(i) / 100.}};
+            const auto pres = ta_s.propagate_until(10.);
+
+            REQUIRE(out.column<double>(0)[i] == ta_s.get_state()[0]);
+            REQUIRE(out.column<double>(1)[i] == ta_s.get_state()[1]);
+            REQUIRE(stats.column<std::int64_t>(0)[i] == static_cast<std::int64_t>(taylor_outcome::time_limit));
+            REQUIRE(stats.column<std::int64_t>(1)[i] == static_cast<std::int64_t>(std::get<3>(pres)));
+        }
+
+        // Inconsistent shapes.
+        columnar_file out_bad(bad_path, columnar_type::dbl, n_iter, 3);
+        REQUIRE_THROWS_AS(ensemble_propagate_until(ta, 10., in, out_bad, stats), std::invalid_argument);
+    }
+
+    std::remove(in_path.c_str());
+    std::remove(out_path.c_str());
+    std::remove(stats_path.c_str());
+    std::remove(bad_path.c_str());
+}
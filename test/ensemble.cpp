@@ -0,0 +1,242 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <heyoka/detail/parallel.hpp>
+#include <heyoka/ensemble.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/math/sin.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+TEST_CASE("ensemble propagate until")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    auto ta = taylor_adaptive<double>{{prime(x) = v, prime(v) = -par[0] * sin(x)}, {0.05, 0.025}, kw::pars = {9.8}};
+
+    // Setup of the i-th iteration.
+    auto gen = [](auto &ta_w, std::size_t i) {
+        ta_w.set_time(0.);
+        ta_w.get_state_data()[0] = 0.05 + static_cast<double>(i) / 1000.;
+        ta_w.get_state_data()[1] = 0.025;
+        ta_w.get_pars_data()[0] = 9.8 + static_cast<double>(i) / 100.;
+    };
+
+    for (std::size_t n_iter : {0u, 1u, 3u, 100u}) {
+        const auto res = ensemble_propagate_until(ta, 10., n_iter, gen);
+
+        REQUIRE(res.size() == n_iter);
+
+        for (std::size_t i = 0; i < n_iter; ++i) {
+            auto ta_s = ta;
+            gen(ta_s, i);
+            const auto pres = ta_s.propagate_until(10.);
+
+            REQUIRE(std::get<0>(res[i].first) == taylor_outcome::time_limit);
+            REQUIRE(std::get<3>(res[i].first) == std::get<3>(pres));
+            REQUIRE(res[i].second == ta_s.get_state());
+        }
+    }
+
+    // The original integrator is not modified.
+    REQUIRE(ta.get_time() == 0.);
+    REQUIRE(ta.get_state() == std::vector{0.05, 0.025});
+
+    // Max number of steps.
+    const auto res = ensemble_propagate_until(ta, 10., 4, gen, 5);
+    for (const auto &r : res) {
+        REQUIRE(std::get<0>(r.first) == taylor_outcome::step_limit);
+        REQUIRE(std::get<3>(r.first) == 5u);
+    }
+
+    // Exceptions are propagated.
+    REQUIRE_THROWS_AS(ensemble_propagate_until(ta, 10., 10,
+                                               [](auto &, std::size_t i) {
+                                                   if (i == 7u) {
+                                                       throw std::invalid_argument("");
+                                                   }
+                                               }),
+                      std::invalid_argument);
+}
+
+TEST_CASE("ensemble for each batch")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const std::uint32_t batch_size = 4;
+
+    auto ta = taylor_adaptive_batch<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)},
+                                            std::vector<double>(2u * batch_size, 0.05),
+                                            batch_size};
+
+    std::vector<double> out(100u * batch_size);
+
+    ensemble_for_each(ta, 100, [&out](auto &ta_w, std::size_t i) {
+        std::fill(ta_w.get_time_data(), ta_w.get_time_data() + batch_size, 0.);
+        std::fill(ta_w.get_state_data(), ta_w.get_state_data() + batch_size, 0.05 + static_cast<double>(i) / 1000.);
+        std::fill(ta_w.get_state_data() + batch_size, ta_w.get_state_data() + 2u * batch_size, 0.);
+
+        ta_w.propagate_until(std::vector<double>(batch_size, 1.));
+
+        std::copy(ta_w.get_state_data(), ta_w.get_state_data() + batch_size, out.data() + i * batch_size);
+    });
+
+    for (std::size_t i = 0; i < 100u; ++i) {
+        auto ta_s = taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)},
+                                            {0.05 + static_cast<double>(i) / 1000., 0.}};
+        ta_s.propagate_until(1.);
+
+        for (std::uint32_t j = 0; j < batch_size; ++j) {
+            REQUIRE(out[i * batch_size + j] == approximately(ta_s.get_state()[0], 1000.));
+        }
+    }
+}
+
+TEST_CASE("ensemble for each variable order")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    auto ta = taylor_adaptive<double>{
+        {prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.025}, kw::variable_order = true};
+
+    // NOTE: the iterations do not reset the time, hence the order
+    // selected at the end of an iteration would leak into
+    // the next iteration of the same block if ensemble_for_each()
+    // did not reset it.
+    auto run = [](auto &ta_w, std::size_t i) {
+        ta_w.get_state_data()[0] = 0.05 + static_cast<double>(i) / 1000.;
+        ta_w.get_state_data()[1] = 0.025;
+
+        for (auto j = 0; j < 10; ++j) {
+            ta_w.step();
+        }
+
+        return ta_w.get_state();
+    };
+
+    std::vector<std::vector<double>> res(100);
+
+    ensemble_for_each(ta, 100, [&res, &run](auto &ta_w, std::size_t i) { res[i] = run(ta_w, i); });
+
+    for (std::size_t i = 0; i < 100u; ++i) {
+        auto ta_s = ta;
+        REQUIRE(res[i] == run(ta_s, i));
+    }
+}
+
+TEST_CASE("ensemble propagate until batch")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const std::uint32_t batch_size = 3;
+
+    auto ta = taylor_adaptive_batch<double>{{prime(x) = v, prime(v) = -par[0] * sin(x)},
+                                            std::vector<double>(2u * batch_size, 0.05),
+                                            batch_size,
+                                            kw::pars = std::vector<double>(batch_size, 9.8)};
+
+    // Setup of the i-th iteration.
+    auto gen = [](auto &ta_w, std::size_t i) {
+        for (std::uint32_t j = 0; j < batch_size; ++j) {
+            ta_w.get_time_data()[j] = 0.;
+            ta_w.get_state_data()[j] = 0.05 + static_cast<double>(i * batch_size + j) / 1000.;
+            ta_w.get_state_data()[batch_size + j] = 0.025;
+            ta_w.get_pars_data()[j] = 9.8 + static_cast<double>(i) / 100.;
+        }
+    };
+
+    const std::vector<double> ts{1., 2., 3.};
+
+    for (std::size_t n_iter : {0u, 1u, 50u}) {
+        const auto res = ensemble_propagate_until(ta, ts, n_iter, gen);
+
+        REQUIRE(res.size() == n_iter);
+
+        for (std::size_t i = 0; i < n_iter; ++i) {
+            auto ta_b = ta;
+            gen(ta_b, i);
+            ta_b.propagate_until(ts);
+
+            REQUIRE(res[i].first.size() == batch_size);
+            for (const auto &r : res[i].first) {
+                REQUIRE(std::get<0>(r) == taylor_outcome::time_limit);
+            }
+            REQUIRE(res[i].second == ta_b.get_state());
+        }
+    }
+
+    // Max number of steps.
+    for (const auto &r : ensemble_propagate_until(ta, ts, 4, gen, 5)) {
+        for (const auto &o : r.first) {
+            REQUIRE(std::get<0>(o) == taylor_outcome::step_limit);
+        }
+    }
+
+    // Invalid number of final times.
+    REQUIRE_THROWS_AS(ensemble_propagate_until(ta, std::vector{1., 2.}, 4, gen), std::invalid_argument);
+}
+
+TEST_CASE("ensemble for each scheduling")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    auto ta = taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.025}};
+
+    // Force the use of multiple threads, with iterations of
+    // very different costs: each iteration must be processed
+    // exactly once, regardless of the scheduling.
+    for (std::size_t n_threads : {1u, 3u, 8u}) {
+        detail::parallel_set_n_threads(n_threads);
+
+        for (std::size_t n_iter : {1u, 2u, 7u, 100u, 1001u}) {
+            std::vector<std::atomic<int>> counts(n_iter);
+            std::vector<double> res(n_iter);
+
+            ensemble_for_each(ta, n_iter, [&counts, &res](auto &ta_w, std::size_t i) {
+                ++counts[i];
+
+                ta_w.set_time(0.);
+                ta_w.get_state_data()[0] = 0.05;
+                ta_w.get_state_data()[1] = 0.025;
+                ta_w.propagate_until(i % 10u == 0u ? 10. : .1);
+
+                res[i] = ta_w.get_state()[0];
+            });
+
+            for (std::size_t i = 0; i < n_iter; ++i) {
+                REQUIRE(counts[i] == 1);
+                REQUIRE(res[i] == res[i % 10u]);
+            }
+        }
+
+        // Exceptions are propagated.
+        REQUIRE_THROWS_AS(ensemble_for_each(ta, 100,
+                                            [](auto &, std::size_t i) {
+                                                if (i == 42u) {
+                                                    throw std::invalid_argument("");
+                                                }
+                                            }),
+                          std::invalid_argument);
+    }
+
+    detail::parallel_set_n_threads(0);
+}
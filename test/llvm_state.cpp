@@ -7,6 +7,8 @@
 // with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include <heyoka/expression.hpp>
 #include <heyoka/llvm_state.hpp>
@@ -36,3 +38,64 @@ TEST_CASE("save object code")
 
     std::cout << "The object code size is: " << s.get_object_code().size() << '\n';
 }
+
+TEST_CASE("huge pages")
+{
+    auto [x, y] = make_vars("x", "y");
+
+    auto ta = taylor_adaptive<double>{{prime(x) = y, prime(y) = (1_dbl - x * x) * y - x}, {0., 1.}};
+    auto ta_hp = taylor_adaptive<double>{
+        {prime(x) = y, prime(y) = (1_dbl - x * x) * y - x}, {0., 1.}, kw::huge_pages = true};
+
+    REQUIRE(!ta.get_llvm_state().huge_pages());
+    REQUIRE(ta_hp.get_llvm_state().huge_pages());
+
+    ta.propagate_until(10.);
+    ta_hp.propagate_until(10.);
+
+    REQUIRE(ta.get_state() == ta_hp.get_state());
+
+    // Copies preserve the flag.
+    auto ta_hp2 = ta_hp;
+    REQUIRE(ta_hp2.get_llvm_state().huge_pages());
+    ta_hp2.propagate_until(20.);
+    ta_hp.propagate_until(20.);
+    REQUIRE(ta_hp2.get_state() == ta_hp.get_state());
+
+    // Without huge pages, the functions are not reordered
+    // before compilation.
+    llvm_state s;
+    taylor_add_jet_dbl(s, "foo", {prime(x) = y, prime(y) = (1_dbl - x * x) * y - x}, 21, 1, true, true);
+    const auto ir = s.get_ir();
+    s.compile();
+    REQUIRE(s.get_ir() == ir);
+}
+
+TEST_CASE("concurrent jits")
+{
+    auto [x, y] = make_vars("x", "y");
+
+    auto ta = taylor_adaptive<double>{{prime(x) = y, prime(y) = (1_dbl - x * x) * y - x}, {0., 1.}};
+    ta.propagate_until(10.);
+
+    // Create and use several integrators concurrently, so that the host detection,
+    // the target machines and the lookup of the process symbols are shared among threads.
+    std::vector<std::thread> threads;
+    std::vector<std::vector<double>> res(8);
+
+    for (auto i = 0u; i < 8u; ++i) {
+        threads.emplace_back([&res, i, x = x, y = y]() {
+            auto ta_t = taylor_adaptive<double>{{prime(x) = y, prime(y) = (1_dbl - x * x) * y - x}, {0., 1.}};
+            ta_t.propagate_until(10.);
+            res[i] = ta_t.get_state();
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    for (const auto &r : res) {
+        REQUIRE(r == ta.get_state());
+    }
+}
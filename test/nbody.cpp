@@ -9,8 +9,14 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <initializer_list>
 #include <iostream>
+#include <limits>
+#include <regex>
+#include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -199,3 +205,153 @@ TEST_CASE("N-body")
         }
     }
 }
+
+// Test the vectorised computation of the Taylor derivatives
+// in scalar compact mode, with both numerical and param masses.
+TEST_CASE("N-body compact mode simd")
+{
+    const std::uint32_t n = 6;
+
+    std::vector<double> init_state(n * 6u), masses{1.};
+    for (std::uint32_t i = 1; i < n; ++i) {
+        const auto r = static_cast<double>(i);
+
+        init_state[i * 6u] = r;
+        init_state[i * 6u + 1u] = 0.1 * r;
+        init_state[i * 6u + 2u] = 0.01 * r;
+        init_state[i * 6u + 4u] = 1. / std::sqrt(r);
+        init_state[i * 6u + 5u] = 0.01;
+
+        masses.push_back(1e-4 * r);
+    }
+
+    // NOTE: disable the inlining so that the vectorised
+    // functions can be detected in the IR.
+    auto ta = taylor_adaptive<double>{make_nbody_sys(n, kw::masses = masses), init_state};
+    auto ta_c = taylor_adaptive<double>{make_nbody_sys(n, kw::masses = masses), init_state, kw::compact_mode = true,
+                                        kw::inline_functions = false};
+    auto ta_p = taylor_adaptive<double>{make_nbody_par_sys(n), init_state, kw::compact_mode = true, kw::pars = masses,
+                                        kw::inline_functions = false};
+    auto ta_ns = taylor_adaptive<double>{make_nbody_sys(n, kw::masses = masses), init_state, kw::compact_mode = true,
+                                         kw::inline_functions = false, kw::compact_mode_simd = false};
+
+    REQUIRE(ta_c.get_llvm_state().compact_mode_simd());
+    REQUIRE(!ta_ns.get_llvm_state().compact_mode_simd());
+
+    // The names of the vectorised functions contain the SIMD size.
+    const std::regex vfunc_re("heyoka_taylor_diff_[a-z_]+_double_[0-9]+_n_uvars_");
+    const std::regex vop_re("fmul[a-z ]* <[0-9]+ x double>");
+
+    REQUIRE(!std::regex_search(ta_ns.get_llvm_state().get_ir(), vfunc_re));
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+    // NOTE: SIMD is always available on x86-64.
+    for (const auto *t : {&ta_c, &ta_p}) {
+        const auto ir = t->get_llvm_state().get_ir();
+
+        REQUIRE(std::regex_search(ir, vfunc_re));
+        REQUIRE(std::regex_search(ir, vop_re));
+    }
+
+#endif
+
+    ta.propagate_until(10.);
+    ta_c.propagate_until(10.);
+    ta_p.propagate_until(10.);
+    ta_ns.propagate_until(10.);
+
+    for (std::uint32_t i = 0; i < n * 6u; ++i) {
+        REQUIRE(ta_c.get_state()[i] == approximately(ta.get_state()[i], 10000.));
+        REQUIRE(ta_p.get_state()[i] == approximately(ta.get_state()[i], 10000.));
+        REQUIRE(ta_ns.get_state()[i] == approximately(ta.get_state()[i], 10000.));
+    }
+}
+
+TEST_CASE("oe batch conversions")
+{
+    const std::size_t n = 5000;
+
+    const std::array<std::pair<double, double>, 6> bounds{
+        {{0.5, 5.}, {0.01, 0.95}, {0.1, 3.}, {0., 6.28}, {0., 6.28}, {0., 6.28}}};
+
+    std::array<std::vector<double>, 6> st, oe, st2;
+    for (std::size_t j = 0; j < 6u; ++j) {
+        st[j].resize(n);
+        oe[j].resize(n);
+        st2[j].resize(n);
+    }
+
+    auto ptrs = [](auto &arr) {
+        return std::array{arr[0].data(), arr[1].data(), arr[2].data(), arr[3].data(), arr[4].data(), arr[5].data()};
+    };
+    auto cptrs = [](const auto &arr) {
+        return std::array{arr[0].data(), arr[1].data(), arr[2].data(), arr[3].data(), arr[4].data(), arr[5].data()};
+    };
+
+    random_elliptic_state_batch(1., bounds, n, ptrs(st), 42);
+
+    // The first state must match the scalar version.
+    const auto s0 = random_elliptic_state(1., bounds, 42);
+    for (std::size_t j = 0; j < 6u; ++j) {
+        REQUIRE(st[j][0] == s0[j]);
+    }
+
+    cartesian_to_oe_batch(1., n, cptrs(st), ptrs(oe));
+    oe_to_cartesian_batch(1., n, cptrs(oe), ptrs(st2));
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto s = std::array{st[0][i], st[1][i], st[2][i], st[3][i], st[4][i], st[5][i]};
+
+        // Batch and scalar versions must produce identical results.
+        const auto cur_oe = cartesian_to_oe(1., s);
+        for (std::size_t j = 0; j < 6u; ++j) {
+            REQUIRE(oe[j][i] == cur_oe[j]);
+        }
+
+        // NOTE: check the roundtrip with an absolute tolerance relative
+        // to the norms of the position and velocity vectors, as individual
+        // components may be close to zero.
+        const auto r = std::sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+        const auto v = std::sqrt(s[3] * s[3] + s[4] * s[4] + s[5] * s[5]);
+
+        const auto cur_s = oe_to_cartesian(1., cur_oe);
+        for (std::size_t j = 0; j < 6u; ++j) {
+            REQUIRE(st2[j][i] == cur_s[j]);
+            REQUIRE(std::abs(cur_s[j] - s[j]) <= 1E-11 * (j < 3u ? r : v));
+        }
+    }
+
+    REQUIRE_THROWS_AS(oe_to_cartesian(1., {1., 1., 0., 0., 0., 0.}), std::invalid_argument);
+    REQUIRE_THROWS_AS(oe_to_cartesian(-1., {1., .1, 0., 0., 0., 0.}), std::invalid_argument);
+    REQUIRE_THROWS_AS(cartesian_to_oe_batch(1., 1u, {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+                                            ptrs(oe)),
+                      std::invalid_argument);
+}
+
+TEST_CASE("kepE")
+{
+    const std::size_t n = 10000;
+
+    std::vector<double> e(n), M(n), E(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        e[i] = 0.999 * static_cast<double>(i) / n;
+        M[i] = -100. + 200. * static_cast<double>(i) / n;
+    }
+
+    kepE_batch(n, e.data(), M.data(), E.data());
+
+    for (std::size_t i = 0; i < n; ++i) {
+        REQUIRE(E[i] - e[i] * std::sin(E[i]) == approximately(M[i], 1000.));
+        REQUIRE(kepE(e[i], M[i]) == approximately(E[i], 1000.));
+    }
+
+    REQUIRE(kepE(0., 1.) == approximately(1.));
+
+    REQUIRE_THROWS_AS(kepE(1., 1.), std::invalid_argument);
+    REQUIRE_THROWS_AS(kepE(-.1, 1.), std::invalid_argument);
+    REQUIRE_THROWS_AS(kepE(.1, std::numeric_limits<double>::infinity()), std::invalid_argument);
+
+    e[10] = 2.;
+    REQUIRE_THROWS_AS(kepE_batch(n, e.data(), M.data(), E.data()), std::invalid_argument);
+}
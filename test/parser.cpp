@@ -0,0 +1,120 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <heyoka/expression.hpp>
+#include <heyoka/math.hpp>
+#include <heyoka/nbody.hpp>
+#include <heyoka/parser.hpp>
+
+#include "catch.hpp"
+
+using namespace heyoka;
+
+std::string to_string(const expression &ex)
+{
+    std::ostringstream oss;
+    oss << ex;
+    return oss.str();
+}
+
+TEST_CASE("parse expression")
+{
+    auto [x, y] = make_vars("x", "y");
+
+    REQUIRE(parse_expression("x") == x);
+    REQUIRE(parse_expression(" x_1 ") == "x_1"_var);
+    REQUIRE(parse_expression("1.5") == 1.5_dbl);
+    REQUIRE(parse_expression("-1.5e-3") == expression{-1.5e-3});
+    REQUIRE(parse_expression("par[3]") == par[3]);
+    REQUIRE(parse_expression("t") == heyoka::time);
+
+    // Precedence and associativity.
+    REQUIRE(parse_expression("x + y * 2.") == x + y * 2_dbl);
+    REQUIRE(parse_expression("x - y - 2.") == (x - y) - 2_dbl);
+    REQUIRE(parse_expression("x / y / 2.") == (x / y) / 2_dbl);
+    REQUIRE(parse_expression("-x") == -x);
+    REQUIRE(parse_expression("(x + y) * # comment\n y") == (x + y) * y);
+
+    // Functions.
+    REQUIRE(parse_expression("sin(x) * cos(y)") == sin(x) * cos(y));
+    REQUIRE(parse_expression("pow(x, 1.5)") == pow(x, 1.5_dbl));
+
+    // Round-trip through the stream operator.
+    for (const auto &ex : {x * y + par[0] * sin(x) - exp(-y) / 3_dbl, sqrt(x * x + y * y) * heyoka::time,
+                           pow(x, y) - erf(tanh(x)) + 1e-20_dbl, -x * y}) {
+        REQUIRE(parse_expression(to_string(ex)) == ex);
+    }
+
+    // Errors.
+    REQUIRE_THROWS_AS(parse_expression(""), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression("x +"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression("(x + y"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression("x y"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression("par[]"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression("1.2.3"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression("foo(x)"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression("sin(x, y)"), std::invalid_argument);
+}
+
+TEST_CASE("parse deep nesting")
+{
+    auto x = "x"_var;
+
+    // The nesting depth does not affect the call stack.
+    const std::string::size_type depth = 1000000;
+    REQUIRE(parse_expression(std::string(depth, '(') + "x" + std::string(depth, ')')) == x);
+    REQUIRE_THROWS_AS(parse_expression(std::string(depth, '(') + "x" + std::string(depth - 1u, ')')),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_expression(std::string(depth, '(') + "x" + std::string(depth + 1u, ')')),
+                      std::invalid_argument);
+
+    // Round-trip a large sum, which is printed
+    // with fully nested parentheses.
+    auto sum = x;
+    for (auto i = 0; i < 10000; ++i) {
+        sum = sum + expression{variable{"y_" + std::to_string(i)}} * par[static_cast<std::uint32_t>(i)];
+    }
+    REQUIRE(parse_expression(to_string(sum)) == sum);
+
+    auto nested = x;
+    for (auto i = 0; i < 1000; ++i) {
+        nested = pow(sin(nested), -x);
+    }
+    REQUIRE(parse_expression(to_string(nested)) == nested);
+}
+
+TEST_CASE("parse sys")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    REQUIRE(parse_sys("prime(x) = v; prime(v) = -9.8 * sin(x)")
+            == std::vector{prime(x) = v, prime(v) = expression{-9.8} * sin(x)});
+    REQUIRE(parse_sys("").empty());
+    REQUIRE(parse_sys("# Nothing here\n").empty());
+
+    // Round-trip an N-body system.
+    const auto sys = make_nbody_sys(4, kw::masses = {1., 2., 3., 4.});
+
+    std::stringstream ss;
+    for (const auto &[lhs, rhs] : sys) {
+        ss << "prime(" << lhs << ") = " << rhs << '\n';
+    }
+
+    REQUIRE(parse_sys(ss) == sys);
+
+    REQUIRE_THROWS_AS(parse_sys("x = v"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_sys("prime(1.) = v"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_sys("prime(x) v"), std::invalid_argument);
+}
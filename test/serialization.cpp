@@ -0,0 +1,183 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <heyoka/config.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/math.hpp>
+#include <heyoka/nbody.hpp>
+#include <heyoka/serialization.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+
+using namespace heyoka;
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+using namespace mppp::literals;
+
+#endif
+
+struct my_func : func_base {
+    my_func() : my_func(0_dbl, 0_dbl) {}
+    explicit my_func(expression a, expression b) : func_base("my_func", std::vector{std::move(a), std::move(b)}) {}
+};
+
+TEST_CASE("expression roundtrip")
+{
+    auto [x, y] = make_vars("x", "y");
+
+    std::vector<expression> v{x,
+                              1.1_dbl,
+                              expression{1.1l},
+#if defined(HEYOKA_HAVE_REAL128)
+                              expression{1.1_rq},
+#endif
+                              par[42],
+                              x + y,
+                              x - 2_dbl * y / par[1],
+                              sin(x) * cos(y) + pow(x, y) + pow(x, 1.5_dbl) + heyoka::time,
+                              exp(log(sqrt(square(x)))) + tan(erf(sigmoid(y))),
+                              asin(acos(atan(x))) + sinh(cosh(tanh(y))) + asinh(acosh(atanh(x)))};
+
+    std::stringstream ss;
+    save_binary(ss, v);
+
+    REQUIRE(load_binary_expressions(ss) == v);
+
+    // Streaming interface.
+    ss.str("");
+    ss.clear();
+    {
+        binary_writer bw(ss);
+        for (const auto &ex : v) {
+            bw.write(ex);
+        }
+    }
+
+    {
+        binary_reader br(ss);
+        for (const auto &ex : v) {
+            REQUIRE(br.read_expression() == ex);
+        }
+
+        REQUIRE_THROWS_AS(br.read_expression(), std::invalid_argument);
+    }
+}
+
+TEST_CASE("custom func")
+{
+    auto [x, y] = make_vars("x", "y");
+
+    auto ex = expression{func{my_func{x, y}}} + x;
+
+    std::stringstream ss;
+    REQUIRE_THROWS_AS(save_binary(ss, std::vector{ex}), std::invalid_argument);
+    REQUIRE(!is_registered_func_type("my_func"));
+
+    register_func_type("my_func", [](std::vector<expression> args) {
+        return func{my_func{std::move(args.at(0)), std::move(args.at(1))}};
+    });
+    REQUIRE(is_registered_func_type("my_func"));
+
+    ss.str("");
+    ss.clear();
+    save_binary(ss, std::vector{ex});
+    REQUIRE(load_binary_expressions(ss) == std::vector{ex});
+
+    REQUIRE_THROWS_AS(register_func_type("my_func", func_factory_t{}), std::invalid_argument);
+}
+
+TEST_CASE("sys and dc roundtrip")
+{
+    auto sys = make_nbody_sys(3, kw::masses = {1., 2., 3.});
+
+    std::stringstream ss;
+    save_binary(ss, sys);
+
+    const auto sys2 = load_binary_sys(ss);
+    REQUIRE(sys2 == sys);
+
+    const auto dc = taylor_decompose(sys);
+
+    ss.str("");
+    ss.clear();
+    save_binary(ss, dc);
+
+    const auto dc2 = load_binary_dc(ss);
+    REQUIRE(dc2 == dc);
+
+    // The deserialised decomposition can be used to
+    // rebuild the integrator.
+    taylor_adaptive<double> ta0{sys, std::vector<double>(18u, 1.)};
+    REQUIRE(ta0.get_decomposition() == dc2);
+}
+
+TEST_CASE("invalid input")
+{
+    std::stringstream ss;
+    REQUIRE_THROWS_AS(load_binary_expressions(ss), std::invalid_argument);
+
+    ss.str("not a heyoka binary stream");
+    ss.clear();
+    REQUIRE_THROWS_AS(load_binary_expressions(ss), std::invalid_argument);
+
+    // Truncated data.
+    ss.str("");
+    ss.clear();
+    save_binary(ss, std::vector{"x"_var + "y"_var});
+    auto str = ss.str();
+    str.pop_back();
+
+    ss.str(str);
+    ss.clear();
+    REQUIRE_THROWS_AS(load_binary_expressions(ss), std::invalid_argument);
+
+    // Corrupted sizes must not result in huge allocations.
+    const auto huge_size = std::numeric_limits<std::uint64_t>::max() / 2u;
+
+    ss.str("");
+    ss.clear();
+    save_binary(ss, std::vector{"x"_var});
+    str = ss.str();
+    // NOTE: the name of the variable is preceded by its size.
+    str.replace(str.size() - 1u - sizeof(std::uint64_t), sizeof(std::uint64_t),
+                reinterpret_cast<const char *>(&huge_size), sizeof(std::uint64_t));
+
+    ss.str(str);
+    ss.clear();
+    REQUIRE_THROWS_AS(load_binary_expressions(ss), std::invalid_argument);
+
+    ss.str("");
+    ss.clear();
+    save_binary(ss, std::vector{sin("x"_var)});
+    str = ss.str();
+    // NOTE: the name of the function is followed by the number of arguments.
+    str.replace(str.find("sin") + 3u, sizeof(std::uint64_t), reinterpret_cast<const char *>(&huge_size),
+                sizeof(std::uint64_t));
+
+    ss.str(str);
+    ss.clear();
+    REQUIRE_THROWS_AS(load_binary_expressions(ss), std::invalid_argument);
+}
@@ -0,0 +1,238 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/math/pow.hpp>
+#include <heyoka/serialization.hpp>
+#include <heyoka/sph_harm.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+namespace
+{
+
+// Unnormalised coefficients up to degree and order 2.
+const std::vector<std::vector<double>> cnm_2 = {{1.}, {0., 0.}, {-1.08e-3, 2e-4, 1.5e-4}};
+const std::vector<std::vector<double>> snm_2 = {{0.}, {0., 0.}, {0., 3e-4, -9e-5}};
+
+const std::vector<double> init_state = {1.7, 0.2, 0.4, 0.1, 0.75, 0.05};
+
+void compare_states(const std::vector<double> &a, const std::vector<double> &b, double tol)
+{
+    REQUIRE(a.size() == b.size());
+
+    for (decltype(a.size()) i = 0; i < a.size(); ++i) {
+        REQUIRE(std::abs(a[i] - b[i]) < tol);
+    }
+}
+
+} // namespace
+
+TEST_CASE("sph harm closed form")
+{
+    auto [x, y, z, vx, vy, vz] = make_vars("x", "y", "z", "vx", "vy", "vz");
+
+    const auto mu = 1.2, R = 0.9;
+
+    // The potential up to degree and order 2 in closed form.
+    const auto r2 = x * x + y * y + z * z;
+    const auto U = mu * pow(r2, -.5_dbl)
+                   + mu * R * R * cnm_2[2][0] * (1.5_dbl * z * z * pow(r2, -2.5_dbl) - .5_dbl * pow(r2, -1.5_dbl))
+                   + 3. * mu * R * R * z * (cnm_2[2][1] * x + snm_2[2][1] * y) * pow(r2, -2.5_dbl)
+                   + 3. * mu * R * R * (cnm_2[2][2] * (x * x - y * y) + 2. * snm_2[2][2] * x * y) * pow(r2, -2.5_dbl);
+
+    auto ta_cf = taylor_adaptive<double>{
+        {prime(x) = vx, prime(y) = vy, prime(z) = vz, prime(vx) = diff(U, "x"), prime(vy) = diff(U, "y"),
+         prime(vz) = diff(U, "z")},
+        init_state};
+
+    auto ta_sh = taylor_adaptive<double>{
+        make_sph_harm_sys(2, 2, kw::mu = mu, kw::radius = R, kw::cnm = cnm_2, kw::snm = snm_2, kw::normalised = false),
+        init_state};
+
+    ta_cf.propagate_until(10.);
+    ta_sh.propagate_until(10.);
+
+    compare_states(ta_cf.get_state(), ta_sh.get_state(), 1e-11);
+
+    // Point mass.
+    auto ta_pm = taylor_adaptive<double>{
+        {prime(x) = vx, prime(y) = vy, prime(z) = vz, prime(vx) = -mu * x * pow(r2, -1.5_dbl),
+         prime(vy) = -mu * y * pow(r2, -1.5_dbl), prime(vz) = -mu * z * pow(r2, -1.5_dbl)},
+        init_state};
+    auto ta_sh0 = taylor_adaptive<double>{make_sph_harm_sys(0, 0, kw::mu = mu, kw::radius = R,
+                                                             kw::cnm = std::vector<std::vector<double>>{{1.}},
+                                                             kw::snm = std::vector<std::vector<double>>{{0.}}),
+                                           init_state};
+
+    ta_pm.propagate_until(10.);
+    ta_sh0.propagate_until(10.);
+
+    compare_states(ta_pm.get_state(), ta_sh0.get_state(), 1e-12);
+}
+
+TEST_CASE("sph harm normalisation and pars")
+{
+    // Normalise the coefficients of degree 2.
+    auto cnm_n = cnm_2, snm_n = snm_2;
+    for (std::uint32_t m = 0; m <= 2u; ++m) {
+        // sqrt((2 - delta_0m) * 5 * (2 - m)! / (2 + m)!).
+        const double fact[] = {1., 1., 2., 6., 24.};
+        const auto nf = std::sqrt((m == 0u ? 1. : 2.) * 5. * fact[2u - m] / fact[2u + m]);
+
+        cnm_n[2][m] /= nf;
+        snm_n[2][m] /= nf;
+    }
+
+    auto ta = taylor_adaptive<double>{
+        make_sph_harm_sys(2, 2, kw::cnm = cnm_2, kw::snm = snm_2, kw::normalised = false), init_state};
+    auto ta_n = taylor_adaptive<double>{make_sph_harm_sys(2, 2, kw::cnm = cnm_n, kw::snm = snm_n), init_state};
+
+    // Coefficients as runtime parameters, after 3 unrelated parameters.
+    std::vector<double> pars = {0., 0., 0.};
+    for (std::uint32_t n = 0; n <= 2u; ++n) {
+        for (std::uint32_t m = 0; m <= n; ++m) {
+            pars.push_back(cnm_n[n][m]);
+            pars.push_back(snm_n[n][m]);
+        }
+    }
+    auto ta_p = taylor_adaptive<double>{make_sph_harm_sys(2, 2, kw::par_offset = 3), init_state, kw::pars = pars};
+
+    ta.propagate_until(10.);
+    ta_n.propagate_until(10.);
+    ta_p.propagate_until(10.);
+
+    compare_states(ta.get_state(), ta_n.get_state(), 1e-11);
+    compare_states(ta.get_state(), ta_p.get_state(), 1e-11);
+}
+
+TEST_CASE("sph harm compact mode")
+{
+    // A field of degree and order 12 with made-up normalised coefficients.
+    std::vector<std::vector<double>> cnm, snm;
+    for (std::uint32_t n = 0; n <= 12u; ++n) {
+        cnm.emplace_back();
+        snm.emplace_back();
+
+        for (std::uint32_t m = 0; m <= n; ++m) {
+            cnm.back().push_back(n == 0u ? 1. : (n < 2u ? 0. : 1e-6 * std::cos(n + 2. * m)));
+            snm.back().push_back(m == 0u || n < 2u ? 0. : 1e-6 * std::sin(3. * n + m));
+        }
+    }
+
+    const auto sys = make_sph_harm_sys(12, 12, kw::cnm = cnm, kw::snm = snm);
+
+    auto ta = taylor_adaptive<double>{sys, init_state};
+    auto ta_c = taylor_adaptive<double>{sys, init_state, kw::compact_mode = true};
+
+    ta.propagate_until(5.);
+    ta_c.propagate_until(5.);
+
+    compare_states(ta.get_state(), ta_c.get_state(), 1e-12);
+}
+
+TEST_CASE("sph harm distinct fields")
+{
+    auto [x, y, z, vx, vy, vz] = make_vars("x", "y", "z", "vx", "vy", "vz");
+
+    // A second field with a different J2.
+    auto cnm_b = cnm_2;
+    cnm_b[2][0] *= 3;
+
+    auto acc_a = sph_harm_gravity(x, y, z, 2, 2, kw::cnm = cnm_2, kw::snm = snm_2, kw::normalised = false);
+    auto acc_b = sph_harm_gravity(x, y, z, 2, 2, kw::cnm = cnm_b, kw::snm = snm_2, kw::normalised = false);
+
+    // Fields differing only in the coefficients, in the gravitational
+    // parameter or in the normalisation are different functions.
+    REQUIRE(acc_a[0] != acc_b[0]);
+    REQUIRE(acc_a[0] != sph_harm_gravity(x, y, z, 2, 2, kw::mu = 2., kw::cnm = cnm_2, kw::snm = snm_2,
+                                         kw::normalised = false)[0]);
+    REQUIRE(acc_a[0] != sph_harm_gravity(x, y, z, 2, 2, kw::cnm = cnm_2, kw::snm = snm_2)[0]);
+    REQUIRE(sph_harm_gravity(x, y, z, 2, 2)[0] != sph_harm_gravity(x, y, z, 2, 2, kw::par_offset = 1)[0]);
+    REQUIRE(acc_a[0] != acc_a[1]);
+    REQUIRE(acc_a[0]
+            == sph_harm_gravity(x, y, z, 2, 2, kw::cnm = cnm_2, kw::snm = snm_2, kw::normalised = false)[0]);
+
+    // The acceleration is linear in the coefficients: the sum of the two fields
+    // at the same position is the field with the sum of the coefficients.
+    auto cnm_ab = cnm_2, snm_ab = snm_2;
+    for (std::uint32_t n = 0; n <= 2u; ++n) {
+        for (std::uint32_t m = 0; m <= n; ++m) {
+            cnm_ab[n][m] += cnm_b[n][m];
+            snm_ab[n][m] += snm_2[n][m];
+        }
+    }
+
+    auto ta = taylor_adaptive<double>{{prime(x) = vx, prime(y) = vy, prime(z) = vz, prime(vx) = acc_a[0] + acc_b[0],
+                                       prime(vy) = acc_a[1] + acc_b[1], prime(vz) = acc_a[2] + acc_b[2]},
+                                      init_state};
+    auto ta_ab = taylor_adaptive<double>{
+        make_sph_harm_sys(2, 2, kw::cnm = cnm_ab, kw::snm = snm_ab, kw::normalised = false), init_state};
+
+    ta.propagate_until(5.);
+    ta_ab.propagate_until(5.);
+
+    compare_states(ta.get_state(), ta_ab.get_state(), 1e-11);
+}
+
+TEST_CASE("sph harm s11n")
+{
+    auto [x, y, z] = make_vars("x", "y", "z");
+
+    auto v = sph_harm_gravity(x, y, z, 2, 2, kw::mu = 1.5, kw::radius = .5, kw::cnm = cnm_2, kw::snm = snm_2);
+    for (auto &ex : sph_harm_gravity(x, y, z, 3, 1, kw::par_offset = 2, kw::normalised = false)) {
+        v.push_back(std::move(ex));
+    }
+
+    std::stringstream ss;
+    save_binary(ss, v);
+
+    REQUIRE(load_binary_expressions(ss) == v);
+
+    // Invalid arguments.
+    REQUIRE_THROWS_AS(func(detail::sph_harm_impl(3, std::vector{x, y, z, 1_dbl, 1_dbl, 0_dbl, 0_dbl, 1_dbl, 1_dbl,
+                                                                0_dbl})),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(func(detail::sph_harm_impl(0, std::vector{x, y, z, 1_dbl, 1_dbl, 1_dbl, 0_dbl, 1_dbl, 1_dbl,
+                                                                0_dbl})),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(func(detail::sph_harm_impl(0, std::vector{x, y, z, 1_dbl, 1_dbl, .5_dbl, 0_dbl, 1_dbl, 1_dbl,
+                                                                0_dbl})),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(func(detail::sph_harm_impl(0, std::vector{x, y, z, 1_dbl, 1_dbl, 0_dbl, 0_dbl, 1_dbl, x,
+                                                                0_dbl})),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(func(detail::sph_harm_impl(0, std::vector{x, y, z, x, 1_dbl, 0_dbl, 0_dbl, 1_dbl, 1_dbl,
+                                                                0_dbl})),
+                      std::invalid_argument);
+}
+
+TEST_CASE("sph harm errors")
+{
+    auto [x, y, z] = make_vars("x", "y", "z");
+
+    REQUIRE_THROWS_AS(sph_harm_gravity(x, y, z, 2, 3), std::invalid_argument);
+    REQUIRE_THROWS_AS(sph_harm_gravity(x, y, z, 121, 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(sph_harm_gravity(x, y, z, 3, 2, kw::cnm = cnm_2, kw::snm = snm_2), std::invalid_argument);
+    REQUIRE_THROWS_AS(sph_harm_gravity(x, y, z, 2, 2, kw::cnm = cnm_2,
+                                       kw::snm = std::vector<std::vector<double>>{{0.}, {0., 0.}, {0.}}),
+                      std::invalid_argument);
+}
@@ -8,12 +8,24 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <initializer_list>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <boost/math/constants/constants.hpp>
 
+#include <heyoka/detail/parallel.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/llvm_state.hpp>
+#include <heyoka/math.hpp>
 #include <heyoka/nbody.hpp>
 #include <heyoka/taylor.hpp>
 
@@ -169,3 +181,556 @@ TEST_CASE("param batch")
     REQUIRE(tad.get_state()[20 + 1] == approximately(v0));
     REQUIRE(tad.get_state()[22 + 1] == approximately(0.));
 }
+
+namespace
+{
+
+// RAII helper to override the number of threads
+// used in the parallel code paths.
+struct n_threads_override {
+    explicit n_threads_override(std::size_t n)
+    {
+        detail::parallel_set_n_threads(n);
+    }
+    n_threads_override(const n_threads_override &) = delete;
+    n_threads_override &operator=(const n_threads_override &) = delete;
+    ~n_threads_override()
+    {
+        detail::parallel_set_n_threads(0);
+    }
+};
+
+} // namespace
+
+// Check the structural properties of the decomposition
+// of a large system (large enough to be split in multiple
+// blocks in the parallel code paths).
+TEST_CASE("large decomposition")
+{
+    const auto sys = make_nbody_sys(25);
+    const auto n_eq = sys.size();
+
+    // The serial decomposition.
+    const auto dc = [&sys]() {
+        n_threads_override nto(1);
+
+        return taylor_decompose(sys);
+    }();
+
+    REQUIRE(dc.size() > n_eq * 2u);
+
+    // The parallel decomposition must produce the same result,
+    // regardless of the number of threads.
+    for (std::size_t n_threads : {2, 3, 8}) {
+        n_threads_override nto(n_threads);
+
+        REQUIRE(taylor_decompose(sys) == dc);
+    }
+    REQUIRE(taylor_decompose(sys) == dc);
+
+    std::unordered_set<expression> uvars_defs;
+    for (auto i = n_eq; i < dc.size() - n_eq; ++i) {
+        // No duplicate definitions after CSE.
+        REQUIRE(uvars_defs.insert(dc[i].first).second);
+
+        // Topological ordering.
+        for (const auto &var : get_variables(dc[i].first)) {
+            REQUIRE(std::stoul(var.substr(2)) < i);
+        }
+        for (auto idx : dc[i].second) {
+            REQUIRE(idx >= n_eq);
+            REQUIRE(idx < dc.size() - n_eq);
+        }
+    }
+
+    // Check that an integrator can be built and
+    // run from the system.
+    std::vector<double> init_state;
+    for (std::size_t i = 0; i < 25u; ++i) {
+        init_state.push_back(static_cast<double>(i));
+        init_state.push_back(static_cast<double>(i * i) / 10.);
+        init_state.push_back(-static_cast<double>(i));
+    }
+    for (std::size_t i = 0; i < 25u; ++i) {
+        init_state.push_back(0.1 * std::cos(static_cast<double>(i)));
+        init_state.push_back(0.1 * std::sin(static_cast<double>(i)));
+        init_state.push_back(0.);
+    }
+
+    auto ta = taylor_adaptive<double>{sys, init_state};
+
+    REQUIRE(ta.get_decomposition() == dc);
+
+    const auto oc = std::get<0>(ta.propagate_until(1.));
+    REQUIRE(oc == taylor_outcome::time_limit);
+}
+
+TEST_CASE("step callback")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    // Scalar.
+    {
+        auto ta = taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.025}};
+
+        // Count the steps via the callback.
+        std::size_t n_cb = 0;
+        auto [oc, min_h, max_h, n_steps] = ta.propagate_until(10., 0, [&n_cb](auto &) {
+            ++n_cb;
+            return true;
+        });
+
+        REQUIRE(oc == taylor_outcome::time_limit);
+        REQUIRE(n_cb == n_steps);
+        REQUIRE(ta.get_time() == 10.);
+
+        // Stop when x changes sign.
+        n_cb = 0;
+        std::tie(oc, min_h, max_h, n_steps) = ta.propagate_for(10., 0, [&n_cb](auto &tint) {
+            ++n_cb;
+            return tint.get_state()[0] > 0;
+        });
+
+        REQUIRE(oc == taylor_outcome::cb_stop);
+        REQUIRE(n_cb == n_steps);
+        REQUIRE(ta.get_state()[0] <= 0);
+        REQUIRE(ta.get_time() < 20.);
+
+        // The step limit is checked after the callback.
+        std::tie(oc, min_h, max_h, n_steps) = ta.propagate_for(10., 1, [](auto &) { return false; });
+        REQUIRE(oc == taylor_outcome::cb_stop);
+        REQUIRE(n_steps == 1u);
+
+        // Reaching the time limit has precedence over a stop request.
+        std::tie(oc, min_h, max_h, n_steps) = ta.propagate_for(1E-6, 0, [](auto &) { return false; });
+        REQUIRE(oc == taylor_outcome::time_limit);
+
+        std::ostringstream oss;
+        oss << taylor_outcome::cb_stop;
+        REQUIRE(oss.str() == "cb_stop");
+    }
+
+    // Batch.
+    {
+        auto ta = taylor_adaptive_batch<double>{
+            {prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.06, 0.025, 0.026}, 2};
+
+        std::size_t n_cb = 0;
+        const auto &res = ta.propagate_until({10., 10.}, 0, [&n_cb](auto &) {
+            ++n_cb;
+            return true;
+        });
+
+        for (const auto &r : res) {
+            REQUIRE(std::get<0>(r) == taylor_outcome::time_limit);
+            REQUIRE(std::get<3>(r) <= n_cb);
+        }
+
+        // Stop after the first step, with the second batch element
+        // reaching the time limit immediately.
+        const auto &res2 = ta.propagate_for({10., 0.}, 0, [](auto &) { return false; });
+
+        REQUIRE(std::get<0>(res2[0]) == taylor_outcome::cb_stop);
+        REQUIRE(std::get<0>(res2[1]) == taylor_outcome::time_limit);
+    }
+}
+
+TEST_CASE("invariants")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    // The decomposition of functions of the state variables.
+    {
+        const auto [dc, sv_idx] = taylor_decompose({prime(x) = v, prime(v) = -9.8 * sin(x)}, {v * v / 2_dbl, x});
+
+        REQUIRE(sv_idx.size() == 2u);
+        REQUIRE(sv_idx[1] == 0u);
+        REQUIRE(sv_idx[0] >= 2u);
+        REQUIRE(sv_idx[0] < dc.size() - 2u);
+
+        // The decomposition of the system is the same.
+        REQUIRE(dc == taylor_decompose({prime(x) = v, prime(v) = -9.8 * sin(x)}));
+
+        REQUIRE_THROWS_AS(taylor_decompose({prime(x) = v, prime(v) = -9.8 * sin(x)}, {1_dbl}), std::invalid_argument);
+        REQUIRE_THROWS_AS(taylor_decompose({prime(x) = v, prime(v) = -9.8 * sin(x)}, {"y"_var}),
+                          std::invalid_argument);
+    }
+
+    // The energy of the pendulum.
+    const auto en = v * v / 2_dbl + 9.8 * (1_dbl - cos(x));
+
+    auto ta = taylor_adaptive<double>{
+        {prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.025}, kw::invariants = {en, x * v * par[0]}};
+
+    REQUIRE(ta.get_invariants().size() == 2u);
+    REQUIRE(ta.get_pars().size() == 1u);
+    REQUIRE(ta.get_inv_drift() == std::vector<double>{0., 0.});
+
+    const auto en0 = 0.025 * 0.025 / 2 + 9.8 * (1 - std::cos(0.05));
+    REQUIRE(ta.get_inv_values()[0] == approximately(en0));
+    REQUIRE(ta.get_inv_values()[1] == 0.);
+
+    auto oc = std::get<0>(ta.propagate_until(100.));
+    REQUIRE(oc == taylor_outcome::time_limit);
+
+    // The energy is conserved, the drift is small.
+    REQUIRE(ta.get_inv_drift()[0] > 0.);
+    REQUIRE(ta.get_inv_drift()[0] < 1E-12);
+    REQUIRE(ta.get_inv_values()[0] == approximately(en0, 1000.));
+
+    // Copy semantics.
+    auto ta_copy = ta;
+    REQUIRE(ta_copy.get_inv_drift() == ta.get_inv_drift());
+    ta_copy.reset_inv_drift();
+    REQUIRE(ta_copy.get_inv_drift() == std::vector<double>{0., 0.});
+    ta_copy.step();
+    REQUIRE(ta_copy.get_inv_drift()[0] > 0.);
+
+    // Terminal outcome. Use a non-conserved quantity
+    // as an invariant.
+    auto ta2 = taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)},
+                                       {0.05, 0.025},
+                                       kw::invariants = {v * v},
+                                       kw::inv_tol = 1E-3};
+
+    REQUIRE(ta2.get_inv_tol() == 1E-3);
+
+    oc = std::get<0>(ta2.propagate_until(100.));
+    REQUIRE(oc == taylor_outcome::err_inv_drift);
+    REQUIRE(ta2.get_time() < 100.);
+    REQUIRE(ta2.get_inv_drift()[0] > 1E-3);
+
+    std::ostringstream oss;
+    oss << taylor_outcome::err_inv_drift;
+    REQUIRE(oss.str() == "err_inv_drift");
+
+    REQUIRE_THROWS_AS((taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)},
+                                               {0.05, 0.025},
+                                               kw::invariants = {en},
+                                               kw::inv_tol = 0.}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS((taylor_adaptive<double>{
+                          {prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.025}, kw::invariants = {en + "y"_var}}),
+                      std::invalid_argument);
+}
+
+TEST_CASE("weights")
+{
+    auto [x1, v1, x2, v2] = make_vars("x1", "v1", "x2", "v2");
+
+    // A slow oscillator with a large amplitude and a fast
+    // oscillator with a tiny amplitude. Without weights, the
+    // timestep is dictated by the fast oscillator.
+    const auto sys = std::vector{prime(x1) = v1, prime(v1) = -x1, prime(x2) = v2, prime(v2) = -100. * x2};
+    const auto ic = std::vector{1000., 0., 1E-3, 0.};
+
+    for (auto cm : {false, true}) {
+        auto ta = taylor_adaptive<double>{sys, ic, kw::compact_mode = cm};
+        REQUIRE(ta.get_weights().empty());
+
+        auto ta_w = taylor_adaptive<double>{sys, ic, kw::compact_mode = cm, kw::weights = {1., 1., 1E-20, 1E-20}};
+        REQUIRE(ta_w.get_weights() == std::vector{1., 1., 1E-20, 1E-20});
+
+        const auto n_steps = std::get<3>(ta.propagate_until(10.));
+        const auto n_steps_w = std::get<3>(ta_w.propagate_until(10.));
+
+        REQUIRE(n_steps_w < n_steps);
+
+        // The slow oscillator is still integrated accurately.
+        REQUIRE(ta_w.get_state()[0] == approximately(1000. * std::cos(10.), 1000.));
+        REQUIRE(ta_w.get_state()[1] == approximately(-1000. * std::sin(10.), 1000.));
+
+        // Copy semantics.
+        auto ta_w2 = ta_w;
+        REQUIRE(ta_w2.get_weights() == ta_w.get_weights());
+
+        // Unit weights do not change the integration.
+        auto ta_1 = taylor_adaptive<double>{sys, ic, kw::compact_mode = cm, kw::weights = {1., 1., 1., 1.}};
+        REQUIRE(std::get<3>(ta_1.propagate_until(10.)) == n_steps);
+        REQUIRE(ta_1.get_state() == ta.get_state());
+
+        // Batch mode.
+        auto tab = taylor_adaptive_batch<double>{sys,
+                                                 {1000., 1000., 0., 0., 1E-3, 1E-3, 0., 0.},
+                                                 2,
+                                                 kw::compact_mode = cm,
+                                                 kw::weights = {1., 1., 1E-20, 1E-20}};
+        REQUIRE(tab.get_weights() == std::vector{1., 1., 1E-20, 1E-20});
+
+        for (const auto &res : tab.propagate_until({10., 10.})) {
+            REQUIRE(std::get<3>(res) < n_steps);
+        }
+        REQUIRE(tab.get_state()[0] == approximately(ta_w.get_state()[0], 1000.));
+    }
+
+    // Error handling.
+    REQUIRE_THROWS_AS((taylor_adaptive<double>{sys, ic, kw::weights = {1., 1.}}), std::invalid_argument);
+    REQUIRE_THROWS_AS((taylor_adaptive<double>{sys, ic, kw::weights = {1., 1., 0., 1.}}), std::invalid_argument);
+    REQUIRE_THROWS_AS((taylor_adaptive<double>{sys, ic, kw::weights = {1., 1., std::nan(""), 1.}}),
+                      std::invalid_argument);
+}
+
+TEST_CASE("variable order")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    for (auto cm : {false, true}) {
+        for (auto ha : {false, true}) {
+            auto ta = taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)},
+                                              {0.05, 0.025},
+                                              kw::high_accuracy = ha,
+                                              kw::compact_mode = cm};
+            auto ta_vo = taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)},
+                                                 {0.05, 0.025},
+                                                 kw::high_accuracy = ha,
+                                                 kw::compact_mode = cm,
+                                                 kw::variable_order = true};
+
+            REQUIRE(ta.get_vo_orders().empty());
+            REQUIRE(ta.get_cur_order() == ta.get_order());
+
+            // The candidate orders are centred on the order
+            // deduced from the tolerance.
+            REQUIRE(ta_vo.get_vo_orders() == std::vector<std::uint32_t>{16, 18, 20, 22, 24});
+            REQUIRE(ta_vo.get_order() == 24u);
+            REQUIRE(ta_vo.get_cur_order() == ta.get_order());
+            REQUIRE(ta_vo.get_tc().size() == 2u * 25u);
+
+            ta.propagate_until(10.);
+            REQUIRE(std::get<0>(ta_vo.propagate_until(10.)) == taylor_outcome::time_limit);
+
+            REQUIRE(ta_vo.get_state()[0] == approximately(ta.get_state()[0], 1000.));
+            REQUIRE(ta_vo.get_state()[1] == approximately(ta.get_state()[1], 1000.));
+
+            const auto &orders = ta_vo.get_vo_orders();
+            REQUIRE(std::find(orders.begin(), orders.end(), ta_vo.get_cur_order()) != orders.end());
+
+            // The Taylor coefficients are stored according
+            // to the layout at the largest order.
+            const auto prev_order = ta_vo.get_cur_order();
+            const auto prev_state = ta_vo.get_state();
+            ta_vo.step(true);
+            const auto &tc = ta_vo.get_tc();
+            REQUIRE(tc[0] == prev_state[0]);
+            REQUIRE(tc[25] == prev_state[1]);
+            for (auto j = prev_order + 1u; j < 25u; ++j) {
+                REQUIRE(tc[j] == 0.);
+                REQUIRE(tc[25u + j] == 0.);
+            }
+
+            // Copy semantics.
+            auto ta_vo2 = ta_vo;
+            REQUIRE(ta_vo2.get_cur_order() == ta_vo.get_cur_order());
+            ta_vo.step();
+            ta_vo2.step();
+            REQUIRE(ta_vo2.get_state() == ta_vo.get_state());
+            REQUIRE(ta_vo2.get_time() == ta_vo.get_time());
+        }
+    }
+
+    // In a linear system the cost of a timestep grows
+    // only linearly with the order, hence the largest
+    // order is selected.
+    auto ta_lin = taylor_adaptive<double>{{prime(x) = v, prime(v) = -x}, {0., 1.}, kw::variable_order = true};
+    ta_lin.step();
+    REQUIRE(ta_lin.get_cur_order() == 24u);
+
+    ta_lin.propagate_until(100.);
+    REQUIRE(ta_lin.get_state()[0] == approximately(std::sin(100.), 10000.));
+    REQUIRE(ta_lin.get_state()[1] == approximately(std::cos(100.), 10000.));
+
+    // Setting the time does not alter the order, resetting
+    // it to the order deduced from the tolerance requires
+    // an explicit reset_vo_order().
+    ta_lin.set_time(0.);
+    REQUIRE(ta_lin.get_cur_order() == 24u);
+    ta_lin.reset_vo_order();
+    REQUIRE(ta_lin.get_cur_order() == 20u);
+    ta_lin.step();
+    REQUIRE(ta_lin.get_cur_order() == 24u);
+
+    // Small tolerances.
+    auto ta_lo = taylor_adaptive<double>{
+        {prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.025}, kw::tol = 1E-3, kw::variable_order = true};
+    REQUIRE(ta_lo.get_vo_orders() == std::vector<std::uint32_t>{3, 5, 7, 9});
+}
+
+TEST_CASE("multiple tolerances")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const auto sys = std::vector{prime(x) = v, prime(v) = -9.8 * sin(x)};
+
+    for (auto cm : {false, true}) {
+        auto ta = taylor_adaptive<double>{sys, {0.05, 0.025}, kw::compact_mode = cm, kw::extra_tols = {1E-6, 1E-10}};
+
+        REQUIRE(ta.get_tols() == std::vector{std::numeric_limits<double>::epsilon(), 1E-6, 1E-10});
+        REQUIRE(ta.get_tol_idx() == 0u);
+        REQUIRE(ta.get_cur_order() == 20u);
+        REQUIRE(ta.get_order() == 20u);
+
+        // Reference integrators.
+        auto ta_lo = taylor_adaptive<double>{sys, {0.05, 0.025}, kw::compact_mode = cm, kw::tol = 1E-6};
+        auto ta_hi = taylor_adaptive<double>{sys, {0.05, 0.025}, kw::compact_mode = cm};
+
+        // Coarse propagation at the loosest tolerance,
+        // then refinement at the tightest one.
+        ta.select_tol(1);
+        REQUIRE(ta.get_tol_idx() == 1u);
+        REQUIRE(ta.get_cur_order() == ta_lo.get_order());
+
+        const auto n_lo = std::get<3>(ta.propagate_until(5.));
+        REQUIRE(n_lo == std::get<3>(ta_lo.propagate_until(5.)));
+        REQUIRE(ta.get_state()[0] == approximately(ta_lo.get_state()[0]));
+        REQUIRE(ta.get_state()[1] == approximately(ta_lo.get_state()[1]));
+
+        // Taylor coefficients are padded with zeroes
+        // above the order of the active tolerance.
+        ta.step(true);
+        for (auto j = ta.get_cur_order() + 1u; j <= ta.get_order(); ++j) {
+            REQUIRE(ta.get_tc()[j] == 0.);
+            REQUIRE(ta.get_tc()[ta.get_order() + 1u + j] == 0.);
+        }
+
+        ta.select_tol(0);
+        ta.set_time(0.);
+        std::copy(ta_hi.get_state().begin(), ta_hi.get_state().end(), ta.get_state_data());
+        REQUIRE(std::get<3>(ta.propagate_until(5.)) > n_lo);
+        ta_hi.propagate_until(5.);
+        REQUIRE(ta.get_state()[0] == approximately(ta_hi.get_state()[0]));
+        REQUIRE(ta.get_state()[1] == approximately(ta_hi.get_state()[1]));
+
+        // Copy semantics.
+        ta.select_tol(2);
+        auto ta2 = ta;
+        REQUIRE(ta2.get_tol_idx() == 2u);
+        ta.step();
+        ta2.step();
+        REQUIRE(ta2.get_state() == ta.get_state());
+
+        REQUIRE_THROWS_AS(ta.select_tol(3), std::invalid_argument);
+    }
+
+    // Single tolerance.
+    auto ta = taylor_adaptive<double>{sys, {0.05, 0.025}};
+    REQUIRE(ta.get_tols() == std::vector{std::numeric_limits<double>::epsilon()});
+    ta.select_tol(0);
+    REQUIRE_THROWS_AS(ta.select_tol(1), std::invalid_argument);
+
+    // Error handling.
+    REQUIRE_THROWS_AS((taylor_adaptive<double>{sys, {0.05, 0.025}, kw::extra_tols = {-1.}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        (taylor_adaptive<double>{sys, {0.05, 0.025}, kw::extra_tols = {1E-6}, kw::variable_order = true}),
+        std::invalid_argument);
+}
+
+TEST_CASE("second order sys")
+{
+    auto [x, y, vx, vy] = make_vars("x", "y", "vx", "vy");
+
+    const auto sys = make_second_order_sys({{x, vx, -x - .1 * vy}, {y, vy, -y + .1 * vx}});
+
+    REQUIRE(sys.size() == 4u);
+    REQUIRE(sys[0].first == x);
+    REQUIRE(sys[0].second == vx);
+    REQUIRE(sys[1].first == y);
+    REQUIRE(sys[1].second == vy);
+    REQUIRE(sys[2].first == vx);
+    REQUIRE(sys[3].first == vy);
+
+    // The equations for the coordinates do not introduce any u variable:
+    // their right-hand sides are the state variables vx and vy, and the
+    // decomposition is as large as if the coordinates had constant derivatives.
+    const auto dc = taylor_decompose(sys);
+    REQUIRE(dc[dc.size() - 4u].first == "u_2"_var);
+    REQUIRE(dc[dc.size() - 3u].first == "u_3"_var);
+    REQUIRE(dc.size()
+            == taylor_decompose({prime(x) = 1_dbl, prime(y) = 1_dbl, prime(vx) = -x - .1 * vy,
+                                 prime(vy) = -y + .1 * vx})
+                   .size());
+
+    // The normalised derivatives of order k of the coordinates are computed
+    // directly from the derivatives of order k - 1 of the velocities.
+    for (auto cm : {false, true}) {
+        const std::uint32_t order = 6;
+
+        llvm_state s;
+        taylor_add_jet<double>(s, "jet", sys, order, 1, false, cm);
+        s.compile();
+        auto jptr = reinterpret_cast<void (*)(double *, const double *, const double *)>(s.jit_lookup("jet"));
+
+        // NOTE: the variables are ordered as x, y, vx, vy.
+        std::vector<double> jet(4u * (order + 1u));
+        jet[0] = 0.05;
+        jet[1] = 0.025;
+        jet[2] = -0.1;
+        jet[3] = 0.02;
+        jptr(jet.data(), nullptr, nullptr);
+
+        for (std::uint32_t k = 1; k <= order; ++k) {
+            REQUIRE(jet[k * 4u] == jet[(k - 1u) * 4u + 2u] / k);
+            REQUIRE(jet[k * 4u + 1u] == jet[(k - 1u) * 4u + 3u] / k);
+        }
+    }
+
+    // Error handling.
+    REQUIRE_THROWS_AS(make_second_order_sys({}), std::invalid_argument);
+    REQUIRE_THROWS_AS(make_second_order_sys({{x, vx, -x}, {y, vx, -y}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(make_second_order_sys({{x, x, -x}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(make_second_order_sys({{x + y, vx, -x}}), std::invalid_argument);
+}
+
+// NOTE: in LLVM, the elements of a vector of x86_fp80 are bit-packed, while
+// in an array of long double they are padded to 16 bytes. Check that the
+// batch mode loads/stores of long double values respect the array layout.
+TEST_CASE("long double batch memory")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    for (auto batch_size : {2u, 4u, 5u}) {
+        for (auto cm : {false, true}) {
+            llvm_state s;
+
+            taylor_add_jet<long double>(s, "jet", {prime(x) = v, prime(v) = -x}, 2, batch_size, false, cm);
+
+            s.compile();
+
+            auto jptr = reinterpret_cast<void (*)(long double *, const long double *, const long double *)>(
+                s.jit_lookup("jet"));
+
+            std::vector<long double> jet(6u * batch_size);
+            for (auto i = 0u; i < batch_size; ++i) {
+                jet[i] = i + 1;
+                jet[batch_size + i] = -static_cast<long double>(i) - 10;
+            }
+
+            jptr(jet.data(), nullptr, nullptr);
+
+            for (auto i = 0u; i < batch_size; ++i) {
+                const auto x0 = jet[i], v0 = jet[batch_size + i];
+
+                REQUIRE(jet[2u * batch_size + i] == v0);
+                REQUIRE(jet[3u * batch_size + i] == -x0);
+                REQUIRE(jet[4u * batch_size + i] == -x0 / 2);
+                REQUIRE(jet[5u * batch_size + i] == -v0 / 2);
+            }
+        }
+    }
+
+    // The same in a batch integrator, compared to the scalar ones.
+    const std::vector<long double> init_x = {1, 2, 3, 4}, init_v = {-1, .5, 0, .25};
+
+    std::vector<long double> init_b(init_x);
+    init_b.insert(init_b.end(), init_v.begin(), init_v.end());
+
+    auto ta_b = taylor_adaptive_batch<long double>{{prime(x) = v, prime(v) = -x - .1L * v}, init_b, 4};
+    ta_b.propagate_until(std::vector<long double>{1, 1, 1, 1});
+
+    for (auto i = 0u; i < 4u; ++i) {
+        auto ta = taylor_adaptive<long double>{{prime(x) = v, prime(v) = -x - .1L * v}, {init_x[i], init_v[i]}};
+        ta.propagate_until(1);
+
+        REQUIRE(ta.get_state()[0] == approximately(ta_b.get_state()[i], 1000.L));
+        REQUIRE(ta.get_state()[1] == approximately(ta_b.get_state()[4u + i], 1000.L));
+    }
+}
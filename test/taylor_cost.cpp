@@ -0,0 +1,98 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <heyoka/expression.hpp>
+#include <heyoka/math/sin.hpp>
+#include <heyoka/nbody.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+
+using namespace heyoka;
+
+TEST_CASE("taylor cost estimate")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const auto sys = std::vector{prime(x) = v, prime(v) = -9.8 * sin(x)};
+    const auto dc = taylor_decompose(sys);
+
+    const auto est = taylor_estimate_cost<double>(dc, 2, 20);
+
+    REQUIRE(est.order_flops.size() == 21u);
+    for (auto k = 2u; k + 1u < est.order_flops.size(); ++k) {
+        REQUIRE(est.order_flops[k] > est.order_flops[k - 1u]);
+    }
+    // At the last order, only the derivatives of the
+    // state variables are computed (one division each).
+    REQUIRE(est.order_flops.back() == 2u);
+    REQUIRE(est.step_flops > est.order_flops.back());
+
+    // sin() and cos() at order 0, plus the determination
+    // of the timestep size.
+    REQUIRE(est.step_transcendentals == 4u);
+
+    REQUIRE(est.jet_bytes == (dc.size() - 2u) * 21u * sizeof(double));
+    REQUIRE(est.unrolled_code_size > 0u);
+    REQUIRE(est.compact_code_size > 0u);
+    REQUIRE(!est.compact_mode_recommended());
+
+    // The estimate from the system matches the estimate from the decomposition.
+    const auto est2 = taylor_estimate_cost<double>(sys, 20);
+    REQUIRE(est2.order_flops == est.order_flops);
+    REQUIRE(est2.step_flops == est.step_flops);
+    REQUIRE(est2.compact_code_size == est.compact_code_size);
+    REQUIRE(est2.unrolled_code_size == est.unrolled_code_size);
+
+    // The estimate from the right-hand sides only (the state
+    // variables are v and x, in alphabetical order).
+    const auto est_rhs = taylor_estimate_cost<double>(std::vector{-9.8 * sin(x), v}, 20);
+    REQUIRE(est_rhs.order_flops == est.order_flops);
+    REQUIRE(est_rhs.step_flops == est.step_flops);
+    REQUIRE(est_rhs.step_transcendentals == est.step_transcendentals);
+    REQUIRE(est_rhs.jet_bytes == est.jet_bytes);
+
+    // Dependency on the batch size and on the type.
+    const auto est_b = taylor_estimate_cost<long double>(dc, 2, 20, 4);
+    for (auto k = 0u; k < est.order_flops.size(); ++k) {
+        REQUIRE(est_b.order_flops[k] == 4u * est.order_flops[k]);
+    }
+    REQUIRE(est_b.step_flops == 4u * est.step_flops);
+    REQUIRE(est_b.step_transcendentals == 4u * est.step_transcendentals);
+    REQUIRE(est_b.jet_bytes == (dc.size() - 2u) * 21u * 4u * sizeof(long double));
+    REQUIRE(est_b.unrolled_code_size == est.unrolled_code_size);
+    REQUIRE(est_b.compact_code_size == est.compact_code_size);
+
+    // Consistency with the integrator.
+    auto ta = taylor_adaptive<double>{sys, {0.05, 0.025}};
+    const auto est3 = taylor_estimate_cost<double>(ta.get_decomposition(), ta.get_dim(), ta.get_order());
+    REQUIRE(est3.step_flops == taylor_estimate_cost<double>(sys, ta.get_order()).step_flops);
+
+    // Error handling.
+    REQUIRE_THROWS_AS(taylor_estimate_cost<double>(dc, 0, 20), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_estimate_cost<double>(dc, 3, 20), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_estimate_cost<double>(dc, 2, 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_estimate_cost<double>(dc, 2, 20, 0), std::invalid_argument);
+}
+
+TEST_CASE("taylor cost estimate large")
+{
+    const auto sys = make_nbody_sys(20);
+
+    const auto est = taylor_estimate_cost<double>(sys, 20);
+
+    // For large systems, the code size in compact mode
+    // is much smaller than in unrolled mode.
+    REQUIRE(est.compact_mode_recommended());
+    REQUIRE(est.compact_code_size < est.unrolled_code_size);
+}
@@ -0,0 +1,165 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <heyoka/config.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/expression.hpp>
+#include <heyoka/math/sin.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+const auto fp_types = std::tuple<double, long double
+#if defined(HEYOKA_HAVE_REAL128)
+                                 ,
+                                 mppp::real128
+#endif
+                                 >{};
+
+TEST_CASE("taylor fixed pendulum")
+{
+    auto tester = [](auto fp_x) {
+        using fp_t = decltype(fp_x);
+
+        auto [x, v] = make_vars("x", "v");
+
+        for (auto cm : {false, true}) {
+            for (auto ha : {false, true}) {
+                auto ta = taylor_adaptive<fp_t>{{prime(x) = v, prime(v) = -9.8_dbl * sin(x)},
+                                                {fp_t(0.05), fp_t(0.025)},
+                                                kw::high_accuracy = ha,
+                                                kw::compact_mode = cm};
+                auto tf = taylor_fixed<fp_t>{{prime(x) = v, prime(v) = -9.8_dbl * sin(x)},
+                                             {fp_t(0.05), fp_t(0.025)},
+                                             fp_t(1) / 64,
+                                             kw::high_accuracy = ha,
+                                             kw::compact_mode = cm};
+
+                // NOTE: by default the order is deduced
+                // from the tolerance as in the adaptive integrator.
+                REQUIRE(tf.get_order() == ta.get_order());
+                REQUIRE(tf.get_dim() == 2u);
+                REQUIRE(tf.get_h() == fp_t(1) / 64);
+                REQUIRE(!tf.get_decomposition().empty());
+
+                REQUIRE(tf.step(64) == taylor_outcome::success);
+                ta.propagate_until(fp_t(1));
+
+                REQUIRE(tf.get_time() == 1);
+                REQUIRE(tf.get_state()[0] == approximately(ta.get_state()[0], fp_t(1000)));
+                REQUIRE(tf.get_state()[1] == approximately(ta.get_state()[1], fp_t(1000)));
+
+                // The splitting of the steps across invocations
+                // does not change the result.
+                auto tf2 = taylor_fixed<fp_t>{{prime(x) = v, prime(v) = -9.8_dbl * sin(x)},
+                                              {fp_t(0.05), fp_t(0.025)},
+                                              fp_t(1) / 64,
+                                              kw::high_accuracy = ha,
+                                              kw::compact_mode = cm};
+                for (auto i = 0; i < 16; ++i) {
+                    REQUIRE(tf2.step(4) == taylor_outcome::success);
+                }
+                REQUIRE(tf2.get_time() == 1);
+                REQUIRE(tf2.get_state() == tf.get_state());
+
+                // Zero steps.
+                REQUIRE(tf2.step(0) == taylor_outcome::success);
+                REQUIRE(tf2.get_time() == 1);
+                REQUIRE(tf2.get_state() == tf.get_state());
+
+                // Copy semantics.
+                auto tf3 = tf;
+                REQUIRE(tf3.step() == taylor_outcome::success);
+                REQUIRE(tf.step() == taylor_outcome::success);
+                REQUIRE(tf3.get_state() == tf.get_state());
+                REQUIRE(tf3.get_time() == tf.get_time());
+
+                // Explicit order.
+                auto tf4 = taylor_fixed<fp_t>{{prime(x) = v, prime(v) = -9.8_dbl * sin(x)},
+                                              {fp_t(0.05), fp_t(0.025)},
+                                              fp_t(1) / 64,
+                                              kw::high_accuracy = ha,
+                                              kw::compact_mode = cm,
+                                              kw::order = 6u};
+                REQUIRE(tf4.get_order() == 6u);
+                REQUIRE(tf4.step(64) == taylor_outcome::success);
+                REQUIRE(tf4.get_state()[0] == approximately(ta.get_state()[0], fp_t(1E8)));
+            }
+        }
+    };
+
+    tuple_for_each(fp_types, tester);
+}
+
+TEST_CASE("taylor fixed batch")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const std::uint32_t batch_size = 4;
+
+    auto tf = taylor_fixed_batch<double>{{prime(x) = v, prime(v) = -9.8_dbl * sin(x)},
+                                         {0.05, 0.06, 0.07, 0.08, 0.025, 0.026, 0.027, 0.028},
+                                         batch_size,
+                                         {1. / 64, 1. / 32, -1. / 64, 1. / 16}};
+
+    REQUIRE(tf.get_batch_size() == batch_size);
+    REQUIRE(tf.get_time() == std::vector<double>(batch_size, 0.));
+
+    for (auto oc : tf.step(16)) {
+        REQUIRE(oc == taylor_outcome::success);
+    }
+
+    REQUIRE(tf.get_time() == std::vector<double>{.25, .5, -.25, 1.});
+
+    // Compare with the scalar integrator.
+    for (std::uint32_t i = 0; i < batch_size; ++i) {
+        auto tf_s = taylor_fixed<double>{{prime(x) = v, prime(v) = -9.8_dbl * sin(x)},
+                                         {0.05 + i / 100., 0.025 + i / 1000.},
+                                         tf.get_h()[i]};
+
+        tf_s.step(16);
+
+        REQUIRE(tf.get_state()[i] == approximately(tf_s.get_state()[0]));
+        REQUIRE(tf.get_state()[batch_size + i] == approximately(tf_s.get_state()[1]));
+    }
+
+    REQUIRE_THROWS_AS(tf.set_h({1., 2.}), std::invalid_argument);
+    REQUIRE_THROWS_AS(tf.set_h({1., 2., 3., std::nan("")}), std::invalid_argument);
+}
+
+TEST_CASE("taylor fixed errors")
+{
+    auto [x] = make_vars("x");
+
+    REQUIRE_THROWS_AS(taylor_fixed<double>({prime(x) = x}, {1., 2.}, 0.1), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_fixed<double>({prime(x) = x}, {std::nan("")}, 0.1), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_fixed<double>({prime(x) = x}, {1.}, std::nan("")), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_fixed<double>({prime(x) = x}, {1.}, 0.1, kw::tol = -1.), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_fixed_batch<double>({prime(x) = x}, {1., 2.}, 2, {0.1}), std::invalid_argument);
+
+    // Blow-up of the solution.
+    auto tf = taylor_fixed<double>{{prime(x) = x * x}, {1.}, 10.};
+    REQUIRE(tf.step(100) == taylor_outcome::err_nf_state);
+}
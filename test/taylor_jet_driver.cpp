@@ -0,0 +1,158 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <heyoka/detail/parallel.hpp>
+#include <heyoka/expression.hpp>
+#include <heyoka/llvm_state.hpp>
+#include <heyoka/math/sin.hpp>
+#include <heyoka/math/time.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+static std::mt19937 rng;
+
+TEST_CASE("taylor jet driver")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const auto sys = std::vector{prime(x) = v, prime(v) = -par[0] * sin(x) + heyoka::time};
+    const auto obs = std::vector{x * v};
+    const std::uint32_t order = 7;
+
+    // Reference scalar jet function.
+    llvm_state s;
+    taylor_add_jet<double>(s, "jet", sys, order, 1, false, false, obs);
+    s.compile();
+    auto jptr = reinterpret_cast<void (*)(double *, const double *, const double *)>(s.jit_lookup("jet"));
+
+    std::uniform_real_distribution<double> dist(-1., 1.);
+
+    for (std::size_t n : {1u, 37u, 10000u}) {
+        std::vector<double> in(2u * n), pars(n), times(n);
+        for (auto &val : in) {
+            val = dist(rng);
+        }
+        for (auto &val : pars) {
+            val = dist(rng);
+        }
+        for (auto &val : times) {
+            val = dist(rng);
+        }
+
+        for (std::uint32_t batch_size : {0u, 1u, 3u}) {
+            for (auto cm : {false, true}) {
+                auto jd = taylor_jet_driver<double>{sys, order, kw::batch_size = batch_size, kw::compact_mode = cm,
+                                                    kw::observables = obs};
+
+                REQUIRE(jd.get_order() == order);
+                REQUIRE(jd.get_dim() == 2u);
+                REQUIRE(jd.get_n_pars() == 1u);
+                REQUIRE(jd.get_batch_size() > 0u);
+                if (batch_size != 0u) {
+                    REQUIRE(jd.get_batch_size() == batch_size);
+                }
+
+                std::vector<double> out(3u * (order + 1u) * n);
+                jd(out.data(), in.data(), n, pars.data(), times.data());
+
+                // The copy must produce the same results.
+                auto jd2 = jd;
+                std::vector<double> out2(out.size());
+                jd2(out2.data(), in.data(), n, pars.data(), times.data());
+                REQUIRE(out2 == out);
+
+                std::vector<double> jet(3u * (order + 1u));
+                for (std::size_t i = 0; i < n; ++i) {
+                    jet[0] = in[i];
+                    jet[1] = in[n + i];
+                    jptr(jet.data(), pars.data() + i, times.data() + i);
+
+                    for (std::size_t j = 0; j < jet.size(); ++j) {
+                        REQUIRE(out[j * n + i] == approximately(jet[j]));
+                    }
+                }
+            }
+        }
+    }
+
+    // A null time pointer is equivalent to zero initial times.
+    auto jd = taylor_jet_driver<double>{sys, order};
+    REQUIRE(jd.get_observables().empty());
+
+    std::vector<double> in{.1, .2, .3, .4}, pars{.5, .6}, t0(2u), out(2u * (order + 1u) * 2u), out2(out.size());
+    jd(out.data(), in.data(), 2, pars.data());
+    jd(out2.data(), in.data(), 2, pars.data(), t0.data());
+    REQUIRE(out == out2);
+
+    // Error handling.
+    REQUIRE_THROWS_AS(jd(out.data(), in.data(), 2), std::invalid_argument);
+    REQUIRE_THROWS_AS(jd(nullptr, in.data(), 2, pars.data()), std::invalid_argument);
+    REQUIRE_THROWS_AS(taylor_jet_driver<double>(sys, 0), std::invalid_argument);
+}
+
+TEST_CASE("taylor jet driver threads")
+{
+    auto [x, v] = make_vars("x", "v");
+
+    const auto sys = std::vector{prime(x) = v, prime(v) = -par[0] * sin(x)};
+    const std::uint32_t order = 5;
+    const std::size_t n = 5000;
+
+    llvm_state s;
+    taylor_add_jet<double>(s, "jet", sys, order, 1, false, false);
+    s.compile();
+    auto jptr = reinterpret_cast<void (*)(double *, const double *, const double *)>(s.jit_lookup("jet"));
+
+    std::uniform_real_distribution<double> dist(-1., 1.);
+
+    std::vector<double> in(2u * n), pars(n);
+    for (auto &val : in) {
+        val = dist(rng);
+    }
+    for (auto &val : pars) {
+        val = dist(rng);
+    }
+
+    // Force the use of multiple threads, also in compact mode
+    // (where the jet function uses global arrays).
+    for (std::size_t n_threads : {2u, 8u}) {
+        detail::parallel_set_n_threads(n_threads);
+
+        for (auto cm : {false, true}) {
+            auto jd = taylor_jet_driver<double>{sys, order, kw::batch_size = 2u, kw::compact_mode = cm};
+
+            std::vector<double> out(2u * (order + 1u) * n);
+            jd(out.data(), in.data(), n, pars.data());
+
+            std::vector<double> jet(2u * (order + 1u));
+            for (std::size_t i = 0; i < n; ++i) {
+                jet[0] = in[i];
+                jet[1] = in[n + i];
+                jptr(jet.data(), pars.data() + i, nullptr);
+
+                for (std::size_t j = 0; j < jet.size(); ++j) {
+                    REQUIRE(out[j * n + i] == approximately(jet[j]));
+                }
+            }
+        }
+    }
+
+    detail::parallel_set_n_threads(0);
+}
@@ -0,0 +1,193 @@
+// Copyright 2020, 2021 Francesco Biscani (bluescarni@gmail.com), Dario Izzo (dario.izzo@gmail.com)
+//
+// This file is part of the heyoka library.
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <heyoka/config.hpp>
+
+#include <algorithm>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(HEYOKA_HAVE_REAL128)
+
+#include <mp++/real128.hpp>
+
+#endif
+
+#include <heyoka/expression.hpp>
+#include <heyoka/func.hpp>
+#include <heyoka/llvm_state.hpp>
+#include <heyoka/math/lin_comb.hpp>
+#include <heyoka/math/sin.hpp>
+#include <heyoka/number.hpp>
+#include <heyoka/serialization.hpp>
+#include <heyoka/taylor.hpp>
+
+#include "catch.hpp"
+#include "test_utils.hpp"
+
+using namespace heyoka;
+using namespace heyoka_test;
+
+const auto fp_types = std::tuple<double, long double
+#if defined(HEYOKA_HAVE_REAL128)
+                                 ,
+                                 mppp::real128
+#endif
+                                 >{};
+
+namespace
+{
+
+// Count the linear combinations in a decomposition.
+template <typename Dc>
+auto count_lin_combs(const Dc &dc)
+{
+    return std::count_if(dc.begin(), dc.end(), [](const auto &p) {
+        const auto *f = std::get_if<func>(&p.first.value());
+        return f != nullptr && f->get_name() == "lin_comb";
+    });
+}
+
+} // namespace
+
+TEST_CASE("taylor lin_comb")
+{
+    auto tester = [](auto fp_x, unsigned opt_level, bool high_accuracy, bool compact_mode) {
+        using fp_t = decltype(fp_x);
+
+        auto x = "x"_var, y = "y"_var;
+
+        llvm_state s{kw::opt_level = opt_level};
+
+        taylor_add_jet<fp_t>(s, "jet",
+                             {lin_comb({{2_dbl, x}, {par[0], y}, {3_dbl, par[1]}, {par[1], 5_dbl}}), x + y}, 2, 1,
+                             high_accuracy, compact_mode);
+
+        s.compile();
+
+        auto jptr = reinterpret_cast<void (*)(fp_t *, const fp_t *, const fp_t *)>(s.jit_lookup("jet"));
+
+        std::vector<fp_t> jet{fp_t{2}, fp_t{3}};
+        jet.resize(6);
+
+        const std::vector<fp_t> pars{fp_t{-4}, fp_t{1} / 4};
+
+        jptr(jet.data(), pars.data(), nullptr);
+
+        REQUIRE(jet[0] == 2);
+        REQUIRE(jet[1] == 3);
+        REQUIRE(jet[2] == approximately(2 * jet[0] + pars[0] * jet[1] + 3 * pars[1] + 5 * pars[1]));
+        REQUIRE(jet[3] == approximately(jet[0] + jet[1]));
+        REQUIRE(jet[4] == approximately((2 * jet[2] + pars[0] * jet[3]) / 2));
+        REQUIRE(jet[5] == approximately((jet[2] + jet[3]) / 2));
+    };
+
+    for (auto cm : {false, true}) {
+        for (auto f : {false, true}) {
+            tuple_for_each(fp_types, [&tester, f, cm](auto x) { tester(x, 0, f, cm); });
+            tuple_for_each(fp_types, [&tester, f, cm](auto x) { tester(x, 1, f, cm); });
+            tuple_for_each(fp_types, [&tester, f, cm](auto x) { tester(x, 2, f, cm); });
+            tuple_for_each(fp_types, [&tester, f, cm](auto x) { tester(x, 3, f, cm); });
+        }
+    }
+}
+
+TEST_CASE("taylor linear detection")
+{
+    auto [x, y, z] = make_vars("x", "y", "z");
+
+    // Linear right-hand sides with at least 3 variables
+    // are represented by a single u variable.
+    const auto dc = taylor_decompose({prime(x) = 2. * x - y + z / 4. + 1., prime(y) = -(x + y) + 3. * (z - x),
+                                      prime(z) = x - y});
+    REQUIRE(count_lin_combs(dc) == 2);
+    REQUIRE(dc.size() == 9u);
+
+    // Repeated variables are merged, and variables which
+    // cancel out are removed.
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = x + y + z - z, prime(y) = x, prime(z) = y})) == 0);
+
+    // Nonlinear right-hand sides are left alone.
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = x * y + z + x, prime(y) = x, prime(z) = y})) == 0);
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = par[0] * par[1] * x + y + z, prime(y) = x, prime(z) = y}))
+            == 0);
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = (par[0] + 1.) * x + y + z, prime(y) = x, prime(z) = y}))
+            == 0);
+
+    // Param coefficients, also multiplying sums and
+    // constant terms, are accepted.
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = par[0] * x + y + z, prime(y) = x, prime(z) = y})) == 1);
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = par[0] * (x + y) + 2. * z + x * par[1] + par[2] * .5 + par[3],
+                                              prime(y) = x, prime(z) = y}))
+            == 1);
+
+    // A param coefficient cannot be scaled by a number.
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = 2. * par[0] * x + y + z, prime(y) = x, prime(z) = y}))
+            == 0);
+    REQUIRE(count_lin_combs(taylor_decompose({prime(x) = par[0] * x + y + z + x * par[0], prime(y) = x, prime(z) = y}))
+            == 0);
+
+    // Compare against the standard decomposition, obtained via runtime
+    // parameters as coefficients (hidden behind a nonlinear factor).
+    for (auto cm : {false, true}) {
+        auto ta = taylor_adaptive<double>{
+            {prime(x) = -.1 * x + y - .5 * z, prime(y) = -x - .1 * y + .2, prime(z) = .5 * x - .3 * z + .1 * y},
+            {1., 0., -1.},
+            kw::compact_mode = cm};
+        auto ta_p = taylor_adaptive<double>{{prime(x) = par[0] * x + y + par[1] * z, prime(y) = -x + par[0] * y + .2,
+                                             prime(z) = par[3] * x + par[4] * z + par[2] * y},
+                                            {1., 0., -1.},
+                                            kw::compact_mode = cm,
+                                            kw::pars = {-.1, -.5, .1, .5, -.3}};
+        auto ta_s = taylor_adaptive<double>{{prime(x) = (par[0] + par[5]) * x + y + (par[1] + par[5]) * z,
+                                             prime(y) = -x + par[0] * y + .2,
+                                             prime(z) = (par[3] + par[5]) * x + (par[4] + par[5]) * z + par[2] * y},
+                                            {1., 0., -1.},
+                                            kw::compact_mode = cm,
+                                            kw::pars = {-.1, -.5, .1, .5, -.3, 0.}};
+
+        REQUIRE(count_lin_combs(ta.get_decomposition()) == 2);
+        REQUIRE(count_lin_combs(ta_p.get_decomposition()) == 2);
+        REQUIRE(count_lin_combs(ta_s.get_decomposition()) == 0);
+
+        ta.propagate_until(10.);
+        ta_p.propagate_until(10.);
+        ta_s.propagate_until(10.);
+
+        for (auto i = 0u; i < 3u; ++i) {
+            REQUIRE(ta.get_state()[i] == approximately(ta_s.get_state()[i], 1000.));
+            REQUIRE(ta_p.get_state()[i] == approximately(ta_s.get_state()[i], 1000.));
+        }
+    }
+
+    // Linear blocks next to nonlinear equations.
+    auto ta_nl = taylor_adaptive<double>{
+        {prime(x) = y, prime(y) = -9.8 * sin(x) + .1 * z, prime(z) = x - 2. * y + z / 10.}, {.05, .025, 0.}};
+    REQUIRE(count_lin_combs(ta_nl.get_decomposition()) == 1);
+    ta_nl.propagate_until(1.);
+}
+
+TEST_CASE("lin_comb misc")
+{
+    auto [x, y] = make_vars("x", "y");
+
+    REQUIRE(lin_comb({}) == 0_dbl);
+    REQUIRE_THROWS_AS(lin_comb({{x, y}}), std::invalid_argument);
+
+    const auto lc = lin_comb({{2_dbl, x * y}, {par[0], y}});
+    REQUIRE(diff(lc, "x") == lin_comb({{2_dbl, diff(x * y, "x")}, {par[0], 0_dbl}}));
+
+    std::stringstream ss;
+    save_binary(ss, std::vector{lc});
+    REQUIRE(load_binary_expressions(ss) == std::vector{lc});
+}
@@ -6,6 +6,8 @@
 // Public License v. 2.0. If a copy of the MPL was not distributed
 // with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <cmath>
+#include <cstdint>
 #include <initializer_list>
 #include <tuple>
 #include <vector>
@@ -14,6 +16,8 @@
 #include <xtensor/xview.hpp>
 
 #include <heyoka/expression.hpp>
+#include <heyoka/llvm_state.hpp>
+#include <heyoka/math/cos.hpp>
 #include <heyoka/math/sin.hpp>
 #include <heyoka/taylor.hpp>
 
@@ -187,3 +191,129 @@ TEST_CASE("taylor tc basic")
         }
     }
 }
+
+TEST_CASE("taylor tc observables")
+{
+    using std::cos;
+    using std::sin;
+
+    auto [x, v] = make_vars("x", "v");
+
+    // Jet of derivatives.
+    for (auto cm : {false, true}) {
+        llvm_state s{kw::opt_level = 0u};
+
+        taylor_add_jet<double>(s, "jet", {prime(x) = v, prime(v) = -9.8 * sin(x)}, 2, 1, false, cm,
+                               {x * v, par[0] * x});
+
+        s.compile();
+
+        auto jptr = reinterpret_cast<void (*)(double *, const double *, const double *)>(s.jit_lookup("jet"));
+
+        // NOTE: the layout is [order][x, v, x * v, par[0] * x].
+        std::vector<double> jet{.2, -.3};
+        jet.resize(12);
+        const std::vector<double> pars{3.};
+
+        jptr(jet.data(), pars.data(), nullptr);
+
+        REQUIRE(jet[0] == .2);
+        REQUIRE(jet[1] == -.3);
+        REQUIRE(jet[2] == approximately(.2 * -.3));
+        REQUIRE(jet[3] == approximately(3 * .2));
+
+        REQUIRE(jet[4] == approximately(-.3));
+        REQUIRE(jet[5] == approximately(-9.8 * sin(.2)));
+        REQUIRE(jet[6] == approximately(-.3 * -.3 + .2 * -9.8 * sin(.2)));
+        REQUIRE(jet[7] == approximately(3 * -.3));
+
+        REQUIRE(jet[8] == approximately(-9.8 * sin(.2) / 2));
+        REQUIRE(jet[9] == approximately(-9.8 * cos(.2) * -.3 / 2));
+        REQUIRE(jet[10] == approximately((3 * -.3 * -9.8 * sin(.2) + .2 * -9.8 * cos(.2) * -.3) / 2));
+        REQUIRE(jet[11] == approximately(3 * -9.8 * sin(.2) / 2));
+    }
+
+    // Scalar integrator.
+    for (auto cm : {false, true}) {
+        for (auto ha : {false, true}) {
+            auto ta = taylor_adaptive<double>{{prime(x) = v, prime(v) = -9.8 * sin(x)},
+                                              {0.05, 0.025},
+                                              kw::high_accuracy = ha,
+                                              kw::compact_mode = cm,
+                                              kw::observables = {x * v, cos(x) + par[0]},
+                                              kw::pars = {2.}};
+
+            const auto order = ta.get_order();
+
+            REQUIRE(ta.get_observables().size() == 2u);
+            REQUIRE(ta.get_tc().size() == 4u * (order + 1u));
+            REQUIRE(ta.get_obs_tc_data() == ta.get_tc_data() + 2u * (order + 1u));
+
+            // Evaluate the Taylor polynomial with coefficients tc at h.
+            auto tc_eval = [order](const double *tc, double h) {
+                auto ret = tc[order];
+                for (auto o = order; o > 0u; --o) {
+                    ret = tc[o - 1u] + ret * h;
+                }
+
+                return ret;
+            };
+            auto obs_eval = [&](std::uint32_t i, double h) {
+                return tc_eval(ta.get_obs_tc_data() + i * (order + 1u), h);
+            };
+
+            for (auto i = 0; i < 3; ++i) {
+                const auto old_state = ta.get_state();
+
+                auto [oc, h] = ta.step(true);
+                REQUIRE(oc == taylor_outcome::success);
+
+                const auto &st = ta.get_state();
+
+                REQUIRE(obs_eval(0, 0) == approximately(old_state[0] * old_state[1], 1000.));
+                REQUIRE(obs_eval(1, 0) == approximately(cos(old_state[0]) + 2, 1000.));
+
+                REQUIRE(obs_eval(0, h) == approximately(st[0] * st[1], 1000.));
+                REQUIRE(obs_eval(1, h) == approximately(cos(st[0]) + 2, 1000.));
+
+                // In-step evaluation, checked against
+                // the Taylor polynomials of the state variables.
+                const auto x_mid = tc_eval(ta.get_tc_data(), h / 2);
+                const auto v_mid = tc_eval(ta.get_tc_data() + (order + 1u), h / 2);
+                REQUIRE(obs_eval(0, h / 2) == approximately(x_mid * v_mid, 1000.));
+                REQUIRE(obs_eval(1, h / 2) == approximately(cos(x_mid) + 2, 1000.));
+            }
+
+            // Copy semantics.
+            auto ta_copy = ta;
+            REQUIRE(ta_copy.get_observables() == ta.get_observables());
+            REQUIRE(ta_copy.get_tc() == ta.get_tc());
+        }
+    }
+
+    // Batch integrator.
+    {
+        auto ta = taylor_adaptive_batch<double>{
+            {prime(x) = v, prime(v) = -9.8 * sin(x)}, {0.05, 0.06, 0.025, 0.026}, 2, kw::observables = {x * v}};
+
+        const auto order = ta.get_order();
+
+        REQUIRE(ta.get_tc().size() == 2u * 3u * (order + 1u));
+        REQUIRE(ta.get_obs_tc_data() == ta.get_tc_data() + 2u * 2u * (order + 1u));
+
+        const auto &res = ta.step(true);
+
+        // NOTE: the layout is [var][order][lane].
+        for (std::uint32_t lane = 0; lane < 2u; ++lane) {
+            const auto h = std::get<1>(res[lane]);
+            const auto *tc = ta.get_obs_tc_data();
+
+            auto ret = tc[order * 2u + lane];
+            for (auto o = order; o > 0u; --o) {
+                ret = tc[(o - 1u) * 2u + lane] + ret * h;
+            }
+
+            REQUIRE(ret == approximately(ta.get_state()[lane] * ta.get_state()[2u + lane], 1000.));
+        }
+    }
+}